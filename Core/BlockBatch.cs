@@ -0,0 +1,167 @@
+/* Copyright(c) 2016 UltimaLive
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. 
+*/
+
+
+using System;
+using System.Collections.Generic;
+using Server;
+using Server.Mobiles;
+
+namespace UltimaLive.Network
+{
+    /* Collects land and statics blocks for one player and sends them as compressed BlockBatchPacket
+     * packets instead of one packet per block.  Clients that can't take batches get the usual single 
+     * block packets, so callers don't have to check.  Call Flush once everything has been added.
+     * 
+     * Record format, all big endian:
+     *   byte    type (0 land, 1 statics, 2 land delta)
+     *   uint    block number
+     *   land:       192 bytes of land data
+     *   statics:    uint length, then that many bytes of statics
+     *   land delta: a LandDelta, see LandDelta.cs
+    /**/
+    public class BlockBatch
+    {
+        public const int MAX_BATCH_LENGTH = 0x8000;
+        public const byte RECORD_LAND = 0;
+        public const byte RECORD_STATICS = 1;
+        public const byte RECORD_LAND_DELTA = 2;
+
+        private Mobile m_Mobile;
+        private int m_MapID;
+        private bool m_Supported;
+        private byte[] m_Records;
+        private int m_Length;
+
+        //clients that answer region hash queries also understand batches
+        public static bool IsSupportedBy(Mobile m)
+        {
+            return m is PlayerMobile && ((PlayerMobile)m).UltimaLiveDeltaQueries;
+        }
+
+        public BlockBatch(Mobile m)
+        {
+            m_Mobile = m;
+            m_MapID = m.Map.MapID;
+            m_Supported = IsSupportedBy(m);
+            m_Records = null;
+            m_Length = 0;
+        }
+
+        public void AddLand(Point2D blockCoords)
+        {
+            int blockNumber = (blockCoords.X * m_Mobile.Map.Tiles.BlockHeight) + blockCoords.Y;
+            AddLand(BlockUtility.GetLandData(blockCoords, m_MapID), blockNumber);
+        }
+
+        public void AddLand(byte[] landData, int blockNumber)
+        {
+            if (!m_Supported)
+            {
+                m_Mobile.Send(new UpdateTerrainPacket(landData, blockNumber, m_MapID));
+                return;
+            }
+
+            Reserve(5 + landData.Length);
+            WriteHeader(RECORD_LAND, blockNumber);
+            Buffer.BlockCopy(landData, 0, m_Records, m_Length, landData.Length);
+            m_Length += landData.Length;
+        }
+
+        /* Sends only the tiles in changedTiles, or the whole block when a delta wouldn't be smaller
+         * or the client can't take one
+        /**/
+        public void AddLandDelta(byte[] landData, int blockNumber, ulong changedTiles)
+        {
+            int tileCount = LandDelta.CountTiles(changedTiles);
+            if (!m_Supported || tileCount == 0 || tileCount > LandDelta.MAX_DELTA_TILES)
+            {
+                AddLand(landData, blockNumber);
+                return;
+            }
+
+            byte[] delta = LandDelta.Encode(landData, changedTiles);
+            Reserve(5 + delta.Length);
+            WriteHeader(RECORD_LAND_DELTA, blockNumber);
+            Buffer.BlockCopy(delta, 0, m_Records, m_Length, delta.Length);
+            m_Length += delta.Length;
+        }
+
+        public void AddStatics(Point2D blockCoords)
+        {
+            int blockNumber = (blockCoords.X * m_Mobile.Map.Tiles.BlockHeight) + blockCoords.Y;
+            AddStatics(BlockUtility.GetRawStaticsData(blockCoords, m_MapID), blockNumber);
+        }
+
+        public void AddStatics(byte[] staticsData, int blockNumber)
+        {
+            int recordLength = 9 + staticsData.Length;
+            if (!m_Supported || recordLength > MAX_BATCH_LENGTH)
+            {
+                m_Mobile.Send(new UpdateStaticsPacket(staticsData, blockNumber, m_MapID));
+                return;
+            }
+
+            Reserve(recordLength);
+            WriteHeader(RECORD_STATICS, blockNumber);
+            WriteUInt32((uint)staticsData.Length);
+            Buffer.BlockCopy(staticsData, 0, m_Records, m_Length, staticsData.Length);
+            m_Length += staticsData.Length;
+        }
+
+        public void Flush()
+        {
+            if (m_Length > 0)
+            {
+                m_Mobile.Send(new BlockBatchPacket(m_MapID, m_Records, m_Length));
+                m_Length = 0;
+            }
+        }
+
+        private void Reserve(int recordLength)
+        {
+            if (m_Records == null)
+            {
+                m_Records = new byte[MAX_BATCH_LENGTH];
+            }
+
+            if (m_Length + recordLength > MAX_BATCH_LENGTH)
+            {
+                Flush();
+            }
+        }
+
+        private void WriteHeader(byte type, int blockNumber)
+        {
+            m_Records[m_Length++] = type;
+            WriteUInt32((uint)blockNumber);
+        }
+
+        private void WriteUInt32(uint value)
+        {
+            m_Records[m_Length++] = (byte)(value >> 24);
+            m_Records[m_Length++] = (byte)(value >> 16);
+            m_Records[m_Length++] = (byte)(value >> 8);
+            m_Records[m_Length++] = (byte)value;
+        }
+    }
+}
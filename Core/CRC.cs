@@ -36,6 +36,7 @@ namespace UltimaLive
         public static void InvalidateBlockCRC(int map, int block)
         {
             MapCRCs[map][block] = UInt16.MaxValue;
+            RegionHashTree.InvalidateBlock(map, block);
         }
 
         public static void Configure()
@@ -0,0 +1,102 @@
+/* Copyright(c) 2016 UltimaLive
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. 
+*/
+
+
+
+using System;
+using System.Collections.Generic;
+using Server;
+
+namespace UltimaLive
+{
+    /* Keeps track of which tiles of a land block were changed since its last update went out, so
+     * that a single tile edit can be sent as a delta instead of the whole 192 byte block.
+     * 
+     * Delta format, all big endian:
+     *   ulong   changed tile mask, bit n is tile n ((y * 8) + x within the block)
+     *   ushort  fletcher16 of the whole 192 byte block after the change
+     *   3 bytes per changed tile, in tile order: id low byte, id high byte, z
+     * 
+     * The checksum lets the client drop a delta that was made against a block it doesn't have.
+    /**/
+    public class LandDelta
+    {
+        //past this many changed tiles the full block is smaller
+        public const int MAX_DELTA_TILES = 60;
+
+        private static Dictionary<long, ulong> m_ChangedTiles = new Dictionary<long, ulong>();
+
+        public static void MarkTile(int map, int block, int tileIndex)
+        {
+            long key = ((long)map << 32) | (uint)block;
+            ulong mask;
+            m_ChangedTiles.TryGetValue(key, out mask);
+            m_ChangedTiles[key] = mask | (1UL << tileIndex);
+        }
+
+        /* Returns the tiles changed in a block since the last call for it, or 0 if nothing was recorded */
+        public static ulong TakeChangedTiles(int map, int block)
+        {
+            long key = ((long)map << 32) | (uint)block;
+            ulong mask;
+            if (m_ChangedTiles.TryGetValue(key, out mask))
+            {
+                m_ChangedTiles.Remove(key);
+            }
+            return mask;
+        }
+
+        public static int CountTiles(ulong mask)
+        {
+            int count = 0;
+            for (; mask != 0; mask &= mask - 1)
+            {
+                count++;
+            }
+            return count;
+        }
+
+        public static byte[] Encode(byte[] landData, ulong mask)
+        {
+            byte[] delta = new byte[10 + (CountTiles(mask) * 3)];
+            for (int i = 0; i < 8; i++)
+            {
+                delta[i] = (byte)(mask >> (56 - (i * 8)));
+            }
+
+            UInt16 crc = CRC.Fletcher16(landData);
+            delta[8] = (byte)(crc >> 8);
+            delta[9] = (byte)crc;
+
+            int position = 10;
+            for (int tile = 0; tile < 64; tile++)
+            {
+                if ((mask & (1UL << tile)) != 0)
+                {
+                    Buffer.BlockCopy(landData, tile * 3, delta, position, 3);
+                    position += 3;
+                }
+            }
+            return delta;
+        }
+    }
+}
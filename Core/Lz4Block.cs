@@ -0,0 +1,132 @@
+/* Copyright(c) 2016 UltimaLive
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. 
+*/
+
+
+using System;
+
+namespace UltimaLive
+{
+    /* Compressor for the LZ4 block format, used for block batches.  The client only has the decoder 
+     * (Network/Lz4Block.cpp).  This is the simple single pass version: one hash table of 4 byte 
+     * sequences, greedy matching, no chains.  Map data is mostly repeated tiles, so that is enough.
+     * 
+     * The format requires the last 5 bytes to be literals and the last match to start at least 12 
+     * bytes before the end of the input.
+    /**/
+    public class Lz4Block
+    {
+        private const int MIN_MATCH = 4;
+        private const int HASH_LOG = 12;
+        private const int LAST_LITERALS = 5;
+        private const int MATCH_FIND_LIMIT = 12;
+        private const int MAX_OFFSET = 0xFFFF;
+
+        public static int MaxCompressedLength(int length)
+        {
+            return length + (length / 255) + 16;
+        }
+
+        /* Compresses length bytes of source into destination, which must hold at least
+         * MaxCompressedLength(length) bytes.  Returns the compressed length.
+        /**/
+        public static int Compress(byte[] source, int length, byte[] destination)
+        {
+            int[] table = new int[1 << HASH_LOG];
+            int anchor = 0;
+            int input = 0;
+            int output = 0;
+            int matchLimit = length - MATCH_FIND_LIMIT;
+
+            while (input < matchLimit)
+            {
+                uint sequence = Read32(source, input);
+                int hash = (int)((sequence * 2654435761u) >> (32 - HASH_LOG));
+                int reference = table[hash] - 1;
+                table[hash] = input + 1;
+
+                if (reference < 0 || input - reference > MAX_OFFSET || Read32(source, reference) != sequence)
+                {
+                    input++;
+                    continue;
+                }
+
+                int matchLength = MIN_MATCH;
+                int maxMatchLength = length - LAST_LITERALS - input;
+                while (matchLength < maxMatchLength && source[reference + matchLength] == source[input + matchLength])
+                {
+                    matchLength++;
+                }
+
+                output = WriteSequence(source, anchor, input - anchor, destination, output, input - reference, matchLength);
+                input += matchLength;
+                anchor = input;
+            }
+
+            return WriteSequence(source, anchor, length - anchor, destination, output, 0, 0);
+        }
+
+        //a match length of 0 writes the final literals only sequence
+        private static int WriteSequence(byte[] source, int literals, int literalLength, byte[] destination, int output, int offset, int matchLength)
+        {
+            int token = output++;
+            destination[token] = (byte)(Math.Min(literalLength, 15) << 4);
+            if (literalLength >= 15)
+            {
+                output = WriteLength(destination, output, literalLength - 15);
+            }
+
+            Buffer.BlockCopy(source, literals, destination, output, literalLength);
+            output += literalLength;
+
+            if (matchLength > 0)
+            {
+                destination[output++] = (byte)(offset & 0xFF);
+                destination[output++] = (byte)(offset >> 8);
+
+                int extraMatchLength = matchLength - MIN_MATCH;
+                destination[token] |= (byte)Math.Min(extraMatchLength, 15);
+                if (extraMatchLength >= 15)
+                {
+                    output = WriteLength(destination, output, extraMatchLength - 15);
+                }
+            }
+
+            return output;
+        }
+
+        private static int WriteLength(byte[] destination, int output, int length)
+        {
+            while (length >= 255)
+            {
+                destination[output++] = 255;
+                length -= 255;
+            }
+            destination[output++] = (byte)length;
+            return output;
+        }
+
+        private static uint Read32(byte[] data, int position)
+        {
+            return (uint)(data[position] | (data[position + 1] << 8) | (data[position + 2] << 16) | (data[position + 3] << 24));
+        }
+    }
+}
@@ -93,13 +93,20 @@ namespace UltimaLive
 
             if (sendoutUpdates)
             {
+                //one batch per player for the whole series instead of a packet per block
+                Dictionary<Mobile, UltimaLive.Network.BlockBatch> batches = new Dictionary<Mobile, UltimaLive.Network.BlockBatch>();
                 foreach (KeyValuePair<int, LocalUpdateFlags> kvp in blockUpdateChain)
                 {
                     if (kvp.Key >= 0)
                     {
-                        BaseMapOperation.SendOutLocalUpdates( m_MapNumber, kvp.Key, kvp.Value);
+                        BaseMapOperation.SendOutLocalUpdates( m_MapNumber, kvp.Key, kvp.Value, batches);
                     }
                 }
+
+                foreach (UltimaLive.Network.BlockBatch batch in batches.Values)
+                {
+                    batch.Flush();
+                }
             }
         }
 
@@ -126,9 +133,65 @@ namespace UltimaLive
             SendOutLocalUpdates(map, x, y, flags);
         }
 
+        public static void SendOutLocalUpdates(int mapNum, int blockNumber, LocalUpdateFlags flags, Dictionary<Mobile, UltimaLive.Network.BlockBatch> batches)
+        {
+            Map map = Map.Maps[mapNum];
+            TileMatrix tm = map.Tiles;
+            int x = ((blockNumber / tm.BlockHeight) * 8) + 4;
+            int y = ((blockNumber % tm.BlockHeight) * 8) + 4;
+
+            byte[] landData = null;
+            ulong changedTiles = 0;
+            if ((flags & LocalUpdateFlags.Terrain) == LocalUpdateFlags.Terrain)
+            {
+                landData = BlockUtility.GetLandData(blockNumber, mapNum);
+                changedTiles = LandDelta.TakeChangedTiles(mapNum, blockNumber);
+            }
+
+            IPooledEnumerable eable = map.GetMobilesInRange(new Point3D(x, y, 0));
+            List<Mobile> candidates = new List<Mobile>();
+            foreach (Mobile m in eable)
+            {
+                if (m.Player)
+                {
+                    candidates.Add(m);
+                }
+            }
+            eable.Free();
+
+            foreach (Mobile m in candidates)
+            {
+                UltimaLive.Network.BlockBatch batch;
+                if (!batches.TryGetValue(m, out batch))
+                {
+                    batch = new UltimaLive.Network.BlockBatch(m);
+                    batches[m] = batch;
+                }
+
+                if ((flags & LocalUpdateFlags.Terrain) == LocalUpdateFlags.Terrain)
+                {
+                    batch.AddLandDelta(landData, blockNumber, changedTiles);
+                }
+
+                if ((flags & LocalUpdateFlags.Statics) == LocalUpdateFlags.Statics)
+                {
+                    batch.AddStatics(new Point2D(x >> 3, y >> 3));
+                }
+            }
+        }
+
         public static void SendOutLocalUpdates(Map map, int x, int y, LocalUpdateFlags flags)
         {
             List<Mobile> candidates = new List<Mobile>();
+            int blockNumber = ((x >> 3) * map.Tiles.BlockHeight) + (y >> 3);
+
+            byte[] landData = null;
+            ulong changedTiles = 0;
+            if ((flags & LocalUpdateFlags.Terrain) == LocalUpdateFlags.Terrain)
+            {
+                landData = BlockUtility.GetLandData(new Point2D(x >> 3, y >> 3), map.MapID);
+                changedTiles = LandDelta.TakeChangedTiles(map.MapID, blockNumber);
+            }
 
             IPooledEnumerable eable = map.GetMobilesInRange(new Point3D(x, y, 0));
 
@@ -145,7 +208,9 @@ namespace UltimaLive
             {
                 if ((flags & LocalUpdateFlags.Terrain) == LocalUpdateFlags.Terrain)
                 {
-                  m.Send(new UltimaLive.Network.UpdateTerrainPacket(new Point2D(x >> 3, y >> 3), m));
+                  UltimaLive.Network.BlockBatch batch = new UltimaLive.Network.BlockBatch(m);
+                  batch.AddLandDelta(landData, blockNumber, changedTiles);
+                  batch.Flush();
                 }
 
                 if ((flags & LocalUpdateFlags.Statics) == LocalUpdateFlags.Statics)
@@ -544,6 +609,7 @@ namespace UltimaLive
         {
             base.DoOperation(blockUpdateChain);
             MapChangeTracker.MarkLandBlockForSave(m_Map.MapID, new Point2D(m_Location.X >> 3, m_Location.Y >> 3));
+            LandDelta.MarkTile(m_MapNumber, m_BlockNumber, m_TileIndex);
 
 
             if (blockUpdateChain == null)
@@ -102,6 +102,7 @@ namespace UltimaLive
     private static void EventSink_Login(LoginEventArgs args)
     {
       args.Mobile.Send(new UltimaLive.Network.QueryClientHash(args.Mobile));
+      UltimaLivePacketHandlers.StartRegionReconciliation(args.Mobile);
     }
   }
 }
\ No newline at end of file
@@ -46,7 +46,14 @@ namespace UltimaLive
 
             if (blocknum != previousMapBlock)
             {
-              m.Send(new QueryClientHash(m));
+              if (m is PlayerMobile && ((PlayerMobile)m).UltimaLiveDeltaQueries)
+              {
+                m.Send(new DeltaQueryClientHash(m));
+              }
+              else
+              {
+                m.Send(new QueryClientHash(m));
+              }
             }
 
             return blocknum;
@@ -13,6 +13,7 @@ namespace Server.Mobiles
     private int m_PreviousMapBlock = -1;
     private int m_UltimaLiveMajorVersion = 0;
     private int m_UltimaLiveMinorVersion = 0;
+    private bool m_UltimaLiveDeltaQueries = false;
 
     [CommandProperty(AccessLevel.GameMaster, true)]
     public int UltimaLiveMajorVersion
@@ -39,5 +40,19 @@ namespace Server.Mobiles
         m_UltimaLiveMinorVersion = value;
       }
     }
+
+    //set once the client has answered a query that only newer clients understand
+    [CommandProperty(AccessLevel.GameMaster, true)]
+    public bool UltimaLiveDeltaQueries
+    {
+      get
+      {
+        return m_UltimaLiveDeltaQueries;
+      }
+      set
+      {
+        m_UltimaLiveDeltaQueries = value;
+      }
+    }
   }
 }
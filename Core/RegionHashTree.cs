@@ -0,0 +1,277 @@
+/* Copyright(c) 2016 UltimaLive
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. 
+*/
+
+
+using System;
+using System.Collections.Generic;
+using Server;
+
+namespace UltimaLive
+{
+    /* Hash tree over the blocks of a map, matching RegionHashTree on the client.  Level 0 is the 
+     * blocks and their hashes are the block CRCs.  Each node above covers 4x4 nodes of the level 
+     * below, and its hash is FNV-1a 32 over its children's hashes (4 bytes each, low byte first), 
+     * walking the children a column at a time.  The top level is the first one with a single node.
+     * 
+     * Hashes are computed as they are asked for and dropped whenever a block under them changes.
+     * 
+     * Verify checks the tree against a synthetic map whose node hashes are fixed in the client's 
+     * RegionHashTreeTests.cpp, and runs when the server starts.
+    /**/
+    public class RegionHashTree
+    {
+        public delegate ushort BlockCrcSource(int block);
+
+        public const int REGION_SIZE_SHIFT = 2;
+        public const int REGION_SIZE = 1 << REGION_SIZE_SHIFT;
+        public const int MAX_NODES_PER_QUERY = 256;
+        private const uint FNV_OFFSET_BASIS = 2166136261;
+        private const uint FNV_PRIME = 16777619;
+
+        //[map]
+        private static Dictionary<int, RegionHashTree> m_Trees = new Dictionary<int, RegionHashTree>();
+
+        public static RegionHashTree GetTree(int mapID)
+        {
+            RegionHashTree tree;
+            if (!m_Trees.TryGetValue(mapID, out tree))
+            {
+                tree = new RegionHashTree(mapID);
+                m_Trees[mapID] = tree;
+            }
+            return tree;
+        }
+
+        public static void InvalidateBlock(int mapID, int block)
+        {
+            RegionHashTree tree;
+            if (m_Trees.TryGetValue(mapID, out tree))
+            {
+                tree.InvalidateBlock(block);
+            }
+        }
+
+        private int m_MapID;
+        private BlockCrcSource m_GetBlockCrc;
+        private int[] m_Widths;
+        private int[] m_Heights;
+        private uint[][] m_Hashes;
+        private bool[][] m_Valid;
+
+        public RegionHashTree(int mapID)
+            : this(Map.Maps[mapID].Tiles.BlockWidth, Map.Maps[mapID].Tiles.BlockHeight, null)
+        {
+            m_MapID = mapID;
+            m_GetBlockCrc = GetMapBlockCrc;
+        }
+
+        /* A tree over a map of the given size whose block CRCs come from getBlockCrc */
+        public RegionHashTree(int blockWidth, int blockHeight, BlockCrcSource getBlockCrc)
+        {
+            m_GetBlockCrc = getBlockCrc;
+
+            List<int> widths = new List<int>();
+            List<int> heights = new List<int>();
+            widths.Add(blockWidth);
+            heights.Add(blockHeight);
+            while (widths[widths.Count - 1] > 1 || heights[heights.Count - 1] > 1)
+            {
+                widths.Add((widths[widths.Count - 1] + REGION_SIZE - 1) >> REGION_SIZE_SHIFT);
+                heights.Add((heights[heights.Count - 1] + REGION_SIZE - 1) >> REGION_SIZE_SHIFT);
+            }
+
+            m_Widths = widths.ToArray();
+            m_Heights = heights.ToArray();
+            m_Hashes = new uint[m_Widths.Length][];
+            m_Valid = new bool[m_Widths.Length][];
+            for (int level = 1; level < m_Widths.Length; level++)
+            {
+                m_Hashes[level] = new uint[m_Widths[level] * m_Heights[level]];
+                m_Valid[level] = new bool[m_Widths[level] * m_Heights[level]];
+            }
+        }
+
+        public int Levels
+        {
+            get { return m_Widths.Length; }
+        }
+
+        public int GetNodeCount(int level)
+        {
+            if (level < 0 || level >= m_Widths.Length)
+            {
+                return 0;
+            }
+            return m_Widths[level] * m_Heights[level];
+        }
+
+        public uint GetNodeHash(int level, int node)
+        {
+            if (node < 0 || node >= GetNodeCount(level))
+            {
+                return 0;
+            }
+
+            if (level == 0)
+            {
+                return m_GetBlockCrc(node);
+            }
+
+            if (!m_Valid[level][node])
+            {
+                int firstX = (node / m_Heights[level]) << REGION_SIZE_SHIFT;
+                int firstY = (node % m_Heights[level]) << REGION_SIZE_SHIFT;
+                uint hash = FNV_OFFSET_BASIS;
+
+                for (int x = firstX; x < firstX + REGION_SIZE && x < m_Widths[level - 1]; x++)
+                {
+                    for (int y = firstY; y < firstY + REGION_SIZE && y < m_Heights[level - 1]; y++)
+                    {
+                        uint childHash = GetNodeHash(level - 1, (x * m_Heights[level - 1]) + y);
+                        for (int i = 0; i < 4; i++)
+                        {
+                            hash ^= (childHash >> (i * 8)) & 0xFF;
+                            hash *= FNV_PRIME;
+                        }
+                    }
+                }
+
+                m_Hashes[level][node] = hash;
+                m_Valid[level][node] = true;
+            }
+
+            return m_Hashes[level][node];
+        }
+
+        private ushort GetMapBlockCrc(int node)
+        {
+            //CRC caching
+            UInt16 crc = CRC.MapCRCs[m_MapID][node];
+            if (crc == UInt16.MaxValue)
+            {
+                byte[] landData = new byte[0];
+                byte[] staticsData = new byte[0];
+                Point2D blockPosition = new Point2D(node / m_Heights[0], node % m_Heights[0]);
+                crc = UltimaLivePacketHandlers.GetBlockCrc(blockPosition, m_MapID, ref landData, ref staticsData);
+                CRC.MapCRCs[m_MapID][node] = crc;
+            }
+            return crc;
+        }
+
+        /* Appends the nodes one level down that make up a node */
+        public void GetChildren(int level, int node, List<int> children)
+        {
+            if (level < 1 || node < 0 || node >= GetNodeCount(level))
+            {
+                return;
+            }
+
+            int firstX = (node / m_Heights[level]) << REGION_SIZE_SHIFT;
+            int firstY = (node % m_Heights[level]) << REGION_SIZE_SHIFT;
+            for (int x = firstX; x < firstX + REGION_SIZE && x < m_Widths[level - 1]; x++)
+            {
+                for (int y = firstY; y < firstY + REGION_SIZE && y < m_Heights[level - 1]; y++)
+                {
+                    children.Add((x * m_Heights[level - 1]) + y);
+                }
+            }
+        }
+
+        /* The lowest level whose nodes all fit in a single query */
+        public int StartingLevel
+        {
+            get
+            {
+                int level = 0;
+                while (GetNodeCount(level) > MAX_NODES_PER_QUERY && level < m_Widths.Length - 1)
+                {
+                    level++;
+                }
+                return level;
+            }
+        }
+
+        public void InvalidateBlock(int block)
+        {
+            if (block < 0 || block >= GetNodeCount(0))
+            {
+                return;
+            }
+
+            int x = block / m_Heights[0];
+            int y = block % m_Heights[0];
+            for (int level = 1; level < m_Widths.Length; level++)
+            {
+                x >>= REGION_SIZE_SHIFT;
+                y >>= REGION_SIZE_SHIFT;
+                m_Valid[level][(x * m_Heights[level]) + y] = false;
+            }
+        }
+
+        public static void Initialize()
+        {
+            if (!Verify())
+            {
+                Console.WriteLine("UltimaLive: RegionHashTree does not hash nodes the way the client does, region hash queries will not match");
+            }
+        }
+
+        /* Builds the tree over the 9x6 block map of the client's RegionHashTreeTests.cpp and checks 
+         * every node hash against the values the client test expects, before and after a block changes
+        /**/
+        public static bool Verify()
+        {
+            uint[] level1Hashes = { 0x67CF73DC, 0x8B281DA2, 0xE8DAE345, 0xCE2D5106, 0xCBEFE3CA, 0xC9E9C4B8 };
+            const uint topHash = 0x8A7D78A1;
+            const int changedBlock = 22;
+            const uint changedLevel1Hash = 0xA09FFB27;
+            const uint changedTopHash = 0xFDCF5BA4;
+
+            bool blockChanged = false;
+            RegionHashTree tree = new RegionHashTree(9, 6, delegate(int block)
+            {
+                if (blockChanged && block == changedBlock)
+                {
+                    return 0xBEEF;
+                }
+                return (ushort)((block * 40503) + 4660);
+            });
+
+            if (tree.Levels != 3 || tree.GetNodeHash(2, 0) != topHash)
+            {
+                return false;
+            }
+
+            for (int node = 0; node < level1Hashes.Length; node++)
+            {
+                if (tree.GetNodeHash(1, node) != level1Hashes[node])
+                {
+                    return false;
+                }
+            }
+
+            blockChanged = true;
+            tree.InvalidateBlock(changedBlock);
+            return tree.GetNodeHash(1, 1) == changedLevel1Hash && tree.GetNodeHash(2, 0) == changedTopHash;
+        }
+    }
+}
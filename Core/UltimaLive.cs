@@ -720,6 +720,7 @@ namespace UltimaLive
       }
 
       TileMatrix matrix = targetMap.Tiles;
+      Dictionary<Mobile, BlockBatch> batches = new Dictionary<Mobile, BlockBatch>();
       foreach (KeyValuePair<Point2D, List<Item>> kvp in ItemsByBlockLocation)
       {
         StaticTile[][][] blockOfTiles = matrix.GetStaticBlock(kvp.Key.X, kvp.Key.Y);
@@ -802,10 +803,21 @@ namespace UltimaLive
         CRC.InvalidateBlockCRC(targetMap.MapID, blockNum);
         foreach (Mobile m in candidates)
         {
-          m.Send(new UpdateStaticsPacket(new Point2D(kvp.Key.X, kvp.Key.Y), m));
+          BlockBatch batch;
+          if (!batches.TryGetValue(m, out batch))
+          {
+            batch = new BlockBatch(m);
+            batches[m] = batch;
+          }
+          batch.AddStatics(new Point2D(kvp.Key.X, kvp.Key.Y));
         }
         MapChangeTracker.MarkStaticsBlockForSave(targetMap.MapID, kvp.Key);
       }
+
+      foreach (BlockBatch batch in batches.Values)
+      {
+        batch.Flush();
+      }
     }
 
     public static void SendWarning(Mobile m, string header, string baseWarning, Map map, Point3D start, Point3D end, WarningGumpCallback callback)
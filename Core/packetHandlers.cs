@@ -60,6 +60,7 @@ namespace UltimaLive
         Console.WriteLine("Reseting UltimaLive Major and Minor version for " + player.Name);
         player.UltimaLiveMajorVersion = 0;
         player.UltimaLiveMinorVersion = 0;
+        player.UltimaLiveDeltaQueries = false;
       }
     }
 
@@ -81,6 +82,18 @@ namespace UltimaLive
           }
           break;
 
+        case 0x04: //region hash query response
+          {
+            HandleRegionHashReply(state, pvSrc);
+          }
+          break;
+
+        case 0x05: //delta block query response
+          {
+            HandleDeltaBlockQueryReply(state, pvSrc);
+          }
+          break;
+
         case 0xFE: //read client version of UltimaLive
           {
             pvSrc.Seek(15, SeekOrigin.Begin);
@@ -145,6 +158,159 @@ namespace UltimaLive
       PushBlockUpdates((int)blocknum, (int)mapID, receivedCRCs, from);
     }
 
+    /*
+     * The answer to a delta block query only carries the blocks of the 5x5
+     * window that weren't in the last window the client answered, each as
+     * its position in the window and its CRC.  The rest were already
+     * compared on an earlier step.
+    /**/
+    public static void HandleDeltaBlockQueryReply(NetState state, PacketReader pvSrc)
+    {
+      Mobile from = state.Mobile;
+      if (from == null || from.Map == null)
+      {
+        return;
+      }
+
+      //byte 000              -  cmd
+      //byte 001 through 002  -  packet size
+      pvSrc.Seek(3, SeekOrigin.Begin);            //byte 003 through 006  -  central block number for the query (block that player is standing in)
+      UInt32 blocknum = pvSrc.ReadUInt32();
+      //byte 007 through 010  -  number of statics in the packet (payload rounded up to 7 bytes)
+      //byte 011 through 012  -  UltimaLive sequence number
+      //byte 013              -  UltimaLive command (0x05 is a delta block query response)
+      pvSrc.Seek(14, SeekOrigin.Begin);           //byte 014              -  UltimaLive mapnumber
+      Int32 mapID = (Int32)pvSrc.ReadByte();
+
+      if (mapID != from.Map.MapID)
+      {
+        Console.WriteLine(string.Format("Received a delta block query response from {0} for map {1} but that player is on map {2}",
+            from.Name, mapID, from.Map.MapID));
+        return;
+      }
+
+      UInt16[] receivedCRCs = new UInt16[25];
+      bool[] received = new bool[25];
+      int count = Math.Min((int)pvSrc.ReadByte(), 25); //byte 015              -  number of blocks
+      for (int i = 0; i < count; i++)                  //byte 016 through end  -  window position and CRC of each block
+      {
+        int position = pvSrc.ReadByte();
+        UInt16 crc = pvSrc.ReadUInt16();
+        if (position < 25)
+        {
+          receivedCRCs[position] = crc;
+          received[position] = true;
+        }
+      }
+
+      PushBlockUpdates((int)blocknum, (int)mapID, receivedCRCs, received, from);
+    }
+
+    /*
+     * At login we ask the client for the hashes of the regions of its map
+     * instead of waiting for it to walk around.  Each reply is compared 
+     * against the server's region hash tree, the children of every region 
+     * that differs are asked for next, and once we're down to single blocks 
+     * the blocks that differ are sent.  Unchanged regions cost one node in 
+     * one round trip.
+    /**/
+    public static void StartRegionReconciliation(Mobile m)
+    {
+      if (m == null || m.Map == null || m.Map == Map.Internal || !MapRegistry.Definitions.ContainsKey(m.Map.MapID))
+      {
+        return;
+      }
+
+      RegionHashTree tree = RegionHashTree.GetTree(m.Map.MapID);
+      int level = tree.StartingLevel;
+      List<int> nodes = new List<int>();
+      for (int i = 0; i < tree.GetNodeCount(level); i++)
+      {
+        nodes.Add(i);
+      }
+      SendRegionHashQueries(m, m.Map.MapID, level, nodes);
+    }
+
+    public static void SendRegionHashQueries(Mobile m, int mapID, int level, List<int> nodes)
+    {
+      for (int offset = 0; offset < nodes.Count; offset += RegionHashTree.MAX_NODES_PER_QUERY)
+      {
+        int count = Math.Min(RegionHashTree.MAX_NODES_PER_QUERY, nodes.Count - offset);
+        m.Send(new UltimaLive.Network.RegionHashQuery(mapID, level, nodes, offset, count));
+      }
+    }
+
+    public static void HandleRegionHashReply(NetState state, PacketReader pvSrc)
+    {
+      Mobile from = state.Mobile;
+      if (from == null || from.Map == null)
+      {
+        return;
+      }
+
+      //byte 000              -  cmd
+      //byte 001 through 002  -  packet size
+      pvSrc.Seek(3, SeekOrigin.Begin);            //byte 003 through 006  -  tree level of the nodes in the reply
+      int level = (int)pvSrc.ReadUInt32();
+      //byte 007 through 010  -  number of statics in the packet (payload rounded up to 7 bytes)
+      //byte 011 through 012  -  UltimaLive sequence number
+      //byte 013              -  UltimaLive command (0x04 is a region hash query response)
+      pvSrc.Seek(14, SeekOrigin.Begin);           //byte 014              -  UltimaLive mapnumber
+      Int32 mapID = (Int32)pvSrc.ReadByte();
+
+      if (mapID != from.Map.MapID || !MapRegistry.Definitions.ContainsKey(mapID))
+      {
+        Console.WriteLine(string.Format("Received a region hash response from {0} for map {1} but that player is on map {2}",
+            from.Name, mapID, from.Map.MapID));
+        return;
+      }
+
+      if (from is PlayerMobile)
+      {
+        ((PlayerMobile)from).UltimaLiveDeltaQueries = true;
+      }
+
+      RegionHashTree tree = RegionHashTree.GetTree(mapID);
+      if (level < 0 || level >= tree.Levels)
+      {
+        return;
+      }
+
+      int count = Math.Min((int)pvSrc.ReadUInt16(), RegionHashTree.MAX_NODES_PER_QUERY); //byte 015 through 016  -  number of nodes
+      List<int> divergent = new List<int>();
+      for (int i = 0; i < count; i++)                                                     //byte 017 through end  -  node index and hash pairs
+      {
+        int node = (int)pvSrc.ReadUInt32();
+        uint hash = pvSrc.ReadUInt32();
+        if (node >= 0 && node < tree.GetNodeCount(level) && tree.GetNodeHash(level, node) != hash)
+        {
+          divergent.Add(node);
+        }
+      }
+
+      if (level == 0)
+      {
+        int blockHeight = from.Map.Tiles.BlockHeight;
+        UltimaLive.Network.BlockBatch batch = new UltimaLive.Network.BlockBatch(from);
+        foreach (int block in divergent)
+        {
+          Point2D blockPosition = new Point2D(block / blockHeight, block % blockHeight);
+          batch.AddLand(blockPosition);
+          batch.AddStatics(blockPosition);
+        }
+        batch.Flush();
+      }
+      else if (divergent.Count > 0)
+      {
+        List<int> children = new List<int>();
+        foreach (int node in divergent)
+        {
+          tree.GetChildren(level, node, children);
+        }
+        SendRegionHashQueries(from, mapID, level - 1, children);
+      }
+    }
+
     public static UInt16 GetBlockCrc(Point2D blockCoords, int mapID, ref byte[] landDataOut, ref byte[] staticsDataOut)
     {
       if (blockCoords.X < 0 || blockCoords.Y < 0 || (blockCoords.X) >= Map.Maps[mapID].Tiles.BlockWidth || (blockCoords.Y) >= Map.Maps[mapID].Tiles.BlockHeight)
@@ -163,6 +329,12 @@ namespace UltimaLive
     }
 
     public static void PushBlockUpdates(int block, int mapID, UInt16[] recievedCRCs, Mobile from)
+    {
+      PushBlockUpdates(block, mapID, recievedCRCs, null, from);
+    }
+
+    //only the positions flagged in received are compared, or all 25 if it is null
+    public static void PushBlockUpdates(int block, int mapID, UInt16[] recievedCRCs, bool[] received, Mobile from)
     {
       //Console.WriteLine("------------------------------------------Push Block Updates----------------------------------------");
       //Console.WriteLine("Map: " + mapID);
@@ -196,6 +368,7 @@ namespace UltimaLive
       }
 
       byte[] buf = new byte[2];
+      UltimaLive.Network.BlockBatch batch = new UltimaLive.Network.BlockBatch(from);
 
       for (int x = -2; x <= 2; x++)
       {
@@ -237,6 +410,11 @@ namespace UltimaLive
             }
           }
 
+          if (received != null && !received[((x + 2) * 5) + (y + 2)])
+          {
+            continue;
+          }
+
           Int32 blocknum = (xBlockItr * mapHeightInBlocks) + yBlockItr;
 
           //CRC caching
@@ -257,18 +435,20 @@ namespace UltimaLive
           {
             if (landData.Length < 1)
             {
-              from.Send(new UltimaLive.Network.UpdateTerrainPacket(blockPosition, from));
-              from.Send(new UltimaLive.Network.UpdateStaticsPacket(blockPosition, from));
+              batch.AddLand(blockPosition);
+              batch.AddStatics(blockPosition);
             }
             else
             {
-              from.Send(new UltimaLive.Network.UpdateTerrainPacket(landData, blocknum, from.Map.MapID));
-              from.Send(new UltimaLive.Network.UpdateStaticsPacket(staticsData, blocknum, from.Map.MapID));
+              batch.AddLand(landData, blocknum);
+              batch.AddStatics(staticsData, blocknum);
             }
           }
         }
       }
 
+      batch.Flush();
+
       //if (refreshClientView)
       //{
       //  from.Send(new RefreshClientView());
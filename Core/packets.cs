@@ -145,6 +145,84 @@ namespace UltimaLive.Network
     }
     #endregion
 
+    #region Delta Query Client Hash Packet
+    //Same as QueryClientHash, but the client only answers with the blocks that weren't in the last window it answered
+    public class DeltaQueryClientHash : Packet 
+    {
+        public DeltaQueryClientHash(Mobile m)
+            : base(0x3F)
+        {
+            Map playerMap = m.Map;
+            TileMatrix tm = playerMap.Tiles;
+            int blocknum = (((m.Location.X >> 3) * tm.BlockHeight) + (m.Location.Y >> 3));
+
+                                                        //byte 000         -  cmd
+            this.EnsureCapacity(15);                    //byte 001 to 002  -  packet size
+            m_Stream.Write((UInt32)blocknum);           //byte 003 to 006  -  central block number for the query (block that player is standing in)
+            m_Stream.Write((Int32)0);                   //byte 007 to 010  -  number of statics in the packet (0 for a query)
+            m_Stream.Write((UInt16)0x0000);             //byte 011 to 012  -  UltimaLive sequence number
+            m_Stream.Write((byte)0x05);                 //byte 013         -  UltimaLive command (0x05 is a Delta Block Query)
+            m_Stream.Write((byte)playerMap.MapID);      //byte 014         -  UltimaLive mapnumber
+        }
+    }
+    #endregion
+
+    #region Region Hash Query Packet
+    //Asks the client for the hashes of a set of region hash tree nodes, see RegionHashTree
+    public class RegionHashQuery : Packet
+    {
+        public RegionHashQuery(int mapID, int level, List<int> nodes, int offset, int count)
+            : base(0x3F)
+        {
+            int length = 2 + (count * 4);
+            int statics = (length + 6) / 7;
+                                                        //byte 000         -  cmd
+            this.EnsureCapacity(15 + (statics * 7));    //byte 001 to 002  -  packet size
+            m_Stream.Write((UInt32)level);              //byte 003 to 006  -  tree level of the requested nodes
+            m_Stream.Write((Int32)statics);             //byte 007 to 010  -  number of statics in the packet (payload rounded up to 7 bytes)
+            m_Stream.Write((UInt16)0x0000);             //byte 011 to 012  -  UltimaLive sequence number
+            m_Stream.Write((byte)0x04);                 //byte 013         -  UltimaLive command (0x04 is a Region Hash Query)
+            m_Stream.Write((byte)mapID);                //byte 014         -  UltimaLive mapnumber
+            m_Stream.Write((UInt16)count);              //byte 015 to 016  -  number of nodes
+            for (int i = offset; i < offset + count; i++)
+            {
+                m_Stream.Write((UInt32)nodes[i]);       //byte 017 to ???  -  node indices
+            }
+            for (int i = length; i < statics * 7; i++)
+            {
+                m_Stream.Write((byte)0xFF);             //padding
+            }
+        }
+    }
+    #endregion
+
+    #region Block Batch Packet
+    //Many land and statics blocks in one LZ4 compressed payload, see BlockBatch for the record format
+    public class BlockBatchPacket : Packet
+    {
+        public BlockBatchPacket(int mapID, byte[] records, int length)
+            : base(0x3F)
+        {
+            byte[] compressed = new byte[Lz4Block.MaxCompressedLength(length)];
+            int compressedLength = Lz4Block.Compress(records, length, compressed);
+            int statics = (4 + compressedLength + 6) / 7;
+                                                        //byte 000         -  cmd
+            this.EnsureCapacity(15 + (statics * 7));    //byte 001 to 002  -  packet size
+            m_Stream.Write((UInt32)length);             //byte 003 to 006  -  uncompressed length of the records
+            m_Stream.Write((Int32)statics);             //byte 007 to 010  -  number of statics in the packet (payload rounded up to 7 bytes)
+            m_Stream.Write((UInt16)0x0000);             //byte 011 to 012  -  UltimaLive sequence number
+            m_Stream.Write((byte)0x06);                 //byte 013         -  UltimaLive command (0x06 is a Block Batch)
+            m_Stream.Write((byte)mapID);                //byte 014         -  UltimaLive mapnumber
+            m_Stream.Write((UInt32)compressedLength);   //byte 015 to 018  -  compressed length of the records
+            m_Stream.Write(compressed, 0, compressedLength); //byte 019 to ??? - compressed records
+            for (int i = 4 + compressedLength; i < statics * 7; i++)
+            {
+                m_Stream.Write((byte)0xFF);             //padding
+            }
+        }
+    }
+    #endregion
+
     #region Update Map Definitions
     //This is sent to the client so the client knows the dimensions of extra maps.
     public class MapDefinitions : Packet
@@ -0,0 +1,452 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "PeImage.h"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+
+PeImage::PeImage()
+  : m_file(),
+  m_error(),
+  m_imageBase(0),
+  m_sizeOfImage(0),
+  m_sizeOfHeaders(0),
+  m_timeDateStamp(0),
+  m_entryPoint(0),
+  m_sections(),
+  m_imports(),
+  m_exports()
+{
+  //do nothing
+}
+
+/* Reads the whole file and parses it.  Returns false with a reason in getError if it is not a PE32 image or any of 
+ * its tables point outside of the file.
+ */
+bool PeImage::load(const std::string& path)
+{
+  m_file.clear();
+  m_sections.clear();
+  m_imports.clear();
+  m_exports.clear();
+  m_error = "";
+
+  std::ifstream file(path.c_str(), std::ios::binary | std::ios::in);
+  if (!file.is_open())
+  {
+    m_error = "cannot open file";
+    return false;
+  }
+
+  file.seekg(0, std::ios::end);
+  std::streamoff fileSize = file.tellg();
+  file.seekg(0, std::ios::beg);
+
+  if (fileSize <= 0 || fileSize > 0x7FFFFFFF)
+  {
+    m_error = "file is empty or too large";
+    return false;
+  }
+
+  m_file.resize(static_cast<size_t>(fileSize));
+  file.read(reinterpret_cast<char*>(&m_file[0]), fileSize);
+  if (!file.good())
+  {
+    m_error = "cannot read file";
+    return false;
+  }
+
+  return parseHeaders();
+}
+
+const std::string& PeImage::getError() const
+{
+  return m_error;
+}
+
+uint32_t PeImage::getImageBase() const
+{
+  return m_imageBase;
+}
+
+uint32_t PeImage::getSizeOfImage() const
+{
+  return m_sizeOfImage;
+}
+
+uint32_t PeImage::getSizeOfHeaders() const
+{
+  return m_sizeOfHeaders;
+}
+
+uint32_t PeImage::getTimeDateStamp() const
+{
+  return m_timeDateStamp;
+}
+
+uint32_t PeImage::getEntryPoint() const
+{
+  return m_entryPoint;
+}
+
+const std::vector<PeImage::Section>& PeImage::getSections() const
+{
+  return m_sections;
+}
+
+const std::vector<PeImage::ImportedModule>& PeImage::getImports() const
+{
+  return m_imports;
+}
+
+const std::vector<PeImage::ExportedFunction>& PeImage::getExports() const
+{
+  return m_exports;
+}
+
+/* Headers map one to one, everything else has to fall inside the raw data of a section */
+bool PeImage::rvaToFileOffset(uint32_t rva, uint32_t& rOffset) const
+{
+  if (rva < m_sizeOfHeaders)
+  {
+    rOffset = rva;
+    return rva < m_file.size();
+  }
+
+  for (std::vector<Section>::const_iterator it = m_sections.begin(); it != m_sections.end(); ++it)
+  {
+    if (rva >= it->virtualAddress && rva - it->virtualAddress < it->rawSize)
+    {
+      rOffset = it->rawOffset + (rva - it->virtualAddress);
+      return rOffset < m_file.size();
+    }
+  }
+
+  return false;
+}
+
+bool PeImage::fileOffsetToRva(uint32_t offset, uint32_t& rRva) const
+{
+  if (offset < m_sizeOfHeaders)
+  {
+    rRva = offset;
+    return true;
+  }
+
+  for (std::vector<Section>::const_iterator it = m_sections.begin(); it != m_sections.end(); ++it)
+  {
+    if (offset >= it->rawOffset && offset - it->rawOffset < it->rawSize)
+    {
+      rRva = it->virtualAddress + (offset - it->rawOffset);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/* Lays the headers and sections out at their RVAs in a zero filled buffer of at least SizeOfImage bytes.  A section 
+ * gets no more than its virtual size from the file, the rest of it is left zero like the loader leaves it.
+ */
+void PeImage::mapImage(std::vector<uint8_t>& rImage, uint32_t minimumSize) const
+{
+  rImage.assign(m_sizeOfImage > minimumSize ? m_sizeOfImage : minimumSize, 0);
+
+  uint32_t headerLength = m_sizeOfHeaders < m_file.size() ? m_sizeOfHeaders : static_cast<uint32_t>(m_file.size());
+  if (headerLength > rImage.size())
+  {
+    headerLength = static_cast<uint32_t>(rImage.size());
+  }
+  memcpy(&rImage[0], &m_file[0], headerLength);
+
+  for (std::vector<Section>::const_iterator it = m_sections.begin(); it != m_sections.end(); ++it)
+  {
+    uint32_t length = (it->virtualSize != 0 && it->virtualSize < it->rawSize) ? it->virtualSize : it->rawSize;
+
+    if (!isInFile(it->rawOffset, length))
+    {
+      length = it->rawOffset < m_file.size() ? static_cast<uint32_t>(m_file.size()) - it->rawOffset : 0;
+    }
+
+    if (it->virtualAddress >= rImage.size())
+    {
+      continue;
+    }
+
+    if (length > rImage.size() - it->virtualAddress)
+    {
+      length = static_cast<uint32_t>(rImage.size()) - it->virtualAddress;
+    }
+
+    if (length > 0)
+    {
+      memcpy(&rImage[it->virtualAddress], &m_file[it->rawOffset], length);
+    }
+  }
+}
+
+bool PeImage::parseHeaders()
+{
+  if (!isInFile(0, 0x40) || read16(0) != DOS_SIGNATURE)
+  {
+    m_error = "no MZ header";
+    return false;
+  }
+
+  uint32_t ntOffset = read32(0x3C);
+  if (!isInFile(ntOffset, 24) || read32(ntOffset) != NT_SIGNATURE)
+  {
+    m_error = "no PE header";
+    return false;
+  }
+
+  uint32_t fileHeader = ntOffset + 4;
+  uint16_t machine = read16(fileHeader);
+  uint16_t numberOfSections = read16(fileHeader + 2);
+  m_timeDateStamp = read32(fileHeader + 4);
+  uint16_t sizeOfOptionalHeader = read16(fileHeader + 16);
+
+  uint32_t optionalHeader = fileHeader + 20;
+  if (!isInFile(optionalHeader, 96) || read16(optionalHeader) != PE32_MAGIC || machine != MACHINE_I386)
+  {
+    m_error = "not a 32 bit x86 image";
+    return false;
+  }
+
+  m_entryPoint = read32(optionalHeader + 16);
+  m_imageBase = read32(optionalHeader + 28);
+  m_sizeOfImage = read32(optionalHeader + 56);
+  m_sizeOfHeaders = read32(optionalHeader + 60);
+  uint32_t numberOfDirectories = read32(optionalHeader + 92);
+
+  uint32_t sectionTable = optionalHeader + sizeOfOptionalHeader;
+  if (!isInFile(sectionTable, numberOfSections * 40))
+  {
+    m_error = "section table is cut off";
+    return false;
+  }
+
+  for (uint32_t i = 0; i < numberOfSections; i++)
+  {
+    uint32_t entry = sectionTable + i * 40;
+    Section section;
+    const char* pName = reinterpret_cast<const char*>(&m_file[entry]);
+    section.name.assign(pName, strnlen(pName, 8));
+    section.virtualSize = read32(entry + 8);
+    section.virtualAddress = read32(entry + 12);
+    section.rawSize = read32(entry + 16);
+    section.rawOffset = read32(entry + 20);
+    section.characteristics = read32(entry + 36);
+    m_sections.push_back(section);
+  }
+
+  uint32_t exportRva = 0;
+  uint32_t importRva = 0;
+  if (numberOfDirectories > DIRECTORY_ENTRY_EXPORT && isInFile(optionalHeader + 96, 8))
+  {
+    exportRva = read32(optionalHeader + 96 + DIRECTORY_ENTRY_EXPORT * 8);
+  }
+  if (numberOfDirectories > DIRECTORY_ENTRY_IMPORT && isInFile(optionalHeader + 96 + 8, 8))
+  {
+    importRva = read32(optionalHeader + 96 + DIRECTORY_ENTRY_IMPORT * 8);
+  }
+
+  return (exportRva == 0 || parseExports(exportRva)) && (importRva == 0 || parseImports(importRva));
+}
+
+/* Walks the import descriptors up to the empty one that ends them.  Functions imported by ordinal are listed as 
+ * #ordinal.  The hint name table is used when there is one, since the bound import address table may not hold names.
+ */
+bool PeImage::parseImports(uint32_t directoryRva)
+{
+  for (uint32_t descriptorRva = directoryRva; ; descriptorRva += 20)
+  {
+    uint32_t descriptor = 0;
+    if (!rvaToFileOffset(descriptorRva, descriptor) || !isInFile(descriptor, 20))
+    {
+      m_error = "import table is cut off";
+      return false;
+    }
+
+    uint32_t hintNameTable = read32(descriptor);
+    uint32_t nameRva = read32(descriptor + 12);
+    uint32_t firstThunk = read32(descriptor + 16);
+    if (nameRva == 0 && firstThunk == 0)
+    {
+      break;
+    }
+
+    ImportedModule module;
+    if (!readStringAtRva(nameRva, module.name))
+    {
+      m_error = "import module name is cut off";
+      return false;
+    }
+
+    uint32_t thunkRva = hintNameTable != 0 ? hintNameTable : firstThunk;
+    for (uint32_t index = 0; index < MAX_IMPORTS_PER_MODULE; index++, thunkRva += 4)
+    {
+      uint32_t thunk = 0;
+      if (!read32AtRva(thunkRva, thunk))
+      {
+        m_error = "import thunks are cut off";
+        return false;
+      }
+
+      if (thunk == 0)
+      {
+        break;
+      }
+
+      std::string functionName;
+      if ((thunk & ORDINAL_FLAG) != 0)
+      {
+        std::ostringstream ordinalName;
+        ordinalName << "#" << (thunk & 0xFFFF);
+        functionName = ordinalName.str();
+      }
+      else if (!readStringAtRva(thunk + 2, functionName))
+      {
+        m_error = "imported function name is cut off";
+        return false;
+      }
+
+      module.functionNames.push_back(functionName);
+    }
+
+    m_imports.push_back(module);
+  }
+
+  return true;
+}
+
+/* Lists every exported function with its ordinal, named or not */
+bool PeImage::parseExports(uint32_t directoryRva)
+{
+  uint32_t directory = 0;
+  if (!rvaToFileOffset(directoryRva, directory) || !isInFile(directory, 40))
+  {
+    m_error = "export directory is cut off";
+    return false;
+  }
+
+  uint32_t ordinalBase = read32(directory + 16);
+  uint32_t numberOfFunctions = read32(directory + 20);
+  uint32_t numberOfNames = read32(directory + 24);
+  uint32_t functionsRva = read32(directory + 28);
+  uint32_t namesRva = read32(directory + 32);
+  uint32_t nameOrdinalsRva = read32(directory + 36);
+
+  if (numberOfFunctions > MAX_IMPORTS_PER_MODULE || numberOfNames > numberOfFunctions)
+  {
+    m_error = "export directory is damaged";
+    return false;
+  }
+
+  std::vector<std::string> names(numberOfFunctions);
+  for (uint32_t i = 0; i < numberOfNames; i++)
+  {
+    uint32_t nameRva = 0;
+    uint32_t ordinalsOffset = 0;
+    if (!read32AtRva(namesRva + i * 4, nameRva) || !rvaToFileOffset(nameOrdinalsRva + i * 2, ordinalsOffset) || !isInFile(ordinalsOffset, 2))
+    {
+      m_error = "export names are cut off";
+      return false;
+    }
+
+    uint16_t functionIndex = read16(ordinalsOffset);
+    if (functionIndex < numberOfFunctions && !readStringAtRva(nameRva, names[functionIndex]))
+    {
+      m_error = "exported function name is cut off";
+      return false;
+    }
+  }
+
+  for (uint32_t i = 0; i < numberOfFunctions; i++)
+  {
+    ExportedFunction function;
+    function.name = names[i];
+    function.ordinal = ordinalBase + i;
+    if (!read32AtRva(functionsRva + i * 4, function.rva))
+    {
+      m_error = "export addresses are cut off";
+      return false;
+    }
+
+    if (function.rva != 0)
+    {
+      m_exports.push_back(function);
+    }
+  }
+
+  return true;
+}
+
+bool PeImage::isInFile(uint32_t offset, uint32_t length) const
+{
+  return offset <= m_file.size() && length <= m_file.size() - offset;
+}
+
+uint16_t PeImage::read16(uint32_t offset) const
+{
+  return static_cast<uint16_t>(m_file[offset] | (m_file[offset + 1] << 8));
+}
+
+uint32_t PeImage::read32(uint32_t offset) const
+{
+  return static_cast<uint32_t>(m_file[offset]) | (static_cast<uint32_t>(m_file[offset + 1]) << 8) | 
+    (static_cast<uint32_t>(m_file[offset + 2]) << 16) | (static_cast<uint32_t>(m_file[offset + 3]) << 24);
+}
+
+bool PeImage::read32AtRva(uint32_t rva, uint32_t& rValue) const
+{
+  uint32_t offset = 0;
+  if (!rvaToFileOffset(rva, offset) || !isInFile(offset, 4))
+  {
+    return false;
+  }
+
+  rValue = read32(offset);
+  return true;
+}
+
+bool PeImage::readStringAtRva(uint32_t rva, std::string& rString) const
+{
+  uint32_t offset = 0;
+  if (!rvaToFileOffset(rva, offset))
+  {
+    return false;
+  }
+
+  const char* pStart = reinterpret_cast<const char*>(&m_file[offset]);
+  size_t length = strnlen(pStart, m_file.size() - offset);
+  if (offset + length >= m_file.size())
+  {
+    return false;
+  }
+
+  rString.assign(pStart, length);
+  return true;
+}
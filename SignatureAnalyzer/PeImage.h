@@ -0,0 +1,118 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#ifndef _PE_IMAGE_H
+#define _PE_IMAGE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/* Reads a PE32 executable from disk without any help from Windows, so client builds can be looked at on any machine.
+ *
+ * LocalPeHelper32 works on a module the loader has already mapped into the current process.  This class reads the 
+ * file itself: the headers, the section table, and the import and export tables.  It maps RVAs to file offsets and 
+ * back, and it can lay the sections out at their RVAs the way the loader would, which is what the signature 
+ * searches in the client expect to see.  All fields are read little endian one at a time, so nothing depends on 
+ * the host's structure packing or byte order.
+ */
+class PeImage
+{
+  public:
+    struct Section
+    {
+      std::string name;
+      uint32_t virtualAddress;
+      uint32_t virtualSize;
+      uint32_t rawOffset;
+      uint32_t rawSize;
+      uint32_t characteristics;
+    };
+
+    struct ImportedModule
+    {
+      std::string name;
+      std::vector<std::string> functionNames;
+    };
+
+    struct ExportedFunction
+    {
+      std::string name;
+      uint32_t ordinal;
+      uint32_t rva;
+    };
+
+    PeImage();
+
+    bool load(const std::string& path);
+    const std::string& getError() const;
+
+    uint32_t getImageBase() const;
+    uint32_t getSizeOfImage() const;
+    uint32_t getSizeOfHeaders() const;
+    uint32_t getTimeDateStamp() const;
+    uint32_t getEntryPoint() const;
+
+    const std::vector<Section>& getSections() const;
+    const std::vector<ImportedModule>& getImports() const;
+    const std::vector<ExportedFunction>& getExports() const;
+
+    bool rvaToFileOffset(uint32_t rva, uint32_t& rOffset) const;
+    bool fileOffsetToRva(uint32_t offset, uint32_t& rRva) const;
+    void mapImage(std::vector<uint8_t>& rImage, uint32_t minimumSize) const;
+
+    static const uint16_t DOS_SIGNATURE = 0x5A4D; //MZ
+    static const uint32_t NT_SIGNATURE = 0x00004550; //PE\0\0
+    static const uint16_t PE32_MAGIC = 0x10B;
+    static const uint16_t MACHINE_I386 = 0x14C;
+    static const uint32_t SCN_CNT_CODE = 0x00000020;
+    static const uint32_t DIRECTORY_ENTRY_EXPORT = 0;
+    static const uint32_t DIRECTORY_ENTRY_IMPORT = 1;
+    static const uint32_t ORDINAL_FLAG = 0x80000000;
+    static const uint32_t MAX_IMPORTS_PER_MODULE = 0x10000;
+
+  private:
+    bool parseHeaders();
+    bool parseImports(uint32_t directoryRva);
+    bool parseExports(uint32_t directoryRva);
+
+    bool isInFile(uint32_t offset, uint32_t length) const;
+    uint16_t read16(uint32_t offset) const;
+    uint32_t read32(uint32_t offset) const;
+    bool read32AtRva(uint32_t rva, uint32_t& rValue) const;
+    bool readStringAtRva(uint32_t rva, std::string& rString) const;
+
+    std::vector<uint8_t> m_file;
+    std::string m_error;
+    uint32_t m_imageBase;
+    uint32_t m_sizeOfImage;
+    uint32_t m_sizeOfHeaders;
+    uint32_t m_timeDateStamp;
+    uint32_t m_entryPoint;
+    std::vector<Section> m_sections;
+    std::vector<ImportedModule> m_imports;
+    std::vector<ExportedFunction> m_exports;
+};
+
+#endif
@@ -0,0 +1,247 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+/* Runs the client signature set against client builds on disk and prints where each signature resolves in each build.
+ * A new client patch can be checked on a build box in seconds instead of launching the game with it, and the offsets 
+ * in the table can be shipped alongside the DLL.
+ *
+ *   SignatureAnalyzer [-j threads] [-v] client.exe [client.exe ...]
+ *
+ * Every build is read with PeImage, laid out at its RVAs the way the loader would, and scanned over the same
+ * CLIENT_IMAGE_MAX_SIZE bytes from the image base that the DLL scans inside the client, with the DLL's own 
+ * SignatureScanner.  Builds are analyzed in parallel.  -v also lists the sections, imports and exports of each build.
+ *
+ * The analyzer has no Windows dependencies and builds with any C++11 compiler, for example:
+ *
+ *   g++ -O2 -std=c++11 -pthread -o SignatureAnalyzer SignatureAnalyzer.cpp PeImage.cpp 
+ *     ../UltimaLive/SignatureScanner.cpp ../UltimaLive/ClientSignatures.cpp
+ */
+
+#include "PeImage.h"
+#include "../UltimaLive/SignatureScanner.h"
+#include "../UltimaLive/ClientSignatures.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint32_t CLIENT_IMAGE_MAX_SIZE = 0x300000;
+static const uint32_t NOT_FOUND = 0xFFFFFFFF;
+
+struct BuildResult
+{
+  std::string path;
+  bool loaded;
+  std::string error;
+  PeImage image;
+  std::vector<uint32_t> offsets;
+  double scanMs;
+};
+
+static void analyzeBuild(BuildResult& rResult)
+{
+  rResult.loaded = rResult.image.load(rResult.path);
+  if (!rResult.loaded)
+  {
+    rResult.error = rResult.image.getError();
+    return;
+  }
+
+  std::vector<uint8_t> mappedImage;
+  rResult.image.mapImage(mappedImage, CLIENT_IMAGE_MAX_SIZE);
+
+  SignatureScanner scanner;
+  for (unsigned int i = 0; i < ClientSignatures::COUNT; i++)
+  {
+    scanner.addSignature(ClientSignatures::TABLE[i].pBytes, ClientSignatures::TABLE[i].length);
+  }
+
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  scanner.scan(&mappedImage[0], CLIENT_IMAGE_MAX_SIZE);
+  rResult.scanMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+  rResult.offsets.assign(ClientSignatures::COUNT, NOT_FOUND);
+  for (unsigned int i = 0; i < ClientSignatures::COUNT; i++)
+  {
+    const uint8_t* pMatch = scanner.getMatch(i);
+    if (pMatch != NULL)
+    {
+      rResult.offsets[i] = static_cast<uint32_t>(pMatch - &mappedImage[0]);
+    }
+  }
+}
+
+static void printDetails(const BuildResult& rResult)
+{
+  const PeImage& rImage = rResult.image;
+  printf("%s\n", rResult.path.c_str());
+
+  const std::vector<PeImage::Section>& rSections = rImage.getSections();
+  for (size_t i = 0; i < rSections.size(); i++)
+  {
+    printf("  section %-8s rva 0x%08x size 0x%08x file 0x%08x size 0x%08x%s\n", rSections[i].name.c_str(), rSections[i].virtualAddress, 
+      rSections[i].virtualSize, rSections[i].rawOffset, rSections[i].rawSize, (rSections[i].characteristics & PeImage::SCN_CNT_CODE) != 0 ? " code" : "");
+  }
+
+  const std::vector<PeImage::ImportedModule>& rImports = rImage.getImports();
+  for (size_t i = 0; i < rImports.size(); i++)
+  {
+    printf("  import %s (%u functions)\n", rImports[i].name.c_str(), static_cast<uint32_t>(rImports[i].functionNames.size()));
+    for (size_t j = 0; j < rImports[i].functionNames.size(); j++)
+    {
+      printf("    %s\n", rImports[i].functionNames[j].c_str());
+    }
+  }
+
+  const std::vector<PeImage::ExportedFunction>& rExports = rImage.getExports();
+  for (size_t i = 0; i < rExports.size(); i++)
+  {
+    printf("  export %u %s rva 0x%08x\n", rExports[i].ordinal, rExports[i].name.c_str(), rExports[i].rva);
+  }
+
+  printf("\n");
+}
+
+/* One line per build, then one row per signature with the virtual address it resolves to in every build */
+static void printResolutionTable(const std::vector<BuildResult>& rResults)
+{
+  printf("# build\timage base\ttimestamp\tsize of image\tsections\tscan ms\n");
+  for (size_t b = 0; b < rResults.size(); b++)
+  {
+    if (rResults[b].loaded)
+    {
+      printf("# %s\t0x%08x\t0x%08x\t0x%08x\t%u\t%.2f\n", rResults[b].path.c_str(), rResults[b].image.getImageBase(), rResults[b].image.getTimeDateStamp(),
+        rResults[b].image.getSizeOfImage(), static_cast<uint32_t>(rResults[b].image.getSections().size()), rResults[b].scanMs);
+    }
+    else
+    {
+      printf("# %s\tnot analyzed: %s\n", rResults[b].path.c_str(), rResults[b].error.c_str());
+    }
+  }
+
+  printf("signature");
+  for (size_t b = 0; b < rResults.size(); b++)
+  {
+    printf("\t%s", rResults[b].path.c_str());
+  }
+  printf("\n");
+
+  for (unsigned int i = 0; i < ClientSignatures::COUNT; i++)
+  {
+    printf("%s", ClientSignatures::TABLE[i].pName);
+    for (size_t b = 0; b < rResults.size(); b++)
+    {
+      if (rResults[b].loaded && rResults[b].offsets[i] != NOT_FOUND)
+      {
+        printf("\t0x%08x", rResults[b].image.getImageBase() + rResults[b].offsets[i]);
+      }
+      else
+      {
+        printf("\t-");
+      }
+    }
+    printf("\n");
+  }
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t numberOfThreads = std::thread::hardware_concurrency();
+  bool verbose = false;
+  std::vector<BuildResult> results;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+    {
+      numberOfThreads = static_cast<uint32_t>(atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "-v") == 0)
+    {
+      verbose = true;
+    }
+    else
+    {
+      BuildResult result;
+      result.path = argv[i];
+      result.loaded = false;
+      result.scanMs = 0;
+      results.push_back(result);
+    }
+  }
+
+  if (results.empty())
+  {
+    fprintf(stderr, "usage: %s [-j threads] [-v] client.exe [client.exe ...]\n", argv[0]);
+    return 2;
+  }
+
+  if (numberOfThreads == 0)
+  {
+    numberOfThreads = 1;
+  }
+  if (numberOfThreads > results.size())
+  {
+    numberOfThreads = static_cast<uint32_t>(results.size());
+  }
+
+  //each worker takes the next build that nobody has started on yet
+  std::atomic<size_t> nextBuild(0);
+  std::vector<std::thread> workers;
+  for (uint32_t t = 0; t < numberOfThreads; t++)
+  {
+    workers.push_back(std::thread([&results, &nextBuild]()
+    {
+      for (size_t b = nextBuild++; b < results.size(); b = nextBuild++)
+      {
+        analyzeBuild(results[b]);
+      }
+    }));
+  }
+
+  for (size_t t = 0; t < workers.size(); t++)
+  {
+    workers[t].join();
+  }
+
+  int exitCode = 0;
+  for (size_t b = 0; b < results.size(); b++)
+  {
+    if (!results[b].loaded)
+    {
+      exitCode = 1;
+    }
+    else if (verbose)
+    {
+      printDetails(results[b]);
+    }
+  }
+
+  printResolutionTable(results);
+  return exitCode;
+}
@@ -58,7 +58,12 @@ HANDLE WINAPI ClientRedirections::OnCreateFileA(
 {
   if (g_hookedInstalled)
   {
-    return g_pInstance->GetFileManager()->OnCreateFileA(lpFileName, dwDesiredAccess, dwShareMode, lpSecurityAttributes, dwCreationDisposition, dwFlagsAndAttributes, hTemplateFile);
+    BaseFileManager* pManager = g_pInstance->GetFileManager();
+    LARGE_INTEGER startTime;
+    QueryPerformanceCounter(&startTime);
+    HANDLE hFile = pManager->OnCreateFileA(lpFileName, dwDesiredAccess, dwShareMode, lpSecurityAttributes, dwCreationDisposition, dwFlagsAndAttributes, hTemplateFile);
+    pManager->recordHookCall(BaseFileManager::HOOK_CREATE_FILE, startTime);
+    return hFile;
   }
 
   return CreateFileA(lpFileName, dwDesiredAccess, dwShareMode, lpSecurityAttributes, dwCreationDisposition, dwFlagsAndAttributes, hTemplateFile);
@@ -75,7 +80,11 @@ LPVOID WINAPI ClientRedirections::OnMapViewOfFile(
   if (g_hookedInstalled)
   {
     BaseFileManager* pManager = g_pInstance->GetFileManager();
-    return g_pInstance->GetFileManager()->OnMapViewOfFile(hFileMappingObject, dwDesiredAccess, dwFileOffsetHigh, dwFileOffsetLow, dwNumberOfBytesToMap);
+    LARGE_INTEGER startTime;
+    QueryPerformanceCounter(&startTime);
+    LPVOID pView = pManager->OnMapViewOfFile(hFileMappingObject, dwDesiredAccess, dwFileOffsetHigh, dwFileOffsetLow, dwNumberOfBytesToMap);
+    pManager->recordHookCall(BaseFileManager::HOOK_MAP_VIEW_OF_FILE, startTime);
+    return pView;
   }
 
   return MapViewOfFile(hFileMappingObject, dwDesiredAccess, dwFileOffsetHigh, dwFileOffsetLow, dwNumberOfBytesToMap);
@@ -111,7 +120,12 @@ HANDLE WINAPI ClientRedirections::OnCreateFileMappingA(
 {
   if (g_hookedInstalled)
   {
-    return g_pInstance->GetFileManager()->OnCreateFileMappingA(hFile, lpAttributes, flProtect, dwMaximumSizeHigh, dwMaximumSizeLow, lpName);
+    BaseFileManager* pManager = g_pInstance->GetFileManager();
+    LARGE_INTEGER startTime;
+    QueryPerformanceCounter(&startTime);
+    HANDLE hMapping = pManager->OnCreateFileMappingA(hFile, lpAttributes, flProtect, dwMaximumSizeHigh, dwMaximumSizeLow, lpName);
+    pManager->recordHookCall(BaseFileManager::HOOK_CREATE_FILE_MAPPING, startTime);
+    return hMapping;
   }
 
   return CreateFileMappingA(hFile, lpAttributes, flProtect, dwMaximumSizeHigh, dwMaximumSizeLow, lpName);
@@ -122,7 +136,11 @@ BOOL WINAPI ClientRedirections::OnCloseHandle(_In_  HANDLE hObject)
 {
   if (g_hookedInstalled)
   {
-    g_pInstance->GetFileManager()->OnCloseHandle(hObject);
+    BaseFileManager* pManager = g_pInstance->GetFileManager();
+    LARGE_INTEGER startTime;
+    QueryPerformanceCounter(&startTime);
+    pManager->OnCloseHandle(hObject);
+    pManager->recordHookCall(BaseFileManager::HOOK_CLOSE_HANDLE, startTime);
   }
 
   return CloseHandle(hObject);
@@ -162,9 +180,13 @@ void ClientRedirections::UpdateStaticBlocks()
   ReleaseMutex(g_UpdateStaticBlocksMutex);
 }
 
+/* The client calls this every frame to load the statics of blocks that came into view, so queued refreshes are run
+ * just before it
+ */
 void ClientRedirections::OnUpdateStaticBlocks()
 {
   uint32_t dwWaitResult = WaitForSingleObject(g_UpdateStaticBlocksMutex, INFINITE); 
+  g_pInstance->GetAtlas()->onClientFrame();
   updateBlocksFunctionPtr();
   ReleaseMutex(g_UpdateStaticBlocksMutex);
 }
@@ -0,0 +1,86 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "ClientSignatures.h"
+
+unsigned char ClientSignatures::g_sendSignature1[] = { 0x8D, 0x8B, 0x94, 0x00, 0x00, 0x00, 0xE8, 0xCC, 0xCC, 0xCC, 0xCC, 0x55, 0x8D, 0x8B, 0xBC, 0x00, 0x00, 0x00 };
+unsigned char ClientSignatures::g_sendSignature2[] = { 0x0F, 0xB7, 0xD8, 0x0F, 0xB6, 0x06, 0x83, 0xC4, 0x04, 0x53, 0x50, 0x8D, 0x4F, 0x6C };
+
+unsigned char ClientSignatures::g_recvSignature1[] = { 0x53, 0x56, 0x57, 0x8B, 0xF9, 0x8B, 0x0D, 0xCC, 0xCC, 0xCC, 0xCC, 0x33, 0xD2 };
+unsigned char ClientSignatures::g_recvSignature2[] = { 0xA1, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xC7, 0x05, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0x8B, 0x38, 0x8B, 0xCC, 0xBE };
+
+unsigned char ClientSignatures::g_NetworkObjectSignature1[] = { 0xA1, 0xCC, 0xCC, 0xCC, 0xCC, 0x8B, 0x0D, 0xCC, 0xCC, 0xCC, 0xCC, 0x8B, 0x16 };
+unsigned char ClientSignatures::g_NetworkObjectSignature2[] = { 0xC7, 0x06, 0xCC, 0xCC, 0xCC, 0xCC, 0x89, 0x35, 0xCC, 0xCC, 0xCC, 0xCC, 0x8B, 0x4C, 0x24, 0x0C };
+
+unsigned char ClientSignatures::g_PlayerBaseSignature1[] = { 0x66, 0x89, 0x71, 0x24, 0x8B, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC };
+unsigned char ClientSignatures::g_PlayerBaseSignature2[] = { 0x66, 0x89, 0x71, 0x28, 0x8B, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC };
+unsigned char ClientSignatures::g_mapDimensionSignature[] = { 0x00, 0x1c, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00 };
+
+unsigned char ClientSignatures::g_functionStartSig1[] = { 0x55, 0x8B, 0xEC };
+unsigned char ClientSignatures::g_functionStartSig2[] = { 0x90, 0x90, 0x6A };
+
+unsigned char ClientSignatures::g_aDrawMapThingieTableSig1[] = { 0x83, 0xE1, 0x3F, 0x83, 0xE2, 0x3F, 0xC1, 0xE2, 0x06 }; 
+unsigned char ClientSignatures::g_aDrawMapThingieTableSig2[] = { 0x83, 0xE1, 0x3F, 0xC1, 0xE1, 0x06, 0x83, 0xE2, 0x3F }; 
+
+unsigned char ClientSignatures::g_minClientDisplaySig1[] = { 0xB8, 0xF1, 0xD8, 0xFF, 0xFF, 0x89, 0x3D, 0xCC, 0xCC, 0xCC, 0xCC, 0xA3, 0xCC, 0xCC, 0xCC, 0xCC, 0xA3 };
+unsigned char ClientSignatures::g_minClientDisplaySig2[] = { 0xB8, 0xF1, 0xD8, 0xFF, 0xFF, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xA3, 0xCC, 0xCC, 0xCC, 0xCC, 0xA3 };
+unsigned char ClientSignatures::g_minClientDisplaySig3[] = { 0xB8, 0xF1, 0xD8, 0xFF, 0xFF, 0xA3, 0xCC, 0xCC, 0xCC, 0xCC, 0xA3 };
+
+unsigned char ClientSignatures::g_updateBlocksSig1[] = { 0xEE, 0xC1, 0xCC, 0x03, 0xC1, 0xCC, 0x03 }; //works up through 7.0.1.1
+unsigned char ClientSignatures::g_updateBlocksSig2[] = { 0x2B, 0xD8, 0xC1, 0xCC, 0x03, 0xC1, 0xCC, 0x03 }; //works up through 7.0.1.1
+
+unsigned char ClientSignatures::g_refreshTerrainFunctionSig1[] = { 0x75, 0xCC, 0x83, 0xCC, 0xFF, 0x74, 0xCC, 0xE8 };
+
+unsigned char ClientSignatures::g_masterStaticsListSig1[] = { 0x33, 0xf6, 0x68, 0x00, 0x00, 0xCC, 0x00, 0x89 }; //2.0.8n to 7.0.8.2
+unsigned char ClientSignatures::g_masterStaticsListSig2[] = { 0x68, 0x40, 0xF9, 0x2F, 0x00, 0x89, 0x35 };
+
+/* Every signature the lookup functions search the client image for.  They are all found in one pass the first time 
+ * any of them is needed, see MasterControlUtils::ScanClientImage, and the offline signature analyzer runs the same 
+ * table against client builds on disk.  The function start signatures are only ever searched backwards from a 
+ * match, so they are not in here.
+ */
+const ClientSignatures::Entry ClientSignatures::TABLE[] =
+{
+  { "sendSignature1", g_sendSignature1, sizeof(g_sendSignature1) },
+  { "sendSignature2", g_sendSignature2, sizeof(g_sendSignature2) },
+  { "recvSignature1", g_recvSignature1, sizeof(g_recvSignature1) },
+  { "recvSignature2", g_recvSignature2, sizeof(g_recvSignature2) },
+  { "NetworkObjectSignature1", g_NetworkObjectSignature1, sizeof(g_NetworkObjectSignature1) },
+  { "NetworkObjectSignature2", g_NetworkObjectSignature2, sizeof(g_NetworkObjectSignature2) },
+  { "PlayerBaseSignature1", g_PlayerBaseSignature1, sizeof(g_PlayerBaseSignature1) },
+  { "PlayerBaseSignature2", g_PlayerBaseSignature2, sizeof(g_PlayerBaseSignature2) },
+  { "mapDimensionSignature", g_mapDimensionSignature, sizeof(g_mapDimensionSignature) },
+  { "aDrawMapThingieTableSig1", g_aDrawMapThingieTableSig1, sizeof(g_aDrawMapThingieTableSig1) },
+  { "aDrawMapThingieTableSig2", g_aDrawMapThingieTableSig2, sizeof(g_aDrawMapThingieTableSig2) },
+  { "minClientDisplaySig1", g_minClientDisplaySig1, sizeof(g_minClientDisplaySig1) },
+  { "minClientDisplaySig2", g_minClientDisplaySig2, sizeof(g_minClientDisplaySig2) },
+  { "minClientDisplaySig3", g_minClientDisplaySig3, sizeof(g_minClientDisplaySig3) },
+  { "updateBlocksSig1", g_updateBlocksSig1, sizeof(g_updateBlocksSig1) },
+  { "updateBlocksSig2", g_updateBlocksSig2, sizeof(g_updateBlocksSig2) },
+  { "refreshTerrainFunctionSig1", g_refreshTerrainFunctionSig1, sizeof(g_refreshTerrainFunctionSig1) },
+  { "masterStaticsListSig1", g_masterStaticsListSig1, sizeof(g_masterStaticsListSig1) },
+  { "masterStaticsListSig2", g_masterStaticsListSig2, sizeof(g_masterStaticsListSig2) }
+};
+
+const unsigned int ClientSignatures::COUNT = sizeof(TABLE) / sizeof(TABLE[0]);
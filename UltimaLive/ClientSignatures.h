@@ -0,0 +1,68 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#ifndef _CLIENT_SIGNATURES_H
+#define _CLIENT_SIGNATURES_H
+
+/* The byte signatures used to find functions and data in the client, with 0xCC as a wildcard byte.  They are kept 
+ * apart from MasterControlUtils, which only builds on Windows, so that tools can share them.  The lengths are spelled 
+ * out here so that sizeof works on them everywhere, and have to be changed together with the bytes.
+ */
+class ClientSignatures
+{
+  public:
+    struct Entry
+    {
+      const char* pName;
+      unsigned char* pBytes;
+      unsigned int length;
+    };
+
+    static unsigned char g_sendSignature1[18];
+    static unsigned char g_sendSignature2[14];
+    static unsigned char g_recvSignature1[13];
+    static unsigned char g_recvSignature2[23];
+    static unsigned char g_NetworkObjectSignature1[13];
+    static unsigned char g_NetworkObjectSignature2[16];
+    static unsigned char g_PlayerBaseSignature1[10];
+    static unsigned char g_PlayerBaseSignature2[10];
+    static unsigned char g_mapDimensionSignature[8];
+    static unsigned char g_functionStartSig1[3];
+    static unsigned char g_functionStartSig2[3];
+    static unsigned char g_aDrawMapThingieTableSig1[9];
+    static unsigned char g_aDrawMapThingieTableSig2[9];
+    static unsigned char g_minClientDisplaySig1[17];
+    static unsigned char g_minClientDisplaySig2[16];
+    static unsigned char g_minClientDisplaySig3[11];
+    static unsigned char g_updateBlocksSig1[7];
+    static unsigned char g_updateBlocksSig2[8];
+    static unsigned char g_refreshTerrainFunctionSig1[8];
+    static unsigned char g_masterStaticsListSig1[8];
+    static unsigned char g_masterStaticsListSig2[7];
+
+    static const Entry TABLE[];
+    static const unsigned int COUNT;
+};
+
+#endif
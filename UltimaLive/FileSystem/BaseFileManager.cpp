@@ -21,165 +21,933 @@
 */
 
 #include "BaseFileManager.h"
+#include "ShardImporter.h"
 
 #include <shlwapi.h>
 #pragma comment(lib,"shlwapi.lib")
 #include "shlobj.h"
 #include "..\Maps\MapDefinition.h"
+#include "..\Maps\LandDelta.h"
 
-unsigned char* BaseFileManager::readStaticsBlock(uint32_t, uint32_t blockNum, uint32_t& rNumberOfBytesOut)
+/* Returns a pointer straight into the statics pool, or NULL if the block has no statics.  The memory is not owned by
+ * the caller and is only good until the next statics update, compaction or map change.
+ */
+unsigned char* BaseFileManager::getStaticsBlockView(uint32_t, uint32_t blockNum, uint32_t& rNumberOfBytesOut)
 {
-  uint8_t* pBlockIdx = m_pStaidxPool;
-  pBlockIdx += (blockNum * 12);
+  rNumberOfBytesOut = 0;
 
-  uint32_t lookup = *reinterpret_cast<uint32_t*>(pBlockIdx); 
-  rNumberOfBytesOut = *reinterpret_cast<uint32_t*>(pBlockIdx + 4); //length
-  uint8_t* pRawStaticData = NULL;
+  if (blockNum >= static_cast<uint32_t>(m_pStaidxPoolEnd - m_pStaidxPool) / 12)
+  {
+    return NULL;
+  }
 
-  if (lookup >= 0 && lookup < STATICS_MEMORY_SIZE && rNumberOfBytesOut > 0 && rNumberOfBytesOut != 0xFFFFFFFF)
+  uint8_t* pBlockIdx = m_pStaidxPool + (blockNum * 12);
+  uint32_t lookup = *reinterpret_cast<uint32_t*>(pBlockIdx);
+  uint32_t length = *reinterpret_cast<uint32_t*>(pBlockIdx + 4);
+
+  if (length == 0 || !isStaticsExtentValid(lookup, length))
   {
-    uint8_t* pStatics = reinterpret_cast<uint8_t*>(m_pStaticsPool);
-    pStatics += lookup;
+    return NULL;
+  }
+
+  rNumberOfBytesOut = length;
+  return m_pStaticsPool + lookup;
+}
+
+unsigned char* BaseFileManager::readStaticsBlock(uint32_t mapNumber, uint32_t blockNum, uint32_t& rNumberOfBytesOut)
+{
+  uint8_t* pStatics = getStaticsBlockView(mapNumber, blockNum, rNumberOfBytesOut);
+  uint8_t* pRawStaticData = NULL;
 
+  if (pStatics != NULL)
+  {
     pRawStaticData = new uint8_t[rNumberOfBytesOut];
 
     for(uint32_t i = 0; i < rNumberOfBytesOut; ++i)
     {
       pRawStaticData[i] = pStatics[i];
     }
-  }
+  }
+
+  return pRawStaticData;
+}
+
+bool BaseFileManager::writeStaticsBlock(uint8_t, uint32_t blockNum, uint8_t* pBlockData, uint32_t updatedStaticsLength)
+{
+#ifdef DEBUG
+  printf("Writing statics: %i\n", blockNum);
+#endif
+
+  m_pBlockCrcs->invalidate(blockNum);
+
+  uint8_t* pBlockIdx = m_pStaidxPool;
+  pBlockIdx += (blockNum * 12);
+
+  uint32_t existingLookup = *reinterpret_cast<uint32_t*>(pBlockIdx); 
+
+  #ifdef DEBUG
+    printf("Existing lookup: 0x%x\n", existingLookup);
+  #endif
+
+  uint32_t existingStaticsLength = *reinterpret_cast<uint32_t*>(pBlockIdx + 4);
+
+  //Zero length statics block is a corner case
+  if (updatedStaticsLength <= 0)
+  {
+#ifdef DEBUG
+    printf("writing block with zero statics\n");
+#endif
+
+    m_pJournal->recordStaticsBlock(blockNum, 0xFFFFFFFF, NULL, 0);
+    commitBeforeStaticsWrite();
+
+    //update index length in memory
+    *reinterpret_cast<uint32_t*>(pBlockIdx + 4) = 0;
+    
+    //update index lookup in memory
+    *reinterpret_cast<uint32_t*>(pBlockIdx) = 0xFFFFFFFF;
+
+    //update index on disk
+    persistStaidxEntry(blockNum);
+
+    //the old statics can be reused
+    releaseStatics(existingLookup, existingStaticsLength);
+  }
+  //Do we have enough room to write the statics into the existing location?  Statics other blocks share are left alone
+  else if (existingStaticsLength >= updatedStaticsLength && isStaticsExtentValid(existingLookup, existingStaticsLength) && !m_pStaticsAllocator->isShared(existingLookup))
+  {
+#ifdef DEBUG
+    printf("writing statics to existing file location at 0x%x, length:%i\n", existingLookup, updatedStaticsLength);
+#endif
+
+    m_pJournal->recordStaticsBlock(blockNum, existingLookup, pBlockData, updatedStaticsLength);
+    commitBeforeStaticsWrite();
+
+    //update memory
+    uint8_t* pStatics = m_pStaticsPool;
+    pStatics += existingLookup;
+    memcpy(pStatics, pBlockData, updatedStaticsLength);
+
+    //update disk
+    persistStatics(existingLookup, updatedStaticsLength);
+
+    //update index length in memory
+    *reinterpret_cast<uint32_t*>(pBlockIdx + 4) = updatedStaticsLength;
+
+    //update index on disk
+    persistStaidxEntry(blockNum);
+
+    //the block shrank, the tail can be reused
+    releaseStatics(existingLookup + updatedStaticsLength, existingStaticsLength - updatedStaticsLength);
+  }
+  else
+  {
+    //reuse freed space before growing the statics
+    uint32_t newLookup = m_pStaticsAllocator->allocate(updatedStaticsLength);
+
+    if (newLookup == StaticsAllocator::INVALID_LOOKUP && !reserveStaticsSpace(updatedStaticsLength))
+    {
+      //out of room, reclaim everything that is free and try again
+      compactStatics(0xFFFFFFFF, true);
+      existingLookup = *reinterpret_cast<uint32_t*>(pBlockIdx);
+      existingStaticsLength = *reinterpret_cast<uint32_t*>(pBlockIdx + 4);
+      newLookup = m_pStaticsAllocator->allocate(updatedStaticsLength);
+
+      if (newLookup == StaticsAllocator::INVALID_LOOKUP && !reserveStaticsSpace(updatedStaticsLength))
+      {
+#ifdef DEBUG
+        printf("Statics pool is full, unable to write block %u!\n", blockNum);
+#endif
+        return false;
+      }
+    }
+
+    if (newLookup == StaticsAllocator::INVALID_LOOKUP)
+    {
+      newLookup = m_pStaticsPoolEnd - m_pStaticsPool;
+      m_pStaticsPoolEnd += updatedStaticsLength;
+    }
+
+#ifdef DEBUG
+    printf("writing statics to new file location 0x%x, length:%i\n", newLookup, updatedStaticsLength);
+#endif
+
+    m_pJournal->recordStaticsBlock(blockNum, newLookup, pBlockData, updatedStaticsLength);
+    commitBeforeStaticsWrite();
+
+    //update index lookup and length in memory
+    *reinterpret_cast<uint32_t*>(pBlockIdx) = newLookup;
+    *reinterpret_cast<uint32_t*>(pBlockIdx + 4) = updatedStaticsLength;
+
+    //update statics in memory
+    memcpy(m_pStaticsPool + newLookup, pBlockData, updatedStaticsLength);
+
+    //update statics and index on disk
+    persistStatics(newLookup, updatedStaticsLength);
+    persistStaidxEntry(blockNum);
+
+    //the old statics can be reused
+    releaseStatics(existingLookup, existingStaticsLength);
+  }
+
+  compactStatics(StaticsAllocator::COMPACTION_MOVES_PER_UPDATE, false);
+  checkpointIfNeeded();
+
+  return true;
+}
+
+/* Journal records have to be on disk before the shard files they describe are changed.  Windows can write a dirty
+ * page of a mapped file out at any time, so a change made through a view is only made once the journal has been 
+ * committed.  Changes written through the streams are committed by the block writer before it writes them.
+ */
+void BaseFileManager::commitBeforeViewWrite(MappedFile* pMapping)
+{
+  if (pMapping != NULL && pMapping->isOpen() && !pMapping->isCopyOnWrite())
+  {
+    m_pJournal->commit();
+  }
+}
+
+void BaseFileManager::commitBeforeStaticsWrite()
+{
+  commitBeforeViewWrite(m_pStaidxFileMapping);
+  commitBeforeViewWrite(m_pStaticsFileMapping);
+}
+
+/* True if an index entry points at statics that lie within the statics data */
+bool BaseFileManager::isStaticsExtentValid(uint32_t lookup, uint32_t length)
+{
+  uint32_t staticsSize = m_pStaticsPoolEnd - m_pStaticsPool;
+  return lookup != 0xFFFFFFFF && length != 0xFFFFFFFF && lookup < staticsSize && length <= staticsSize - lookup;
+}
+
+void BaseFileManager::releaseStatics(uint32_t lookup, uint32_t length)
+{
+  if (length > 0 && isStaticsExtentValid(lookup, length))
+  {
+    m_pStaticsAllocator->release(lookup, length);
+  }
+}
+
+/* Makes room for length more bytes at the end of the statics */
+bool BaseFileManager::reserveStaticsSpace(uint32_t length)
+{
+  uint32_t staticsSize = m_pStaticsPoolEnd - m_pStaticsPool;
+  if (length > m_pStaticsReservation->getSize() - staticsSize)
+  {
+    return false;
+  }
+
+  //a mapped statics file covers the whole pool, so the room is already there
+  if (m_pStaticsFileMapping->isOpen())
+  {
+    return staticsSize + length <= m_pStaticsFileMapping->getMappedSize();
+  }
+
+  return m_pStaticsReservation->commit(staticsSize + length);
+}
+
+/* Moves up to maxMoves statics blocks down towards the start of the pool.  A compaction is started once the allocator
+ * reports that enough of the pool is free, or whenever anything is free at all if force is set.
+ */
+void BaseFileManager::compactStatics(uint32_t maxMoves, bool force)
+{
+  uint32_t staticsSize = m_pStaticsPoolEnd - m_pStaticsPool;
+
+  if (!m_pStaticsAllocator->isCompacting())
+  {
+    if (!m_pStaticsAllocator->needsCompaction(staticsSize) && !(force && m_pStaticsAllocator->getFreeBytes() > 0))
+    {
+      return;
+    }
+
+    m_pStaticsAllocator->beginCompaction(m_pStaidxPool, (m_pStaidxPoolEnd - m_pStaidxPool) / 12, staticsSize);
+  }
+
+  uint32_t blockNum = 0;
+  uint32_t from = 0;
+  uint32_t to = 0;
+  uint32_t length = 0;
+
+  for (uint32_t moves = 0; moves < maxMoves; moves++)
+  {
+    if (!m_pStaticsAllocator->nextCompactionMove(m_pStaidxPool, (m_pStaidxPoolEnd - m_pStaidxPool) / 12, m_pStaticsPoolEnd - m_pStaticsPool, blockNum, from, to, length))
+    {
+      m_pStaticsAllocator->endCompaction(staticsSize);
+      m_pStaticsPoolEnd = m_pStaticsPool + staticsSize;
+      break;
+    }
+
+    //the record is taken from where the statics are now, they are the same bytes once they are moved
+    m_pJournal->recordStaticsBlock(blockNum, to, m_pStaticsPool + from, length);
+    commitBeforeStaticsWrite();
+
+    memmove(m_pStaticsPool + to, m_pStaticsPool + from, length);
+    *reinterpret_cast<uint32_t*>(m_pStaidxPool + (blockNum * 12)) = to;
+
+    persistStatics(to, length);
+    persistStaidxEntry(blockNum);
+  }
+}
+
+/* Queues an index entry that was changed in the staidx pool to be written out by the block writer.  When the staidx 
+ * file is mapped the pool is the file, so there is nothing left to do.  Either way the journal makes the change 
+ * durable, the stream is only flushed at a checkpoint.
+ */
+void BaseFileManager::persistStaidxEntry(uint32_t blockNum)
+{
+  if (!m_pStaidxFileMapping->isOpen() && m_pStaidxFileStream->is_open())
+  {
+    m_pBlockWriter->queueWrite(BlockWriter::FILE_STAIDX, blockNum * 12, m_pStaidxPool + (blockNum * 12), 12);
+  }
+}
+
+void BaseFileManager::persistStatics(uint32_t lookup, uint32_t length)
+{
+  if (!m_pStaticsFileMapping->isOpen() && m_pStaticsFileStream->is_open() && length > 0)
+  {
+    m_pBlockWriter->queueWrite(BlockWriter::FILE_STATICS, lookup, m_pStaticsPool + lookup, length);
+  }
+}
+
+/* Maps one of a map's files into its pool.  A resident map hands over the file and section it kept open, so the 
+ * pool is backed by the pages that are already in memory instead of reading the file again.
+ */
+bool BaseFileManager::openShardFile(MappedFile* pMapping, uint8_t mapNumber, uint32_t file, std::string fileNameAndPath, uint32_t minimumSize, bool copyOnWrite)
+{
+  HANDLE hFile = INVALID_HANDLE_VALUE;
+  HANDLE hMapping = NULL;
+  m_pResidentMaps->takeFile(mapNumber, file, hFile, hMapping);
+  return pMapping->open(fileNameAndPath, minimumSize, copyOnWrite, hFile, hMapping);
+}
+
+/* Maps the statics index and statics files for a map into their pools.  If a file cannot be mapped it is read into
+ * its pool instead and updates are written back through a file stream.
+ */
+void BaseFileManager::loadStaticsFiles(uint8_t mapNumber, std::string staidxFileNameAndPath, std::string staticsFileNameAndPath)
+{
+#ifdef DEBUG
+  printf("Loading Staidx: %s\n", staidxFileNameAndPath.c_str());
+#endif
+
+  if (openShardFile(m_pStaidxFileMapping, mapNumber, ResidentMapCache::FILE_STAIDX, staidxFileNameAndPath, 0))
+  {
+    m_pStaidxPoolEnd = m_pStaidxPool + m_pStaidxFileMapping->getFileSize();
+  }
+  else
+  {
+    uint32_t length = 0;
+    readFileIntoPool(staidxFileNameAndPath, m_pStaidxReservation, length);
+    m_pStaidxPoolEnd = m_pStaidxPool + length;
+    m_pStaidxFileStream->open(staidxFileNameAndPath, std::ios::out | std::ios::in | std::ios::binary);
+  }
+
+#ifdef DEBUG
+  printf("Loading Statics: %s\n", staticsFileNameAndPath.c_str());
+#endif
+
+  //the statics file is mapped over the whole pool up front, so appending statics never has to move the view
+  if (openShardFile(m_pStaticsFileMapping, mapNumber, ResidentMapCache::FILE_STATICS, staticsFileNameAndPath, m_pStaticsReservation->getSize()))
+  {
+    m_pStaticsPoolEnd = m_pStaticsPool + getStaticsDataEnd(m_pStaticsFileMapping->getFileSize());
+  }
+  else
+  {
+    uint32_t length = 0;
+    readFileIntoPool(staticsFileNameAndPath, m_pStaticsReservation, length);
+    m_pStaticsPoolEnd = m_pStaticsPool + length;
+    m_pStaticsFileStream->open(staticsFileNameAndPath, std::ios::out | std::ios::in | std::ios::binary);
+  }
+
+  //pick up the space that was free when the map was last closed
+  m_staticsFreeListFileNameAndPath = staticsFileNameAndPath.substr(0, staticsFileNameAndPath.rfind('.'));
+  m_staticsFreeListFileNameAndPath.append(".free");
+  m_pStaticsAllocator->load(m_staticsFreeListFileNameAndPath, m_pStaticsPoolEnd - m_pStaticsPool);
+  m_pStaticsAllocator->countReferences(m_pStaidxPool, (m_pStaidxPoolEnd - m_pStaidxPool) / 12, m_pStaticsPoolEnd - m_pStaticsPool);
+}
+
+/* The statics file is only as large as the pool while it is mapped.  If it is that large when it is opened, it was 
+ * left mapped by a crash, and the statics end with the last block the index points at.
+ */
+uint32_t BaseFileManager::getStaticsDataEnd(uint32_t fileSize)
+{
+  if (fileSize < m_pStaticsReservation->getSize())
+  {
+    return fileSize;
+  }
+
+  uint32_t dataEnd = 0;
+  for (uint8_t* pEntry = m_pStaidxPool; pEntry + 12 <= m_pStaidxPoolEnd; pEntry += 12)
+  {
+    uint32_t lookup = *reinterpret_cast<uint32_t*>(pEntry);
+    uint32_t length = *reinterpret_cast<uint32_t*>(pEntry + 4);
+    if (lookup != 0xFFFFFFFF && length != 0xFFFFFFFF && lookup < fileSize && length <= fileSize - lookup && lookup + length > dataEnd)
+    {
+      dataEnd = lookup + length;
+    }
+  }
+
+#ifdef DEBUG
+  printf("Statics file was left at the size of the pool, the data ends at %u\n", dataEnd);
+#endif
+
+  return dataEnd;
+}
+
+/* Unmaps and closes the files for the current map.  The statics file is cut back to the end of the statics data,
+ * dropping any room that was added to the mapping for appended blocks.
+ */
+void BaseFileManager::closeMapFiles()
+{
+  //the pager may be copying out of a mapped file, so it has to let go of the map pool first
+  if (m_pMapPoolPager != NULL)
+  {
+    m_pMapPoolPager->disarm();
+  }
+
+  if (m_staticsFreeListFileNameAndPath != "")
+  {
+    //a compaction that is still running has thrown away the free lists, so it has to finish before they are saved
+    if (m_pStaticsAllocator->isCompacting())
+    {
+      compactStatics(0xFFFFFFFF, false);
+    }
+
+    m_pStaticsAllocator->save(m_staticsFreeListFileNameAndPath, m_pStaticsPoolEnd - m_pStaticsPool);
+    m_pStaticsAllocator->reset();
+    m_staticsFreeListFileNameAndPath = "";
+  }
+
+  m_pBlockWriter->drain();
+  checkpoint();
+  m_pJournal->close();
+
+  //whatever failed to write is kept in the journal, which is replayed when the map is loaded again
+  m_pBlockWriter->clearWriteFailure();
+  m_pMaterializedBlocks->close();
+
+  if (m_pMapFileStream->is_open())
+  {
+    m_pMapFileStream->flush();
+    m_pMapFileStream->close();
+  }
+
+  if (m_pStaidxFileStream->is_open())
+  {
+    m_pStaidxFileStream->flush();
+    m_pStaidxFileStream->close();
+  }
+
+  if (m_pStaticsFileStream->is_open())
+  {
+    m_pStaticsFileStream->flush();
+    m_pStaticsFileStream->close();
+  }
+
+  if (m_pMapFileMapping != NULL)
+  {
+    m_pMapFileMapping->close();
+  }
+
+  if (m_pStaidxFileMapping != NULL)
+  {
+    m_pStaidxFileMapping->close();
+  }
+
+  if (m_pStaticsFileMapping != NULL && m_pStaticsFileMapping->isOpen())
+  {
+    m_pStaticsFileMapping->close(m_pStaticsPoolEnd - m_pStaticsPool);
+  }
+
+  //pools that were read into instead of mapped give their memory back until the next map is loaded
+  if (m_pStaidxReservation != NULL)
+  {
+    m_pStaidxReservation->decommit();
+  }
+
+  if (m_pStaticsReservation != NULL)
+  {
+    m_pStaticsReservation->decommit();
+  }
+
+  //the crcs are saved against the files as they were just left
+  if (m_pBlockCrcs->isOpen())
+  {
+    uint32_t mapFileSize = 0;
+    m_pBlockCrcs->close(getBlockCrcFilesStamp(m_loadedMapFileNameAndPath, m_loadedStaidxFileNameAndPath, m_loadedStaticsFileNameAndPath, mapFileSize));
+  }
+
+  //the map the player is leaving stays in memory in case they come back to it
+  if (m_mapLoaded)
+  {
+    m_mapLoaded = false;
+    m_pResidentMaps->retain(m_loadedMapNumber, m_loadedMapFileNameAndPath, m_loadedStaidxFileNameAndPath, m_loadedStaticsFileNameAndPath);
+  }
+}
+
+/* Called by LoadMap once the map is in the pools.  The pools hold the map's pages now, so the resident copy of the 
+ * map is let go until the map is closed again.
+ */
+void BaseFileManager::finishLoadingMap(uint8_t mapNumber, std::string mapFileNameAndPath, std::string staidxFileNameAndPath, std::string staticsFileNameAndPath, bool resident, LARGE_INTEGER startTime)
+{
+  m_pResidentMaps->release(mapNumber);
+  m_pResidentMaps->recordLoad(resident, startTime);
+
+  m_mapLoaded = true;
+  m_loadedMapNumber = mapNumber;
+  m_loadedMapFileNameAndPath = mapFileNameAndPath;
+  m_loadedStaidxFileNameAndPath = staidxFileNameAndPath;
+  m_loadedStaticsFileNameAndPath = staticsFileNameAndPath;
+}
+
+/* The pools are reserved when the client starts, before the shard has said anything about its maps.  Once the map
+ * definitions arrive the map and statics index pools are extended to fit the largest map, if the address space after
+ * them allows it.
+ */
+void BaseFileManager::reservePoolsForMaps(std::map<uint32_t, MapDefinition>& rDefinitions)
+{
+  uint32_t largestMapInBlocks = 0;
+
+  for (std::map<uint32_t, MapDefinition>::iterator itr = rDefinitions.begin(); itr != rDefinitions.end(); itr++)
+  {
+    uint32_t mapInBlocks = (itr->second.mapWidthInTiles >> 3) * (itr->second.mapHeightInTiles >> 3);
+    if (mapInBlocks > largestMapInBlocks)
+    {
+      largestMapInBlocks = mapInBlocks;
+    }
+  }
+
+  bool mapFits = m_pMapReservation->extend(largestMapInBlocks * 196);
+  bool staidxFits = m_pStaidxReservation->extend(largestMapInBlocks * 12);
+
+#ifdef DEBUG
+  printf("Largest map has %u blocks, map pool %u bytes%s, staidx pool %u bytes%s\n", largestMapInBlocks, 
+    m_pMapReservation->getSize(), mapFits ? "" : " (too small)", m_pStaidxReservation->getSize(), staidxFits ? "" : " (too small)");
+#endif
+}
+
+/* Replays the map's journal into its files and leaves the journal open for the updates that follow.  Must be called
+ * before the files are mapped or read.
+ */
+void BaseFileManager::replayJournal(std::string journalFileNameAndPath, std::string mapFileNameAndPath, std::string staidxFileNameAndPath, std::string staticsFileNameAndPath)
+{
+  //a blank map has to know which of its blocks were written before the journal adds more
+  m_pMaterializedBlocks->load(getMaterializedBlockMapPath(mapFileNameAndPath));
+
+  //the saved crcs are checked against the files before the journal changes them
+  uint32_t mapFileSize = 0;
+  uint64_t filesStamp = getBlockCrcFilesStamp(mapFileNameAndPath, staidxFileNameAndPath, staticsFileNameAndPath, mapFileSize);
+  m_pBlockCrcs->open(getBlockCrcCachePath(mapFileNameAndPath), mapFileSize / 196, filesStamp);
+
+  if (m_pJournal->open(journalFileNameAndPath))
+  {
+    m_pJournal->replay(mapFileNameAndPath, staidxFileNameAndPath, staticsFileNameAndPath, m_pMaterializedBlocks);
+  }
+}
+
+std::string BaseFileManager::getMaterializedBlockMapPath(std::string mapFileNameAndPath)
+{
+  std::string path = mapFileNameAndPath.substr(0, mapFileNameAndPath.rfind('.'));
+  path.append(".blank");
+  return path;
+}
+
+std::string BaseFileManager::getBlockCrcCachePath(std::string mapFileNameAndPath)
+{
+  std::string path = mapFileNameAndPath.substr(0, mapFileNameAndPath.rfind('.'));
+  path.append(".crc");
+  return path;
+}
+
+/* Combines the sizes and last write times of the map, staidx and statics files */
+uint64_t BaseFileManager::getBlockCrcFilesStamp(std::string mapFileNameAndPath, std::string staidxFileNameAndPath, std::string staticsFileNameAndPath, uint32_t& rMapFileSize)
+{
+  std::string paths[3] = { mapFileNameAndPath, staidxFileNameAndPath, staticsFileNameAndPath };
+  uint64_t stamp = 0;
+
+  for (uint32_t i = 0; i < 3; i++)
+  {
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (GetFileAttributesExA(paths[i].c_str(), GetFileExInfoStandard, &attributes))
+    {
+      uint64_t lastWriteTime = (static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+      stamp = (stamp * 31) ^ lastWriteTime;
+      stamp = (stamp * 31) ^ attributes.nFileSizeLow;
+
+      if (i == 0)
+      {
+        rMapFileSize = attributes.nFileSizeLow;
+      }
+    }
+  }
+
+  return stamp;
+}
+
+/* Looks up the crc of a block of the loaded map, false if it has to be computed */
+bool BaseFileManager::lookupBlockCrc(uint32_t mapNumber, uint32_t blockNum, uint16_t& rCrc)
+{
+  if (!m_mapLoaded || mapNumber != m_loadedMapNumber)
+  {
+    return false;
+  }
+
+  return m_pBlockCrcs->lookup(blockNum, rCrc);
+}
+
+void BaseFileManager::storeBlockCrc(uint32_t mapNumber, uint32_t blockNum, uint16_t crc)
+{
+  if (m_mapLoaded && mapNumber == m_loadedMapNumber)
+  {
+    m_pBlockCrcs->store(blockNum, crc);
+  }
+}
+
+/* Describes where the land blocks [firstBlock, firstBlock + length / 196) that live at poolOffset in the map pool come
+ * from to the map pool pager.  Blocks of a blank map that were never written are filled with the blank land block,
+ * everything else is copied from pMapData, or left as it is if pMapData is NULL.
+ */
+void BaseFileManager::addLandSources(uint32_t poolOffset, uint32_t firstBlock, uint32_t length, uint8_t* pMapData)
+{
+  if (!m_pMaterializedBlocks->isLoaded())
+  {
+    if (pMapData != NULL)
+    {
+      m_pMapPoolPager->addSource(poolOffset, pMapData, length);
+    }
+    return;
+  }
+
+  uint32_t numberOfBlocks = (length + 195) / 196;
+  uint32_t runStart = 0;
+
+  while (runStart < numberOfBlocks)
+  {
+    bool materialized = m_pMaterializedBlocks->isMaterialized(firstBlock + runStart);
+    uint32_t runEnd = runStart + 1;
+    while (runEnd < numberOfBlocks && m_pMaterializedBlocks->isMaterialized(firstBlock + runEnd) == materialized)
+    {
+      runEnd++;
+    }
+
+    uint32_t runLength = (runEnd * 196 < length ? runEnd * 196 : length) - (runStart * 196);
+
+    if (!materialized)
+    {
+      m_pMapPoolPager->addPattern(poolOffset + (runStart * 196), BLANK_LAND_BLOCK, 196, runLength);
+    }
+    else if (pMapData != NULL)
+    {
+      m_pMapPoolPager->addSource(poolOffset + (runStart * 196), pMapData + (runStart * 196), runLength);
+    }
 
-  return pRawStaticData;
+    runStart = runEnd;
+  }
 }
 
-bool BaseFileManager::writeStaticsBlock(uint8_t, uint32_t blockNum, uint8_t* pBlockData, uint32_t updatedStaticsLength)
+/* Makes the shard files durable and empties the journal that covered them.  The block writer has to be drained 
+ * first.  If the files can't be made durable the journal is kept, it is replayed the next time the map is loaded.
+ */
+void BaseFileManager::checkpoint()
 {
 #ifdef DEBUG
-  printf("Writing statics: %i\n", blockNum);
+  printf("Checkpointing map files\n");
 #endif
 
-  char buffer[sizeof(uint32_t)];
-  uint8_t* pBlockIdx = m_pStaidxPool;
-  pBlockIdx += (blockNum * 12);
+  //the journal is about to be emptied, the blocks it wrote to a blank map have to be marked on disk first
+  m_pMaterializedBlocks->save();
+  if (!m_pBlockWriter->hasWriteFailed() && flushShardFiles())
+  {
+    m_pJournal->reset();
+  }
+#ifdef DEBUG
+  else
+  {
+    printf("Unable to write the map files, keeping the journal\n");
+  }
+#endif
+}
 
-  //Zero length statics block is a corner case
-  if (updatedStaticsLength <= 0)
+/* Runs on the block writer's thread once the writes queued ahead of the checkpoint are done */
+void BaseFileManager::checkpointInBackground(uint64_t journalMark)
+{
+#ifdef DEBUG
+  printf("Checkpointing map files in the background\n");
+#endif
+
+  if (flushShardFiles())
   {
+    m_pJournal->discardUpTo(journalMark);
+  }
 #ifdef DEBUG
-    printf("writing block with zero statics\n");
+  else
+  {
+    printf("Unable to flush the map files, keeping the journal\n");
+  }
 #endif
+}
 
-    //update index length in memory
-    *reinterpret_cast<uint32_t*>(pBlockIdx + 4) = 0;
-    
-    //update index lookup in memory
-    *reinterpret_cast<uint32_t*>(pBlockIdx) = 0xFFFFFFFF;
+/* Writes everything that was written to the shard files through to the disk.  Returns false if any of it may not have
+ * made it, in which case the journal that covers it must be kept.
+ */
+bool BaseFileManager::flushShardFiles()
+{
+  //the loaded paths only belong to the open streams once the map has finished loading
+  std::string noPath;
+  bool flushed = flushStream(m_pMapFileStream, m_mapLoaded ? m_loadedMapFileNameAndPath : noPath);
+  flushed = flushStream(m_pStaidxFileStream, m_mapLoaded ? m_loadedStaidxFileNameAndPath : noPath) && flushed;
+  flushed = flushStream(m_pStaticsFileStream, m_mapLoaded ? m_loadedStaticsFileNameAndPath : noPath) && flushed;
 
-    //update index length on disk
-    *reinterpret_cast<uint32_t*>(buffer) = 0;
-    m_pStaidxFileStream->seekp((blockNum * 12) + 4, std::ios::beg);
-    m_pStaidxFileStream->write(buffer, sizeof(uint32_t));
+  WaitForSingleObject(m_hMappingMutex, INFINITE);
 
-    //update index lookup on disk
-    *reinterpret_cast<uint32_t*>(buffer) = 0xFFFFFFFF;
-    m_pStaidxFileStream->seekp(blockNum * 12, std::ios::beg);
-    m_pStaidxFileStream->write(buffer, sizeof(uint32_t));
-    m_pStaidxFileStream->flush();
+  if (m_pMapFileMapping != NULL)
+  {
+    flushed = m_pMapFileMapping->flush() && flushed;
+  }
+
+  if (m_pStaidxFileMapping != NULL)
+  {
+    flushed = m_pStaidxFileMapping->flush() && flushed;
+  }
+
+  if (m_pStaticsFileMapping != NULL)
+  {
+    flushed = m_pStaticsFileMapping->flush() && flushed;
+  }
+
+  ReleaseMutex(m_hMappingMutex);
+
+  return flushed;
+}
 
+/* Flushing a stream only hands its data to Windows, so the file is flushed to disk through a handle of its own.  A 
+ * stream that failed a write at any point since it was opened can't be trusted to hold what the journal recorded.
+ */
+bool BaseFileManager::flushStream(std::ofstream* pStream, const std::string& path)
+{
+  if (!pStream->is_open())
+  {
     return true;
   }
 
-  uint32_t existingLookup = *reinterpret_cast<uint32_t*>(pBlockIdx); 
+  pStream->flush();
+  if (pStream->fail() || path == "")
+  {
+    return false;
+  }
 
-  #ifdef DEBUG
-    printf("Existing lookup: 0x%x\n", existingLookup);
-  #endif
+  HANDLE hFile = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (hFile == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
 
-  uint32_t existingStaticsLength = *reinterpret_cast<uint32_t*>(pBlockIdx + 4);
+  bool flushed = FlushFileBuffers(hFile) != FALSE;
+  CloseHandle(hFile);
+  return flushed;
+}
 
-  //update index length in memory
-  *reinterpret_cast<uint32_t*>(pBlockIdx + 4) = updatedStaticsLength;
+/* Hands a checkpoint to the block writer once the journal is big enough.  Everything recorded so far has already been
+ * queued for writing, so the checkpoint can drop the journal up to here once the writer gets to it.
+ */
+void BaseFileManager::checkpointIfNeeded()
+{
+  if (!m_applyingBatch && !m_pBlockWriter->isCheckpointQueued() && m_pJournal->needsCheckpoint())
+  {
+    //the journal is about to be emptied, the blocks it wrote to a blank map have to be marked on disk first
+    m_pMaterializedBlocks->save();
+    m_pBlockWriter->queueCheckpoint(m_pJournal->getRecordedSize());
+  }
+}
 
-  //update index length on disk
-  *reinterpret_cast<uint32_t*>(buffer) = updatedStaticsLength;
-  m_pStaidxFileStream->seekp((blockNum * 12) + 4, std::ios::beg);
-  m_pStaidxFileStream->write(buffer, sizeof(uint32_t));
+/* Applies a batch of land and statics blocks sent by the server.  Each record is a type byte and a big endian block 
+ * number, followed by 192 bytes of land, or by a big endian length and that many bytes of statics.  The blocks are 
+ * written the same way single updates are, but the journal is only committed, and checkpointed if needed, once the 
+ * whole batch is in.  The blocks that were written are added to rLandBlocks and rStaticsBlocks.
+ */
+void BaseFileManager::applyBlockBatch(uint8_t mapNumber, uint8_t* pRecords, uint32_t length, std::vector<uint32_t>& rLandBlocks, std::vector<uint32_t>& rStaticsBlocks)
+{
+  m_pJournal->holdCommits();
+  m_applyingBatch = true;
 
-  //Do we have enough room to write the statics into the existing location?
-  if (existingStaticsLength >= updatedStaticsLength && existingLookup != 0xFFFFFFFF && existingLookup < STATICS_MEMORY_SIZE)
+  uint32_t position = 0;
+  while (length - position >= 5)
   {
+    uint8_t type = pRecords[position];
+    uint32_t blockNum = (static_cast<uint32_t>(pRecords[position + 1]) << 24) | (pRecords[position + 2] << 16) | (pRecords[position + 3] << 8) | pRecords[position + 4];
+    position += 5;
+
+    if (type == BATCH_RECORD_LAND && length - position >= 192)
+    {
+      if (updateLandBlock(mapNumber, blockNum, pRecords + position))
+      {
+        rLandBlocks.push_back(blockNum);
+      }
+      position += 192;
+    }
+    else if (type == BATCH_RECORD_LAND_DELTA && LandDelta::getLength(pRecords + position, length - position) > 0)
+    {
+      uint8_t* pBlock = getLandBlockView(mapNumber, blockNum);
+      uint8_t patchedBlock[LandDelta::BLOCK_LENGTH];
+
+      if (pBlock != NULL && LandDelta::apply(pBlock, pRecords + position, patchedBlock))
+      {
+        if (updateLandBlock(mapNumber, blockNum, patchedBlock))
+        {
+          rLandBlocks.push_back(blockNum);
+        }
+      }
 #ifdef DEBUG
-    printf("writing statics to existing file location at 0x%x, length:%i\n", existingLookup, updatedStaticsLength);
+      else
+      {
+        printf("Dropped land delta for block %u, it doesn't match the block on disk\n", blockNum);
+      }
 #endif
+      position += LandDelta::getLength(pRecords + position, length - position);
+    }
+    else if (type == BATCH_RECORD_STATICS && length - position >= 4)
+    {
+      uint32_t staticsLength = (static_cast<uint32_t>(pRecords[position]) << 24) | (pRecords[position + 1] << 16) | (pRecords[position + 2] << 8) | pRecords[position + 3];
+      position += 4;
 
-    //update memory
-    uint8_t* pStatics = m_pStaticsPool;
-    pStatics += existingLookup;
-    memcpy(pStatics, pBlockData, updatedStaticsLength);
+      if (staticsLength > length - position)
+      {
+        break;
+      }
 
-    //update disk
-    m_pStaticsFileStream->seekp(existingLookup, std::ios::beg);
-    m_pStaticsFileStream->write((const char*)pBlockData, updatedStaticsLength);
+      if (writeStaticsBlock(mapNumber, blockNum, pRecords + position, staticsLength))
+      {
+        rStaticsBlocks.push_back(blockNum);
+      }
+      position += staticsLength;
+    }
+    else
+    {
+#ifdef DEBUG
+      printf("Malformed block batch record at %u of %u\n", position - 5, length);
+#endif
+      break;
+    }
   }
-  else
-  {
-    uint32_t newLookup = m_pStaticsPoolEnd - m_pStaticsPool;
+
+  m_applyingBatch = false;
+  m_pJournal->releaseCommits();
+  checkpointIfNeeded();
+
 #ifdef DEBUG
-    printf("writing statics to end of file 0x%x, length:%i\n", newLookup, updatedStaticsLength);
+  printf("Applied block batch: %u land, %u statics\n", rLandBlocks.size(), rStaticsBlocks.size());
 #endif
+}
 
-    //update index lookup in memory
-    *reinterpret_cast<uint32_t*>(pBlockIdx) = newLookup;
+/* Brings the statics index entries and statics of a run of consecutive blocks into memory before the client asks for
+ * them, so that the page faults happen here instead of while the client is drawing.
+ */
+void BaseFileManager::touchBlocks(uint8_t, uint32_t firstBlock, uint32_t numberOfBlocks)
+{
+  uint32_t numberOfIndexEntries = (m_pStaidxPoolEnd - m_pStaidxPool) / 12;
+  if (firstBlock >= numberOfIndexEntries)
+  {
+    return;
+  }
 
-    //update index lookup on disk
-    *reinterpret_cast<uint32_t*>(buffer) = newLookup;
-    m_pStaidxFileStream->seekp(blockNum * 12, std::ios::beg);
-    m_pStaidxFileStream->write(buffer, sizeof(uint32_t));
+  if (numberOfBlocks > numberOfIndexEntries - firstBlock)
+  {
+    numberOfBlocks = numberOfIndexEntries - firstBlock;
+  }
 
-    //update statics in memory
-    memcpy(m_pStaticsPoolEnd, pBlockData, updatedStaticsLength);
+  touchPages(m_pStaidxPool + (firstBlock * 12), numberOfBlocks * 12);
 
-    //update statics on disk
-    m_pStaticsFileStream->seekp(newLookup, std::ios::beg);
-    m_pStaticsFileStream->write((const char*)pBlockData, updatedStaticsLength);
+  for (uint32_t blockNum = firstBlock; blockNum < firstBlock + numberOfBlocks; blockNum++)
+  {
+    uint32_t lookup = *reinterpret_cast<uint32_t*>(m_pStaidxPool + (blockNum * 12));
+    uint32_t length = *reinterpret_cast<uint32_t*>(m_pStaidxPool + (blockNum * 12) + 4);
 
-    m_pStaticsPoolEnd += updatedStaticsLength;
+    if (isStaticsExtentValid(lookup, length))
+    {
+      touchPages(m_pStaticsPool + lookup, length);
+    }
   }
-
-  m_pStaidxFileStream->flush();
-  m_pStaticsFileStream->flush();
-  return true;
 }
 
-void BaseFileManager::Initialize()
+void BaseFileManager::touchPages(uint8_t* pData, uint32_t length)
 {
-  CreateDirectoryA(getUltimaLiveSavePath().c_str(), NULL);
+  if (length == 0)
+  {
+    return;
+  }
+
+  volatile uint8_t touched = 0;
+  uint8_t* pLastPage = reinterpret_cast<uint8_t*>(reinterpret_cast<uint32_t>(pData + length - 1) & ~(DemandPagedPool::PAGE_SIZE - 1));
+
+  for (uint8_t* pPage = reinterpret_cast<uint8_t*>(reinterpret_cast<uint32_t>(pData) & ~(DemandPagedPool::PAGE_SIZE - 1)); pPage <= pLastPage; pPage += DemandPagedPool::PAGE_SIZE)
+  {
+    touched = *(pPage < pData ? pData : pPage);
+  }
 }
 
-void BaseFileManager::onLogout()
+bool BaseFileManager::readFileIntoPool(std::string filePath, ReservedPool* pPool, uint32_t& rLength)
 {
-#ifdef DEBUG
-  printf("Closing map, staidx, statics file streams\n");
-#endif
-  if (m_pMapFileStream != NULL)
+  rLength = 0;
+
+  std::ifstream file;
+  file.open(filePath, std::ios::binary | std::ios::in);
+  if (!file.is_open())
   {
-    m_pMapFileStream->flush();
-    m_pMapFileStream->close();
+    return false;
   }
 
-  if (m_pStaidxFileStream != NULL)
+  file.seekg (0, file.end);
+  std::streamoff length = file.tellg();
+  if (length > pPool->getSize())
   {
-    m_pStaidxFileStream->flush();
-    m_pStaidxFileStream->close();
+    length = pPool->getSize();
   }
 
-  if (m_pStaticsFileStream != NULL)
+  if (length > 0 && pPool->commit(static_cast<uint32_t>(length)))
   {
-    m_pStaticsFileStream->flush();
-    m_pStaticsFileStream->close();
+    file.seekg (0, file.beg);
+    file.read(reinterpret_cast<char*>(pPool->getAddress()), length);
+    rLength = static_cast<uint32_t>(length);
   }
+  file.close();
+
+  return true;
+}
+
+void BaseFileManager::Initialize()
+{
+  CreateDirectoryA(getUltimaLiveSavePath().c_str(), NULL);
+}
+
+void BaseFileManager::onLogout()
+{
+#ifdef DEBUG
+  printf("Closing map, staidx, statics files\n");
+#endif
+  //nothing is kept resident across logins, the next login may be to another shard
+  m_mapLoaded = false;
+  closeMapFiles();
+  m_pResidentMaps->printStatistics();
+  m_pResidentMaps->clear();
+  m_pBlockWriter->printStatistics();
+  printHookStatistics();
+
+#ifdef DEBUG
+  printf("Pools: %u KB committed, %u KB peak this session\n", ReservedPool::getCommittedBytes() / 1024, ReservedPool::getPeakCommittedBytes() / 1024);
+#endif
 }
 
+const uint8_t BaseFileManager::BLANK_LAND_BLOCK[196] = {
+  0x00, 0x00, 0x00, 0x00, //header
+  0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00,
+  0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00,
+  0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00,
+  0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00,
+  0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00,
+  0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00,
+  0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00,
+  0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00 };
+
 bool BaseFileManager::createNewPersistentMap(std::string pathWithoutFilename, uint8_t mapNumber, uint32_t numHorizontalBlocks, uint32_t numVerticalBlocks)
 {
   //create file names
@@ -195,39 +963,32 @@ bool BaseFileManager::createNewPersistentMap(std::string pathWithoutFilename, ui
   sprintf_s(filename, "statics%i.mul", mapNumber);
   staticsPath.append(filename);
 
-  //create map new file
-  std::fstream mapFile;
-  mapFile.open(mapPath, std::ios::out | std::ios::app | std::ios::binary | std::ios::in);
+  uint32_t numberOfBlocks = numHorizontalBlocks * numVerticalBlocks;
 
 #ifdef DEBUG
   printf("Creating map file\n");
   printf("Writing %u blocks by %u blocks\n", numHorizontalBlocks, numVerticalBlocks);
 #endif
 
-  uint32_t numberOfBytesInStrip = 196 * numVerticalBlocks;
-  char* pVerticalBlockStrip = new char[numberOfBytesInStrip];
-
-  const char block[196] = {
-                          0x00, 0x00, 0x00, 0x00, //header
-                          0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00,
-                          0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00,
-                          0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00,
-                          0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00,
-                          0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00,
-                          0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00,
-                          0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00,
-                          0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00, 0x44, 0x02, 0x00 };
-  for (uint32_t y = 0; y < numVerticalBlocks; y++)
-  {
-    memcpy(&pVerticalBlockStrip[196 * y], block, 196);
-  }  
+  //the map file is created sparse and left empty, blocks that are never written are served as the blank land block.
+  //The sidecar goes first so that a map file without one always holds real data.
+  MaterializedBlockMap materializedBlocks;
+  if (!materializedBlocks.create(getMaterializedBlockMapPath(mapPath), numberOfBlocks))
+  {
+    return false;
+  }
 
-  for (uint32_t x = 0; x < numHorizontalBlocks; x++)
+  HANDLE hMapFile = CreateFileA(mapPath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (hMapFile == INVALID_HANDLE_VALUE)
   {
-    mapFile.write(pVerticalBlockStrip, numberOfBytesInStrip);
+    return false;
   }
-  delete pVerticalBlockStrip;
-  mapFile.close();
+
+  DWORD bytesReturned = 0;
+  DeviceIoControl(hMapFile, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &bytesReturned, NULL);
+  SetFilePointer(hMapFile, numberOfBlocks * 196, NULL, FILE_BEGIN);
+  SetEndOfFile(hMapFile);
+  CloseHandle(hMapFile);
 
   std::fstream staidxFile;
   staidxFile.open(staidxPath, std::ios::out | std::ios::app | std::ios::binary | std::ios::in);
@@ -237,20 +998,17 @@ bool BaseFileManager::createNewPersistentMap(std::string pathWithoutFilename, ui
   printf("W %u blocks by %u blocks\n", numHorizontalBlocks, numVerticalBlocks);
 #endif
 
-  uint32_t numberOfBytesInIndexStrip = 12 * numVerticalBlocks;
-  char* pVerticalBlockIndexStrip = new char[numberOfBytesInIndexStrip];
+  uint32_t numberOfBytesInIndex = 12 * numberOfBlocks;
+  char* pIndex = new char[numberOfBytesInIndex];
   unsigned char blankIndex[12] = { 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
 
-  for (uint32_t y = 0; y < numVerticalBlocks; y++)
+  for (uint32_t blockNum = 0; blockNum < numberOfBlocks; blockNum++)
   {
-    memcpy(&pVerticalBlockIndexStrip[12 * y], blankIndex, 12);
+    memcpy(&pIndex[12 * blockNum], blankIndex, 12);
   }  
 
-  for (uint32_t x = 0; x < numHorizontalBlocks; x++)
-  {
-    staidxFile.write(pVerticalBlockIndexStrip, numberOfBytesInIndexStrip);
-  }
-  delete pVerticalBlockIndexStrip;
+  staidxFile.write(pIndex, numberOfBytesInIndex);
+  delete[] pIndex;
   staidxFile.close();
 
   std::fstream staticsFile;
@@ -260,56 +1018,6 @@ bool BaseFileManager::createNewPersistentMap(std::string pathWithoutFilename, ui
   return true;
 }
 
-void BaseFileManager::copyFile(std::string sourceFilePath, std::string destFilePath, ProgressBarDialog* pProgress)
-{
-  std::ifstream sourceFile(sourceFilePath, std::ifstream::binary);
-
-  if (!sourceFile.good())
-  {
-    sourceFile.close();
-    return;
-  }
-
-  sourceFile.seekg(0, sourceFile.end);
-  std::streamoff totalFileSizeInBytes = sourceFile.tellg();
-  sourceFile.close();
-
-  uint32_t bytesCopied = 0;
-  uint32_t prevPercent = 0;
-
-  // allocate memory for buffer
-  char* buffer = new char[4096];
-  size_t bytesToWrite;
-
-  FILE* pSource = fopen(sourceFilePath.c_str(), "rb");
-  FILE* pDest = fopen(destFilePath.c_str(), "wb");
-
-    // clean and more secure
-    // feof(FILE* stream) returns non-zero if the end of file indicator for stream is set
-  do 
-  {
-    bytesToWrite = fread(buffer, 1, 4096, pSource);
-    if (bytesToWrite != 0)
-    {
-      fwrite(buffer, 1, bytesToWrite, pDest);
-      bytesCopied += bytesToWrite;
-      
-      if (pProgress != NULL)
-      {
-        uint32_t percent = (uint32_t)(((float)bytesCopied / (float)totalFileSizeInBytes) * 100.0f);
-        if ((uint32_t)percent > prevPercent)
-        {
-          prevPercent = percent;
-          pProgress->setProgress((uint32_t)percent);
-        }
-      }
-    }
-  } while (bytesToWrite != 0);
-
-  fclose(pSource);
-  fclose(pDest);
-}
-
 void BaseFileManager::InitializeShardMaps(std::string shardIdentifier, std::map<uint32_t, MapDefinition> mapDefinitions)
 {
   m_pProgressDlg = new ProgressBarDialog();
@@ -321,11 +1029,17 @@ void BaseFileManager::InitializeShardMaps(std::string shardIdentifier, std::map<
 #endif
 
   m_shardIdentifier = shardIdentifier;
+  m_pResidentMaps->clear();
+  reservePoolsForMaps(mapDefinitions);
+
   std::string shardFullPath(getUltimaLiveSavePath());
   shardFullPath.append("\\");
   shardFullPath.append(shardIdentifier);
   CreateDirectoryA(shardFullPath.c_str(), NULL);
 
+  //files found in the client folder are queued here and imported together once all maps have been checked
+  ShardImporter importer;
+
   for (std::map<uint32_t, MapDefinition>::iterator itr = mapDefinitions.begin(); itr != mapDefinitions.end(); itr++)
   {
     std::string filePath(shardFullPath);
@@ -378,19 +1092,11 @@ void BaseFileManager::InitializeShardMaps(std::string shardIdentifier, std::map<
       if (fileSizeNeeded == currentFileSize)
       {
 #ifdef DEBUG
-        printf("Copying File: %s to %s ... ", existingFilePath.c_str(), filePath.c_str());
+        printf("Importing File: %s to %s\n", existingFilePath.c_str(), filePath.c_str());
 #endif
         //map file
-        std::string mapMessage("Copying ");
-        mapMessage.append(filename);
-        mapMessage.append(" from game client folder");
-        m_pProgressDlg->setMessage(mapMessage);
-        m_pProgressDlg->setProgress(0);
-        copyFile(existingFilePath, filePath, m_pProgressDlg);
+        importer.addCopy(itr->first, existingFilePath, filePath);
 
-#ifdef DEBUG
-        printf("done!\n");
-#endif
         //statics file
         std::string dstStaticsFilePath(shardFullPath);
         dstStaticsFilePath.append("\\");
@@ -400,20 +1106,8 @@ void BaseFileManager::InitializeShardMaps(std::string shardIdentifier, std::map<
         std::string staticsFilePath (clientFolder);
         staticsFilePath.append("\\");
         staticsFilePath.append(staticsFilename);
+        importer.addCopy(itr->first, staticsFilePath, dstStaticsFilePath);
 
-#ifdef DEBUG
-        printf("Copying File: %s to %s ... ", staticsFilePath.c_str(), dstStaticsFilePath.c_str());
-#endif
-        std::string staticsMessage("Copying ");
-        staticsMessage.append(staticsFilename);
-        staticsMessage.append(" from game client folder");
-        m_pProgressDlg->setMessage(staticsMessage);
-        m_pProgressDlg->setProgress(0);
-        copyFile(staticsFilePath, dstStaticsFilePath, m_pProgressDlg);
-
-#ifdef DEBUG
-        printf("done!\n");
-#endif
         //statics idx
         std::string dstStaidxFilePath(shardFullPath);
         dstStaidxFilePath.append("\\");
@@ -423,21 +1117,7 @@ void BaseFileManager::InitializeShardMaps(std::string shardIdentifier, std::map<
         std::string staidxFilePath (clientFolder);
         staidxFilePath.append("\\");
         staidxFilePath.append(staidxFilename);
-
-#ifdef DEBUG
-        printf("Copying File: %s to %s ... ", staidxFilePath.c_str(), dstStaidxFilePath.c_str());
-#endif
-        std::string staidxMessage("Copying ");
-        staidxMessage.append(filename);
-        staidxMessage.append(" from game client folder");
-        m_pProgressDlg->setMessage(staidxMessage);
-        m_pProgressDlg->setProgress(0);
-        copyFile(staidxFilePath, dstStaidxFilePath, m_pProgressDlg);
-
-#ifdef DEBUG
-        printf("done!\n");
-#endif
-
+        importer.addCopy(itr->first, staidxFilePath, dstStaidxFilePath);
       }
       else
       {
@@ -448,6 +1128,18 @@ void BaseFileManager::InitializeShardMaps(std::string shardIdentifier, std::map<
     mapFile.close();
   }
 
+  if (!importer.run(m_pProgressDlg))
+  {
+    //start over with a blank map where the client files could not be imported
+    for (std::map<uint32_t, MapDefinition>::iterator itr = mapDefinitions.begin(); itr != mapDefinitions.end(); itr++)
+    {
+      if (!importer.mapSucceeded(itr->first))
+      {
+        createNewPersistentMap(shardFullPath, static_cast<uint8_t>(itr->first), itr->second.mapWidthInTiles >> 3, itr->second.mapWrapHeightInTiles >> 3);
+      }
+    }
+  }
+
   m_pProgressDlg->hide();
   delete m_pProgressDlg;
   m_pProgressDlg = NULL;
@@ -469,6 +1161,8 @@ std::string BaseFileManager::getUltimaLiveSavePath()
 
 BaseFileManager::BaseFileManager()
   : m_files(),
+  m_filesByCreateHandle(),
+  m_filesByMappingHandle(),
   m_pMapPool(NULL),
   m_pStaticsPool(NULL),
   m_pStaticsPoolEnd(NULL),
@@ -478,25 +1172,110 @@ BaseFileManager::BaseFileManager()
   m_pMapFileStream(new std::ofstream()),
   m_pStaidxFileStream(new std::ofstream()),
   m_pStaticsFileStream(new std::ofstream()),
+  m_pBlockWriter(NULL),
+  m_hMappingMutex(CreateMutex(NULL, false, NULL)),
+  m_pMapReservation(NULL),
+  m_pStaidxReservation(NULL),
+  m_pStaticsReservation(NULL),
+  m_pMapFileMapping(NULL),
+  m_pStaidxFileMapping(NULL),
+  m_pStaticsFileMapping(NULL),
+  m_pJournal(new Journal()),
+  m_pStaticsAllocator(new StaticsAllocator()),
+  m_pMapPoolPager(NULL),
+  m_pMaterializedBlocks(new MaterializedBlockMap()),
+  m_pResidentMaps(new ResidentMapCache(ResidentMapCache::DEFAULT_BUDGET)),
+  m_pBlockCrcs(new BlockCrcCache()),
+  m_applyingBatch(false),
+  m_mapLoaded(false),
+  m_loadedMapNumber(0),
+  m_loadedMapFileNameAndPath(""),
+  m_loadedStaidxFileNameAndPath(""),
+  m_loadedStaticsFileNameAndPath(""),
+  m_staticsFreeListFileNameAndPath(""),
   m_pProgressDlg()
 {
-  //do nothing
+  memset(m_hookCallCounts, 0, sizeof(m_hookCallCounts));
+  memset(m_hookTicks, 0, sizeof(m_hookTicks));
+
+  m_pBlockWriter = new BlockWriter(m_pMapFileStream, m_pStaidxFileStream, m_pStaticsFileStream);
+  m_pBlockWriter->setCheckpointFunction(std::bind(&BaseFileManager::checkpointInBackground, this, std::placeholders::_1));
+  m_pBlockWriter->setWriteAheadFunction(std::bind(&Journal::commit, m_pJournal));
 }
 
 BOOL WINAPI BaseFileManager::OnCloseHandle(_In_ HANDLE hObject)
 {
-  for (std::map<std::string, ClientFileHandleSet*>::const_iterator iterator = m_files.begin(); iterator != m_files.end(); iterator++)
+  std::unordered_map<HANDLE, ClientFileHandleSet*>::iterator createItr = m_filesByCreateHandle.find(hObject);
+  if (createItr != m_filesByCreateHandle.end())
   {
-    if (iterator->second->m_createFileHandle == hObject)
-    {
-        m_files.erase(iterator);
-        break;
-    }
+    ClientFileHandleSet* pFile = createItr->second;
+    m_filesByCreateHandle.erase(createItr);
+    pFile->m_createFileHandle = INVALID_HANDLE_VALUE;
+    releaseFileIfClosed(pFile);
+    return true;
+  }
+
+  std::unordered_map<HANDLE, ClientFileHandleSet*>::iterator mappingItr = m_filesByMappingHandle.find(hObject);
+  if (mappingItr != m_filesByMappingHandle.end())
+  {
+    ClientFileHandleSet* pFile = mappingItr->second;
+    m_filesByMappingHandle.erase(mappingItr);
+    pFile->m_createFileMappingHandle = INVALID_HANDLE_VALUE;
+    releaseFileIfClosed(pFile);
   }
 
   return true;
 }
 
+/* A file set is kept until both its file handle and its mapping handle are closed, the client may close the file 
+ * before it maps a view of the mapping.
+ */
+void BaseFileManager::releaseFileIfClosed(ClientFileHandleSet* pFile)
+{
+  if (pFile->m_createFileHandle == INVALID_HANDLE_VALUE && pFile->m_createFileMappingHandle == INVALID_HANDLE_VALUE)
+  {
+    m_files.erase(Utils::getFilenameFromPath(pFile->m_filename));
+    delete pFile;
+  }
+}
+
+ClientFileHandleSet* BaseFileManager::findFileByMappingHandle(HANDLE hFileMappingObject)
+{
+  std::unordered_map<HANDLE, ClientFileHandleSet*>::iterator itr = m_filesByMappingHandle.find(hFileMappingObject);
+  if (itr != m_filesByMappingHandle.end())
+  {
+    return itr->second;
+  }
+
+  return NULL;
+}
+
+void BaseFileManager::recordHookCall(FileHook hook, LARGE_INTEGER startTime)
+{
+  LARGE_INTEGER endTime;
+  QueryPerformanceCounter(&endTime);
+  m_hookCallCounts[hook]++;
+  m_hookTicks[hook] += endTime.QuadPart - startTime.QuadPart;
+}
+
+void BaseFileManager::printHookStatistics()
+{
+#ifdef DEBUG
+  static const char* hookNames[NUMBER_OF_FILE_HOOKS] = { "CreateFileA", "CreateFileMappingA", "MapViewOfFile", "CloseHandle" };
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+
+  for (uint32_t i = 0; i < NUMBER_OF_FILE_HOOKS; i++)
+  {
+    double totalUs = (m_hookTicks[i] * 1000000.0) / frequency.QuadPart;
+    printf("Hook %s: %u calls, %.0f us total, %.2f us per call\n", hookNames[i], m_hookCallCounts[i], totalUs, 
+      m_hookCallCounts[i] > 0 ? totalUs / m_hookCallCounts[i] : 0.0);
+  }
+
+  printf("Tracking %u client files\n", static_cast<uint32_t>(m_files.size()));
+#endif
+}
+
 HANDLE WINAPI BaseFileManager::OnCreateFileA(
   __in      LPCSTR lpFileName,
   __in      DWORD dwDesiredAccess,
@@ -510,14 +1289,31 @@ HANDLE WINAPI BaseFileManager::OnCreateFileA(
   std::string originalFilename(lpFileName);
   std::string filename = Utils::getFilenameFromPath(originalFilename);
 
-  std::map<std::string, ClientFileHandleSet*>::iterator pMatchingFileSetItr = m_files.find(filename);
-
   HANDLE handleToBeReturned = CreateFileA(lpFileName, dwDesiredAccess, dwShareMode, lpSecurityAttributes, dwCreationDisposition, dwFlagsAndAttributes, hTemplateFile);
 
+  if (handleToBeReturned == INVALID_HANDLE_VALUE)
+  {
+    return handleToBeReturned;
+  }
+
+  std::map<std::string, ClientFileHandleSet*>::iterator pMatchingFileSetItr = m_files.find(filename);
+  ClientFileHandleSet* pFile = NULL;
+
   if (pMatchingFileSetItr == m_files.end())
   {
-    m_files[filename] = new ClientFileHandleSet(originalFilename);
-    m_files[filename]->m_createFileHandle = handleToBeReturned;
+    pFile = new ClientFileHandleSet(originalFilename);
+    m_files[filename] = pFile;
+  }
+  else if (pMatchingFileSetItr->second->m_createFileHandle == INVALID_HANDLE_VALUE)
+  {
+    //the file was closed but its mapping is still open
+    pFile = pMatchingFileSetItr->second;
+  }
+
+  if (pFile != NULL)
+  {
+    pFile->m_createFileHandle = handleToBeReturned;
+    m_filesByCreateHandle[handleToBeReturned] = pFile;
   }
 
   return handleToBeReturned;
@@ -532,22 +1328,19 @@ HANDLE WINAPI BaseFileManager::OnCreateFileMappingA(
   __in_opt  LPCSTR lpName
   )
 {
-  ClientFileHandleSet* pMatchingFileset = NULL;
+  HANDLE handleToReturn = CreateFileMappingA(hFile, lpAttributes, flProtect, dwMaximumSizeHigh, dwMaximumSizeLow, lpName);
 
-  for (std::map<std::string, ClientFileHandleSet*>::const_iterator iterator = m_files.begin(); iterator != m_files.end(); iterator++)
+  std::unordered_map<HANDLE, ClientFileHandleSet*>::iterator itr = m_filesByCreateHandle.find(hFile);
+  if (itr != m_filesByCreateHandle.end() && handleToReturn != NULL)
   {
-    if (hFile == iterator->second->m_createFileHandle)
+    ClientFileHandleSet* pMatchingFileset = itr->second;
+    if (pMatchingFileset->m_createFileMappingHandle != INVALID_HANDLE_VALUE)
     {
-      pMatchingFileset = iterator->second;
-      break;
+      m_filesByMappingHandle.erase(pMatchingFileset->m_createFileMappingHandle);
     }
-  }
-  
-  HANDLE handleToReturn = CreateFileMappingA(hFile, lpAttributes, flProtect, dwMaximumSizeHigh, dwMaximumSizeLow, lpName);
 
-  if (pMatchingFileset != NULL)
-  {
     pMatchingFileset->m_createFileMappingHandle = handleToReturn;
+    m_filesByMappingHandle[handleToReturn] = pMatchingFileset;
   }
 
 	return handleToReturn;
@@ -561,16 +1354,7 @@ LPVOID WINAPI BaseFileManager::OnMapViewOfFile(
   __in  SIZE_T dwNumberOfBytesToMap
   )
 {
-  ClientFileHandleSet* pMatchingFileset = NULL;
-
-  for (std::map<std::string, ClientFileHandleSet*>::const_iterator iterator = m_files.begin(); iterator != m_files.end(); iterator++)
-  {
-    if (hFileMappingObject == iterator->second->m_createFileMappingHandle)
-    {
-      pMatchingFileset = iterator->second;
-      break;
-    }
-  }
+  ClientFileHandleSet* pMatchingFileset = findFileByMappingHandle(hFileMappingObject);
 
   HANDLE handleToReturn = handleToReturn = MapViewOfFile(hFileMappingObject, dwDesiredAccess, dwFileOffsetHigh, dwFileOffsetLow, dwNumberOfBytesToMap); 
 
@@ -26,11 +26,22 @@
 #include <cstdio>
 #include <fstream>
 #include <map>
+#include <unordered_map>
+#include <vector>
 #include <string>
 #include <stdio.h>
 #include <Windows.h>
 
 #include "ClientFileHandleSet.h"
+#include "ReservedPool.h"
+#include "MappedFile.h"
+#include "Journal.h"
+#include "BlockWriter.h"
+#include "StaticsAllocator.h"
+#include "DemandPagedPool.h"
+#include "MaterializedBlockMap.h"
+#include "ResidentMapCache.h"
+#include "BlockCrcCache.h"
 #include "BaseFileManager.h"
 #include "..\Utils.h"
 #include "..\ProgressBarDialog.h"
@@ -83,18 +94,45 @@ class BaseFileManager
   virtual bool updateLandBlock(uint8_t mapNumber, uint32_t blockNum, uint8_t* pData) = 0;
   virtual unsigned char* readLandBlock(uint8_t mapNumber, uint32_t blockNum) = 0;
   virtual unsigned char* readStaticsBlock(uint32_t mapNumber, uint32_t blockNum, uint32_t& rNumberOfBytesOut);
+  virtual unsigned char* getLandBlockView(uint8_t mapNumber, uint32_t blockNum) = 0;
+  virtual unsigned char* getStaticsBlockView(uint32_t mapNumber, uint32_t blockNum, uint32_t& rNumberOfBytesOut);
   virtual bool writeStaticsBlock(uint8_t mapNumber, uint32_t blockNum, uint8_t* pBlockData, uint32_t length);
   virtual void Initialize();
   virtual void LoadMap(uint8_t mapNumber) = 0;
   virtual void InitializeShardMaps(std::string shardIdentifier, std::map<uint32_t, MapDefinition> definitions);
   virtual void onLogout();
+  virtual void touchBlocks(uint8_t mapNumber, uint32_t firstBlock, uint32_t numberOfBlocks);
+  void applyBlockBatch(uint8_t mapNumber, uint8_t* pRecords, uint32_t length, std::vector<uint32_t>& rLandBlocks, std::vector<uint32_t>& rStaticsBlocks);
 
-  static void copyFile(std::string sourceFilePath, std::string destFilePath, ProgressBarDialog* pProgress);
+  enum FileHook
+  {
+    HOOK_CREATE_FILE,
+    HOOK_CREATE_FILE_MAPPING,
+    HOOK_MAP_VIEW_OF_FILE,
+    HOOK_CLOSE_HANDLE,
+    NUMBER_OF_FILE_HOOKS
+  };
+
+  void recordHookCall(FileHook hook, LARGE_INTEGER startTime);
+
+  bool lookupBlockCrc(uint32_t mapNumber, uint32_t blockNum, uint16_t& rCrc);
+  void storeBlockCrc(uint32_t mapNumber, uint32_t blockNum, uint16_t crc);
+
+  static bool readFileIntoPool(std::string filePath, ReservedPool* pPool, uint32_t& rLength);
 
   static const int STATICS_MEMORY_SIZE = 200000000;
+  static const uint8_t BLANK_LAND_BLOCK[196];
+  static const uint8_t BATCH_RECORD_LAND = 0;
+  static const uint8_t BATCH_RECORD_STATICS = 1;
+  static const uint8_t BATCH_RECORD_LAND_DELTA = 2;
 
 protected:
+  //m_files owns the file sets, the handle maps only index them
   std::map<std::string, ClientFileHandleSet*> m_files;
+  std::unordered_map<HANDLE, ClientFileHandleSet*> m_filesByCreateHandle;
+  std::unordered_map<HANDLE, ClientFileHandleSet*> m_filesByMappingHandle;
+  uint32_t m_hookCallCounts[NUMBER_OF_FILE_HOOKS];
+  int64_t m_hookTicks[NUMBER_OF_FILE_HOOKS];
   uint8_t* m_pMapPool;
   uint8_t* m_pStaticsPool;
   uint8_t* m_pStaticsPoolEnd;
@@ -104,7 +142,56 @@ protected:
   std::ofstream* m_pMapFileStream;
   std::ofstream* m_pStaidxFileStream;
   std::ofstream* m_pStaticsFileStream;
+  BlockWriter* m_pBlockWriter;
+  HANDLE m_hMappingMutex;
+  ReservedPool* m_pMapReservation;
+  ReservedPool* m_pStaidxReservation;
+  ReservedPool* m_pStaticsReservation;
+  MappedFile* m_pMapFileMapping;
+  MappedFile* m_pStaidxFileMapping;
+  MappedFile* m_pStaticsFileMapping;
+  Journal* m_pJournal;
+  StaticsAllocator* m_pStaticsAllocator;
+  DemandPagedPool* m_pMapPoolPager;
+  MaterializedBlockMap* m_pMaterializedBlocks;
+  ResidentMapCache* m_pResidentMaps;
+  BlockCrcCache* m_pBlockCrcs;
+  bool m_applyingBatch;
+  bool m_mapLoaded;
+  uint8_t m_loadedMapNumber;
+  std::string m_loadedMapFileNameAndPath;
+  std::string m_loadedStaidxFileNameAndPath;
+  std::string m_loadedStaticsFileNameAndPath;
+  std::string m_staticsFreeListFileNameAndPath;
   std::string getUltimaLiveSavePath();
+  ClientFileHandleSet* findFileByMappingHandle(HANDLE hFileMappingObject);
+  void releaseFileIfClosed(ClientFileHandleSet* pFile);
+  void printHookStatistics();
+  bool openShardFile(MappedFile* pMapping, uint8_t mapNumber, uint32_t file, std::string fileNameAndPath, uint32_t minimumSize, bool copyOnWrite = false);
+  void loadStaticsFiles(uint8_t mapNumber, std::string staidxFileNameAndPath, std::string staticsFileNameAndPath);
+  uint32_t getStaticsDataEnd(uint32_t fileSize);
+  void finishLoadingMap(uint8_t mapNumber, std::string mapFileNameAndPath, std::string staidxFileNameAndPath, std::string staticsFileNameAndPath, bool resident, LARGE_INTEGER startTime);
+  virtual void closeMapFiles();
+  void reservePoolsForMaps(std::map<uint32_t, MapDefinition>& rDefinitions);
+  static void touchPages(uint8_t* pData, uint32_t length);
+  void addLandSources(uint32_t poolOffset, uint32_t firstBlock, uint32_t length, uint8_t* pMapData);
+  static std::string getMaterializedBlockMapPath(std::string mapFileNameAndPath);
+  static std::string getBlockCrcCachePath(std::string mapFileNameAndPath);
+  static uint64_t getBlockCrcFilesStamp(std::string mapFileNameAndPath, std::string staidxFileNameAndPath, std::string staticsFileNameAndPath, uint32_t& rMapFileSize);
+  void replayJournal(std::string journalFileNameAndPath, std::string mapFileNameAndPath, std::string staidxFileNameAndPath, std::string staticsFileNameAndPath);
+  void checkpoint();
+  void checkpointIfNeeded();
+  void checkpointInBackground(uint64_t journalMark);
+  bool flushShardFiles();
+  static bool flushStream(std::ofstream* pStream, const std::string& path);
+  void commitBeforeViewWrite(MappedFile* pMapping);
+  void commitBeforeStaticsWrite();
+  void persistStaidxEntry(uint32_t blockNum);
+  void persistStatics(uint32_t lookup, uint32_t length);
+  bool isStaticsExtentValid(uint32_t lookup, uint32_t length);
+  void releaseStatics(uint32_t lookup, uint32_t length);
+  bool reserveStaticsSpace(uint32_t length);
+  void compactStatics(uint32_t maxMoves, bool force);
   virtual bool createNewPersistentMap(std::string pathWithoutFilename, uint8_t mapNumber, uint32_t numHorizontalBlocks, uint32_t numVerticalBlocks);
 
   ProgressBarDialog* m_pProgressDlg;
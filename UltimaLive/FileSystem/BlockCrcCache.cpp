@@ -0,0 +1,191 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "BlockCrcCache.h"
+#include <fstream>
+#include <cstdio>
+
+BlockCrcCache::BlockCrcCache()
+  : m_path(),
+  m_crcs(),
+  m_validBits(),
+  m_numberOfBlocks(0),
+  m_open(false),
+  m_hits(0),
+  m_misses(0)
+{
+  //do nothing
+}
+
+/* Starts a table for a map of numberOfBlocks blocks, picking up the saved table if it was computed from files with the 
+ * same stamp.  Must be called before the journal is replayed into the files.  A table that is still open is dropped
+ * without being saved.
+ */
+void BlockCrcCache::open(std::string path, uint32_t numberOfBlocks, uint64_t filesStamp)
+{
+  m_path = path;
+  m_numberOfBlocks = numberOfBlocks;
+  m_hits = 0;
+  m_misses = 0;
+  m_open = true;
+
+  if (!load(m_numberOfBlocks, filesStamp))
+  {
+    m_crcs.assign(m_numberOfBlocks, 0);
+    m_validBits.assign((m_numberOfBlocks + 7) / 8, 0);
+  }
+
+  //the table on disk is only good until the first update, it is written again when the map is closed
+  remove(path.c_str());
+}
+
+/* Saves the table with the stamp of the files as they were left when the map was closed, so it has to be called after
+ * the files are closed.
+ */
+void BlockCrcCache::close(uint64_t filesStamp)
+{
+  if (!m_open)
+  {
+    return;
+  }
+
+#ifdef DEBUG
+  printf("Block crcs: %u lookups answered from the table, %u computed\n", m_hits, m_misses);
+#endif
+
+  save(filesStamp);
+  m_path = "";
+  m_crcs.clear();
+  m_validBits.clear();
+  m_numberOfBlocks = 0;
+  m_open = false;
+}
+
+bool BlockCrcCache::isOpen()
+{
+  return m_open;
+}
+
+bool BlockCrcCache::lookup(uint32_t blockNum, uint16_t& rCrc)
+{
+  if (!m_open)
+  {
+    return false;
+  }
+
+  if (blockNum >= m_numberOfBlocks || (m_validBits[blockNum >> 3] & (1 << (blockNum & 7))) == 0)
+  {
+    m_misses++;
+    return false;
+  }
+
+  m_hits++;
+  rCrc = m_crcs[blockNum];
+  return true;
+}
+
+void BlockCrcCache::store(uint32_t blockNum, uint16_t crc)
+{
+  if (m_open && blockNum < m_numberOfBlocks)
+  {
+    m_crcs[blockNum] = crc;
+    m_validBits[blockNum >> 3] |= static_cast<uint8_t>(1 << (blockNum & 7));
+  }
+}
+
+void BlockCrcCache::invalidate(uint32_t blockNum)
+{
+  if (m_open && blockNum < m_numberOfBlocks)
+  {
+    m_validBits[blockNum >> 3] &= static_cast<uint8_t>(~(1 << (blockNum & 7)));
+  }
+}
+
+//lookups of an open table answered from it and not, since it was opened
+uint32_t BlockCrcCache::getHits()
+{
+  return m_hits;
+}
+
+uint32_t BlockCrcCache::getMisses()
+{
+  return m_misses;
+}
+
+bool BlockCrcCache::load(uint32_t numberOfBlocks, uint64_t filesStamp)
+{
+  std::ifstream cacheFile(m_path, std::ios::binary | std::ios::in);
+  if (!cacheFile.is_open())
+  {
+    return false;
+  }
+
+  uint32_t header[2] = { 0, 0 };
+  uint64_t stamp = 0;
+  cacheFile.read(reinterpret_cast<char*>(header), sizeof(header));
+  cacheFile.read(reinterpret_cast<char*>(&stamp), sizeof(stamp));
+
+  bool loaded = false;
+  if (cacheFile.good() && header[0] == CACHE_MAGIC && header[1] == numberOfBlocks && stamp == filesStamp && numberOfBlocks > 0)
+  {
+    m_validBits.assign((numberOfBlocks + 7) / 8, 0);
+    m_crcs.assign(numberOfBlocks, 0);
+    cacheFile.read(reinterpret_cast<char*>(&m_validBits[0]), m_validBits.size());
+    cacheFile.read(reinterpret_cast<char*>(&m_crcs[0]), m_crcs.size() * sizeof(uint16_t));
+    loaded = cacheFile.good();
+  }
+
+  cacheFile.close();
+
+#ifdef DEBUG
+  printf("Block crc table %s %s\n", m_path.c_str(), loaded ? "loaded" : "is stale or damaged");
+#endif
+
+  return loaded;
+}
+
+void BlockCrcCache::save(uint64_t filesStamp)
+{
+  if (m_numberOfBlocks == 0)
+  {
+    return;
+  }
+
+  std::ofstream cacheFile(m_path, std::ios::binary | std::ios::out | std::ios::trunc);
+  if (cacheFile.is_open())
+  {
+    uint32_t header[2] = { CACHE_MAGIC, m_numberOfBlocks };
+    cacheFile.write(reinterpret_cast<const char*>(header), sizeof(header));
+    cacheFile.write(reinterpret_cast<const char*>(&filesStamp), sizeof(filesStamp));
+    cacheFile.write(reinterpret_cast<const char*>(&m_validBits[0]), m_validBits.size());
+    cacheFile.write(reinterpret_cast<const char*>(&m_crcs[0]), m_crcs.size() * sizeof(uint16_t));
+    cacheFile.flush();
+    bool saved = cacheFile.good();
+    cacheFile.close();
+
+    if (!saved)
+    {
+      remove(m_path.c_str());
+    }
+  }
+}
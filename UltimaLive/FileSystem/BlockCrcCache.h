@@ -0,0 +1,71 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _BLOCK_CRC_CACHE_H
+#define _BLOCK_CRC_CACHE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/* Remembers the crc of every block of the loaded map that has been hashed since the block was last written.
+ *
+ * A block only changes when the server sends a land or statics update for it, so a crc stays good until then and
+ * answering a hash query mostly comes down to table lookups.  The table is saved next to the map file when the map
+ * is closed and read back when it is loaded again, together with a stamp of the shard files it was computed from, 
+ * which the file manager works out.
+ * The saved table is deleted as soon as it has been read, so after a crash, when the journal may have replayed 
+ * updates into the files, every crc is computed again.
+ */
+class BlockCrcCache
+{
+  public:
+    BlockCrcCache();
+
+    void open(std::string path, uint32_t numberOfBlocks, uint64_t filesStamp);
+    void close(uint64_t filesStamp);
+    bool isOpen();
+
+    bool lookup(uint32_t blockNum, uint16_t& rCrc);
+    void store(uint32_t blockNum, uint16_t crc);
+    void invalidate(uint32_t blockNum);
+
+    uint32_t getHits();
+    uint32_t getMisses();
+
+    static const uint32_t CACHE_MAGIC = 0x52434C55; //ULCR
+
+  private:
+    bool load(uint32_t numberOfBlocks, uint64_t filesStamp);
+    void save(uint64_t filesStamp);
+
+    std::string m_path;
+    std::vector<uint16_t> m_crcs;
+    std::vector<uint8_t> m_validBits;
+    uint32_t m_numberOfBlocks;
+    bool m_open;
+    uint32_t m_hits;
+    uint32_t m_misses;
+};
+
+#endif
@@ -0,0 +1,321 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "BlockWriter.h"
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+BlockWriter::BlockWriter(std::ofstream* pMapFileStream, std::ofstream* pStaidxFileStream, std::ofstream* pStaticsFileStream)
+  : m_head(0),
+  m_tail(0),
+  m_checkpointQueued(0),
+  m_writeFailed(0),
+  m_checkpoint(),
+  m_writeAhead(),
+  m_hWorkEvent(CreateEvent(NULL, false, false, NULL)),
+  m_hSpaceEvent(CreateEvent(NULL, false, false, NULL)),
+  m_hStopEvent(CreateEvent(NULL, true, false, NULL)),
+  m_hWriterThread(NULL),
+  m_fullStalls(0),
+  m_queuedWrites(0),
+  m_mergedWrites(0),
+  m_checkpoints(0),
+  m_bytesWritten(0)
+{
+  m_pFileStreams[FILE_MAP] = pMapFileStream;
+  m_pFileStreams[FILE_STAIDX] = pStaidxFileStream;
+  m_pFileStreams[FILE_STATICS] = pStaticsFileStream;
+  memset(m_depthHistogram, 0, sizeof(m_depthHistogram));
+  memset(m_latencyHistogram, 0, sizeof(m_latencyHistogram));
+  QueryPerformanceFrequency(&m_frequency);
+
+  m_hWriterThread = CreateThread(NULL, 0, writerThreadProc, this, 0, NULL);
+}
+
+BlockWriter::~BlockWriter()
+{
+  drain();
+  SetEvent(m_hStopEvent);
+  WaitForSingleObject(m_hWriterThread, INFINITE);
+  CloseHandle(m_hWriterThread);
+  CloseHandle(m_hWorkEvent);
+  CloseHandle(m_hSpaceEvent);
+  CloseHandle(m_hStopEvent);
+}
+
+void BlockWriter::setCheckpointFunction(std::function<void(uint64_t)> checkpoint)
+{
+  m_checkpoint = checkpoint;
+}
+
+/* Sets what has to run before anything is written, so that the journal is always ahead of the files */
+void BlockWriter::setWriteAheadFunction(std::function<void()> writeAhead)
+{
+  m_writeAhead = writeAhead;
+}
+
+/* Queues a write of length bytes at offset in one of the FILE_ files.  The data is copied, so the caller can change
+ * it as soon as this returns.
+ */
+void BlockWriter::queueWrite(uint32_t file, uint32_t offset, const uint8_t* pData, uint32_t length)
+{
+  Request request;
+  request.type = REQUEST_WRITE;
+  request.file = file;
+  request.offset = offset;
+  request.length = length;
+  request.pData = new uint8_t[length];
+  memcpy(request.pData, pData, length);
+  request.journalMark = 0;
+  request.hDoneEvent = NULL;
+
+  m_queuedWrites++;
+  m_depthHistogram[getBucket(getQueueDepth())]++;
+  push(request);
+}
+
+/* Queues a checkpoint behind the writes that are already queued.  Journal records up to journalMark are covered by 
+ * those writes and can be dropped once the checkpoint has flushed the files.
+ */
+void BlockWriter::queueCheckpoint(uint64_t journalMark)
+{
+  Request request;
+  request.type = REQUEST_CHECKPOINT;
+  request.file = 0;
+  request.offset = 0;
+  request.length = 0;
+  request.pData = NULL;
+  request.journalMark = journalMark;
+  request.hDoneEvent = NULL;
+
+  InterlockedExchange(&m_checkpointQueued, 1);
+  push(request);
+}
+
+bool BlockWriter::isCheckpointQueued()
+{
+  return m_checkpointQueued != 0;
+}
+
+/* True if any write failed since the last clearWriteFailure */
+bool BlockWriter::hasWriteFailed()
+{
+  return m_writeFailed != 0;
+}
+
+/* Only call this once the journal that covers the failed writes has been kept for replay */
+void BlockWriter::clearWriteFailure()
+{
+  InterlockedExchange(&m_writeFailed, 0);
+}
+
+/* Waits until everything queued so far has been written */
+void BlockWriter::drain()
+{
+  Request request;
+  request.type = REQUEST_DRAIN;
+  request.file = 0;
+  request.offset = 0;
+  request.length = 0;
+  request.pData = NULL;
+  request.journalMark = 0;
+  request.hDoneEvent = CreateEvent(NULL, true, false, NULL);
+
+  HANDLE hDoneEvent = request.hDoneEvent;
+  push(request);
+  WaitForSingleObject(hDoneEvent, INFINITE);
+  CloseHandle(hDoneEvent);
+}
+
+uint32_t BlockWriter::getQueueDepth()
+{
+  return static_cast<uint32_t>(m_tail - m_head);
+}
+
+void BlockWriter::push(Request& rRequest)
+{
+  QueryPerformanceCounter(&rRequest.queuedAt);
+
+  while (static_cast<uint32_t>(m_tail - m_head) >= QUEUE_CAPACITY)
+  {
+    m_fullStalls++;
+    SetEvent(m_hWorkEvent);
+    WaitForSingleObject(m_hSpaceEvent, 1);
+  }
+
+  //the slot has to be filled in before the writer can see the new tail
+  m_ring[m_tail & (QUEUE_CAPACITY - 1)] = rRequest;
+  MemoryBarrier();
+  InterlockedExchange(&m_tail, m_tail + 1);
+  SetEvent(m_hWorkEvent);
+}
+
+bool BlockWriter::pop(Request& rRequest)
+{
+  if (m_head == m_tail)
+  {
+    return false;
+  }
+
+  MemoryBarrier();
+  rRequest = m_ring[m_head & (QUEUE_CAPACITY - 1)];
+  InterlockedExchange(&m_head, m_head + 1);
+  return true;
+}
+
+/* Writes each range once, with the data of the last request for it.  A range is written where its last request was 
+ * queued, so when ranges overlap the newer data still ends up on top.
+ */
+void BlockWriter::writeRequests(std::vector<Request>& rRequests)
+{
+  if (!rRequests.empty() && m_writeAhead)
+  {
+    m_writeAhead();
+  }
+
+  std::map<std::pair<uint64_t, uint32_t>, uint32_t> lastRequests;
+  for (uint32_t i = 0; i < rRequests.size(); i++)
+  {
+    lastRequests[std::make_pair((static_cast<uint64_t>(rRequests[i].file) << 32) | rRequests[i].offset, rRequests[i].length)] = i;
+  }
+
+  for (uint32_t i = 0; i < rRequests.size(); i++)
+  {
+    Request& rRequest = rRequests[i];
+    std::ofstream* pStream = m_pFileStreams[rRequest.file];
+
+    if (lastRequests[std::make_pair((static_cast<uint64_t>(rRequest.file) << 32) | rRequest.offset, rRequest.length)] != i)
+    {
+      m_mergedWrites++;
+    }
+    else if (pStream->is_open())
+    {
+      pStream->seekp(rRequest.offset, std::ios::beg);
+      pStream->write(reinterpret_cast<const char*>(rRequest.pData), rRequest.length);
+      m_bytesWritten += rRequest.length;
+
+      if (pStream->fail())
+      {
+        InterlockedExchange(&m_writeFailed, 1);
+#ifdef DEBUG
+        printf("Failed to write %u bytes at 0x%x to file %u (%i)\n", rRequest.length, rRequest.offset, rRequest.file, GetLastError());
+#endif
+      }
+    }
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    m_latencyHistogram[getBucket(((now.QuadPart - rRequest.queuedAt.QuadPart) * 1000) / m_frequency.QuadPart)]++;
+    delete[] rRequest.pData;
+  }
+
+  rRequests.clear();
+}
+
+void BlockWriter::runBarrier(Request& rRequest)
+{
+  if (rRequest.type == REQUEST_CHECKPOINT)
+  {
+    //a checkpoint would drop the only copy of a write that never reached the file
+    if (m_checkpoint && m_writeFailed == 0)
+    {
+      m_checkpoint(rRequest.journalMark);
+      m_checkpoints++;
+    }
+#ifdef DEBUG
+    else if (m_checkpoint)
+    {
+      printf("Skipped a checkpoint, a write failed since the map was loaded\n");
+    }
+#endif
+    InterlockedExchange(&m_checkpointQueued, 0);
+  }
+  else
+  {
+    SetEvent(rRequest.hDoneEvent);
+  }
+}
+
+/* Bucket 0 counts values of 0, bucket n values from 2^(n-1) up to 2^n, the last bucket everything above */
+uint32_t BlockWriter::getBucket(uint64_t value)
+{
+  uint32_t bucket = 0;
+  while (value != 0 && bucket < HISTOGRAM_BUCKETS - 1)
+  {
+    value >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+void BlockWriter::printStatistics()
+{
+#ifdef DEBUG
+  printf("Block writer: %u writes queued, %u merged, %u KB written, %u checkpoints, %u full queue stalls\n", 
+    m_queuedWrites, m_mergedWrites, static_cast<uint32_t>(m_bytesWritten / 1024), m_checkpoints, m_fullStalls);
+
+  printf("Queue depth:");
+  for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+  {
+    printf(" %s%u:%u", i == HISTOGRAM_BUCKETS - 1 ? ">=" : "<", i == HISTOGRAM_BUCKETS - 1 ? 1 << (i - 1) : 1 << i, m_depthHistogram[i]);
+  }
+
+  printf("\nWrite latency (ms):");
+  for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+  {
+    printf(" %s%u:%u", i == HISTOGRAM_BUCKETS - 1 ? ">=" : "<", i == HISTOGRAM_BUCKETS - 1 ? 1 << (i - 1) : 1 << i, m_latencyHistogram[i]);
+  }
+  printf("\n");
+#endif
+}
+
+DWORD WINAPI BlockWriter::writerThreadProc(LPVOID pParam)
+{
+  BlockWriter* pWriter = reinterpret_cast<BlockWriter*>(pParam);
+  HANDLE events[2] = { pWriter->m_hStopEvent, pWriter->m_hWorkEvent };
+  std::vector<Request> writes;
+
+  while (WaitForMultipleObjects(2, events, false, INFINITE) != WAIT_OBJECT_0)
+  {
+    Request request;
+    while (pWriter->pop(request))
+    {
+      SetEvent(pWriter->m_hSpaceEvent);
+
+      if (request.type == REQUEST_WRITE)
+      {
+        writes.push_back(request);
+      }
+      else
+      {
+        pWriter->writeRequests(writes);
+        pWriter->runBarrier(request);
+      }
+    }
+
+    pWriter->writeRequests(writes);
+  }
+
+  return 0;
+}
@@ -0,0 +1,126 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _BLOCK_WRITER_H
+#define _BLOCK_WRITER_H
+
+#include <fstream>
+#include <functional>
+#include <vector>
+#include <stdint.h>
+#include <Windows.h>
+
+/* Writes block updates to the shard files on a background thread, so that a slow disk doesn't hold up the packet 
+ * handlers.  The pools are still updated right away by the caller, only the file writes are handed off.
+ *
+ * Writes are passed through a bounded single producer, single consumer ring that takes no locks.  Only the thread 
+ * that handles server packets may queue writes.  When the ring is full the producer waits for the writer to make 
+ * room.  The writer takes everything that is queued at once and writes each range only once, with the data of the 
+ * last write to it.  A checkpoint queued behind some writes runs after them, and writes are never merged across it.
+ * The write-ahead function runs before each group of writes, it commits the journal records that cover them.  Once a 
+ * write has failed, checkpoints are skipped, the journal is the only copy of that write until the map is reloaded.
+ *
+ * Queue depth is sampled each time a write is queued, and the time from queueing to the end of the write is recorded, 
+ * both in power of two histograms.
+ */
+class BlockWriter
+{
+  public:
+    BlockWriter(std::ofstream* pMapFileStream, std::ofstream* pStaidxFileStream, std::ofstream* pStaticsFileStream);
+    ~BlockWriter();
+
+    void setCheckpointFunction(std::function<void(uint64_t)> checkpoint);
+    void setWriteAheadFunction(std::function<void()> writeAhead);
+
+    void queueWrite(uint32_t file, uint32_t offset, const uint8_t* pData, uint32_t length);
+    void queueCheckpoint(uint64_t journalMark);
+    bool isCheckpointQueued();
+    bool hasWriteFailed();
+    void clearWriteFailure();
+    void drain();
+
+    uint32_t getQueueDepth();
+    void printStatistics();
+
+    static const uint32_t FILE_MAP = 0;
+    static const uint32_t FILE_STAIDX = 1;
+    static const uint32_t FILE_STATICS = 2;
+    static const uint32_t NUMBER_OF_FILES = 3;
+
+    static const uint32_t QUEUE_CAPACITY = 1024; //power of two
+    static const uint32_t HISTOGRAM_BUCKETS = 12;
+
+  private:
+    enum RequestType
+    {
+      REQUEST_WRITE,
+      REQUEST_CHECKPOINT,
+      REQUEST_DRAIN
+    };
+
+    struct Request
+    {
+      RequestType type;
+      uint32_t file;
+      uint32_t offset;
+      uint32_t length;
+      uint8_t* pData;
+      uint64_t journalMark;
+      HANDLE hDoneEvent;
+      LARGE_INTEGER queuedAt;
+    };
+
+    void push(Request& rRequest);
+    bool pop(Request& rRequest);
+    void writeRequests(std::vector<Request>& rRequests);
+    void runBarrier(Request& rRequest);
+    static uint32_t getBucket(uint64_t value);
+    static DWORD WINAPI writerThreadProc(LPVOID pParam);
+
+    Request m_ring[QUEUE_CAPACITY];
+    volatile LONG m_head;
+    volatile LONG m_tail;
+    volatile LONG m_checkpointQueued;
+    volatile LONG m_writeFailed;
+
+    std::ofstream* m_pFileStreams[NUMBER_OF_FILES];
+    std::function<void(uint64_t)> m_checkpoint;
+    std::function<void()> m_writeAhead;
+
+    HANDLE m_hWorkEvent;
+    HANDLE m_hSpaceEvent;
+    HANDLE m_hStopEvent;
+    HANDLE m_hWriterThread;
+    LARGE_INTEGER m_frequency;
+
+    //the depth histogram and stalls are only touched by the producer, everything else by the writer
+    uint32_t m_depthHistogram[HISTOGRAM_BUCKETS];
+    uint32_t m_latencyHistogram[HISTOGRAM_BUCKETS];
+    uint32_t m_fullStalls;
+    uint32_t m_queuedWrites;
+    uint32_t m_mergedWrites;
+    uint32_t m_checkpoints;
+    uint64_t m_bytesWritten;
+};
+
+#endif
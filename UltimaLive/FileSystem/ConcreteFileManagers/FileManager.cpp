@@ -51,20 +51,14 @@ FileManager::FileManager()
 
 void FileManager::LoadMap(uint8_t mapNumber)
 {
-  if (m_pMapFileStream->is_open())
-  {
-    m_pMapFileStream->close();
-  }
-  if (m_pStaidxFileStream->is_open())
-  {
-    m_pStaidxFileStream->close();
-  }
-  if (m_pStaticsFileStream->is_open())
-  {
-    m_pStaticsFileStream->close();
-  }
+  LARGE_INTEGER switchStartTime;
+  QueryPerformanceCounter(&switchStartTime);
+#ifdef DEBUG
+  DWORD loadStartTime = GetTickCount();
+#endif
 
-  uint32_t currentByteIndexOfFile = 0;
+  closeMapFiles();
+  bool resident = m_pResidentMaps->isResident(mapNumber);
 
   std::string filenameAndPath = BaseFileManager::getUltimaLiveSavePath();
   if (m_shardIdentifier != "")
@@ -86,79 +80,65 @@ void FileManager::LoadMap(uint8_t mapNumber)
   sprintf_s(filename, "statics%i.mul", mapNumber);
   staticsFileNameAndPath.append(filename);
 
+  std::string journalFileNameAndPath(filenameAndPath);
+  sprintf_s(filename, "journal%i.dat", mapNumber);
+  journalFileNameAndPath.append(filename);
+
+  //bring the files up to date with any updates that were committed but never checkpointed
+  replayJournal(journalFileNameAndPath, mapFileNameAndPath, staidxFileNameAndPath, staticsFileNameAndPath);
+
 #ifdef DEBUG
   printf("Loading Map: %s\n", mapFileNameAndPath.c_str());
 #endif
 
-  std::ifstream mapFile;
-  mapFile.open(mapFileNameAndPath, std::ios::binary | std::ios::in);
-  if (mapFile.is_open())
+  //the map pool becomes a view of the map file, blocks are only read from disk when the client touches them.  A blank
+  //map is mapped copy-on-write, so the blank blocks filled into it stay in memory and only blocks that are actually
+  //written reach the sparse file, through the stream
+  bool blankMap = m_pMaterializedBlocks->isLoaded();
+  if (!openShardFile(m_pMapFileMapping, mapNumber, ResidentMapCache::FILE_MAP, mapFileNameAndPath, 0, blankMap))
   {
-    mapFile.seekg (0, mapFile.end);
-    std::streamoff length = mapFile.tellg();
-    if (length > 0)
-    {
-      mapFile.seekg (0, mapFile.beg);
-      mapFile.read(reinterpret_cast<char*>(m_pMapPool), length);
-    }
-
-    mapFile.close();
+    uint32_t length = 0;
+    readFileIntoPool(mapFileNameAndPath, m_pMapReservation, length);
+    m_pMapFileStream->open(mapFileNameAndPath, std::ios::out | std::ios::in | std::ios::binary);
   }
-
-#ifdef DEBUG
-  printf("Loading Staidx: %s\n", staidxFileNameAndPath.c_str());
-#endif
-
-  std::ifstream staidxFile;
-  staidxFile.open(staidxFileNameAndPath, std::ios::binary | std::ios::in);
-
-  if (staidxFile.is_open())
+  else if (m_pMapFileMapping->isCopyOnWrite())
   {
-    staidxFile.seekg (0, staidxFile.end);
-    std::streamoff length = staidxFile.tellg();
-    if (length > 0)
-    {
-      staidxFile.seekg (0, staidxFile.beg);
-      staidxFile.read(reinterpret_cast<char*>(m_pStaidxPool), length);
-    }
-    staidxFile.close();
+    m_pMapFileStream->open(mapFileNameAndPath, std::ios::out | std::ios::in | std::ios::binary);
   }
 
-#ifdef DEBUG
-  printf("Loading Statics: %s\n", staticsFileNameAndPath.c_str());
-#endif
-
-  std::ifstream staticsFile;
-  staticsFile.open(staticsFileNameAndPath, std::ios::binary | std::ios::in);
-  if (staticsFile.is_open())
+  //blocks of a blank map that were never written read back as zeros, the pager fills them in when they are touched
+  if (blankMap)
   {
-    staticsFile.seekg (0, staticsFile.end);
-    std::streamoff length = staticsFile.tellg();
-    if (length > 0)
-    {
-      staticsFile.seekg (0, staticsFile.beg);
-      staticsFile.read(reinterpret_cast<char*>(m_pStaticsPool), length);
-    }
-    m_pStaticsPoolEnd = m_pStaticsPool + length;
-    staticsFile.close();
+    addLandSources(0, 0, m_pMaterializedBlocks->getNumberOfBlocks() * 196, NULL);
+    m_pMapPoolPager->arm();
   }
 
-  m_pMapFileStream->open(mapFileNameAndPath, std::ios::out | std::ios::in | std::ios::binary);
-  m_pStaidxFileStream->open(staidxFileNameAndPath, std::ios::out | std::ios::in | std::ios::binary);
-  m_pStaticsFileStream->open(staticsFileNameAndPath, std::ios::out | std::ios::in | std::ios::binary);
+  loadStaticsFiles(mapNumber, staidxFileNameAndPath, staticsFileNameAndPath);
+  finishLoadingMap(mapNumber, mapFileNameAndPath, staidxFileNameAndPath, staticsFileNameAndPath, resident, switchStartTime);
 
 #ifdef DEBUG
-  printf("Finished Loading Map!\n");
+  printf("Finished Loading Map in %u ms (%s, %u KB committed, %u KB peak)\n", GetTickCount() - loadStartTime, m_pMapFileMapping->isOpen() ? "mapped" : "copied",
+    ReservedPool::getCommittedBytes() / 1024, ReservedPool::getPeakCommittedBytes() / 1024);
 #endif
 }
 
 void FileManager::Initialize()
 {
   BaseFileManager::Initialize();
-  m_pMapPool = reinterpret_cast<uint8_t*>(VirtualAlloc(NULL, MAP_MEMORY_SIZE, MEM_COMMIT, PAGE_EXECUTE_READWRITE));
-  m_pStaticsPool = reinterpret_cast<uint8_t*>(VirtualAlloc(NULL, STATICS_MEMORY_SIZE, MEM_COMMIT, PAGE_EXECUTE_READWRITE));
+
+  //only address space is taken here, memory is committed as the pools are filled
+  m_pMapReservation = new ReservedPool(MAP_MEMORY_SIZE);
+  m_pStaticsReservation = new ReservedPool(STATICS_MEMORY_SIZE);
+  m_pStaidxReservation = new ReservedPool(STAIDX_MEMORY_SIZE);
+  m_pMapPool = m_pMapReservation->getAddress();
+  m_pStaticsPool = m_pStaticsReservation->getAddress();
   m_pStaticsPoolEnd = m_pStaticsPool;
-  m_pStaidxPool = reinterpret_cast<uint8_t*>(VirtualAlloc(NULL, STAIDX_MEMORY_SIZE, MEM_COMMIT, PAGE_EXECUTE_READWRITE));
+  m_pStaidxPool = m_pStaidxReservation->getAddress();
+
+  m_pMapFileMapping = new MappedFile(m_pMapReservation);
+  m_pStaidxFileMapping = new MappedFile(m_pStaidxReservation);
+  m_pStaticsFileMapping = new MappedFile(m_pStaticsReservation);
+  m_pMapPoolPager = new DemandPagedPool(m_pMapPool, MAP_MEMORY_SIZE);
 
 #ifdef DEBUG
   printf("Map 0x%x\n", m_pMapPool);
@@ -175,16 +155,7 @@ LPVOID WINAPI FileManager::OnMapViewOfFile(
   __in  SIZE_T dwNumberOfBytesToMap
   )
 {
-  ClientFileHandleSet* pMatchingFileset = NULL;
-
-  for (std::map<std::string, ClientFileHandleSet*>::const_iterator iterator = m_files.begin(); iterator != m_files.end(); iterator++)
-  {
-    if (iterator->second->m_createFileMappingHandle == hFileMappingObject)
-    {
-      pMatchingFileset = iterator->second;
-      break;
-    }
-  }
+  ClientFileHandleSet* pMatchingFileset = findFileByMappingHandle(hFileMappingObject);
 
   HANDLE handleToReturn = INVALID_HANDLE_VALUE;
 
@@ -224,10 +195,22 @@ LPVOID WINAPI FileManager::OnMapViewOfFile(
 
 unsigned char* FileManager::seekLandBlock(uint8_t mapNumber, uint32_t blockNum)
 {
+  //a mapped pool ends at the end of the map file
+  if (m_pMapFileMapping->isOpen() && (blockNum * 196) + 196 > m_pMapFileMapping->getMappedSize())
+  {
+    return NULL;
+  }
+
   uint8_t* pData = reinterpret_cast<unsigned char*>(m_pMapPool + (blockNum * 196) + 4);
   return pData;
 }
 
+/* Returns a pointer to the 192 bytes of the block in the map pool, or NULL if the block is past the end of the map */
+unsigned char* FileManager::getLandBlockView(uint8_t mapNumber, uint32_t blockNum)
+{
+  return seekLandBlock(mapNumber, blockNum);
+}
+
 unsigned char* FileManager::readLandBlock(uint8_t mapNumber, uint32_t blockNum)
 {
   unsigned char* pBlockPosition = seekLandBlock(mapNumber, blockNum);
@@ -247,66 +230,73 @@ unsigned char* FileManager::readLandBlock(uint8_t mapNumber, uint32_t blockNum)
  
 bool FileManager::updateLandBlock(uint8_t mapNumber, uint32_t blockNum, uint8_t* pLandData)
 {
-  //update block in memory
   unsigned char* pBlockPosition = seekLandBlock(mapNumber, blockNum);
 
   #ifdef DEBUG
     printf("Land Block Memory Location: 0x%x\n", (int)pBlockPosition);
   #endif
 
-
-  if (pBlockPosition != NULL)
+  if (pBlockPosition == NULL)
   {
-    for (int i = 0; i < 192; ++i)
-    {
-      pBlockPosition[i] = pLandData[i];
-    }
+#ifdef DEBUG
+    printf("Unable to update land block!\n");
+#endif
+    return false;
   }
-  #ifdef DEBUG
-  else
+
+  //the record goes ahead of the change, a mapped map file is changed as soon as the pool is
+  m_pJournal->recordLandBlock(blockNum, pLandData);
+  commitBeforeViewWrite(m_pMapFileMapping);
+
+  //update block in memory
+  for (int i = 0; i < 192; ++i)
   {
-    printf("Unable to update land block!\n");
+    pBlockPosition[i] = pLandData[i];
   }
-  #endif
 
-  if (m_pMapFileStream->is_open())
+  //a mapped map file was already updated through the pool, unless it is mapped copy-on-write
+  if ((!m_pMapFileMapping->isOpen() || m_pMapFileMapping->isCopyOnWrite()) && m_pMapFileStream->is_open())
   {
-    //update block on disk
+    //update block on disk from the block writer's thread
     uint32_t blockSeekLocation = (blockNum * 196) + 4;
 #ifdef DEBUG
-    printf("Updating Land block on disk at location: 0x%x\n", blockSeekLocation);
-#endif
-    m_pMapFileStream->seekp(blockSeekLocation, std::ios::beg);
-  
-#ifdef DEBUG
-    if (m_pMapFileStream->bad())
-    {
-      printf("Failed to Seek!!!!!!!!!!!!!! (%i)\n", GetLastError());
-    }
-    else
-    {
-      printf("Seek successful\n");
-    }
-#endif
-  
-    m_pMapFileStream->write(const_cast<const char*>(reinterpret_cast<char*>(pLandData)), 192);
-#ifdef DEBUG  
-    if (m_pMapFileStream->bad())
-    {
-      printf("Failed to Write!!!!!!!!!!!!!! (%i)\n", GetLastError());
-    }
-    else
-    {
-      printf("Wrote successfully\n");
-    }
+    printf("Queueing land block write at location: 0x%x\n", blockSeekLocation);
 #endif
+    m_pBlockWriter->queueWrite(BlockWriter::FILE_MAP, blockSeekLocation, pLandData, 192);
   }
 
-  m_pMapFileStream->flush();
-
-#ifdef DEBUG  
-      printf("Flushed successfully\n");
-#endif
+  m_pMaterializedBlocks->markMaterialized(blockNum);
+  m_pBlockCrcs->invalidate(blockNum);
+  checkpointIfNeeded();
 
   return true;
+}
+
+void FileManager::closeMapFiles()
+{
+  BaseFileManager::closeMapFiles();
+
+  //a map that was read into the pool instead of mapped gives its memory back
+  if (m_pMapReservation != NULL)
+  {
+    m_pMapReservation->decommit();
+  }
+}
+
+void FileManager::touchBlocks(uint8_t mapNumber, uint32_t firstBlock, uint32_t numberOfBlocks)
+{
+  //the map pool is a view of the map file, Windows pages it in as it is read
+  if (m_pMapFileMapping->isOpen() && firstBlock * 196 < m_pMapFileMapping->getMappedSize())
+  {
+    uint32_t length = numberOfBlocks * 196;
+    if (length > m_pMapFileMapping->getMappedSize() - (firstBlock * 196))
+    {
+      length = m_pMapFileMapping->getMappedSize() - (firstBlock * 196);
+    }
+
+    m_pMapPoolPager->touch(firstBlock * 196, length);
+    touchPages(m_pMapPool + (firstBlock * 196), length);
+  }
+
+  BaseFileManager::touchBlocks(mapNumber, firstBlock, numberOfBlocks);
 }
\ No newline at end of file
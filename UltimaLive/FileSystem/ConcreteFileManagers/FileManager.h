@@ -45,9 +45,11 @@ class FileManager : public BaseFileManager
 
     bool updateLandBlock(uint8_t mapNumber, uint32_t blockNum, uint8_t* pData);
     unsigned char* readLandBlock(uint8_t mapNumber, uint32_t blockNum);
+    unsigned char* getLandBlockView(uint8_t mapNumber, uint32_t blockNum);
     
     void Initialize();
     void LoadMap(uint8_t mapNumber);
+    void touchBlocks(uint8_t mapNumber, uint32_t firstBlock, uint32_t numberOfBlocks);
 
     static const int MAP_MEMORY_SIZE = 100000000;
     static const int STAIDX_MEMORY_SIZE = 10000000;
@@ -56,5 +58,6 @@ class FileManager : public BaseFileManager
   protected:
     std::map<std::string, uint32_t> m_neededFiles;
     unsigned char* seekLandBlock(uint8_t mapNumber, uint32_t blockNum);
+    void closeMapFiles();
 };
 #endif
\ No newline at end of file
@@ -17,12 +17,14 @@
 #include "FileManager_7_0_29_2.h"
 #include <cstdio>
 #include "..\Uop\UopUtility.h"
+#include "..\ShardImporter.h"
 #include "..\..\Maps\MapDefinition.h"
 
 FileManager_7_0_29_2::FileManager_7_0_29_2()
   : BaseFileManager(),
     m_fileEntries(),
-    m_neededFiles()
+    m_neededFiles(),
+    m_blockTable()
 {
   m_neededFiles["map0LegacyMUL.uop"] = 0;
   m_neededFiles["staidx0.mul"] = 0;
@@ -53,20 +55,14 @@ FileManager_7_0_29_2::FileManager_7_0_29_2()
 
 void FileManager_7_0_29_2::LoadMap(uint8_t mapNumber)
 {
-  if (m_pMapFileStream->is_open())
-  {
-    m_pMapFileStream->close();
-  }
-  if (m_pStaidxFileStream->is_open())
-  {
-    m_pStaidxFileStream->close();
-  }
-  if (m_pStaticsFileStream->is_open())
-  {
-    m_pStaticsFileStream->close();
-  }
+  LARGE_INTEGER switchStartTime;
+  QueryPerformanceCounter(&switchStartTime);
+#ifdef DEBUG
+  DWORD loadStartTime = GetTickCount();
+#endif
 
-  uint32_t currentByteIndexOfFile = 0;
+  closeMapFiles();
+  bool resident = m_pResidentMaps->isResident(mapNumber);
 
   std::string filenameAndPath = BaseFileManager::getUltimaLiveSavePath();
   if (m_shardIdentifier != "")
@@ -88,72 +84,117 @@ void FileManager_7_0_29_2::LoadMap(uint8_t mapNumber)
   sprintf_s(filename, "statics%i.mul", mapNumber);
   staticsFileNameAndPath.append(filename);
 
+  std::string journalFileNameAndPath(filenameAndPath);
+  sprintf_s(filename, "journal%i.dat", mapNumber);
+  journalFileNameAndPath.append(filename);
+
+  //bring the files up to date with any updates that were committed but never checkpointed
+  replayJournal(journalFileNameAndPath, mapFileNameAndPath, staidxFileNameAndPath, staticsFileNameAndPath);
+
 #ifdef DEBUG
   printf("******************Loading Map: %s *************************\n", mapFileNameAndPath.c_str());
 #endif
 
-  std::ifstream mapFile;
-  mapFile.open(mapFileNameAndPath, std::ios::binary | std::ios::in);
-  if (mapFile.is_open())
+  //the client sees the map in uop layout, so the mul file is mapped on its own and copied entry by entry into the pool,
+  //in lazy mode only when the client first touches a page of an entry
+  if (openShardFile(m_pMapFileMapping, mapNumber, ResidentMapCache::FILE_MAP, mapFileNameAndPath, 0))
   {
+    uint8_t* pMapFile = m_pMapFileMapping->getView();
+    uint32_t mapFileSize = m_pMapFileMapping->getFileSize();
+    uint32_t currentByteIndexOfFile = 0;
+
     int numFilesInMap = m_fileEntries.size();
-    for (int i = 0; i < numFilesInMap; i++)
+    for (int i = 0; i < numFilesInMap && currentByteIndexOfFile < mapFileSize; i++)
     {
       FileEntry* pCurrentEntry = m_fileEntries[i];
-      char* offset = reinterpret_cast<char*>(m_pMapPool + pCurrentEntry->MetaDataSize + pCurrentEntry->UopFileOffset);
-      mapFile.read(offset, pCurrentEntry->UncompressedDataSize);
+      uint32_t length = pCurrentEntry->UncompressedDataSize;
+      if (length > mapFileSize - currentByteIndexOfFile)
+      {
+        length = mapFileSize - currentByteIndexOfFile;
+      }
+
+      addLandSources(static_cast<uint32_t>(pCurrentEntry->MetaDataSize + pCurrentEntry->UopFileOffset), currentByteIndexOfFile / 196, length, pMapFile + currentByteIndexOfFile);
+      currentByteIndexOfFile += length;
+    }
+
+    m_pMapPoolPager->arm();
+
+    if (!LAZY_MAP_LOADING)
+    {
+      m_pMapPoolPager->touch(0, MAP_MEMORY_SIZE);
+      m_pMapPoolPager->disarm();
     }
-    mapFile.close();
   }
+  else
+  {
+    uint32_t currentByteIndexOfFile = 0;
 
-#ifdef DEBUG
-  printf("******************Loading Staidx: %s *************************\n", staidxFileNameAndPath.c_str());
-#endif
+    std::ifstream mapFile;
+    mapFile.open(mapFileNameAndPath, std::ios::binary | std::ios::in);
+    if (mapFile.is_open())
+    {
+      int numFilesInMap = m_fileEntries.size();
+      for (int i = 0; i < numFilesInMap; i++)
+      {
+        FileEntry* pCurrentEntry = m_fileEntries[i];
+        char* offset = reinterpret_cast<char*>(m_pMapPool + pCurrentEntry->MetaDataSize + pCurrentEntry->UopFileOffset);
+        mapFile.read(offset, pCurrentEntry->UncompressedDataSize);
 
-  std::ifstream staidxFile;
-  staidxFile.open(staidxFileNameAndPath, std::ios::binary | std::ios::in);
+        //the blank blocks of a blank map are filled in over what was read
+        addLandSources(static_cast<uint32_t>(pCurrentEntry->MetaDataSize + pCurrentEntry->UopFileOffset), currentByteIndexOfFile / 196, pCurrentEntry->UncompressedDataSize, NULL);
+        currentByteIndexOfFile += pCurrentEntry->UncompressedDataSize;
+      }
+      mapFile.close();
+      m_pMapPoolPager->arm();
+    }
 
-  if (staidxFile.is_open())
-  {
-    staidxFile.seekg (0, staidxFile.end);
-    std::streamoff length = staidxFile.tellg();
-    staidxFile.seekg (0, staidxFile.beg);
-    staidxFile.read(reinterpret_cast<char*>(m_pStaidxPool), length);
-    staidxFile.close();
+    m_pMapFileStream->open(mapFileNameAndPath, std::ios::out | std::ios::in | std::ios::binary);
   }
 
+  loadStaticsFiles(mapNumber, staidxFileNameAndPath, staticsFileNameAndPath);
+  finishLoadingMap(mapNumber, mapFileNameAndPath, staidxFileNameAndPath, staticsFileNameAndPath, resident, switchStartTime);
+
 #ifdef DEBUG
-  printf("******************Loading Statics: %s *************************\n", staticsFileNameAndPath.c_str());
+  printf("##################   Finished Loading Map in %u ms! (%u KB committed, %u KB peak)\n", GetTickCount() - loadStartTime, 
+    ReservedPool::getCommittedBytes() / 1024, ReservedPool::getPeakCommittedBytes() / 1024);
 #endif
+}
 
-  std::ifstream staticsFile;
-  staticsFile.open(staticsFileNameAndPath, std::ios::binary | std::ios::in);
-  if (staticsFile.is_open())
+void FileManager_7_0_29_2::touchBlocks(uint8_t mapNumber, uint32_t firstBlock, uint32_t numberOfBlocks)
+{
+  if (m_pMapPoolPager->isArmed())
   {
-    staticsFile.seekg (0, staticsFile.end);
-    std::streamoff length = staticsFile.tellg();
-    staticsFile.seekg (0, staticsFile.beg);
-    staticsFile.read(reinterpret_cast<char*>(m_pStaticsPool), length);
-    m_pStaticsPoolEnd = m_pStaticsPool + length;
-    staticsFile.close();
+    for (uint32_t blockNum = firstBlock; blockNum < firstBlock + numberOfBlocks; blockNum++)
+    {
+      unsigned char* pBlock = seekLandBlock(mapNumber, blockNum);
+      if (pBlock != NULL)
+      {
+        m_pMapPoolPager->touch((pBlock - 4) - m_pMapPool, 196);
+      }
+    }
   }
 
-  m_pMapFileStream->open(mapFileNameAndPath, std::ios::out | std::ios::in | std::ios::binary);
-  m_pStaidxFileStream->open(staidxFileNameAndPath, std::ios::out | std::ios::in | std::ios::binary);
-  m_pStaticsFileStream->open(staticsFileNameAndPath, std::ios::out | std::ios::in | std::ios::binary);
-
-#ifdef DEBUG
-  printf("##################   Finished Loading Map!\n");
-#endif
+  BaseFileManager::touchBlocks(mapNumber, firstBlock, numberOfBlocks);
 }
 
 void FileManager_7_0_29_2::Initialize()
 {
   BaseFileManager::Initialize();
-  m_pMapPool = reinterpret_cast<uint8_t*>(VirtualAlloc(NULL, MAP_MEMORY_SIZE, MEM_COMMIT, PAGE_EXECUTE_READWRITE));
-  m_pStaticsPool = reinterpret_cast<uint8_t*>(VirtualAlloc(NULL, STATICS_MEMORY_SIZE, MEM_COMMIT, PAGE_EXECUTE_READWRITE));
+
+  //only address space is taken here, memory is committed as the pools are filled
+  m_pMapReservation = new ReservedPool(MAP_MEMORY_SIZE);
+  m_pStaticsReservation = new ReservedPool(STATICS_MEMORY_SIZE);
+  m_pStaidxReservation = new ReservedPool(STAIDX_MEMORY_SIZE);
+  m_pMapPool = m_pMapReservation->getAddress();
+  m_pStaticsPool = m_pStaticsReservation->getAddress();
   m_pStaticsPoolEnd = m_pStaticsPool;
-  m_pStaidxPool = reinterpret_cast<uint8_t*>(VirtualAlloc(NULL, STAIDX_MEMORY_SIZE, MEM_COMMIT, PAGE_EXECUTE_READWRITE));
+  m_pStaidxPool = m_pStaidxReservation->getAddress();
+
+  //the map pool holds the uop layout the client expects, so the map file is mapped separately from it
+  m_pMapFileMapping = new MappedFile();
+  m_pStaidxFileMapping = new MappedFile(m_pStaidxReservation);
+  m_pStaticsFileMapping = new MappedFile(m_pStaticsReservation);
+  m_pMapPoolPager = new DemandPagedPool(m_pMapPool, MAP_MEMORY_SIZE);
 
 #ifdef DEBUG
   printf("Map 0x%x\n", m_pMapPool);
@@ -170,16 +211,7 @@ LPVOID WINAPI FileManager_7_0_29_2::OnMapViewOfFile(
   __in  SIZE_T dwNumberOfBytesToMap
   )
 {
-  ClientFileHandleSet* pMatchingFileset = NULL;
-
-  for (std::map<std::string, ClientFileHandleSet*>::const_iterator iterator = m_files.begin(); iterator != m_files.end(); iterator++)
-  {
-    if (iterator->second->m_createFileMappingHandle == hFileMappingObject)
-    {
-      pMatchingFileset = iterator->second;
-      break;
-    }
-  }
+  ClientFileHandleSet* pMatchingFileset = findFileByMappingHandle(hFileMappingObject);
 
   HANDLE handleToReturn = INVALID_HANDLE_VALUE;
 
@@ -196,14 +228,19 @@ LPVOID WINAPI FileManager_7_0_29_2::OnMapViewOfFile(
 
         if (shortFilename == "map0LegacyMUL.uop")
         {
-          std::ifstream map0(m_files["map0LegacyMUL.uop"]->m_filename, std::ios::in|std::ios::binary);
+          std::ifstream map0(pMatchingFileset->m_filename, std::ios::in|std::ios::binary);
+          uint32_t mapFileSize = 0;
 
           if (map0.is_open())
           {
             map0.seekg (0, map0.end);
             std::streamoff length = map0.tellg();
             map0.seekg (0, map0.beg);
-            map0.read(reinterpret_cast<char*>(m_pMapPool), length);
+            if (m_pMapReservation->commit(static_cast<uint32_t>(length)))
+            {
+              map0.read(reinterpret_cast<char*>(m_pMapPool), length);
+              mapFileSize = static_cast<uint32_t>(length);
+            }
             map0.close();
           }
 #ifdef DEBUG
@@ -212,7 +249,7 @@ LPVOID WINAPI FileManager_7_0_29_2::OnMapViewOfFile(
             printf("FAILED TO OPEN FILE\n");
           }
 #endif
-          parseMapFile("map0legacymul");
+          parseMapFile("map0legacymul", mapFileSize);
         }
       }
       else if (shortFilename.find("statics") != std::string::npos)
@@ -238,60 +275,92 @@ LPVOID WINAPI FileManager_7_0_29_2::OnMapViewOfFile(
 	return handleToReturn;
 }
 
-void FileManager_7_0_29_2::parseMapFile(std::string filename)
+/* Reads the file tables of the uop map the client loaded into the map pool and maps its entries to the map blocks.
+ * The mul layout is the entries laid end to end, so if any entry is missing no block past it can be placed and the 
+ * map is left without entries, the same way the uop to mul conversion gives up on it.
+ */
+void FileManager_7_0_29_2::parseMapFile(std::string filename, uint32_t fileSize)
 {
-  //printf("PARSING MAP\n");
-  UopHeader header; 
-  header.unmarshal(m_pMapPool);
-  
-  std::map<uint32_t, uint64_t>* pHashes = UopUtility::getMapHashes(header.TotalFiles, filename);
+  clearFileEntries();
+
+  UopReader reader;
+  if (!reader.attach(m_pMapPool, fileSize))
+  {
+#ifdef DEBUG
+    printf("Failed to read the file tables of %s\n", filename.c_str());
+#endif
+    buildBlockAddressTable();
+    return;
+  }
+
+  uint32_t totalFiles = reader.getHeader().TotalFiles;
+  std::vector<uint64_t> hashes;
+  UopPathHash::getMapHashes(totalFiles, filename, hashes);
   
-  //unmarshal file table
-  FileTable table;
-  table.unmarshal(m_pMapPool + header.FileTableOffset);
+  std::vector<FileEntry> entries;
+  reader.getEntries(entries);
+
+  UopEntryIndex index;
+  index.build(entries.empty() ? NULL : &entries[0], static_cast<uint32_t>(entries.size()));
   
   //make a list of file entries and map them in order
-  for (uint32_t i = 0; i < header.TotalFiles; ++i)
+  for (uint32_t i = 0; i < totalFiles; ++i)
   {
-    //find the corresponding FileEntry
-    for (uint32_t j = 0; j < header.TotalFiles; ++j)
+    int32_t entry = index.find(hashes[i]);
+    if (entry == UopEntryIndex::EMPTY_SLOT)
     {
-      if ((*pHashes)[i] == table.pEntries[j].PathChecksum)
-      {
-        m_fileEntries[i] = new FileEntry(table.pEntries[j]);
-        break;
-      }
+#ifdef DEBUG
+      printf("No file entry for map block %u in %s\n", i, filename.c_str());
+#endif
+      clearFileEntries();
+      break;
     }
+
+    m_fileEntries[i] = new FileEntry(entries[entry]);
   }
 
-  delete pHashes;
+  buildBlockAddressTable();
 }
 
-unsigned char* FileManager_7_0_29_2::seekLandBlock(uint8_t mapNumber, uint32_t blockNum)
+void FileManager_7_0_29_2::clearFileEntries()
 {
-  uint8_t* pData = NULL;
-  uint32_t blockSeekLocation = blockNum * 196;
+  for (std::map<uint32_t, FileEntry*>::iterator itr = m_fileEntries.begin(); itr != m_fileEntries.end(); itr++)
+  {
+    delete itr->second;
+  }
+  m_fileEntries.clear();
+}
+
+void FileManager_7_0_29_2::buildBlockAddressTable()
+{
+  m_blockTable.clear();
+
   int numFilesInMap = m_fileEntries.size();
-  uint32_t fileSeekLocation = 0;
-    
   for (int i = 0; i < numFilesInMap; i++)
   {
-    FileEntry* pCurrentEntry = m_fileEntries[i];
-    
-    if (blockSeekLocation < (fileSeekLocation + pCurrentEntry->UncompressedDataSize))
-    {
-      uint32_t blockOffset = blockSeekLocation - fileSeekLocation;
-      uint32_t fileViewAddress = (uint32_t)m_pMapPool;
-      uint32_t fileEntryAddress = static_cast<uint32_t>(fileViewAddress + pCurrentEntry->UopFileOffset);
-      pData = reinterpret_cast<unsigned char*>(fileEntryAddress + blockOffset + pCurrentEntry->MetaDataSize + 4);
-    
-      break;
-    }
-    
-    fileSeekLocation += pCurrentEntry->UncompressedDataSize;
+    m_blockTable.addEntry(*m_fileEntries[i]);
   }
 
-  return pData;
+#ifdef DEBUG
+  printf("Land block table: %u entries, %u bytes, %s\n", m_blockTable.getNumberOfEntries(), m_blockTable.getTotalDataSize(), m_blockTable.isUniform() ? "uniform" : "binary search");
+#endif
+}
+
+unsigned char* FileManager_7_0_29_2::seekLandBlock(uint8_t mapNumber, uint32_t blockNum)
+{
+  uint32_t poolOffset = 0;
+  if (!m_blockTable.find(blockNum, poolOffset))
+  {
+    return NULL;
+  }
+
+  return m_pMapPool + poolOffset + 4;
+}
+
+/* Returns a pointer to the 192 bytes of the block in the map pool, or NULL if the block is past the end of the map */
+unsigned char* FileManager_7_0_29_2::getLandBlockView(uint8_t mapNumber, uint32_t blockNum)
+{
+  return seekLandBlock(mapNumber, blockNum);
 }
 
 unsigned char* FileManager_7_0_29_2::readLandBlock(uint8_t mapNumber, uint32_t blockNum)
@@ -312,60 +381,43 @@ unsigned char* FileManager_7_0_29_2::readLandBlock(uint8_t mapNumber, uint32_t b
  
 bool FileManager_7_0_29_2::updateLandBlock(uint8_t mapNumber, uint32_t blockNum, uint8_t* pLandData)
 {
-  //update block in memory
   unsigned char* pBlockPosition = seekLandBlock(mapNumber, blockNum);
-  if (pBlockPosition != NULL)
+  if (pBlockPosition == NULL)
   {
-    for (int i = 0; i < 192; ++i)
-    {
-      pBlockPosition[i] = pLandData[i];
-    }
+#ifdef DEBUG
+    printf("Unable to update land block!\n");
+#endif
+    return false;
   }
-  #ifdef DEBUG
-  else
+
+  //the record goes ahead of the change, the mapped map file is written straight through its view
+  m_pJournal->recordLandBlock(blockNum, pLandData);
+  commitBeforeViewWrite(m_pMapFileMapping);
+
+  //update block in memory
+  for (int i = 0; i < 192; ++i)
   {
-    printf("Unable to update land block!\n");
+    pBlockPosition[i] = pLandData[i];
   }
-  #endif
 
-  if (m_pMapFileStream->is_open())
+  if (m_pMapFileMapping->isOpen() && (blockNum * 196) + 196 <= m_pMapFileMapping->getMappedSize())
   {
-    //update block on disk
+    //update block in the mapped map file
+    memcpy(m_pMapFileMapping->getView() + (blockNum * 196) + 4, pLandData, 192);
+  }
+  else if (m_pMapFileStream->is_open())
+  {
+    //update block on disk from the block writer's thread
     uint32_t blockSeekLocation = (blockNum * 196) + 4;
 #ifdef DEBUG
-    printf("Updating Land block on disk at location: 0x%x\n", blockSeekLocation);
-#endif
-    m_pMapFileStream->seekp(blockSeekLocation, std::ios::beg);
-  
-#ifdef DEBUG
-    if (m_pMapFileStream->bad())
-    {
-      printf("Failed to Seek!!!!!!!!!!!!!! (%i)\n", GetLastError());
-    }
-    else
-    {
-      printf("Seek successful\n");
-    }
-#endif
-  
-    m_pMapFileStream->write(const_cast<const char*>(reinterpret_cast<char*>(pLandData)), 192);
-#ifdef DEBUG  
-    if (m_pMapFileStream->bad())
-    {
-      printf("Failed to Write!!!!!!!!!!!!!! (%i)\n", GetLastError());
-    }
-    else
-    {
-      printf("Wrote successfully\n");
-    }
+    printf("Queueing land block write at location: 0x%x\n", blockSeekLocation);
 #endif
+    m_pBlockWriter->queueWrite(BlockWriter::FILE_MAP, blockSeekLocation, pLandData, 192);
   }
 
-  m_pMapFileStream->flush();
-
-#ifdef DEBUG  
-      printf("Flushed successfully\n");
-#endif
+  m_pMaterializedBlocks->markMaterialized(blockNum);
+  m_pBlockCrcs->invalidate(blockNum);
+  checkpointIfNeeded();
 
   return true;
 }
@@ -381,12 +433,17 @@ void FileManager_7_0_29_2::InitializeShardMaps(std::string shardIdentifier, std:
 #endif
 
   m_shardIdentifier = shardIdentifier;
+  m_pResidentMaps->clear();
+  reservePoolsForMaps(mapDefinitions);
 
   std::string shardFullPath(getUltimaLiveSavePath());
   shardFullPath.append("\\");
   shardFullPath.append(shardIdentifier);
   CreateDirectoryA(shardFullPath.c_str(), NULL);
 
+  //files found in the client folder are queued here and imported together once all maps have been checked
+  ShardImporter importer;
+
   for (std::map<uint32_t, MapDefinition>::iterator itr = mapDefinitions.begin(); itr != mapDefinitions.end(); itr++)
   {
     std::string filePath(shardFullPath);
@@ -436,21 +493,11 @@ void FileManager_7_0_29_2::InitializeShardMaps(std::string shardIdentifier, std:
       if (currentFileBlocks <= blocksNeeded + 1 && currentFileBlocks >= blocksNeeded - 1)
       {
 #ifdef DEBUG
-        printf("Copying File: %s to %s ... ", existingFilePath.c_str(), filePath.c_str());
+        printf("Importing File: %s to %s\n", existingFilePath.c_str(), filePath.c_str());
 #endif
         //map file
-        std::string mapMessage("Importing ");
-        mapMessage.append(filename);
-        mapMessage.append(" from game client folder");
-        m_pProgressDlg->setMessage(mapMessage);
-        m_pProgressDlg->setProgress(0);
-        //copyFile(existingFilePath, filePath, m_pProgressDlg);
-        UopUtility::convertUopMapToMul(existingFilePath, filePath, m_pProgressDlg);
+        importer.addUopConversion(itr->first, existingFilePath, filePath, currentFileSize);
 
-
-#ifdef DEBUG
-        printf("done!\n");
-#endif
         //statics file
         std::string dstStaticsFilePath(shardFullPath);
         dstStaticsFilePath.append("\\");
@@ -460,20 +507,7 @@ void FileManager_7_0_29_2::InitializeShardMaps(std::string shardIdentifier, std:
         std::string staticsFilePath (clientFolder);
         staticsFilePath.append("\\");
         staticsFilePath.append(staticsFilename);
-
-#ifdef DEBUG
-        printf("Copying File: %s to %s ... ", staticsFilePath.c_str(), dstStaticsFilePath.c_str());
-#endif
-        std::string staticsMessage("Copying ");
-        staticsMessage.append(staticsFilename);
-        staticsMessage.append(" from game client folder");
-        m_pProgressDlg->setMessage(staticsMessage);
-        m_pProgressDlg->setProgress(0);
-        copyFile(staticsFilePath, dstStaticsFilePath, m_pProgressDlg);
-
-#ifdef DEBUG
-        printf("done!\n");
-#endif
+        importer.addCopy(itr->first, staticsFilePath, dstStaticsFilePath);
 
         //statics idx
         std::string dstStaidxFilePath(shardFullPath);
@@ -484,21 +518,7 @@ void FileManager_7_0_29_2::InitializeShardMaps(std::string shardIdentifier, std:
         std::string staidxFilePath (clientFolder);
         staidxFilePath.append("\\");
         staidxFilePath.append(staidxFilename);
-
-#ifdef DEBUG
-        printf("Copying File: %s to %s ... ", staidxFilePath.c_str(), dstStaidxFilePath.c_str());
-#endif
-        std::string staidxMessage("Copying ");
-        staidxMessage.append(filename);
-        staidxMessage.append(" from game client folder");
-        m_pProgressDlg->setMessage(staidxMessage);
-        m_pProgressDlg->setProgress(0);
-        copyFile(staidxFilePath, dstStaidxFilePath, m_pProgressDlg);
-
-#ifdef DEBUG
-        printf("done!\n");
-#endif
-
+        importer.addCopy(itr->first, staidxFilePath, dstStaidxFilePath);
       }
       else
       {
@@ -509,6 +529,17 @@ void FileManager_7_0_29_2::InitializeShardMaps(std::string shardIdentifier, std:
     mapFile.close();
   }
 
+  if (!importer.run(m_pProgressDlg))
+  {
+    //start over with a blank map where the client files could not be imported
+    for (std::map<uint32_t, MapDefinition>::iterator itr = mapDefinitions.begin(); itr != mapDefinitions.end(); itr++)
+    {
+      if (!importer.mapSucceeded(itr->first))
+      {
+        createNewPersistentMap(shardFullPath, itr->first, itr->second.mapWidthInTiles >> 3, itr->second.mapWrapHeightInTiles >> 3);
+      }
+    }
+  }
 
   m_pProgressDlg->hide();
   delete m_pProgressDlg;
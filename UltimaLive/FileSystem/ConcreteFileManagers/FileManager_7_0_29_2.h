@@ -21,6 +21,10 @@
 #include "..\BaseFileManager.h"
 #include "..\Uop\UopStructs.h"
 #include "..\Uop\UopUtility.h"
+#include "..\Uop\UopEntryIndex.h"
+#include "..\Uop\UopBlockTable.h"
+#include "..\Uop\UopReader.h"
+#include "..\Uop\Inflate.h"
 #include "..\..\Utils.h"
 #include "..\..\LocalPeHelper32.hpp"
 
@@ -30,6 +34,7 @@
 #include <iostream>
 #include <fstream>
 #include <map>
+#include <vector>
 #include <stdint.h>
 
 class FileManager_7_0_29_2 : public BaseFileManager
@@ -47,20 +52,29 @@ class FileManager_7_0_29_2 : public BaseFileManager
 
     bool updateLandBlock(uint8_t mapNumber, uint32_t blockNum, uint8_t* pData);
     unsigned char* readLandBlock(uint8_t mapNumber, uint32_t blockNum);
+    unsigned char* getLandBlockView(uint8_t mapNumber, uint32_t blockNum);
     
     void InitializeShardMaps(std::string shardIdentifier, std::map<uint32_t, MapDefinition> definitions);
 
     void Initialize();
     void LoadMap(uint8_t mapNumber);
+    void touchBlocks(uint8_t mapNumber, uint32_t firstBlock, uint32_t numberOfBlocks);
 
     static const int MAP_MEMORY_SIZE = 100000000;
     static const int STAIDX_MEMORY_SIZE = 10000000;
+    static const bool LAZY_MAP_LOADING = true;
 
   protected:
     std::map<uint32_t, FileEntry*> m_fileEntries; 
     std::map<std::string, uint32_t> m_neededFiles;
+
+    //block addressing tables built once in parseMapFile
+    UopBlockTable m_blockTable;
+
     unsigned char* seekLandBlock(uint8_t mapNumber, uint32_t blockNum);
 
-    void parseMapFile(std::string filename);
+    void parseMapFile(std::string filename, uint32_t fileSize);
+    void clearFileEntries();
+    void buildBlockAddressTable();
 };
 #endif
\ No newline at end of file
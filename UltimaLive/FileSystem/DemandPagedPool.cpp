@@ -0,0 +1,339 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "DemandPagedPool.h"
+#include <algorithm>
+#include <cstdio>
+
+std::vector<DemandPagedPool*> DemandPagedPool::s_pools;
+PVOID DemandPagedPool::s_pExceptionHandler = NULL;
+
+DemandPagedPool::DemandPagedPool(uint8_t* pPool, uint32_t poolSize)
+  : m_pPool(pPool),
+  m_poolSize(poolSize),
+  m_sources(),
+  m_pageStates((poolSize + PAGE_SIZE - 1) / PAGE_SIZE, PAGE_RESIDENT),
+  m_pageProtections((poolSize + PAGE_SIZE - 1) / PAGE_SIZE, PAGE_NOACCESS),
+  m_sourceBytes(0),
+  m_pagedInBytes(0),
+  m_pagesFaulted(0),
+  m_pagesTouched(0),
+  m_armed(false),
+  m_hMutex(CreateMutex(NULL, false, NULL))
+{
+  if (s_pExceptionHandler == NULL)
+  {
+    s_pExceptionHandler = AddVectoredExceptionHandler(1, onException);
+  }
+
+  s_pools.push_back(this);
+}
+
+DemandPagedPool::~DemandPagedPool()
+{
+  disarm();
+
+  for (std::vector<DemandPagedPool*>::iterator itr = s_pools.begin(); itr != s_pools.end(); itr++)
+  {
+    if (*itr == this)
+    {
+      s_pools.erase(itr);
+      break;
+    }
+  }
+
+  CloseHandle(m_hMutex);
+}
+
+/* Source ranges must not overlap */
+void DemandPagedPool::addSource(uint32_t poolOffset, uint8_t* pSource, uint32_t length)
+{
+  addRange(poolOffset, pSource, length, 0);
+}
+
+/* Fills length bytes starting at poolOffset with the pattern repeated, the pattern has to outlive the pool's sources */
+void DemandPagedPool::addPattern(uint32_t poolOffset, const uint8_t* pPattern, uint32_t patternLength, uint32_t length)
+{
+  if (patternLength > 0)
+  {
+    addRange(poolOffset, pPattern, length, patternLength);
+  }
+}
+
+void DemandPagedPool::addRange(uint32_t poolOffset, const uint8_t* pSource, uint32_t length, uint32_t patternLength)
+{
+  if (poolOffset >= m_poolSize || length == 0)
+  {
+    return;
+  }
+
+  if (length > m_poolSize - poolOffset)
+  {
+    length = m_poolSize - poolOffset;
+  }
+
+  SourceRange range = { poolOffset, pSource, length, patternLength };
+  m_sources.push_back(range);
+  m_sourceBytes += length;
+}
+
+/* Takes away access to every page that is covered by a source range */
+void DemandPagedPool::arm()
+{
+  WaitForSingleObject(m_hMutex, INFINITE);
+
+  m_pagedInBytes = 0;
+  m_pagesFaulted = 0;
+  m_pagesTouched = 0;
+
+  std::sort(m_sources.begin(), m_sources.end(), compareSources);
+
+  for (std::vector<SourceRange>::iterator itr = m_sources.begin(); itr != m_sources.end(); itr++)
+  {
+    uint32_t page = itr->poolOffset / PAGE_SIZE;
+    uint32_t endPage = ((itr->poolOffset + itr->length - 1) / PAGE_SIZE) + 1;
+
+    while (page < endPage)
+    {
+      //the first page may be shared with the range before, it already remembers its protection
+      if (m_pageStates[page] == PAGE_ARMED)
+      {
+        page++;
+        continue;
+      }
+
+      //pages are armed a region at a time, every page of a region has the same protection
+      MEMORY_BASIC_INFORMATION info;
+      uint8_t* pPage = m_pPool + (page * PAGE_SIZE);
+      if (VirtualQuery(pPage, &info, sizeof(info)) == 0)
+      {
+        break;
+      }
+
+      uint32_t regionEndPage = static_cast<uint32_t>((reinterpret_cast<uint8_t*>(info.BaseAddress) + info.RegionSize - m_pPool) / PAGE_SIZE);
+      uint32_t runEndPage = regionEndPage < endPage ? regionEndPage : endPage;
+
+      DWORD oldProtection = 0;
+      if (info.State == MEM_COMMIT && VirtualProtect(pPage, (runEndPage - page) * PAGE_SIZE, PAGE_NOACCESS, &oldProtection))
+      {
+        for (uint32_t armedPage = page; armedPage < runEndPage; armedPage++)
+        {
+          m_pageProtections[armedPage] = info.Protect;
+          m_pageStates[armedPage] = PAGE_ARMED;
+        }
+      }
+
+      page = runEndPage;
+    }
+  }
+
+  m_armed = true;
+  ReleaseMutex(m_hMutex);
+}
+
+/* Gives access back to every page that was never filled and forgets the sources.  Those pages keep whatever they held
+ * before the pool was armed.
+ */
+void DemandPagedPool::disarm()
+{
+  WaitForSingleObject(m_hMutex, INFINITE);
+
+  if (m_armed)
+  {
+#ifdef DEBUG
+    printf("Demand paged pool: %u pages faulted, %u pages touched, %u of %u bytes never loaded\n", m_pagesFaulted, m_pagesTouched, getBytesAvoided(), m_sourceBytes);
+#endif
+
+    uint32_t pagesLeftArmed = 0;
+    for (uint32_t page = 0; page < m_pageStates.size(); page++)
+    {
+      if (m_pageStates[page] == PAGE_ARMED)
+      {
+        DWORD oldProtection = 0;
+        if (VirtualProtect(m_pPool + (page * PAGE_SIZE), PAGE_SIZE, m_pageProtections[page], &oldProtection))
+        {
+          m_pageStates[page] = PAGE_RESIDENT;
+        }
+        else
+        {
+          pagesLeftArmed++;
+        }
+      }
+    }
+
+    //a page that is still armed gets its protection back when it is touched, without any source to fill it from
+    m_armed = pagesLeftArmed > 0;
+#ifdef DEBUG
+    if (pagesLeftArmed > 0)
+    {
+      printf("Demand paged pool: unable to give %u pages their protection back (%i)\n", pagesLeftArmed, GetLastError());
+    }
+#endif
+  }
+
+  m_sources.clear();
+  m_sourceBytes = 0;
+
+  ReleaseMutex(m_hMutex);
+}
+
+/* Fills every page in the range that has not been filled yet */
+void DemandPagedPool::touch(uint32_t poolOffset, uint32_t length)
+{
+  if (!m_armed || length == 0 || poolOffset >= m_poolSize)
+  {
+    return;
+  }
+
+  uint32_t lastOffset = poolOffset + length - 1;
+  if (lastOffset >= m_poolSize)
+  {
+    lastOffset = m_poolSize - 1;
+  }
+
+  for (uint32_t page = poolOffset / PAGE_SIZE; page <= lastOffset / PAGE_SIZE; page++)
+  {
+    if (m_pageStates[page] == PAGE_ARMED && pageIn(page))
+    {
+      m_pagesTouched++;
+    }
+  }
+}
+
+bool DemandPagedPool::isArmed()
+{
+  return m_armed;
+}
+
+uint32_t DemandPagedPool::getPagesFaulted()
+{
+  return m_pagesFaulted;
+}
+
+uint32_t DemandPagedPool::getPagesTouched()
+{
+  return m_pagesTouched;
+}
+
+uint32_t DemandPagedPool::getBytesAvoided()
+{
+  return m_sourceBytes - m_pagedInBytes;
+}
+
+bool DemandPagedPool::pageIn(uint32_t page)
+{
+  WaitForSingleObject(m_hMutex, INFINITE);
+
+  //another thread may have filled the page while this one was waiting
+  if (m_pageStates[page] != PAGE_ARMED)
+  {
+    ReleaseMutex(m_hMutex);
+    return false;
+  }
+
+  uint32_t pageStart = page * PAGE_SIZE;
+  uint32_t pageEnd = pageStart + PAGE_SIZE;
+
+  //the page stays armed if it can't be given back, copying into it would only fault again
+  DWORD oldProtection = 0;
+  if (!VirtualProtect(m_pPool + pageStart, PAGE_SIZE, m_pageProtections[page], &oldProtection))
+  {
+    ReleaseMutex(m_hMutex);
+    return false;
+  }
+
+  for (std::vector<SourceRange>::iterator itr = m_sources.begin(); itr != m_sources.end() && itr->poolOffset < pageEnd; itr++)
+  {
+    uint32_t rangeEnd = itr->poolOffset + itr->length;
+    if (rangeEnd <= pageStart)
+    {
+      continue;
+    }
+
+    uint32_t copyStart = itr->poolOffset > pageStart ? itr->poolOffset : pageStart;
+    uint32_t copyEnd = rangeEnd < pageEnd ? rangeEnd : pageEnd;
+    if (itr->patternLength == 0)
+    {
+      memcpy(m_pPool + copyStart, itr->pSource + (copyStart - itr->poolOffset), copyEnd - copyStart);
+    }
+    else
+    {
+      for (uint32_t offset = copyStart; offset < copyEnd; )
+      {
+        uint32_t patternOffset = (offset - itr->poolOffset) % itr->patternLength;
+        uint32_t length = itr->patternLength - patternOffset;
+        if (length > copyEnd - offset)
+        {
+          length = copyEnd - offset;
+        }
+
+        memcpy(m_pPool + offset, itr->pSource + patternOffset, length);
+        offset += length;
+      }
+    }
+
+    m_pagedInBytes += copyEnd - copyStart;
+  }
+
+  m_pageStates[page] = PAGE_RESIDENT;
+  ReleaseMutex(m_hMutex);
+  return true;
+}
+
+bool DemandPagedPool::compareSources(const SourceRange& rLeft, const SourceRange& rRight)
+{
+  return rLeft.poolOffset < rRight.poolOffset;
+}
+
+LONG CALLBACK DemandPagedPool::onException(PEXCEPTION_POINTERS pExceptionInfo)
+{
+  if (pExceptionInfo->ExceptionRecord->ExceptionCode == EXCEPTION_ACCESS_VIOLATION)
+  {
+    uint8_t* pAddress = reinterpret_cast<uint8_t*>(pExceptionInfo->ExceptionRecord->ExceptionInformation[1]);
+
+    for (std::vector<DemandPagedPool*>::iterator itr = s_pools.begin(); itr != s_pools.end(); itr++)
+    {
+      DemandPagedPool* pPool = *itr;
+
+      if (pPool->m_armed && pAddress >= pPool->m_pPool && pAddress < pPool->m_pPool + pPool->m_poolSize)
+      {
+        uint32_t page = (pAddress - pPool->m_pPool) / PAGE_SIZE;
+        bool wasArmed = pPool->m_pageStates[page] == PAGE_ARMED;
+
+        if (pPool->pageIn(page))
+        {
+          pPool->m_pagesFaulted++;
+        }
+
+        //either this thread or another one filled the page, retry the access.  A page that is still armed could not 
+        //be given its protection back, retrying would only fault on it again
+        if (wasArmed && pPool->m_pageStates[page] != PAGE_ARMED)
+        {
+          return EXCEPTION_CONTINUE_EXECUTION;
+        }
+      }
+    }
+  }
+
+  return EXCEPTION_CONTINUE_SEARCH;
+}
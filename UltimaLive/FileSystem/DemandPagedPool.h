@@ -0,0 +1,101 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _DEMAND_PAGED_POOL_H
+#define _DEMAND_PAGED_POOL_H
+
+#include <vector>
+#include <stdint.h>
+#include <Windows.h>
+
+/* Fills a memory pool from its source data one page at a time, the first time each page is touched.
+ *
+ * Arming the pool describes where each range of the pool comes from and takes away access to every page that 
+ * overlaps one of those ranges.  When the client (or UltimaLive itself) touches such a page the access violation is
+ * caught by a vectored exception handler, the page is copied in from its source and execution continues.  Pages can 
+ * also be filled ahead of time with touch(), which is how the area around the player is brought in before the 
+ * client asks for it.
+ *
+ * A source can also be a short pattern that is repeated over its range, which is how blocks of a blank map that were 
+ * never written are filled with the blank land block.
+ *
+ * Bytes of a page that are not covered by a source range are left alone, so data already in the pool (like the uop
+ * headers and file tables around the map data) stays valid.
+ *
+ * A page gets back the protection it had when the pool was armed, which depends on whether the pool is committed 
+ * memory or a view, and on whether that view is copy-on-write.  A page whose protection can't be given back stays armed.
+ */
+class DemandPagedPool
+{
+  public:
+    DemandPagedPool(uint8_t* pPool, uint32_t poolSize);
+    ~DemandPagedPool();
+
+    void addSource(uint32_t poolOffset, uint8_t* pSource, uint32_t length);
+    void addPattern(uint32_t poolOffset, const uint8_t* pPattern, uint32_t patternLength, uint32_t length);
+    void arm();
+    void disarm();
+    void touch(uint32_t poolOffset, uint32_t length);
+    bool isArmed();
+
+    uint32_t getPagesFaulted();
+    uint32_t getPagesTouched();
+    uint32_t getBytesAvoided();
+
+    static const uint32_t PAGE_SIZE = 0x1000;
+
+  private:
+    struct SourceRange
+    {
+      uint32_t poolOffset;
+      const uint8_t* pSource;
+      uint32_t length;
+      uint32_t patternLength;
+    };
+
+    void addRange(uint32_t poolOffset, const uint8_t* pSource, uint32_t length, uint32_t patternLength);
+
+    static const uint8_t PAGE_RESIDENT = 0;
+    static const uint8_t PAGE_ARMED = 1;
+
+    bool pageIn(uint32_t page);
+    static bool compareSources(const SourceRange& rLeft, const SourceRange& rRight);
+    static LONG CALLBACK onException(PEXCEPTION_POINTERS pExceptionInfo);
+
+    uint8_t* m_pPool;
+    uint32_t m_poolSize;
+    std::vector<SourceRange> m_sources;
+    std::vector<uint8_t> m_pageStates;
+    std::vector<DWORD> m_pageProtections; //what each armed page is given back, a view of the map file may be copy-on-write
+    uint32_t m_sourceBytes;
+    uint32_t m_pagedInBytes;
+    uint32_t m_pagesFaulted;
+    uint32_t m_pagesTouched;
+    bool m_armed;
+    HANDLE m_hMutex;
+
+    static std::vector<DemandPagedPool*> s_pools;
+    static PVOID s_pExceptionHandler;
+};
+
+#endif
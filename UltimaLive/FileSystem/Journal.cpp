@@ -0,0 +1,428 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "Journal.h"
+#include <cstdio>
+
+Journal::Journal()
+  : m_journalPath(),
+  m_hFile(INVALID_HANDLE_VALUE),
+  m_hPendingMutex(CreateMutex(NULL, false, NULL)),
+  m_hCommitMutex(CreateMutex(NULL, false, NULL)),
+  m_hCommitEvent(CreateEvent(NULL, false, false, NULL)),
+  m_hStopEvent(CreateEvent(NULL, true, false, NULL)),
+  m_hCommitThread(NULL),
+  m_commitsHeld(0),
+  m_pending(),
+  m_committedSize(0),
+  m_discardedSize(0)
+{
+  //do nothing
+}
+
+Journal::~Journal()
+{
+  close();
+  CloseHandle(m_hPendingMutex);
+  CloseHandle(m_hCommitMutex);
+  CloseHandle(m_hCommitEvent);
+  CloseHandle(m_hStopEvent);
+}
+
+bool Journal::open(std::string journalPath)
+{
+  close();
+
+  m_journalPath = journalPath;
+  m_hFile = CreateFileA(journalPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (m_hFile == INVALID_HANDLE_VALUE)
+  {
+#ifdef DEBUG
+    printf("Unable to open journal %s (%i)\n", journalPath.c_str(), GetLastError());
+#endif
+    return false;
+  }
+
+  m_committedSize = GetFileSize(m_hFile, NULL);
+  m_discardedSize = 0;
+  SetFilePointer(m_hFile, 0, NULL, FILE_END);
+
+  ResetEvent(m_hStopEvent);
+  m_hCommitThread = CreateThread(NULL, 0, commitThreadProc, this, 0, NULL);
+
+  return true;
+}
+
+/* Stops the commit thread and commits anything still pending before closing the journal file */
+void Journal::close()
+{
+  if (m_hCommitThread != NULL)
+  {
+    SetEvent(m_hStopEvent);
+    WaitForSingleObject(m_hCommitThread, INFINITE);
+    CloseHandle(m_hCommitThread);
+    m_hCommitThread = NULL;
+  }
+
+  if (m_hFile != INVALID_HANDLE_VALUE)
+  {
+    commit();
+    CloseHandle(m_hFile);
+    m_hFile = INVALID_HANDLE_VALUE;
+  }
+}
+
+/* Applies every intact record in the journal to the shard files, makes the files durable, and empties the journal.
+ * Replay stops at the first record that is incomplete or fails its checksum, that is where the last commit was cut 
+ * short.  Land blocks that are replayed into a blank map are marked as written before the journal is emptied.
+ */
+bool Journal::replay(std::string mapPath, std::string staidxPath, std::string staticsPath, MaterializedBlockMap* pMaterializedBlocks)
+{
+  if (m_hFile == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  commit();
+
+  if (m_committedSize == 0)
+  {
+    return true;
+  }
+
+  std::vector<uint8_t> journal(m_committedSize);
+  DWORD bytesRead = 0;
+  SetFilePointer(m_hFile, 0, NULL, FILE_BEGIN);
+  ReadFile(m_hFile, &journal[0], m_committedSize, &bytesRead, NULL);
+
+  HANDLE hMapFile = CreateFileA(mapPath.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  HANDLE hStaidxFile = CreateFileA(staidxPath.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  HANDLE hStaticsFile = CreateFileA(staticsPath.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+  uint32_t numberOfRecords = 0;
+  uint32_t position = 0;
+
+  while (position + sizeof(RecordHeader) <= bytesRead)
+  {
+    RecordHeader header;
+    memcpy(&header, &journal[position], sizeof(RecordHeader));
+    uint8_t* pData = &journal[position] + sizeof(RecordHeader);
+
+    if (header.magic != RECORD_MAGIC || header.length > bytesRead - position - sizeof(RecordHeader) || header.checksum != checksum(header, pData))
+    {
+      break;
+    }
+
+    if (header.type == RECORD_LAND)
+    {
+      writeAt(hMapFile, (header.blockNum * 196) + 4, pData, header.length);
+      pMaterializedBlocks->markMaterialized(header.blockNum);
+    }
+    else if (header.type == RECORD_STATICS)
+    {
+      uint32_t indexEntry[2] = { header.lookup, header.length };
+
+      if (header.length > 0)
+      {
+        writeAt(hStaticsFile, header.lookup, pData, header.length);
+      }
+      writeAt(hStaidxFile, header.blockNum * 12, reinterpret_cast<uint8_t*>(indexEntry), sizeof(indexEntry));
+    }
+
+    numberOfRecords++;
+    position += sizeof(RecordHeader) + header.length;
+  }
+
+  HANDLE files[3] = { hMapFile, hStaidxFile, hStaticsFile };
+  for (int i = 0; i < 3; i++)
+  {
+    if (files[i] != INVALID_HANDLE_VALUE)
+    {
+      FlushFileBuffers(files[i]);
+      CloseHandle(files[i]);
+    }
+  }
+
+#ifdef DEBUG
+  printf("Replayed %u journal records (%u of %u bytes)\n", numberOfRecords, position, bytesRead);
+#endif
+
+  pMaterializedBlocks->save();
+  reset();
+  return true;
+}
+
+void Journal::recordLandBlock(uint32_t blockNum, uint8_t* pLandData)
+{
+  appendRecord(RECORD_LAND, blockNum, 0, pLandData, 192);
+}
+
+void Journal::recordStaticsBlock(uint32_t blockNum, uint32_t lookup, uint8_t* pStaticsData, uint32_t length)
+{
+  appendRecord(RECORD_STATICS, blockNum, lookup, pStaticsData, length);
+}
+
+void Journal::appendRecord(uint32_t type, uint32_t blockNum, uint32_t lookup, uint8_t* pData, uint32_t length)
+{
+  if (m_hFile == INVALID_HANDLE_VALUE)
+  {
+    return;
+  }
+
+  RecordHeader header;
+  header.magic = RECORD_MAGIC;
+  header.type = type;
+  header.blockNum = blockNum;
+  header.lookup = lookup;
+  header.length = length;
+  header.checksum = checksum(header, pData);
+
+  WaitForSingleObject(m_hPendingMutex, INFINITE);
+  uint8_t* pHeader = reinterpret_cast<uint8_t*>(&header);
+  m_pending.insert(m_pending.end(), pHeader, pHeader + sizeof(RecordHeader));
+  m_pending.insert(m_pending.end(), pData, pData + length);
+  size_t pendingSize = m_pending.size();
+  ReleaseMutex(m_hPendingMutex);
+
+  if (pendingSize >= COMMIT_SIZE)
+  {
+    SetEvent(m_hCommitEvent);
+  }
+}
+
+/* Writes out every pending record with one write and one flush */
+void Journal::commit()
+{
+  WaitForSingleObject(m_hCommitMutex, INFINITE);
+
+  std::vector<uint8_t> records;
+  WaitForSingleObject(m_hPendingMutex, INFINITE);
+  records.swap(m_pending);
+  ReleaseMutex(m_hPendingMutex);
+
+  if (!records.empty() && m_hFile != INVALID_HANDLE_VALUE)
+  {
+    DWORD bytesWritten = 0;
+    WriteFile(m_hFile, &records[0], records.size(), &bytesWritten, NULL);
+    FlushFileBuffers(m_hFile);
+    m_committedSize += bytesWritten;
+
+#ifdef DEBUG
+    printf("Committed %u journal bytes\n", bytesWritten);
+#endif
+  }
+
+  ReleaseMutex(m_hCommitMutex);
+}
+
+/* Keeps the commit thread from writing until releaseCommits, so that a batch of updates goes out in a single commit 
+ * no matter how long it takes to apply.  Only the timed commits are held back, nothing waits on the hold, so the
+ * block writer can still run a checkpoint while the batch queues writes behind it.
+ */
+void Journal::holdCommits()
+{
+  InterlockedExchange(&m_commitsHeld, 1);
+}
+
+void Journal::releaseCommits()
+{
+  InterlockedExchange(&m_commitsHeld, 0);
+  commit();
+}
+
+/* Empties the journal.  Only call this once the shard files hold everything that was recorded. */
+void Journal::reset()
+{
+  WaitForSingleObject(m_hCommitMutex, INFINITE);
+  WaitForSingleObject(m_hPendingMutex, INFINITE);
+  m_discardedSize += m_committedSize + m_pending.size();
+  m_pending.clear();
+  ReleaseMutex(m_hPendingMutex);
+
+  if (m_hFile != INVALID_HANDLE_VALUE)
+  {
+    SetFilePointer(m_hFile, 0, NULL, FILE_BEGIN);
+    SetEndOfFile(m_hFile);
+    FlushFileBuffers(m_hFile);
+  }
+  m_committedSize = 0;
+
+  ReleaseMutex(m_hCommitMutex);
+}
+
+bool Journal::needsCheckpoint()
+{
+  return m_committedSize >= CHECKPOINT_SIZE;
+}
+
+/* Returns how many bytes have been recorded since the journal was opened, counting the ones that were already 
+ * discarded.  A checkpoint that runs later can pass this to discardUpTo to drop only what was recorded before it.
+ */
+uint64_t Journal::getRecordedSize()
+{
+  WaitForSingleObject(m_hPendingMutex, INFINITE);
+  uint64_t recordedSize = m_discardedSize + m_committedSize + m_pending.size();
+  ReleaseMutex(m_hPendingMutex);
+  return recordedSize;
+}
+
+/* Drops the records that were recorded before recordedSize, keeping the ones after it at the start of the journal.
+ * The kept records are written to a temporary journal that is renamed over the old one, so a crash part way through 
+ * leaves either the old journal or the new one and never a mix of the two.  Only call this once the shard files hold 
+ * everything up to recordedSize.
+ */
+void Journal::discardUpTo(uint64_t recordedSize)
+{
+  WaitForSingleObject(m_hCommitMutex, INFINITE);
+
+  //records of a batch that is still being applied are left pending, they are kept and committed with the rest of it
+  if (m_commitsHeld == 0)
+  {
+    commit();
+  }
+
+  if (recordedSize > m_discardedSize && m_hFile != INVALID_HANDLE_VALUE)
+  {
+    uint32_t discardLength = static_cast<uint32_t>(recordedSize - m_discardedSize);
+    if (discardLength > m_committedSize)
+    {
+      discardLength = m_committedSize;
+    }
+
+    std::vector<uint8_t> keptRecords(m_committedSize - discardLength);
+    DWORD bytesRead = 0;
+    if (!keptRecords.empty())
+    {
+      SetFilePointer(m_hFile, discardLength, NULL, FILE_BEGIN);
+      ReadFile(m_hFile, &keptRecords[0], keptRecords.size(), &bytesRead, NULL);
+    }
+
+    if (bytesRead == keptRecords.size() && replaceFile(keptRecords.empty() ? NULL : &keptRecords[0], bytesRead))
+    {
+      WaitForSingleObject(m_hPendingMutex, INFINITE);
+      m_discardedSize += m_committedSize - bytesRead;
+      m_committedSize = bytesRead;
+      ReleaseMutex(m_hPendingMutex);
+
+#ifdef DEBUG
+      printf("Discarded %u journal bytes, kept %u\n", discardLength, bytesRead);
+#endif
+    }
+    else
+    {
+      //the old journal is still in place, its records are idempotent so keeping them all is harmless
+      SetFilePointer(m_hFile, 0, NULL, FILE_END);
+    }
+  }
+
+  ReleaseMutex(m_hCommitMutex);
+}
+
+/* Swaps the journal file for one holding only the given records.  The new journal is made durable before it is 
+ * renamed over the old one.  Returns false with the old journal still open if the swap could not be made.
+ */
+bool Journal::replaceFile(uint8_t* pRecords, uint32_t length)
+{
+  std::string tempPath = m_journalPath + ".tmp";
+  HANDLE hTempFile = CreateFileA(tempPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (hTempFile == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  bool written = length == 0 || writeAt(hTempFile, 0, pRecords, length);
+  written = written && FlushFileBuffers(hTempFile);
+  CloseHandle(hTempFile);
+
+  if (!written)
+  {
+    DeleteFileA(tempPath.c_str());
+    return false;
+  }
+
+  CloseHandle(m_hFile);
+  bool replaced = MoveFileExA(tempPath.c_str(), m_journalPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+  if (!replaced)
+  {
+#ifdef DEBUG
+    printf("Unable to replace journal %s (%i)\n", m_journalPath.c_str(), GetLastError());
+#endif
+    DeleteFileA(tempPath.c_str());
+  }
+
+  m_hFile = CreateFileA(m_journalPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (m_hFile != INVALID_HANDLE_VALUE)
+  {
+    SetFilePointer(m_hFile, 0, NULL, FILE_END);
+  }
+
+  return replaced;
+}
+
+uint32_t Journal::checksum(RecordHeader& rHeader, uint8_t* pData)
+{
+  //FNV-1a over the header fields and the payload
+  uint32_t hash = 2166136261;
+  uint32_t fields[5] = { rHeader.magic, rHeader.type, rHeader.blockNum, rHeader.lookup, rHeader.length };
+  uint8_t* pFields = reinterpret_cast<uint8_t*>(fields);
+
+  for (uint32_t i = 0; i < sizeof(fields); i++)
+  {
+    hash = (hash ^ pFields[i]) * 16777619;
+  }
+
+  for (uint32_t i = 0; i < rHeader.length; i++)
+  {
+    hash = (hash ^ pData[i]) * 16777619;
+  }
+
+  return hash;
+}
+
+bool Journal::writeAt(HANDLE hFile, uint32_t offset, uint8_t* pData, uint32_t length)
+{
+  if (hFile == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  DWORD bytesWritten = 0;
+  SetFilePointer(hFile, offset, NULL, FILE_BEGIN);
+  return WriteFile(hFile, pData, length, &bytesWritten, NULL) && bytesWritten == length;
+}
+
+DWORD WINAPI Journal::commitThreadProc(LPVOID pParam)
+{
+  Journal* pJournal = reinterpret_cast<Journal*>(pParam);
+  HANDLE events[2] = { pJournal->m_hStopEvent, pJournal->m_hCommitEvent };
+
+  while (WaitForMultipleObjects(2, events, false, COMMIT_INTERVAL_MS) != WAIT_OBJECT_0)
+  {
+    if (pJournal->m_commitsHeld == 0)
+    {
+      pJournal->commit();
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,103 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _JOURNAL_H
+#define _JOURNAL_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <Windows.h>
+#include "MaterializedBlockMap.h"
+
+/* Append-only redo journal for the block updates made to one map's shard files.
+ *
+ * Every land or statics update is recorded as a single record holding the complete new contents of the block.  
+ * Records are buffered and committed in groups by a background thread, either when the commit interval elapses or
+ * when enough bytes are waiting, so that a burst of updates costs one write and one FlushFileBuffers instead of a
+ * flush per block.
+ *
+ * When a map is loaded, whatever made it into the journal is replayed into the map, staidx and statics files before 
+ * they are opened.  Records are idempotent, so replaying a journal that was already applied is harmless.  A
+ * checkpoint flushes the shard files and empties the journal.
+ */
+class Journal
+{
+  public:
+    Journal();
+    ~Journal();
+
+    bool open(std::string journalPath);
+    void close();
+    bool replay(std::string mapPath, std::string staidxPath, std::string staticsPath, MaterializedBlockMap* pMaterializedBlocks);
+
+    void recordLandBlock(uint32_t blockNum, uint8_t* pLandData);
+    void recordStaticsBlock(uint32_t blockNum, uint32_t lookup, uint8_t* pStaticsData, uint32_t length);
+
+    void commit();
+    void holdCommits();
+    void releaseCommits();
+    void reset();
+    bool needsCheckpoint();
+    uint64_t getRecordedSize();
+    void discardUpTo(uint64_t recordedSize);
+
+    static const uint32_t RECORD_MAGIC = 0x524A4C55; //ULJR
+    static const uint32_t RECORD_LAND = 0;
+    static const uint32_t RECORD_STATICS = 1;
+
+    static const uint32_t COMMIT_INTERVAL_MS = 250;
+    static const uint32_t COMMIT_SIZE = 0x10000;
+    static const uint32_t CHECKPOINT_SIZE = 0x400000;
+
+  private:
+    struct RecordHeader
+    {
+      uint32_t magic;
+      uint32_t type;
+      uint32_t blockNum;
+      uint32_t lookup;
+      uint32_t length;
+      uint32_t checksum;
+    };
+
+    void appendRecord(uint32_t type, uint32_t blockNum, uint32_t lookup, uint8_t* pData, uint32_t length);
+    static uint32_t checksum(RecordHeader& rHeader, uint8_t* pData);
+    static bool writeAt(HANDLE hFile, uint32_t offset, uint8_t* pData, uint32_t length);
+    bool replaceFile(uint8_t* pRecords, uint32_t length);
+    static DWORD WINAPI commitThreadProc(LPVOID pParam);
+
+    std::string m_journalPath;
+    HANDLE m_hFile;
+    HANDLE m_hPendingMutex;
+    HANDLE m_hCommitMutex;
+    HANDLE m_hCommitEvent;
+    HANDLE m_hStopEvent;
+    HANDLE m_hCommitThread;
+    volatile LONG m_commitsHeld;
+    std::vector<uint8_t> m_pending;
+    uint32_t m_committedSize;
+    uint64_t m_discardedSize;
+};
+
+#endif
@@ -0,0 +1,341 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "MappedFile.h"
+#include "MappedFileLayout.h"
+#include <cstdio>
+
+MappedFile::MappedFile()
+  : m_path(),
+  m_hFile(INVALID_HANDLE_VALUE),
+  m_hMapping(NULL),
+  m_pView(NULL),
+  m_pPool(NULL),
+  m_fileSize(0),
+  m_mappedSize(0),
+  m_copyOnWrite(false)
+{
+  //do nothing
+}
+
+MappedFile::MappedFile(ReservedPool* pPool)
+  : m_path(),
+  m_hFile(INVALID_HANDLE_VALUE),
+  m_hMapping(NULL),
+  m_pView(NULL),
+  m_pPool(pPool),
+  m_fileSize(0),
+  m_mappedSize(0),
+  m_copyOnWrite(false)
+{
+  //do nothing
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+/* Opens and maps a file, growing it to minimumSize bytes if it is smaller than that.  Returns false if the file could
+ * not be mapped, in which case the pool is left as a private allocation.
+ */
+bool MappedFile::open(std::string path, uint32_t minimumSize)
+{
+  return open(path, minimumSize, false);
+}
+
+/* Opens and maps a file, copy-on-write if asked to.  A copy-on-write file is never grown, minimumSize only applies to
+ * files that are mapped for writing.
+ */
+bool MappedFile::open(std::string path, uint32_t minimumSize, bool copyOnWrite)
+{
+  return open(path, minimumSize, copyOnWrite, INVALID_HANDLE_VALUE, NULL);
+}
+
+/* Maps a file that is already open, through hMapping if that section covers it.  hFile needs read and write access. 
+ * The MappedFile owns both handles from here on, whether or not the file could be mapped.
+ */
+bool MappedFile::open(std::string path, uint32_t minimumSize, bool copyOnWrite, HANDLE hFile, HANDLE hMapping)
+{
+  bool poolReleased = false;
+  bool mapped = false;
+
+  if (m_pPool != NULL)
+  {
+    m_pPool->beginRemap();
+  }
+
+  if (isOpen())
+  {
+    //switching files, the pool address range is already ours
+    unmapView();
+    CloseHandle(m_hFile);
+    m_hFile = INVALID_HANDLE_VALUE;
+    poolReleased = true;
+  }
+
+  m_path = path;
+  m_copyOnWrite = copyOnWrite;
+  if (hFile != INVALID_HANDLE_VALUE)
+  {
+    m_hFile = hFile;
+  }
+  else if (copyOnWrite)
+  {
+    m_hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  }
+  else
+  {
+    m_hFile = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  }
+
+  if (m_hFile != INVALID_HANDLE_VALUE)
+  {
+    m_fileSize = GetFileSize(m_hFile, NULL);
+    uint32_t sizeToMap = MappedFileLayout::getSizeToMap(m_fileSize, minimumSize, copyOnWrite);
+
+    //a section over the file as it is can't be mapped past its end
+    if (hMapping != NULL && MappedFileLayout::growsFile(sizeToMap, m_fileSize))
+    {
+      CloseHandle(hMapping);
+      hMapping = NULL;
+    }
+
+    if (MappedFileLayout::fitsPool(sizeToMap, m_pPool != NULL ? m_pPool->getSize() : MappedFileLayout::NO_POOL))
+    {
+      //the room the file is grown by only takes up disk space once something is written into it
+      if (MappedFileLayout::growsFile(sizeToMap, m_fileSize))
+      {
+        DWORD bytesReturned = 0;
+        DeviceIoControl(m_hFile, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &bytesReturned, NULL);
+      }
+
+      if (m_pPool != NULL && !poolReleased)
+      {
+        //Windows will not place a view inside of an existing allocation, so the pool address range is free until
+        //the view is mapped
+        m_pPool->release();
+        poolReleased = true;
+      }
+
+      mapped = mapView(sizeToMap, hMapping);
+      hMapping = NULL;
+    }
+
+    if (!mapped)
+    {
+      CloseHandle(m_hFile);
+      m_hFile = INVALID_HANDLE_VALUE;
+    }
+  }
+
+  if (hMapping != NULL)
+  {
+    CloseHandle(hMapping);
+  }
+
+#ifdef DEBUG
+  if (mapped)
+  {
+    printf("Mapped %s at 0x%x (%u bytes)\n", path.c_str(), m_pView, m_mappedSize);
+  }
+  else
+  {
+    printf("Unable to map %s (%i)\n", path.c_str(), GetLastError());
+  }
+#endif
+
+  if (!mapped && poolReleased)
+  {
+    restorePool();
+  }
+
+  if (m_pPool != NULL)
+  {
+    m_pPool->endRemap();
+  }
+
+  return mapped;
+}
+
+/* Writes the view through to the disk, returns false if some of it may not have made it */
+bool MappedFile::flush()
+{
+  //the pages of a copy-on-write view are private, there is nothing of theirs to write back
+  if (m_pView == NULL || m_copyOnWrite)
+  {
+    return true;
+  }
+
+  bool flushed = FlushViewOfFile(m_pView, 0) != FALSE;
+  return FlushFileBuffers(m_hFile) != FALSE && flushed;
+}
+
+void MappedFile::close()
+{
+  if (!isOpen())
+  {
+    return;
+  }
+
+  flush();
+
+  if (m_pPool != NULL)
+  {
+    m_pPool->beginRemap();
+  }
+
+  unmapView();
+  CloseHandle(m_hFile);
+  m_hFile = INVALID_HANDLE_VALUE;
+  restorePool();
+
+  if (m_pPool != NULL)
+  {
+    m_pPool->endRemap();
+  }
+}
+
+/* Closes the file and truncates it to finalFileSize bytes, discarding the room that was mapped past the end of the
+ * data.
+ */
+void MappedFile::close(uint32_t finalFileSize)
+{
+  if (!isOpen())
+  {
+    return;
+  }
+
+  flush();
+
+  if (m_pPool != NULL)
+  {
+    m_pPool->beginRemap();
+  }
+
+  unmapView();
+
+  if (!m_copyOnWrite && GetFileSize(m_hFile, NULL) > finalFileSize)
+  {
+    SetFilePointer(m_hFile, finalFileSize, NULL, FILE_BEGIN);
+    SetEndOfFile(m_hFile);
+  }
+
+  CloseHandle(m_hFile);
+  m_hFile = INVALID_HANDLE_VALUE;
+  restorePool();
+
+  if (m_pPool != NULL)
+  {
+    m_pPool->endRemap();
+  }
+}
+
+bool MappedFile::isOpen()
+{
+  return m_hFile != INVALID_HANDLE_VALUE && m_pView != NULL;
+}
+
+bool MappedFile::isCopyOnWrite()
+{
+  return m_copyOnWrite;
+}
+
+uint8_t* MappedFile::getView()
+{
+  return m_pView;
+}
+
+//size of the file on disk at the time it was opened
+uint32_t MappedFile::getFileSize()
+{
+  return m_fileSize;
+}
+
+uint32_t MappedFile::getMappedSize()
+{
+  return m_mappedSize;
+}
+
+/* Maps size bytes of the file, through hMapping if it is not NULL.  The section is closed if the view can't be mapped. */
+bool MappedFile::mapView(uint32_t size, HANDLE hMapping)
+{
+  m_hMapping = hMapping != NULL ? hMapping : CreateFileMappingA(m_hFile, NULL, m_copyOnWrite ? PAGE_WRITECOPY : PAGE_READWRITE, 0, size, NULL);
+  if (m_hMapping == NULL)
+  {
+    return false;
+  }
+
+  m_pView = reinterpret_cast<uint8_t*>(MapViewOfFileEx(m_hMapping, m_copyOnWrite ? FILE_MAP_COPY : FILE_MAP_ALL_ACCESS, 0, 0, size, m_pPool != NULL ? m_pPool->getAddress() : NULL));
+  if (m_pView == NULL)
+  {
+    CloseHandle(m_hMapping);
+    m_hMapping = NULL;
+    return false;
+  }
+
+  m_mappedSize = size;
+
+  if (m_pPool != NULL)
+  {
+    //keep the rest of the pool reserved so nothing else gets allocated where the view needs to grow into
+    uint32_t tailOffset = MappedFileLayout::getTailOffset(size, m_pPool->getSize(), ReservedPool::RESERVATION_GRANULARITY);
+    if (tailOffset != 0)
+    {
+      m_pPool->reserveTail(tailOffset);
+    }
+  }
+
+  return true;
+}
+
+void MappedFile::unmapView()
+{
+  if (m_pView != NULL)
+  {
+    UnmapViewOfFile(m_pView);
+    m_pView = NULL;
+  }
+
+  if (m_hMapping != NULL)
+  {
+    CloseHandle(m_hMapping);
+    m_hMapping = NULL;
+  }
+
+  if (m_pPool != NULL)
+  {
+    //the view is gone, this only frees the tail
+    m_pPool->release();
+  }
+
+  m_mappedSize = 0;
+}
+
+void MappedFile::restorePool()
+{
+  if (m_pPool != NULL)
+  {
+    m_pPool->reserve();
+  }
+}
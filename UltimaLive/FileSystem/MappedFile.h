@@ -0,0 +1,94 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _MAPPED_FILE_H
+#define _MAPPED_FILE_H
+
+#include <string>
+#include <stdint.h>
+#include <Windows.h>
+#include "ReservedPool.h"
+
+/* A shard cache file (map#.mul, staidx#.mul, statics#.mul) mapped straight into the address range of one of the
+ * file manager's memory pools.
+ *
+ * The client holds on to the pool pointers that OnMapViewOfFile handed it at startup, so a pool can never move.
+ * Opening a file releases the reservation behind the pool and maps a view of the file at the same base address;
+ * closing it reserves the range again, with nothing committed.  Whatever the client and UltimaLive write into the pool ends
+ * up in the file without being read into memory or written back out through a stream first.
+ *
+ * A view is never moved or remapped while its file is open.  A file that has to grow, like the statics, is opened with
+ * a minimumSize that covers all of the room it may grow into.  The file is made sparse before it is extended, so the 
+ * room costs no disk space, and it is cut back to the end of its data when it is closed.
+ *
+ * Windows will not place a view inside of a reservation, so the pool range is free for a moment while a file is 
+ * opened or closed.  The pool is marked as being remapped for that moment and a client thread that touches it waits 
+ * in the pool's exception handler until the range is usable again.  Nothing keeps another thread from allocating
+ * memory in the range during that moment, in which case the view can't be mapped there and the pool is lost.  
+ * Placeholders would hold the range across the remap, but a view has to fill its placeholder exactly and placeholders
+ * are split at the allocation granularity, which the shard files are not sized to.
+ *
+ * A file can also be opened copy-on-write.  Writes into such a view stay in private pages and never reach the file,
+ * which is how the blank blocks of a blank map are filled in without dirtying the sparse file behind them.  Real 
+ * changes have to be written to the file separately, the file is shared for writing so a stream can do so.
+ *
+ * A file can also be opened from a file and section that are already open, like the ones a resident map kept.  The
+ * section is mapped as long as it covers the size the file is mapped at, otherwise a new one is made.
+ *
+ * A MappedFile constructed without a pool simply maps the file wherever Windows puts it.
+ */
+class MappedFile
+{
+  public:
+    MappedFile();
+    MappedFile(ReservedPool* pPool);
+    ~MappedFile();
+
+    bool open(std::string path, uint32_t minimumSize);
+    bool open(std::string path, uint32_t minimumSize, bool copyOnWrite);
+    bool open(std::string path, uint32_t minimumSize, bool copyOnWrite, HANDLE hFile, HANDLE hMapping);
+    bool flush();
+    void close();
+    void close(uint32_t finalFileSize);
+    bool isOpen();
+    bool isCopyOnWrite();
+
+    uint8_t* getView();
+    uint32_t getFileSize();
+    uint32_t getMappedSize();
+
+  private:
+    bool mapView(uint32_t size, HANDLE hMapping);
+    void unmapView();
+    void restorePool();
+
+    std::string m_path;
+    HANDLE m_hFile;
+    HANDLE m_hMapping;
+    uint8_t* m_pView;
+    ReservedPool* m_pPool;
+    uint32_t m_fileSize;
+    uint32_t m_mappedSize;
+    bool m_copyOnWrite;
+};
+
+#endif
@@ -0,0 +1,54 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "MappedFileLayout.h"
+
+/* A file is mapped at minimumSize if it is smaller than that, so there is room to write past its end, unless it is 
+ * mapped copy-on-write, which never grows the file
+ */
+uint32_t MappedFileLayout::getSizeToMap(uint32_t fileSize, uint32_t minimumSize, bool copyOnWrite)
+{
+  return (fileSize > minimumSize || copyOnWrite) ? fileSize : minimumSize;
+}
+
+/* An empty view can't be mapped, and a view has to fit in the pool it goes into unless there is no pool */
+bool MappedFileLayout::fitsPool(uint32_t sizeToMap, uint32_t poolSize)
+{
+  return sizeToMap > 0 && (poolSize == NO_POOL || sizeToMap <= poolSize);
+}
+
+//the section behind the view makes the file this large
+bool MappedFileLayout::growsFile(uint32_t sizeToMap, uint32_t fileSize)
+{
+  return sizeToMap > fileSize;
+}
+
+/* The offset in the pool of the first reservation after a view of mappedSize bytes, or 0 if the view leaves no room 
+ * after it.  The view takes up whole units of the allocation granularity.
+ */
+uint32_t MappedFileLayout::getTailOffset(uint32_t mappedSize, uint32_t poolSize, uint32_t granularity)
+{
+  uint32_t viewSpan = static_cast<uint32_t>((static_cast<uint64_t>(mappedSize) + granularity - 1) & ~static_cast<uint64_t>(granularity - 1));
+  return viewSpan < poolSize ? viewSpan : 0;
+}
@@ -0,0 +1,45 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#ifndef _MAPPED_FILE_LAYOUT_H
+#define _MAPPED_FILE_LAYOUT_H
+
+#include <stdint.h>
+
+/* Works out how MappedFile lays a file out in a pool: how much of it is mapped, whether that fits the pool, whether 
+ * the file has to grow for it and where the part of the pool after the view starts.  Kept apart from MappedFile so
+ * that it builds without Windows.
+ */
+class MappedFileLayout
+{
+  public:
+    static uint32_t getSizeToMap(uint32_t fileSize, uint32_t minimumSize, bool copyOnWrite);
+    static bool fitsPool(uint32_t sizeToMap, uint32_t poolSize);
+    static bool growsFile(uint32_t sizeToMap, uint32_t fileSize);
+    static uint32_t getTailOffset(uint32_t mappedSize, uint32_t poolSize, uint32_t granularity);
+
+    static const uint32_t NO_POOL = 0;
+};
+
+#endif
@@ -0,0 +1,171 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "MaterializedBlockMap.h"
+#include <fstream>
+#include <cstdio>
+
+MaterializedBlockMap::MaterializedBlockMap()
+  : m_path(),
+  m_bits(),
+  m_numberOfBlocks(0),
+  m_loaded(false),
+  m_dirty(false)
+{
+  //do nothing
+}
+
+/* Writes a sidecar with no blocks marked */
+bool MaterializedBlockMap::create(std::string path, uint32_t numberOfBlocks)
+{
+  close();
+
+  m_path = path;
+  m_numberOfBlocks = numberOfBlocks;
+  m_bits.assign((numberOfBlocks + 7) / 8, 0);
+  m_loaded = true;
+  m_dirty = true;
+  save();
+
+  bool created = !m_dirty;
+  close();
+  return created;
+}
+
+bool MaterializedBlockMap::load(std::string path)
+{
+  close();
+
+  std::ifstream sidecar(path, std::ios::binary | std::ios::in);
+  if (!sidecar.is_open())
+  {
+    return false;
+  }
+
+  uint32_t header[2] = { 0, 0 };
+  sidecar.read(reinterpret_cast<char*>(header), sizeof(header));
+
+  if (sidecar.good() && header[0] == SIDECAR_MAGIC)
+  {
+    m_bits.assign((header[1] + 7) / 8, 0);
+    if (!m_bits.empty())
+    {
+      sidecar.read(reinterpret_cast<char*>(&m_bits[0]), m_bits.size());
+    }
+
+    if (sidecar.good())
+    {
+      m_path = path;
+      m_numberOfBlocks = header[1];
+      m_loaded = true;
+    }
+  }
+
+  sidecar.close();
+
+#ifdef DEBUG
+  if (m_loaded)
+  {
+    printf("Blank map %s: %u of %u blocks written\n", path.c_str(), getNumberOfMaterializedBlocks(), m_numberOfBlocks);
+  }
+#endif
+
+  return m_loaded;
+}
+
+/* Writes the bitmap out if any blocks were marked since it was last saved */
+void MaterializedBlockMap::save()
+{
+  if (!m_loaded || !m_dirty)
+  {
+    return;
+  }
+
+  std::ofstream sidecar(m_path, std::ios::binary | std::ios::out | std::ios::trunc);
+  if (sidecar.is_open())
+  {
+    uint32_t header[2] = { SIDECAR_MAGIC, m_numberOfBlocks };
+    sidecar.write(reinterpret_cast<const char*>(header), sizeof(header));
+    if (!m_bits.empty())
+    {
+      sidecar.write(reinterpret_cast<const char*>(&m_bits[0]), m_bits.size());
+    }
+    sidecar.flush();
+    m_dirty = !sidecar.good();
+    sidecar.close();
+  }
+}
+
+void MaterializedBlockMap::close()
+{
+  save();
+  m_path = "";
+  m_bits.clear();
+  m_numberOfBlocks = 0;
+  m_loaded = false;
+  m_dirty = false;
+}
+
+bool MaterializedBlockMap::isLoaded()
+{
+  return m_loaded;
+}
+
+/* Blocks outside of the bitmap, and every block of a map without a sidecar, hold real data */
+bool MaterializedBlockMap::isMaterialized(uint32_t blockNum)
+{
+  if (!m_loaded || blockNum >= m_numberOfBlocks)
+  {
+    return true;
+  }
+
+  return (m_bits[blockNum >> 3] & (1 << (blockNum & 7))) != 0;
+}
+
+void MaterializedBlockMap::markMaterialized(uint32_t blockNum)
+{
+  if (!isMaterialized(blockNum))
+  {
+    m_bits[blockNum >> 3] |= static_cast<uint8_t>(1 << (blockNum & 7));
+    m_dirty = true;
+  }
+}
+
+uint32_t MaterializedBlockMap::getNumberOfBlocks()
+{
+  return m_numberOfBlocks;
+}
+
+uint32_t MaterializedBlockMap::getNumberOfMaterializedBlocks()
+{
+  uint32_t count = 0;
+  for (uint32_t blockNum = 0; blockNum < m_numberOfBlocks; blockNum++)
+  {
+    if (isMaterialized(blockNum))
+    {
+      count++;
+    }
+  }
+
+  return count;
+}
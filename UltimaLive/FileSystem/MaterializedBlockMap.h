@@ -0,0 +1,67 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _MATERIALIZED_BLOCK_MAP_H
+#define _MATERIALIZED_BLOCK_MAP_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/* Remembers which land blocks of a blank map have been written since the map was created.
+ *
+ * A blank map file is created sparse and is never filled in, so every block that has not been written reads back as
+ * zeros.  The bitmap is kept in a sidecar file next to the map file and marks the blocks that hold real data, 
+ * everything else is served as the blank land block when the map is loaded.  Maps that were copied from the client 
+ * have no sidecar and every block counts as written.
+ *
+ * The sidecar is saved at every checkpoint, before the journal that covers the writes is emptied, so a block is 
+ * always either marked or still in the journal.
+ */
+class MaterializedBlockMap
+{
+  public:
+    MaterializedBlockMap();
+
+    bool create(std::string path, uint32_t numberOfBlocks);
+    bool load(std::string path);
+    void save();
+    void close();
+    bool isLoaded();
+
+    bool isMaterialized(uint32_t blockNum);
+    void markMaterialized(uint32_t blockNum);
+    uint32_t getNumberOfBlocks();
+    uint32_t getNumberOfMaterializedBlocks();
+
+    static const uint32_t SIDECAR_MAGIC = 0x4B424C55; //ULBK
+
+  private:
+    std::string m_path;
+    std::vector<uint8_t> m_bits;
+    uint32_t m_numberOfBlocks;
+    bool m_loaded;
+    bool m_dirty;
+};
+
+#endif
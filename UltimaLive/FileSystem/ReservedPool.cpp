@@ -0,0 +1,356 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "ReservedPool.h"
+#include <cstdio>
+
+std::vector<ReservedPool*> ReservedPool::s_pools;
+PVOID ReservedPool::s_pExceptionHandler = NULL;
+uint32_t ReservedPool::s_committedBytes = 0;
+uint32_t ReservedPool::s_peakCommittedBytes = 0;
+
+ReservedPool::ReservedPool(uint32_t size)
+  : m_pAddress(NULL),
+  m_size((size + RESERVATION_GRANULARITY - 1) & ~(RESERVATION_GRANULARITY - 1)),
+  m_committedSize(0),
+  m_regionStarts(),
+  m_tailOffset(0),
+  m_reserved(false),
+  m_hMutex(CreateMutex(NULL, false, NULL))
+{
+  if (s_pExceptionHandler == NULL)
+  {
+    s_pExceptionHandler = AddVectoredExceptionHandler(1, onException);
+  }
+
+  s_pools.push_back(this);
+
+  m_pAddress = reinterpret_cast<uint8_t*>(VirtualAlloc(NULL, m_size, MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+  if (m_pAddress != NULL)
+  {
+    m_regionStarts.push_back(0);
+    m_reserved = true;
+  }
+#ifdef DEBUG
+  else
+  {
+    printf("Unable to reserve %u bytes for a pool (%i)\n", m_size, GetLastError());
+  }
+#endif
+}
+
+ReservedPool::~ReservedPool()
+{
+  for (std::vector<ReservedPool*>::iterator itr = s_pools.begin(); itr != s_pools.end(); itr++)
+  {
+    if (*itr == this)
+    {
+      s_pools.erase(itr);
+      break;
+    }
+  }
+
+  release();
+  CloseHandle(m_hMutex);
+}
+
+uint8_t* ReservedPool::getAddress()
+{
+  return m_pAddress;
+}
+
+uint32_t ReservedPool::getSize()
+{
+  return m_size;
+}
+
+uint32_t ReservedPool::getCommittedSize()
+{
+  return m_committedSize;
+}
+
+/* Makes sure that the first size bytes of the pool are backed by memory.  Memory is committed a chunk at a time so 
+ * that appending to the end of the data does not commit page by page.  While only the tail is reserved, the memory
+ * before it is a view and only the tail part of the range is committed.
+ */
+bool ReservedPool::commit(uint32_t size)
+{
+  if (!m_reserved || size > m_size || size <= m_tailOffset)
+  {
+    return false;
+  }
+
+  if (size <= m_committedSize)
+  {
+    return true;
+  }
+
+  WaitForSingleObject(m_hMutex, INFINITE);
+
+  uint32_t newCommittedSize = (size + COMMIT_CHUNK_SIZE - 1) & ~(COMMIT_CHUNK_SIZE - 1);
+  if (newCommittedSize > m_size)
+  {
+    newCommittedSize = m_size;
+  }
+
+  //a single commit cannot span more than one reservation, so the range is split wherever the pool was extended
+  uint32_t offset = m_committedSize > m_tailOffset ? m_committedSize : m_tailOffset;
+  for (uint32_t i = 0; i < m_regionStarts.size() && offset < newCommittedSize; i++)
+  {
+    uint32_t regionEnd = getRegionEnd(i);
+    if (offset >= regionEnd)
+    {
+      continue;
+    }
+
+    uint32_t end = newCommittedSize < regionEnd ? newCommittedSize : regionEnd;
+    if (VirtualAlloc(m_pAddress + offset, end - offset, MEM_COMMIT, PAGE_EXECUTE_READWRITE) == NULL)
+    {
+#ifdef DEBUG
+      printf("Unable to commit 0x%x-0x%x of pool 0x%x (%i)\n", offset, end, m_pAddress, GetLastError());
+#endif
+      if (offset > m_committedSize)
+      {
+        setCommittedSize(offset);
+      }
+
+      ReleaseMutex(m_hMutex);
+      return offset >= size;
+    }
+
+    offset = end;
+  }
+
+  if (newCommittedSize > m_committedSize)
+  {
+    setCommittedSize(newCommittedSize);
+  }
+
+  ReleaseMutex(m_hMutex);
+  return true;
+}
+
+/* Gives all of the memory behind the pool back while keeping the address range */
+void ReservedPool::decommit()
+{
+  WaitForSingleObject(m_hMutex, INFINITE);
+
+  if (m_reserved && m_committedSize > 0)
+  {
+    for (uint32_t i = 0; i < m_regionStarts.size(); i++)
+    {
+      uint32_t regionEnd = getRegionEnd(i);
+      if (m_regionStarts[i] < m_committedSize)
+      {
+        uint32_t end = m_committedSize < regionEnd ? m_committedSize : regionEnd;
+        VirtualFree(m_pAddress + m_regionStarts[i], end - m_regionStarts[i], MEM_DECOMMIT);
+      }
+    }
+  }
+
+  setCommittedSize(0);
+  ReleaseMutex(m_hMutex);
+}
+
+/* Grows the reservation to at least size bytes without moving it.  Fails if anything else lives right after the
+ * pool, in which case the pool keeps its current size.
+ */
+bool ReservedPool::extend(uint32_t size)
+{
+  size = (size + RESERVATION_GRANULARITY - 1) & ~(RESERVATION_GRANULARITY - 1);
+  if (size <= m_size)
+  {
+    return true;
+  }
+
+  if (m_pAddress == NULL)
+  {
+    return false;
+  }
+
+  //while a view covers the start of the pool only the part after it is ours, but the extension can still be claimed
+  if (VirtualAlloc(m_pAddress + m_size, size - m_size, MEM_RESERVE, PAGE_EXECUTE_READWRITE) == NULL)
+  {
+#ifdef DEBUG
+    printf("Unable to extend pool 0x%x from %u to %u bytes (%i)\n", m_pAddress, m_size, size, GetLastError());
+#endif
+    return false;
+  }
+
+  m_regionStarts.push_back(m_size);
+
+#ifdef DEBUG
+  printf("Extended pool 0x%x from %u to %u bytes\n", m_pAddress, m_size, size);
+#endif
+
+  m_size = size;
+  return true;
+}
+
+/* Frees every part of the address range that the pool holds */
+void ReservedPool::release()
+{
+  for (uint32_t i = 0; i < m_regionStarts.size(); i++)
+  {
+    VirtualFree(m_pAddress + m_regionStarts[i], 0, MEM_RELEASE);
+  }
+
+  m_regionStarts.clear();
+  m_reserved = false;
+  setCommittedSize(0);
+  m_tailOffset = 0;
+}
+
+/* Takes the whole address range back, with nothing committed */
+bool ReservedPool::reserve()
+{
+  if (m_reserved && m_tailOffset == 0)
+  {
+    return true;
+  }
+
+  release();
+
+  if (m_pAddress == NULL || VirtualAlloc(m_pAddress, m_size, MEM_RESERVE, PAGE_EXECUTE_READWRITE) != m_pAddress)
+  {
+#ifdef DEBUG
+    printf("Unable to reserve pool at 0x%x (%i)\n", m_pAddress, GetLastError());
+#endif
+    return false;
+  }
+
+  m_regionStarts.push_back(0);
+  m_reserved = true;
+  return true;
+}
+
+/* Reserves the part of a released pool from offset on, so nothing else gets allocated where a view needs to grow 
+ * into.  Pages of the tail that are touched get committed like those of a reserved pool.  Offset has to be a multiple
+ * of RESERVATION_GRANULARITY.
+ */
+bool ReservedPool::reserveTail(uint32_t offset)
+{
+  if (m_reserved || m_pAddress == NULL || offset >= m_size)
+  {
+    return false;
+  }
+
+  if (VirtualAlloc(m_pAddress + offset, m_size - offset, MEM_RESERVE, PAGE_EXECUTE_READWRITE) == NULL)
+  {
+    return false;
+  }
+
+  m_regionStarts.push_back(offset);
+  m_tailOffset = offset;
+  m_reserved = true;
+  return true;
+}
+
+/* Holds the pool while a file is mapped into or out of its range, the exception handler waits for it before it 
+ * looks at a page that was touched in the meantime.
+ */
+void ReservedPool::beginRemap()
+{
+  WaitForSingleObject(m_hMutex, INFINITE);
+}
+
+void ReservedPool::endRemap()
+{
+  ReleaseMutex(m_hMutex);
+}
+
+/* Memory committed across all pools */
+uint32_t ReservedPool::getCommittedBytes()
+{
+  return s_committedBytes;
+}
+
+/* Most memory that was committed across all pools at any one time this session */
+uint32_t ReservedPool::getPeakCommittedBytes()
+{
+  return s_peakCommittedBytes;
+}
+
+LONG CALLBACK ReservedPool::onException(PEXCEPTION_POINTERS pExceptionInfo)
+{
+  static const ULONG_PTR EXECUTE_ACCESS = 8;
+
+  if (pExceptionInfo->ExceptionRecord->ExceptionCode == EXCEPTION_ACCESS_VIOLATION && pExceptionInfo->ExceptionRecord->ExceptionInformation[0] != EXECUTE_ACCESS)
+  {
+    uint8_t* pAddress = reinterpret_cast<uint8_t*>(pExceptionInfo->ExceptionRecord->ExceptionInformation[1]);
+
+    for (std::vector<ReservedPool*>::iterator itr = s_pools.begin(); itr != s_pools.end(); itr++)
+    {
+      ReservedPool* pPool = *itr;
+
+      if (pAddress < pPool->m_pAddress || pAddress >= pPool->m_pAddress + pPool->m_size)
+      {
+        continue;
+      }
+
+      //a file may be being mapped into or out of the pool, which is finished once the pool is free to take
+      WaitForSingleObject(pPool->m_hMutex, INFINITE);
+      bool reserved = pPool->m_reserved;
+      ReleaseMutex(pPool->m_hMutex);
+
+      if (reserved)
+      {
+        pPool->commit((pAddress - pPool->m_pAddress) + 1);
+      }
+
+      //only retry if the page is now plain committed memory or a view, copy-on-write or not, anything else (like a page 
+      //the demand paged pool took access away from) belongs to another handler
+      MEMORY_BASIC_INFORMATION info;
+      if (VirtualQuery(pAddress, &info, sizeof(info)) != 0 && info.State == MEM_COMMIT && isWritableProtection(info.Protect))
+      {
+        return EXCEPTION_CONTINUE_EXECUTION;
+      }
+    }
+  }
+
+  return EXCEPTION_CONTINUE_SEARCH;
+}
+
+bool ReservedPool::isWritableProtection(DWORD protection)
+{
+  return protection == PAGE_EXECUTE_READWRITE || protection == PAGE_READWRITE || protection == PAGE_WRITECOPY || protection == PAGE_EXECUTE_WRITECOPY;
+}
+
+uint32_t ReservedPool::getRegionEnd(uint32_t regionIndex)
+{
+  return (regionIndex + 1 < m_regionStarts.size()) ? m_regionStarts[regionIndex + 1] : m_size;
+}
+
+void ReservedPool::setCommittedSize(uint32_t committedSize)
+{
+  //only the memory past the tail offset is committed by the pool, a view covers the rest
+  uint32_t committedBytes = m_committedSize > m_tailOffset ? m_committedSize - m_tailOffset : 0;
+  uint32_t newCommittedBytes = committedSize > m_tailOffset ? committedSize - m_tailOffset : 0;
+  s_committedBytes = s_committedBytes - committedBytes + newCommittedBytes;
+  m_committedSize = committedSize;
+
+  if (s_committedBytes > s_peakCommittedBytes)
+  {
+    s_peakCommittedBytes = s_committedBytes;
+  }
+}
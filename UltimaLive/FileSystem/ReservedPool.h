@@ -0,0 +1,92 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _RESERVED_POOL_H
+#define _RESERVED_POOL_H
+
+#include <vector>
+#include <stdint.h>
+#include <Windows.h>
+
+/* The address range behind one of the file manager's memory pools.
+ *
+ * The range is only reserved up front, memory is committed behind it in chunks as map data is read or appended.  The
+ * client holds on to the pool address from startup, long before the shard announces how large its maps are, so the
+ * range cannot move.  When a map definition needs more room the reservation is extended in place, which works as long
+ * as the address space right after the pool is still free.
+ *
+ * The client may look at a pool before anything has been loaded into it.  A vectored exception handler commits the
+ * memory behind any reserved part of a pool that is touched, so those reads see zeros just like they did when the
+ * pools were committed up front.
+ *
+ * A mapped file gives the range up for its view with release(), holds on to whatever the view does not cover with
+ * reserveTail() and takes the whole range back with reserve().  The tail is handled like the rest of a reserved pool,
+ * memory is committed behind it from the end of the view on.  It does so between beginRemap() and endRemap(), and
+ * a thread that touches the pool in the meantime waits in the exception handler until the range is usable again.
+ */
+class ReservedPool
+{
+  public:
+    ReservedPool(uint32_t size);
+    ~ReservedPool();
+
+    uint8_t* getAddress();
+    uint32_t getSize();
+    uint32_t getCommittedSize();
+
+    bool commit(uint32_t size);
+    void decommit();
+    bool extend(uint32_t size);
+    void release();
+    bool reserve();
+    bool reserveTail(uint32_t offset);
+    void beginRemap();
+    void endRemap();
+
+    static uint32_t getCommittedBytes();
+    static uint32_t getPeakCommittedBytes();
+
+    static const uint32_t COMMIT_CHUNK_SIZE = 0x100000;
+    static const uint32_t RESERVATION_GRANULARITY = 0x10000;
+
+  private:
+    void setCommittedSize(uint32_t committedSize);
+    uint32_t getRegionEnd(uint32_t regionIndex);
+    static LONG CALLBACK onException(PEXCEPTION_POINTERS pExceptionInfo);
+    static bool isWritableProtection(DWORD protection);
+
+    uint8_t* m_pAddress;
+    uint32_t m_size;
+    uint32_t m_committedSize;
+    std::vector<uint32_t> m_regionStarts;
+    uint32_t m_tailOffset;
+    bool m_reserved;
+    HANDLE m_hMutex;
+
+    static std::vector<ReservedPool*> s_pools;
+    static PVOID s_pExceptionHandler;
+    static uint32_t s_committedBytes;
+    static uint32_t s_peakCommittedBytes;
+};
+
+#endif
@@ -0,0 +1,343 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "ResidentMapCache.h"
+#include <cstdio>
+
+ResidentMapCache::ResidentMapCache(uint32_t budgetInBytes)
+  : m_maps(),
+  m_budget(budgetInBytes),
+  m_residentBytes(0),
+  m_hits(0),
+  m_misses(0),
+  m_hitTicks(0),
+  m_missTicks(0)
+{
+  //do nothing
+}
+
+ResidentMapCache::~ResidentMapCache()
+{
+  clear();
+}
+
+bool ResidentMapCache::isResident(uint8_t mapNumber)
+{
+  for (std::list<ResidentMap>::iterator itr = m_maps.begin(); itr != m_maps.end(); itr++)
+  {
+    if (itr->mapNumber == mapNumber)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/* Keeps the files of a map that was just closed in memory.  Must be called after the pools have let go of the files,
+ * a view of the statics file would keep it from being truncated when it is closed.
+ */
+void ResidentMapCache::retain(uint8_t mapNumber, std::string mapPath, std::string staidxPath, std::string staticsPath)
+{
+  release(mapNumber);
+
+  ResidentMap residentMap;
+  residentMap.mapNumber = mapNumber;
+  residentMap.size = 0;
+  residentMap.hPrefetchThread = NULL;
+  residentMap.stopPrefetch = 0;
+
+  std::string paths[NUMBER_OF_FILES] = { mapPath, staidxPath, staticsPath };
+  for (uint32_t i = 0; i < NUMBER_OF_FILES; i++)
+  {
+    residentMap.files[i].hFile = INVALID_HANDLE_VALUE;
+    residentMap.files[i].hMapping = NULL;
+    residentMap.files[i].pView = NULL;
+    residentMap.files[i].size = 0;
+
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (GetFileAttributesExA(paths[i].c_str(), GetFileExInfoStandard, &attributes))
+    {
+      residentMap.size += attributes.nFileSizeLow;
+    }
+  }
+
+  if (residentMap.size == 0 || residentMap.size > m_budget)
+  {
+#ifdef DEBUG
+    printf("Map %u (%u KB) does not fit the resident map budget\n", mapNumber, residentMap.size / 1024);
+#endif
+    return;
+  }
+
+  evictToFit(residentMap.size);
+
+  for (uint32_t i = 0; i < NUMBER_OF_FILES; i++)
+  {
+    //an empty statics file has nothing to keep
+    if (!mapFile(paths[i], residentMap.files[i]) && GetLastError() != ERROR_FILE_INVALID)
+    {
+#ifdef DEBUG
+      printf("Unable to keep %s resident (%u)\n", paths[i].c_str(), GetLastError());
+#endif
+      unmapResidentMap(residentMap);
+      return;
+    }
+  }
+
+  m_residentBytes += residentMap.size;
+  m_maps.push_front(residentMap);
+
+  //list elements stay put, so the thread can be handed the one in the list
+  ResidentMap& rResidentMap = m_maps.front();
+  rResidentMap.hPrefetchThread = CreateThread(NULL, 0, prefetchThreadProc, &rResidentMap, 0, NULL);
+
+#ifdef DEBUG
+  printf("Map %u is resident, %u KB of %u KB used\n", mapNumber, m_residentBytes / 1024, m_budget / 1024);
+#endif
+}
+
+/* Hands the open file and section of one of a resident map's FILE_ files over to the caller, who has to close them.
+ * Returns false if the map isn't resident or the file was already taken.  The cache's view of the file stays until the
+ * map is released.
+ */
+bool ResidentMapCache::takeFile(uint8_t mapNumber, uint32_t file, HANDLE& rhFile, HANDLE& rhMapping)
+{
+  for (std::list<ResidentMap>::iterator itr = m_maps.begin(); itr != m_maps.end(); itr++)
+  {
+    if (itr->mapNumber == mapNumber && file < NUMBER_OF_FILES && itr->files[file].hMapping != NULL)
+    {
+      rhFile = itr->files[file].hFile;
+      rhMapping = itr->files[file].hMapping;
+      itr->files[file].hFile = INVALID_HANDLE_VALUE;
+      itr->files[file].hMapping = NULL;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/* Lets go of a map's files once the map has been loaded into the pools */
+void ResidentMapCache::release(uint8_t mapNumber)
+{
+  for (std::list<ResidentMap>::iterator itr = m_maps.begin(); itr != m_maps.end(); itr++)
+  {
+    if (itr->mapNumber == mapNumber)
+    {
+      m_residentBytes -= itr->size;
+      unmapResidentMap(*itr);
+      m_maps.erase(itr);
+      return;
+    }
+  }
+}
+
+void ResidentMapCache::clear()
+{
+  for (std::list<ResidentMap>::iterator itr = m_maps.begin(); itr != m_maps.end(); itr++)
+  {
+    unmapResidentMap(*itr);
+  }
+
+  m_maps.clear();
+  m_residentBytes = 0;
+}
+
+void ResidentMapCache::setBudget(uint32_t budgetInBytes)
+{
+  m_budget = budgetInBytes;
+  evictToFit(0);
+}
+
+uint32_t ResidentMapCache::getBudget()
+{
+  return m_budget;
+}
+
+uint32_t ResidentMapCache::getResidentBytes()
+{
+  return m_residentBytes;
+}
+
+/* Counts a map load as a hit or a miss and adds the time it took, startTime is when the load began */
+void ResidentMapCache::recordLoad(bool resident, LARGE_INTEGER startTime)
+{
+  LARGE_INTEGER endTime;
+  QueryPerformanceCounter(&endTime);
+
+  if (resident)
+  {
+    m_hits++;
+    m_hitTicks += endTime.QuadPart - startTime.QuadPart;
+  }
+  else
+  {
+    m_misses++;
+    m_missTicks += endTime.QuadPart - startTime.QuadPart;
+  }
+
+#ifdef DEBUG
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  printf("Map switch took %.2f ms (%s)\n", ((endTime.QuadPart - startTime.QuadPart) * 1000.0) / frequency.QuadPart, resident ? "resident" : "cold");
+#endif
+}
+
+void ResidentMapCache::printStatistics()
+{
+#ifdef DEBUG
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  double hitMs = m_hits > 0 ? ((m_hitTicks * 1000.0) / frequency.QuadPart) / m_hits : 0.0;
+  double missMs = m_misses > 0 ? ((m_missTicks * 1000.0) / frequency.QuadPart) / m_misses : 0.0;
+
+  printf("Resident maps: %u hits (%.2f ms average), %u misses (%.2f ms average), %u maps in %u KB of %u KB\n", 
+    m_hits, hitMs, m_misses, missMs, static_cast<uint32_t>(m_maps.size()), m_residentBytes / 1024, m_budget / 1024);
+#endif
+}
+
+/* Opens a file with a read/write section over all of it, the section the pools map when the map is loaded again, and
+ * maps a read only view of it for the cache.  The file is shared for writing, the journal may be replayed into it 
+ * before the pools take it.
+ */
+bool ResidentMapCache::mapFile(std::string path, ResidentFile& rFile)
+{
+  rFile.hFile = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (rFile.hFile == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  rFile.size = GetFileSize(rFile.hFile, NULL);
+  if (rFile.size == 0 || rFile.size == INVALID_FILE_SIZE)
+  {
+    unmapFile(rFile);
+    SetLastError(ERROR_FILE_INVALID);
+    return false;
+  }
+
+  rFile.hMapping = CreateFileMappingA(rFile.hFile, NULL, PAGE_READWRITE, 0, 0, NULL);
+  if (rFile.hMapping != NULL)
+  {
+    rFile.pView = reinterpret_cast<uint8_t*>(MapViewOfFile(rFile.hMapping, FILE_MAP_READ, 0, 0, 0));
+  }
+
+  if (rFile.pView == NULL)
+  {
+    unmapFile(rFile);
+    return false;
+  }
+
+  return true;
+}
+
+/* Reads in whatever pages of a retained map aren't in memory yet, at background priority so that the new map's own 
+ * reads go first.  Stops early if the map is released or evicted.
+ */
+DWORD WINAPI ResidentMapCache::prefetchThreadProc(LPVOID pParam)
+{
+  ResidentMap* pMap = reinterpret_cast<ResidentMap*>(pParam);
+  SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+
+  PrefetchVirtualMemoryFunction pPrefetch = reinterpret_cast<PrefetchVirtualMemoryFunction>(GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory"));
+
+  for (uint32_t i = 0; i < NUMBER_OF_FILES && pMap->stopPrefetch == 0; i++)
+  {
+    ResidentFile& rFile = pMap->files[i];
+    if (rFile.pView == NULL)
+    {
+      continue;
+    }
+
+    MemoryRange range = { rFile.pView, rFile.size };
+    if (pPrefetch != NULL && pPrefetch(GetCurrentProcess(), 1, &range, 0))
+    {
+      continue;
+    }
+
+    volatile uint8_t sum = 0;
+    for (uint32_t offset = 0; offset < rFile.size && pMap->stopPrefetch == 0; offset += 0x1000)
+    {
+      sum += rFile.pView[offset];
+    }
+  }
+
+  SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+  return 0;
+}
+
+void ResidentMapCache::unmapFile(ResidentFile& rFile)
+{
+  if (rFile.pView != NULL)
+  {
+    UnmapViewOfFile(rFile.pView);
+    rFile.pView = NULL;
+  }
+
+  if (rFile.hMapping != NULL)
+  {
+    CloseHandle(rFile.hMapping);
+    rFile.hMapping = NULL;
+  }
+
+  if (rFile.hFile != INVALID_HANDLE_VALUE)
+  {
+    CloseHandle(rFile.hFile);
+    rFile.hFile = INVALID_HANDLE_VALUE;
+  }
+}
+
+void ResidentMapCache::unmapResidentMap(ResidentMap& rMap)
+{
+  //the views can only go once the prefetch is done reading them
+  if (rMap.hPrefetchThread != NULL)
+  {
+    InterlockedExchange(&rMap.stopPrefetch, 1);
+    WaitForSingleObject(rMap.hPrefetchThread, INFINITE);
+    CloseHandle(rMap.hPrefetchThread);
+    rMap.hPrefetchThread = NULL;
+  }
+
+  for (uint32_t i = 0; i < NUMBER_OF_FILES; i++)
+  {
+    unmapFile(rMap.files[i]);
+  }
+}
+
+/* Evicts the least recently used maps until size more bytes fit the budget */
+void ResidentMapCache::evictToFit(uint32_t size)
+{
+  while (!m_maps.empty() && m_residentBytes + size > m_budget)
+  {
+    ResidentMap& rOldest = m_maps.back();
+
+#ifdef DEBUG
+    printf("Evicting resident map %u (%u KB)\n", rOldest.mapNumber, rOldest.size / 1024);
+#endif
+
+    m_residentBytes -= rOldest.size;
+    unmapResidentMap(rOldest);
+    m_maps.pop_back();
+  }
+}
@@ -0,0 +1,115 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _RESIDENT_MAP_CACHE_H
+#define _RESIDENT_MAP_CACHE_H
+
+#include <Windows.h>
+#include <list>
+#include <string>
+#include <stdint.h>
+
+/* Keeps the files of the maps the player recently left in memory, so that going back to one of them does not have to
+ * read it from disk again.
+ *
+ * The client holds on to the pool pointers, so a map can only ever be shown by mapping its files into the pools.  
+ * What makes a switch slow is reading the data, so every map that is closed keeps its map, staidx and statics files 
+ * open with a read/write section and a read only view of each.  When the map is loaded again the pools take over the
+ * open files and sections with takeFile and map the same sections at the pool addresses, so they come up on the pages 
+ * the cache kept, without any disk reads.  Once a map is loaded its views are let go, the pools hold its pages from 
+ * then on.
+ *
+ * Most of a map that was demand paged was never read, so the pages a retained map doesn't have yet are read on a 
+ * background thread at background I/O priority, with PrefetchVirtualMemory where Windows has it.  The switch itself 
+ * never waits for the disk.
+ *
+ * Resident maps are evicted least recently used first when their files would take more than the budget.  The views 
+ * take address space from the client's process, so the budget is kept well below what the pools reserve.
+ */
+class ResidentMapCache
+{
+  public:
+    ResidentMapCache(uint32_t budgetInBytes);
+    ~ResidentMapCache();
+
+    bool isResident(uint8_t mapNumber);
+    void retain(uint8_t mapNumber, std::string mapPath, std::string staidxPath, std::string staticsPath);
+    bool takeFile(uint8_t mapNumber, uint32_t file, HANDLE& rhFile, HANDLE& rhMapping);
+    void release(uint8_t mapNumber);
+    void clear();
+
+    void setBudget(uint32_t budgetInBytes);
+    uint32_t getBudget();
+    uint32_t getResidentBytes();
+
+    void recordLoad(bool resident, LARGE_INTEGER startTime);
+    void printStatistics();
+
+    static const uint32_t DEFAULT_BUDGET = 0xC000000; //192 MB
+    static const uint32_t FILE_MAP = 0;
+    static const uint32_t FILE_STAIDX = 1;
+    static const uint32_t FILE_STATICS = 2;
+    static const uint32_t NUMBER_OF_FILES = 3;
+
+  private:
+    struct ResidentFile
+    {
+      HANDLE hFile;
+      HANDLE hMapping;
+      uint8_t* pView;
+      uint32_t size;
+    };
+
+    struct ResidentMap
+    {
+      uint8_t mapNumber;
+      ResidentFile files[NUMBER_OF_FILES];
+      uint32_t size;
+      HANDLE hPrefetchThread;
+      volatile LONG stopPrefetch;
+    };
+
+    //PrefetchVirtualMemory and its range entry, looked up at run time since Windows 7 doesn't have them
+    struct MemoryRange
+    {
+      PVOID pAddress;
+      SIZE_T numberOfBytes;
+    };
+    typedef BOOL (WINAPI *PrefetchVirtualMemoryFunction)(HANDLE hProcess, ULONG_PTR numberOfEntries, MemoryRange* pRanges, ULONG flags);
+
+    static bool mapFile(std::string path, ResidentFile& rFile);
+    static DWORD WINAPI prefetchThreadProc(LPVOID pParam);
+    static void unmapFile(ResidentFile& rFile);
+    void unmapResidentMap(ResidentMap& rMap);
+    void evictToFit(uint32_t size);
+
+    std::list<ResidentMap> m_maps; //most recently used first
+    uint32_t m_budget;
+    uint32_t m_residentBytes;
+    uint32_t m_hits;
+    uint32_t m_misses;
+    int64_t m_hitTicks;
+    int64_t m_missTicks;
+};
+
+#endif
@@ -0,0 +1,259 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "ShardImporter.h"
+#include "Uop\UopUtility.h"
+#include "..\ProgressBarDialog.h"
+
+ShardImporter::ShardImporter()
+  : m_jobs(),
+  m_totalBytes(0),
+  m_nextJob(0),
+  m_bytesImported(0)
+{
+  //do nothing
+}
+
+ShardImporter::~ShardImporter()
+{
+  //do nothing
+}
+
+void ShardImporter::addCopy(uint32_t mapNumber, std::string sourcePath, std::string destPath)
+{
+  WIN32_FILE_ATTRIBUTE_DATA attributes;
+  uint64_t size = 0;
+  if (GetFileAttributesExA(sourcePath.c_str(), GetFileExInfoStandard, &attributes))
+  {
+    size = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+  }
+
+  addJob(IMPORT_COPY, mapNumber, sourcePath, destPath, size);
+}
+
+void ShardImporter::addUopConversion(uint32_t mapNumber, std::string sourcePath, std::string destPath, uint32_t convertedSize)
+{
+  addJob(IMPORT_UOP_CONVERSION, mapNumber, sourcePath, destPath, convertedSize);
+}
+
+void ShardImporter::addJob(ImportType type, uint32_t mapNumber, std::string sourcePath, std::string destPath, uint64_t size)
+{
+  ImportJob job;
+  job.type = type;
+  job.mapNumber = mapNumber;
+  job.sourcePath = sourcePath;
+  job.destPath = destPath;
+  job.importPath = destPath + ".import";
+  job.size = size;
+  job.succeeded = false;
+  job.elapsedMs = 0;
+
+  m_jobs.push_back(job);
+  m_totalBytes += size;
+}
+
+bool ShardImporter::hasJobs()
+{
+  return !m_jobs.empty();
+}
+
+bool ShardImporter::mapSucceeded(uint32_t mapNumber)
+{
+  for (std::vector<ImportJob>::iterator itr = m_jobs.begin(); itr != m_jobs.end(); itr++)
+  {
+    if (itr->mapNumber == mapNumber && !itr->succeeded)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* Imports all queued files and waits for them to finish.  Returns true if every file was imported, maps whose files 
+ * could not all be imported are left out and can be checked with mapSucceeded().
+ */
+bool ShardImporter::run(ProgressBarDialog* pProgress)
+{
+  if (m_jobs.empty())
+  {
+    return true;
+  }
+
+  DWORD startTime = GetTickCount();
+  m_nextJob = 0;
+  m_bytesImported = 0;
+
+  uint32_t numberOfThreads = static_cast<uint32_t>(m_jobs.size());
+  if (numberOfThreads > MAX_THREADS)
+  {
+    numberOfThreads = MAX_THREADS;
+  }
+
+  HANDLE threads[MAX_THREADS];
+  uint32_t threadsStarted = 0;
+  for (uint32_t i = 0; i < numberOfThreads; i++)
+  {
+    threads[threadsStarted] = CreateThread(NULL, 0, workerThreadProc, this, 0, NULL);
+    if (threads[threadsStarted] != NULL)
+    {
+      threadsStarted++;
+    }
+  }
+
+  if (threadsStarted == 0)
+  {
+    //no threads available, import on this thread instead
+    workerThreadProc(this);
+  }
+
+  if (pProgress != NULL)
+  {
+    pProgress->setMessage("Importing map files from game client folder");
+    pProgress->setProgress(0);
+  }
+
+  uint32_t prevPercent = 0;
+  while (threadsStarted > 0 && WaitForMultipleObjects(threadsStarted, threads, TRUE, PROGRESS_INTERVAL_MS) == WAIT_TIMEOUT)
+  {
+    if (pProgress != NULL && m_totalBytes > 0)
+    {
+      uint32_t percent = static_cast<uint32_t>((static_cast<uint64_t>(m_bytesImported) * 100) / m_totalBytes);
+      if (percent > prevPercent)
+      {
+        prevPercent = percent;
+        pProgress->setProgress(percent);
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < threadsStarted; i++)
+  {
+    CloseHandle(threads[i]);
+  }
+
+  if (pProgress != NULL)
+  {
+    pProgress->setProgress(100);
+  }
+
+  commitJobs();
+
+  bool allSucceeded = true;
+  for (std::vector<ImportJob>::iterator itr = m_jobs.begin(); itr != m_jobs.end(); itr++)
+  {
+    allSucceeded = allSucceeded && itr->succeeded;
+
+#ifdef DEBUG
+    double seconds = itr->elapsedMs > 0 ? itr->elapsedMs / 1000.0 : 0.001;
+    printf("Imported %s %s in %u ms (%.1f MB/s)\n", itr->destPath.c_str(), itr->succeeded ? "ok" : "FAILED", 
+      itr->elapsedMs, (itr->size / (1024.0 * 1024.0)) / seconds);
+#endif
+  }
+
+#ifdef DEBUG
+  DWORD totalMs = GetTickCount() - startTime;
+  double totalSeconds = totalMs > 0 ? totalMs / 1000.0 : 0.001;
+  printf("Imported %u files, %llu bytes in %u ms on %u threads (%.1f MB/s)\n", static_cast<uint32_t>(m_jobs.size()), 
+    m_totalBytes, totalMs, threadsStarted, (m_totalBytes / (1024.0 * 1024.0)) / totalSeconds);
+#else
+  (void)startTime;
+#endif
+
+  return allSucceeded;
+}
+
+/* Renames the imported files into place.  The jobs of a map are queued map file first, so renaming them in reverse
+ * order puts the map file down last and it only exists once its statics are complete.
+ */
+void ShardImporter::commitJobs()
+{
+  for (std::vector<ImportJob>::reverse_iterator itr = m_jobs.rbegin(); itr != m_jobs.rend(); itr++)
+  {
+    if (mapSucceeded(itr->mapNumber))
+    {
+      if (!MoveFileExA(itr->importPath.c_str(), itr->destPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+      {
+#ifdef DEBUG
+        printf("Could not move %s into place: %u\n", itr->importPath.c_str(), GetLastError());
+#endif
+        itr->succeeded = false;
+        DeleteFileA(itr->importPath.c_str());
+      }
+    }
+    else
+    {
+      DeleteFileA(itr->importPath.c_str());
+    }
+  }
+}
+
+void ShardImporter::runJob(ImportJob& rJob)
+{
+  DWORD startTime = GetTickCount();
+
+  if (rJob.type == IMPORT_COPY)
+  {
+    CopyProgress progress;
+    progress.pBytesImported = &m_bytesImported;
+    progress.bytesReported = 0;
+
+    rJob.succeeded = CopyFileExA(rJob.sourcePath.c_str(), rJob.importPath.c_str(), copyProgressRoutine, &progress, NULL, COPY_FILE_NO_BUFFERING) != FALSE;
+  }
+  else
+  {
+    rJob.succeeded = UopUtility::convertUopMapToMul(rJob.sourcePath, rJob.importPath, &m_bytesImported);
+  }
+
+  rJob.elapsedMs = GetTickCount() - startTime;
+}
+
+DWORD WINAPI ShardImporter::workerThreadProc(LPVOID pParam)
+{
+  ShardImporter* pImporter = reinterpret_cast<ShardImporter*>(pParam);
+
+  LONG jobIndex = InterlockedIncrement(&pImporter->m_nextJob) - 1;
+  while (jobIndex < static_cast<LONG>(pImporter->m_jobs.size()))
+  {
+    pImporter->runJob(pImporter->m_jobs[jobIndex]);
+    jobIndex = InterlockedIncrement(&pImporter->m_nextJob) - 1;
+  }
+
+  return 0;
+}
+
+DWORD CALLBACK ShardImporter::copyProgressRoutine(LARGE_INTEGER totalFileSize, LARGE_INTEGER totalBytesTransferred, 
+  LARGE_INTEGER streamSize, LARGE_INTEGER streamBytesTransferred, DWORD streamNumber, DWORD callbackReason, 
+  HANDLE hSourceFile, HANDLE hDestinationFile, LPVOID pData)
+{
+  CopyProgress* pProgress = reinterpret_cast<CopyProgress*>(pData);
+  uint64_t transferred = static_cast<uint64_t>(totalBytesTransferred.QuadPart);
+
+  if (transferred > pProgress->bytesReported)
+  {
+    InterlockedExchangeAdd(pProgress->pBytesImported, static_cast<LONG>(transferred - pProgress->bytesReported));
+    pProgress->bytesReported = transferred;
+  }
+
+  return PROGRESS_CONTINUE;
+}
@@ -0,0 +1,99 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _SHARD_IMPORTER_H
+#define _SHARD_IMPORTER_H
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class ProgressBarDialog;
+
+/* Imports the map, statics and staidx files of a shard from the game client folder.
+ *
+ * All queued files are imported at the same time on a few worker threads.  Plain copies go through CopyFileEx, which
+ * lets the system use unbuffered large transfers or copy offload, and uop maps are converted by UopUtility.  Each file 
+ * is written next to its destination with an .import extension and the files of a map are only renamed into place 
+ * once all of them were imported, the map file last, so an interrupted import never leaves a map file that looks
+ * complete.
+ *
+ * Progress is shown from the thread that calls run(), the workers only count the bytes they have written.
+ */
+class ShardImporter
+{
+  public:
+    ShardImporter();
+    ~ShardImporter();
+
+    void addCopy(uint32_t mapNumber, std::string sourcePath, std::string destPath);
+    void addUopConversion(uint32_t mapNumber, std::string sourcePath, std::string destPath, uint32_t convertedSize);
+    bool run(ProgressBarDialog* pProgress);
+    bool mapSucceeded(uint32_t mapNumber);
+    bool hasJobs();
+
+    static const uint32_t MAX_THREADS = 4;
+    static const uint32_t PROGRESS_INTERVAL_MS = 100;
+
+  private:
+    enum ImportType
+    {
+      IMPORT_COPY,
+      IMPORT_UOP_CONVERSION
+    };
+
+    struct ImportJob
+    {
+      ImportType type;
+      uint32_t mapNumber;
+      std::string sourcePath;
+      std::string destPath;
+      std::string importPath;
+      uint64_t size;
+      bool succeeded;
+      uint32_t elapsedMs;
+    };
+
+    struct CopyProgress
+    {
+      volatile LONG* pBytesImported;
+      uint64_t bytesReported;
+    };
+
+    void addJob(ImportType type, uint32_t mapNumber, std::string sourcePath, std::string destPath, uint64_t size);
+    void runJob(ImportJob& rJob);
+    void commitJobs();
+
+    static DWORD WINAPI workerThreadProc(LPVOID pParam);
+    static DWORD CALLBACK copyProgressRoutine(LARGE_INTEGER totalFileSize, LARGE_INTEGER totalBytesTransferred, 
+      LARGE_INTEGER streamSize, LARGE_INTEGER streamBytesTransferred, DWORD streamNumber, DWORD callbackReason, 
+      HANDLE hSourceFile, HANDLE hDestinationFile, LPVOID pData);
+
+    std::vector<ImportJob> m_jobs;
+    uint64_t m_totalBytes;
+    volatile LONG m_nextJob;
+    volatile LONG m_bytesImported;
+};
+
+#endif
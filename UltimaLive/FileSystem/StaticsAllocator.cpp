@@ -0,0 +1,452 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "StaticsAllocator.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+StaticsAllocator::StaticsAllocator()
+  : m_largeExtents(),
+  m_freeBytes(0),
+  m_sharedLookups(),
+  m_compacting(false),
+  m_compactionOrder(),
+  m_compactionPosition(0),
+  m_compactionCursor(0),
+  m_compactionEnd(0),
+  m_lastMoveFrom(INVALID_LOOKUP),
+  m_lastMoveTo(INVALID_LOOKUP)
+{
+  //do nothing
+}
+
+void StaticsAllocator::reset()
+{
+  clearFreeLists();
+  m_sharedLookups.clear();
+  m_compacting = false;
+  m_compactionOrder.clear();
+}
+
+void StaticsAllocator::clearFreeLists()
+{
+  for (uint32_t i = 0; i <= NUM_SIZE_CLASSES; i++)
+  {
+    m_sizeClasses[i].clear();
+  }
+
+  m_largeExtents.clear();
+  m_freeBytes = 0;
+}
+
+/* Loads the free lists that were saved when the map was last closed, as long as the statics file is still the size it
+ * was then.  The sidecar is removed either way so that it can never be applied to a statics file that has changed 
+ * since.
+ */
+bool StaticsAllocator::load(std::string path, uint32_t staticsSize)
+{
+  reset();
+
+  std::ifstream sidecar(path, std::ios::binary | std::ios::in);
+  if (!sidecar.is_open())
+  {
+    return false;
+  }
+
+  uint32_t header[3] = { 0, 0, 0 };
+  sidecar.read(reinterpret_cast<char*>(header), sizeof(header));
+
+  bool loaded = false;
+  if (sidecar.good() && header[0] == SIDECAR_MAGIC && header[1] == staticsSize)
+  {
+    for (uint32_t i = 0; i < header[2]; i++)
+    {
+      Extent extent;
+      sidecar.read(reinterpret_cast<char*>(&extent), sizeof(Extent));
+      if (!sidecar.good())
+      {
+        break;
+      }
+
+      if (extent.lookup < staticsSize && extent.length <= staticsSize - extent.lookup)
+      {
+        addExtent(extent.lookup, extent.length);
+      }
+    }
+    loaded = true;
+  }
+
+  sidecar.close();
+  remove(path.c_str());
+
+#ifdef DEBUG
+  printf("Loaded statics free lists: %u bytes free\n", m_freeBytes);
+#endif
+
+  return loaded;
+}
+
+void StaticsAllocator::save(std::string path, uint32_t staticsSize)
+{
+  std::vector<Extent> extents(m_largeExtents);
+  for (uint32_t i = 1; i <= NUM_SIZE_CLASSES; i++)
+  {
+    for (std::vector<uint32_t>::iterator itr = m_sizeClasses[i].begin(); itr != m_sizeClasses[i].end(); itr++)
+    {
+      Extent extent = { *itr, i * RECORD_SIZE };
+      extents.push_back(extent);
+    }
+  }
+
+  std::ofstream sidecar(path, std::ios::binary | std::ios::out | std::ios::trunc);
+  if (sidecar.is_open())
+  {
+    uint32_t header[3] = { SIDECAR_MAGIC, staticsSize, static_cast<uint32_t>(extents.size()) };
+    sidecar.write(reinterpret_cast<const char*>(header), sizeof(header));
+    if (!extents.empty())
+    {
+      sidecar.write(reinterpret_cast<const char*>(&extents[0]), extents.size() * sizeof(Extent));
+    }
+    sidecar.close();
+  }
+}
+
+/* Counts the index entries that point at each lookup, once the index of a map is loaded.  Any free extent that an 
+ * entry points into is dropped, the index is what decides which statics are in use.
+ */
+void StaticsAllocator::countReferences(const uint8_t* pStaidx, uint32_t numberOfBlocks, uint32_t staticsSize)
+{
+  m_sharedLookups.clear();
+
+  std::vector<uint32_t> lookups;
+  lookups.reserve(numberOfBlocks);
+  for (uint32_t blockNum = 0; blockNum < numberOfBlocks; blockNum++)
+  {
+    uint32_t lookup = *reinterpret_cast<const uint32_t*>(pStaidx + (blockNum * 12));
+    uint32_t length = *reinterpret_cast<const uint32_t*>(pStaidx + (blockNum * 12) + 4);
+
+    if (lookup < staticsSize && length > 0 && length <= staticsSize - lookup)
+    {
+      lookups.push_back(lookup);
+    }
+  }
+
+  std::sort(lookups.begin(), lookups.end());
+
+  for (uint32_t i = 1; i < lookups.size(); i++)
+  {
+    if (lookups[i] == lookups[i - 1])
+    {
+      std::map<uint32_t, uint32_t>::iterator itr = m_sharedLookups.find(lookups[i]);
+      if (itr == m_sharedLookups.end())
+      {
+        m_sharedLookups[lookups[i]] = 2;
+      }
+      else
+      {
+        itr->second++;
+      }
+    }
+  }
+
+  if (m_freeBytes == 0)
+  {
+    return;
+  }
+
+  //the free lists may have been saved by a build that freed shared statics
+  std::vector<Extent> extents(m_largeExtents);
+  for (uint32_t i = 1; i <= NUM_SIZE_CLASSES; i++)
+  {
+    for (std::vector<uint32_t>::iterator itr = m_sizeClasses[i].begin(); itr != m_sizeClasses[i].end(); itr++)
+    {
+      Extent extent = { *itr, i * RECORD_SIZE };
+      extents.push_back(extent);
+    }
+  }
+
+  clearFreeLists();
+  for (std::vector<Extent>::iterator itr = extents.begin(); itr != extents.end(); itr++)
+  {
+    if (!isReferenced(lookups, itr->lookup, itr->length))
+    {
+      addExtent(itr->lookup, itr->length);
+    }
+  }
+
+#ifdef DEBUG
+  printf("%u shared statics lookups, %u bytes free\n", m_sharedLookups.size(), m_freeBytes);
+#endif
+}
+
+/* Returns the lookup of a free extent of at least length bytes, or INVALID_LOOKUP if the block has to be appended */
+uint32_t StaticsAllocator::allocate(uint32_t length)
+{
+  if (m_compacting || length == 0)
+  {
+    return INVALID_LOOKUP;
+  }
+
+  uint32_t lookup = INVALID_LOOKUP;
+  uint32_t extentLength = 0;
+
+  if (length % RECORD_SIZE == 0 && length / RECORD_SIZE <= NUM_SIZE_CLASSES)
+  {
+    //exact fit first, then split the smallest bigger extent
+    for (uint32_t sizeClass = length / RECORD_SIZE; sizeClass <= NUM_SIZE_CLASSES; sizeClass++)
+    {
+      if (!m_sizeClasses[sizeClass].empty())
+      {
+        lookup = m_sizeClasses[sizeClass].back();
+        extentLength = sizeClass * RECORD_SIZE;
+        m_sizeClasses[sizeClass].pop_back();
+        break;
+      }
+    }
+  }
+
+  if (lookup == INVALID_LOOKUP)
+  {
+    for (std::vector<Extent>::iterator itr = m_largeExtents.begin(); itr != m_largeExtents.end(); itr++)
+    {
+      if (itr->length >= length)
+      {
+        lookup = itr->lookup;
+        extentLength = itr->length;
+        m_largeExtents.erase(itr);
+        break;
+      }
+    }
+  }
+
+  if (lookup != INVALID_LOOKUP)
+  {
+    m_freeBytes -= extentLength;
+    addExtent(lookup + length, extentLength - length);
+  }
+
+  return lookup;
+}
+
+/* Gives back the statics an index entry no longer points at.  Statics that other entries still point at stay put */
+void StaticsAllocator::release(uint32_t lookup, uint32_t length)
+{
+  std::map<uint32_t, uint32_t>::iterator itr = m_sharedLookups.find(lookup);
+  if (itr != m_sharedLookups.end())
+  {
+    itr->second--;
+    if (itr->second <= 1)
+    {
+      m_sharedLookups.erase(itr);
+    }
+    return;
+  }
+
+  //anything freed while compacting gets compacted over
+  if (!m_compacting)
+  {
+    addExtent(lookup, length);
+  }
+}
+
+uint32_t StaticsAllocator::getFreeBytes()
+{
+  return m_freeBytes;
+}
+
+/* True if more than one index entry points at the statics at lookup */
+bool StaticsAllocator::isShared(uint32_t lookup)
+{
+  return m_sharedLookups.find(lookup) != m_sharedLookups.end();
+}
+
+bool StaticsAllocator::needsCompaction(uint32_t staticsSize)
+{
+  return !m_compacting && m_freeBytes >= COMPACTION_MINIMUM_FREE_BYTES && m_freeBytes >= (staticsSize / 100) * COMPACTION_FREE_PERCENT;
+}
+
+bool StaticsAllocator::isCompacting()
+{
+  return m_compacting;
+}
+
+/* Drops the free lists and starts a compaction.  Blocks written while the compaction runs are appended past the end
+ * of the statics, and are picked up once everything before them has been moved.
+ */
+void StaticsAllocator::beginCompaction(uint8_t* pStaidx, uint32_t numberOfBlocks, uint32_t staticsSize)
+{
+  clearFreeLists();
+  m_compactionOrder.clear();
+
+  m_compacting = true;
+  m_compactionCursor = 0;
+  m_compactionEnd = 0;
+  m_lastMoveFrom = INVALID_LOOKUP;
+  m_lastMoveTo = INVALID_LOOKUP;
+
+  planCompaction(pStaidx, numberOfBlocks, 0, staticsSize);
+
+#ifdef DEBUG
+  printf("Compacting %u statics blocks\n", m_compactionOrder.size());
+#endif
+}
+
+/* Produces the next block that has to move down to keep the statics contiguous.  The block's current index entry is
+ * checked first: a block that was rewritten elsewhere since it was planned is skipped, and one that was rewritten
+ * in place can only have shrunk, so moving it with its current length is safe.  Returns false once every block is
+ * in place.
+ */
+bool StaticsAllocator::nextCompactionMove(uint8_t* pStaidx, uint32_t numberOfBlocks, uint32_t staticsSize, uint32_t& rBlockNum, uint32_t& rFrom, uint32_t& rTo, uint32_t& rLength)
+{
+  while (m_compacting)
+  {
+    if (m_compactionPosition >= m_compactionOrder.size())
+    {
+      if (staticsSize <= m_compactionEnd)
+      {
+        return false;
+      }
+
+      //move on to the blocks that were appended in the meantime
+      planCompaction(pStaidx, numberOfBlocks, m_compactionEnd, staticsSize);
+      continue;
+    }
+
+    BlockLocation& rLocation = m_compactionOrder[m_compactionPosition++];
+    uint32_t lookup = *reinterpret_cast<uint32_t*>(pStaidx + (rLocation.blockNum * 12));
+    uint32_t length = *reinterpret_cast<uint32_t*>(pStaidx + (rLocation.blockNum * 12) + 4);
+
+    if (lookup != rLocation.lookup || length == 0 || length == INVALID_LOOKUP)
+    {
+      continue;
+    }
+
+    rBlockNum = rLocation.blockNum;
+    rLength = length;
+
+    if (lookup == m_lastMoveFrom)
+    {
+      //block shares its statics with the previous one, which has already been moved
+      rFrom = m_lastMoveTo;
+      rTo = m_lastMoveTo;
+      return true;
+    }
+
+    rFrom = lookup;
+    rTo = m_compactionCursor;
+    m_compactionCursor += length;
+    m_lastMoveFrom = rFrom;
+    m_lastMoveTo = rTo;
+
+    if (rFrom != rTo)
+    {
+      //the entries that share the statics follow this one to their new lookup
+      std::map<uint32_t, uint32_t>::iterator itr = m_sharedLookups.find(rFrom);
+      if (itr != m_sharedLookups.end())
+      {
+        uint32_t references = itr->second;
+        m_sharedLookups.erase(itr);
+        m_sharedLookups[rTo] = references;
+      }
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/* Finishes a compaction, the statics now end right after the last block that was moved */
+void StaticsAllocator::endCompaction(uint32_t& rStaticsSize)
+{
+  m_compacting = false;
+  m_compactionOrder.clear();
+
+  if (rStaticsSize <= m_compactionEnd)
+  {
+    rStaticsSize = m_compactionCursor;
+  }
+  else
+  {
+    addExtent(m_compactionCursor, m_compactionEnd - m_compactionCursor);
+  }
+
+#ifdef DEBUG
+  printf("Compaction finished, statics are %u bytes with %u bytes free\n", rStaticsSize, m_freeBytes);
+#endif
+}
+
+/* Queues every block whose statics lie between start and end, in the order they appear in the pool */
+void StaticsAllocator::planCompaction(uint8_t* pStaidx, uint32_t numberOfBlocks, uint32_t start, uint32_t end)
+{
+  m_compactionOrder.clear();
+  m_compactionPosition = 0;
+
+  for (uint32_t blockNum = 0; blockNum < numberOfBlocks; blockNum++)
+  {
+    uint32_t lookup = *reinterpret_cast<uint32_t*>(pStaidx + (blockNum * 12));
+    uint32_t length = *reinterpret_cast<uint32_t*>(pStaidx + (blockNum * 12) + 4);
+
+    if (lookup >= start && lookup < end && length > 0 && length <= end - lookup)
+    {
+      BlockLocation location = { blockNum, lookup };
+      m_compactionOrder.push_back(location);
+    }
+  }
+
+  std::sort(m_compactionOrder.begin(), m_compactionOrder.end(), compareLocations);
+  m_compactionEnd = end;
+}
+
+void StaticsAllocator::addExtent(uint32_t lookup, uint32_t length)
+{
+  if (length == 0)
+  {
+    return;
+  }
+
+  if (length % RECORD_SIZE == 0 && length / RECORD_SIZE <= NUM_SIZE_CLASSES)
+  {
+    m_sizeClasses[length / RECORD_SIZE].push_back(lookup);
+  }
+  else
+  {
+    Extent extent = { lookup, length };
+    m_largeExtents.push_back(extent);
+  }
+
+  m_freeBytes += length;
+}
+
+//true if any of the sorted lookups lies within the extent
+bool StaticsAllocator::isReferenced(const std::vector<uint32_t>& rLookups, uint32_t lookup, uint32_t length)
+{
+  std::vector<uint32_t>::const_iterator itr = std::lower_bound(rLookups.begin(), rLookups.end(), lookup);
+  return itr != rLookups.end() && *itr - lookup < length;
+}
+
+bool StaticsAllocator::compareLocations(const BlockLocation& rLeft, const BlockLocation& rRight)
+{
+  return rLeft.lookup < rRight.lookup;
+}
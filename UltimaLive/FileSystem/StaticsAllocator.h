@@ -0,0 +1,110 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _STATICS_ALLOCATOR_H
+#define _STATICS_ALLOCATOR_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/* Keeps track of the space in the statics pool that is no longer referenced by the statics index so that it can be
+ * handed out again instead of growing the statics file every time a block gets bigger.
+ *
+ * Statics blocks are made of 7 byte records, so freed extents are kept in one free list per record count up to 
+ * NUM_SIZE_CLASSES records, plus a first fit list for anything larger or oddly sized.  Extents are split on 
+ * allocation but never merged, fragmentation is dealt with by compaction instead: once enough of the pool is free,
+ * live blocks are slid down to the start of the pool a few at a time until they are contiguous again.
+ *
+ * The stock statics index has entries that share their statics with other entries.  Such lookups are counted when 
+ * a map is loaded, and releasing one only drops a reference until a single entry is left pointing at it, so the 
+ * extent is never handed out while another block still reads from it.  Shared statics are never rewritten in place.
+ *
+ * The free lists are stored in a sidecar file next to the statics file when a map is closed cleanly.  The sidecar is
+ * deleted as soon as it is loaded, so after a crash the allocator starts out empty and the next compaction recovers 
+ * the space.
+ */
+class StaticsAllocator
+{
+  public:
+    StaticsAllocator();
+
+    void reset();
+    bool load(std::string path, uint32_t staticsSize);
+    void save(std::string path, uint32_t staticsSize);
+    void countReferences(const uint8_t* pStaidx, uint32_t numberOfBlocks, uint32_t staticsSize);
+
+    uint32_t allocate(uint32_t length);
+    void release(uint32_t lookup, uint32_t length);
+    uint32_t getFreeBytes();
+    bool isShared(uint32_t lookup);
+
+    bool needsCompaction(uint32_t staticsSize);
+    bool isCompacting();
+    void beginCompaction(uint8_t* pStaidx, uint32_t numberOfBlocks, uint32_t staticsSize);
+    bool nextCompactionMove(uint8_t* pStaidx, uint32_t numberOfBlocks, uint32_t staticsSize, uint32_t& rBlockNum, uint32_t& rFrom, uint32_t& rTo, uint32_t& rLength);
+    void endCompaction(uint32_t& rStaticsSize);
+
+    static const uint32_t INVALID_LOOKUP = 0xFFFFFFFF;
+    static const uint32_t RECORD_SIZE = 7;
+    static const uint32_t NUM_SIZE_CLASSES = 64;
+    static const uint32_t COMPACTION_MINIMUM_FREE_BYTES = 0x100000;
+    static const uint32_t COMPACTION_FREE_PERCENT = 25;
+    static const uint32_t COMPACTION_MOVES_PER_UPDATE = 64;
+    static const uint32_t SIDECAR_MAGIC = 0x46534C55; //ULSF
+
+  private:
+    struct Extent
+    {
+      uint32_t lookup;
+      uint32_t length;
+    };
+
+    struct BlockLocation
+    {
+      uint32_t blockNum;
+      uint32_t lookup;
+    };
+
+    void clearFreeLists();
+    void addExtent(uint32_t lookup, uint32_t length);
+    static bool isReferenced(const std::vector<uint32_t>& rLookups, uint32_t lookup, uint32_t length);
+    void planCompaction(uint8_t* pStaidx, uint32_t numberOfBlocks, uint32_t start, uint32_t end);
+    static bool compareLocations(const BlockLocation& rLeft, const BlockLocation& rRight);
+
+    std::vector<uint32_t> m_sizeClasses[NUM_SIZE_CLASSES + 1];
+    std::vector<Extent> m_largeExtents;
+    uint32_t m_freeBytes;
+    std::map<uint32_t, uint32_t> m_sharedLookups; //lookup to number of index entries, for lookups with more than one
+
+    bool m_compacting;
+    std::vector<BlockLocation> m_compactionOrder;
+    uint32_t m_compactionPosition;
+    uint32_t m_compactionCursor;
+    uint32_t m_compactionEnd;
+    uint32_t m_lastMoveFrom;
+    uint32_t m_lastMoveTo;
+};
+
+#endif
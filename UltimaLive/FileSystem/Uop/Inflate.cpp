@@ -0,0 +1,454 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+
+#include "Inflate.h"
+#include <string.h>
+
+static const uint16_t LENGTH_BASE[29] = 
+{
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t LENGTH_EXTRA_BITS[29] = 
+{
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t DISTANCE_BASE[30] = 
+{
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 
+  8193, 12289, 16385, 24577
+};
+
+static const uint8_t DISTANCE_EXTRA_BITS[30] = 
+{
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+//the order in which the lengths of the code length codes are stored in a dynamic block
+static const uint8_t CODE_LENGTH_ORDER[Inflate::NUMBER_OF_CODE_LENGTH_CODES] = 
+{
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/* Returns true if the stream decoded to exactly destinationLength bytes and their checksum matched */
+bool Inflate::decompress(const uint8_t* pSource, uint32_t sourceLength, uint8_t* pDestination, uint32_t destinationLength)
+{
+  //two header bytes and the four byte checksum
+  if (sourceLength < 6)
+  {
+    return false;
+  }
+
+  //deflate with a window of at most 32k, no preset dictionary, and a header that is a multiple of 31
+  uint8_t compressionMethod = pSource[0];
+  uint8_t flags = pSource[1];
+  if ((compressionMethod & 0x0F) != 8 || (compressionMethod >> 4) > 7 || (flags & 0x20) != 0 || ((compressionMethod << 8) | flags) % 31 != 0)
+  {
+    return false;
+  }
+
+  State state;
+  state.pSource = pSource + 2;
+  state.pSourceEnd = pSource + sourceLength - 4;
+  state.bitBuffer = 0;
+  state.bitCount = 0;
+  state.pDestination = pDestination;
+  state.pOutput = pDestination;
+  state.pOutputEnd = pDestination + destinationLength;
+
+  if (!inflateBlocks(state) || state.pOutput != state.pOutputEnd)
+  {
+    return false;
+  }
+
+  //the checksum follows the last block, which is padded to a whole byte
+  const uint8_t* pChecksum = state.pSource;
+  if (pSource + sourceLength - pChecksum < 4)
+  {
+    return false;
+  }
+
+  uint32_t checksum = (pChecksum[0] << 24) | (pChecksum[1] << 16) | (pChecksum[2] << 8) | pChecksum[3];
+  return checksum == adler32(pDestination, destinationLength);
+}
+
+uint32_t Inflate::adler32(const uint8_t* pData, uint32_t length)
+{
+  //the largest number of bytes that can be summed before the sums could overflow 32 bits
+  static const uint32_t MAX_RUN = 5552;
+  static const uint32_t MODULUS = 65521;
+
+  uint32_t a = 1;
+  uint32_t b = 0;
+
+  while (length > 0)
+  {
+    uint32_t run = length < MAX_RUN ? length : MAX_RUN;
+    length -= run;
+
+    for (uint32_t i = 0; i < run; i++)
+    {
+      a += pData[i];
+      b += a;
+    }
+
+    pData += run;
+    a %= MODULUS;
+    b %= MODULUS;
+  }
+
+  return (b << 16) | a;
+}
+
+bool Inflate::inflateBlocks(State& rState)
+{
+  uint32_t lastBlock = 0;
+  while (lastBlock == 0)
+  {
+    uint32_t blockType = 0;
+    if (!getBits(rState, 1, lastBlock) || !getBits(rState, 2, blockType))
+    {
+      return false;
+    }
+
+    bool succeeded = false;
+    if (blockType == 0)
+    {
+      succeeded = copyStoredBlock(rState);
+    }
+    else if (blockType == 1)
+    {
+      //literals 0 to 143 have 8 bit codes, 144 to 255 9 bits, 256 to 279 7 bits and the rest 8 bits again
+      uint8_t lengths[MAX_LITERAL_CODES + MAX_DISTANCE_CODES];
+      memset(lengths, 8, 144);
+      memset(lengths + 144, 9, 256 - 144);
+      memset(lengths + 256, 7, 280 - 256);
+      memset(lengths + 280, 8, MAX_LITERAL_CODES - 280);
+      memset(lengths + MAX_LITERAL_CODES, 5, MAX_DISTANCE_CODES);
+
+      HuffmanCode literalCode;
+      HuffmanCode distanceCode;
+      succeeded = buildCode(literalCode, lengths, MAX_LITERAL_CODES) && buildCode(distanceCode, lengths + MAX_LITERAL_CODES, MAX_DISTANCE_CODES) &&
+        inflateCodes(rState, literalCode, distanceCode);
+    }
+    else if (blockType == 2)
+    {
+      HuffmanCode literalCode;
+      HuffmanCode distanceCode;
+      succeeded = readDynamicCodes(rState, literalCode, distanceCode) && inflateCodes(rState, literalCode, distanceCode);
+    }
+
+    if (!succeeded)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* A stored block starts at the next whole byte with its length and the complement of its length */
+bool Inflate::copyStoredBlock(State& rState)
+{
+  //fewer than eight bits are ever left over, and they are the padding up to the next byte
+  rState.bitBuffer = 0;
+  rState.bitCount = 0;
+
+  if (rState.pSourceEnd - rState.pSource < 4)
+  {
+    return false;
+  }
+
+  uint32_t length = rState.pSource[0] | (rState.pSource[1] << 8);
+  uint32_t complement = rState.pSource[2] | (rState.pSource[3] << 8);
+  rState.pSource += 4;
+
+  if (length != (~complement & 0xFFFF) || length > static_cast<uint32_t>(rState.pSourceEnd - rState.pSource) || 
+    length > static_cast<uint32_t>(rState.pOutputEnd - rState.pOutput))
+  {
+    return false;
+  }
+
+  memcpy(rState.pOutput, rState.pSource, length);
+  rState.pSource += length;
+  rState.pOutput += length;
+
+  return true;
+}
+
+/* A dynamic block describes its literal and distance codes by their code lengths, which are themselves written with a 
+ * small huffman code and run lengths: 16 repeats the previous length, 17 and 18 write short and long runs of zeros.
+ */
+bool Inflate::readDynamicCodes(State& rState, HuffmanCode& rLiteralCode, HuffmanCode& rDistanceCode)
+{
+  uint32_t numberOfLiteralCodes = 0;
+  uint32_t numberOfDistanceCodes = 0;
+  uint32_t numberOfCodeLengthCodes = 0;
+
+  if (!getBits(rState, 5, numberOfLiteralCodes) || !getBits(rState, 5, numberOfDistanceCodes) || !getBits(rState, 4, numberOfCodeLengthCodes))
+  {
+    return false;
+  }
+
+  numberOfLiteralCodes += 257;
+  numberOfDistanceCodes += 1;
+  numberOfCodeLengthCodes += 4;
+
+  if (numberOfLiteralCodes > 286 || numberOfDistanceCodes > MAX_DISTANCE_CODES)
+  {
+    return false;
+  }
+
+  uint8_t lengths[MAX_LITERAL_CODES + MAX_DISTANCE_CODES];
+  memset(lengths, 0, NUMBER_OF_CODE_LENGTH_CODES);
+  for (uint32_t i = 0; i < numberOfCodeLengthCodes; i++)
+  {
+    uint32_t length = 0;
+    if (!getBits(rState, 3, length))
+    {
+      return false;
+    }
+    lengths[CODE_LENGTH_ORDER[i]] = static_cast<uint8_t>(length);
+  }
+
+  HuffmanCode codeLengthCode;
+  if (!buildCode(codeLengthCode, lengths, NUMBER_OF_CODE_LENGTH_CODES))
+  {
+    return false;
+  }
+
+  uint32_t numberOfLengths = numberOfLiteralCodes + numberOfDistanceCodes;
+  uint32_t index = 0;
+  while (index < numberOfLengths)
+  {
+    int32_t symbol = decodeSymbol(rState, codeLengthCode);
+    if (symbol < 0)
+    {
+      return false;
+    }
+
+    if (symbol < 16)
+    {
+      lengths[index++] = static_cast<uint8_t>(symbol);
+      continue;
+    }
+
+    uint8_t repeatedLength = 0;
+    uint32_t repeat = 0;
+    bool succeeded = false;
+    if (symbol == 16)
+    {
+      succeeded = index > 0 && getBits(rState, 2, repeat);
+      repeatedLength = index > 0 ? lengths[index - 1] : 0;
+      repeat += 3;
+    }
+    else if (symbol == 17)
+    {
+      succeeded = getBits(rState, 3, repeat);
+      repeat += 3;
+    }
+    else
+    {
+      succeeded = getBits(rState, 7, repeat);
+      repeat += 11;
+    }
+
+    if (!succeeded || index + repeat > numberOfLengths)
+    {
+      return false;
+    }
+
+    memset(lengths + index, repeatedLength, repeat);
+    index += repeat;
+  }
+
+  //a block without an end of block code could never end
+  if (lengths[END_OF_BLOCK] == 0)
+  {
+    return false;
+  }
+
+  return buildCode(rLiteralCode, lengths, numberOfLiteralCodes) && buildCode(rDistanceCode, lengths + numberOfLiteralCodes, numberOfDistanceCodes);
+}
+
+bool Inflate::inflateCodes(State& rState, const HuffmanCode& rLiteralCode, const HuffmanCode& rDistanceCode)
+{
+  for (;;)
+  {
+    int32_t symbol = decodeSymbol(rState, rLiteralCode);
+    if (symbol < 0)
+    {
+      return false;
+    }
+
+    if (symbol < static_cast<int32_t>(END_OF_BLOCK))
+    {
+      if (rState.pOutput == rState.pOutputEnd)
+      {
+        return false;
+      }
+
+      *rState.pOutput++ = static_cast<uint8_t>(symbol);
+      continue;
+    }
+
+    if (symbol == END_OF_BLOCK)
+    {
+      return true;
+    }
+
+    symbol -= END_OF_BLOCK + 1;
+    if (symbol >= 29)
+    {
+      return false;
+    }
+
+    uint32_t length = 0;
+    if (!getBits(rState, LENGTH_EXTRA_BITS[symbol], length))
+    {
+      return false;
+    }
+    length += LENGTH_BASE[symbol];
+
+    symbol = decodeSymbol(rState, rDistanceCode);
+    if (symbol < 0 || symbol >= static_cast<int32_t>(MAX_DISTANCE_CODES))
+    {
+      return false;
+    }
+
+    uint32_t distance = 0;
+    if (!getBits(rState, DISTANCE_EXTRA_BITS[symbol], distance))
+    {
+      return false;
+    }
+    distance += DISTANCE_BASE[symbol];
+
+    if (distance > static_cast<uint32_t>(rState.pOutput - rState.pDestination) || length > static_cast<uint32_t>(rState.pOutputEnd - rState.pOutput))
+    {
+      return false;
+    }
+
+    //matches can overlap the bytes they produce, so they are copied a byte at a time
+    const uint8_t* pMatch = rState.pOutput - distance;
+    for (uint32_t i = 0; i < length; i++)
+    {
+      rState.pOutput[i] = pMatch[i];
+    }
+    rState.pOutput += length;
+  }
+}
+
+/* Sorts the symbols by code length, then by value, which is the order their canonical codes are handed out in.  Fails 
+ * if the lengths ask for more codes than there are, an incomplete code only fails once a missing code is decoded.
+ */
+bool Inflate::buildCode(HuffmanCode& rCode, const uint8_t* pLengths, uint32_t numberOfSymbols)
+{
+  memset(rCode.counts, 0, sizeof(rCode.counts));
+  for (uint32_t symbol = 0; symbol < numberOfSymbols; symbol++)
+  {
+    rCode.counts[pLengths[symbol]]++;
+  }
+
+  int32_t codesLeft = 1;
+  for (uint32_t length = 1; length <= MAX_CODE_LENGTH; length++)
+  {
+    codesLeft = (codesLeft << 1) - rCode.counts[length];
+    if (codesLeft < 0)
+    {
+      return false;
+    }
+  }
+
+  uint16_t offsets[MAX_CODE_LENGTH + 1];
+  offsets[1] = 0;
+  for (uint32_t length = 1; length < MAX_CODE_LENGTH; length++)
+  {
+    offsets[length + 1] = offsets[length] + rCode.counts[length];
+  }
+
+  for (uint32_t symbol = 0; symbol < numberOfSymbols; symbol++)
+  {
+    if (pLengths[symbol] != 0)
+    {
+      rCode.symbols[offsets[pLengths[symbol]]++] = static_cast<uint16_t>(symbol);
+    }
+  }
+
+  return true;
+}
+
+/* Reads a code a bit at a time.  The codes of each length are consecutive numbers that follow on from the codes one 
+ * bit shorter, so a code of a given length is found once it is less than the first code of that length plus their count.
+ */
+int32_t Inflate::decodeSymbol(State& rState, const HuffmanCode& rCode)
+{
+  int32_t code = 0;
+  int32_t first = 0;
+  int32_t index = 0;
+
+  for (uint32_t length = 1; length <= MAX_CODE_LENGTH; length++)
+  {
+    uint32_t bit = 0;
+    if (!getBits(rState, 1, bit))
+    {
+      return -1;
+    }
+
+    //huffman codes are stored starting with their highest bit
+    code |= bit;
+    int32_t count = rCode.counts[length];
+    if (code - first < count)
+    {
+      return rCode.symbols[index + code - first];
+    }
+
+    index += count;
+    first = (first + count) << 1;
+    code <<= 1;
+  }
+
+  return -1;
+}
+
+bool Inflate::getBits(State& rState, uint32_t numberOfBits, uint32_t& rValue)
+{
+  while (rState.bitCount < numberOfBits)
+  {
+    if (rState.pSource == rState.pSourceEnd)
+    {
+      return false;
+    }
+
+    rState.bitBuffer |= static_cast<uint32_t>(*rState.pSource++) << rState.bitCount;
+    rState.bitCount += 8;
+  }
+
+  rValue = rState.bitBuffer & ((1 << numberOfBits) - 1);
+  rState.bitBuffer >>= numberOfBits;
+  rState.bitCount -= numberOfBits;
+
+  return true;
+}
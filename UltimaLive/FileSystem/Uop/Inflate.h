@@ -0,0 +1,79 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+
+#ifndef _INFLATE_H
+#define _INFLATE_H
+
+#include <stdint.h>
+
+/* Decoder for the zlib streams that compressed uop entries are stored as.  A stream is a two byte header, a run of 
+ * deflate blocks and the big endian Adler-32 checksum of the decompressed data.  A deflate block is either stored, 
+ * which is a length and the raw bytes, or a sequence of literals and back references written with huffman codes, 
+ * either the fixed codes from the deflate specification or codes described at the start of the block.
+ *
+ * Codes are decoded canonically from the number of codes of each length, so no decoding tables are built beyond the 
+ * sorted symbols.  Every length, distance and code is checked against the buffers, so a damaged stream fails instead 
+ * of writing out of bounds.
+ */
+class Inflate
+{
+  public:
+    static bool decompress(const uint8_t* pSource, uint32_t sourceLength, uint8_t* pDestination, uint32_t destinationLength);
+    static uint32_t adler32(const uint8_t* pData, uint32_t length);
+
+    static const uint32_t MAX_CODE_LENGTH = 15;
+    static const uint32_t MAX_LITERAL_CODES = 288;
+    static const uint32_t MAX_DISTANCE_CODES = 30;
+    static const uint32_t NUMBER_OF_CODE_LENGTH_CODES = 19;
+    static const uint32_t END_OF_BLOCK = 256;
+
+  private:
+    struct HuffmanCode
+    {
+      uint16_t counts[MAX_CODE_LENGTH + 1];
+      uint16_t symbols[MAX_LITERAL_CODES];
+    };
+
+    struct State
+    {
+      const uint8_t* pSource;
+      const uint8_t* pSourceEnd;
+      uint32_t bitBuffer;
+      uint32_t bitCount;
+      uint8_t* pDestination;
+      uint8_t* pOutput;
+      uint8_t* pOutputEnd;
+    };
+
+    static bool inflateBlocks(State& rState);
+    static bool copyStoredBlock(State& rState);
+    static bool readDynamicCodes(State& rState, HuffmanCode& rLiteralCode, HuffmanCode& rDistanceCode);
+    static bool inflateCodes(State& rState, const HuffmanCode& rLiteralCode, const HuffmanCode& rDistanceCode);
+    static bool buildCode(HuffmanCode& rCode, const uint8_t* pLengths, uint32_t numberOfSymbols);
+    static int32_t decodeSymbol(State& rState, const HuffmanCode& rCode);
+    static bool getBits(State& rState, uint32_t numberOfBits, uint32_t& rValue);
+};
+
+#endif
@@ -0,0 +1,111 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UopBlockTable.h"
+#include <algorithm>
+
+UopBlockTable::UopBlockTable()
+  : m_entryDataStarts(),
+  m_entryPoolOffsets(),
+  m_entryDataSize(0),
+  m_lastEntryDataSize(0),
+  m_uniform(true),
+  m_totalDataSize(0)
+{
+  //do nothing
+}
+
+void UopBlockTable::clear()
+{
+  m_entryDataStarts.clear();
+  m_entryPoolOffsets.clear();
+  m_entryDataSize = 0;
+  m_lastEntryDataSize = 0;
+  m_uniform = true;
+  m_totalDataSize = 0;
+}
+
+/* Adds the next entry of the map, in the order the entries hold the mul layout */
+void UopBlockTable::addEntry(const FileEntry& rEntry)
+{
+  if (m_entryDataStarts.empty())
+  {
+    m_entryDataSize = rEntry.UncompressedDataSize;
+  }
+  else if (m_lastEntryDataSize != m_entryDataSize)
+  {
+    //only the last entry is allowed to be short
+    m_uniform = false;
+  }
+
+  m_entryDataStarts.push_back(m_totalDataSize);
+  m_entryPoolOffsets.push_back(static_cast<uint32_t>(rEntry.UopFileOffset + rEntry.MetaDataSize));
+  m_lastEntryDataSize = rEntry.UncompressedDataSize;
+  m_totalDataSize += rEntry.UncompressedDataSize;
+}
+
+/* Sets rPoolOffset to the offset of the block's 196 bytes in the uop layout, returns false if the block is past the 
+ * end of the map
+ */
+bool UopBlockTable::find(uint32_t blockNum, uint32_t& rPoolOffset) const
+{
+  if (blockNum >= m_totalDataSize / BLOCK_LENGTH)
+  {
+    return false;
+  }
+
+  uint32_t blockSeekLocation = blockNum * BLOCK_LENGTH;
+  uint32_t entryIndex = 0;
+  if (isUniform())
+  {
+    entryIndex = blockSeekLocation / m_entryDataSize;
+    if (entryIndex >= m_entryDataStarts.size())
+    {
+      //a long last entry
+      entryIndex = static_cast<uint32_t>(m_entryDataStarts.size()) - 1;
+    }
+  }
+  else
+  {
+    entryIndex = static_cast<uint32_t>(std::upper_bound(m_entryDataStarts.begin(), m_entryDataStarts.end(), blockSeekLocation) - m_entryDataStarts.begin()) - 1;
+  }
+
+  rPoolOffset = m_entryPoolOffsets[entryIndex] + (blockSeekLocation - m_entryDataStarts[entryIndex]);
+  return true;
+}
+
+uint32_t UopBlockTable::getNumberOfEntries() const
+{
+  return static_cast<uint32_t>(m_entryDataStarts.size());
+}
+
+uint32_t UopBlockTable::getTotalDataSize() const
+{
+  return m_totalDataSize;
+}
+
+bool UopBlockTable::isUniform() const
+{
+  return m_uniform && m_entryDataSize != 0;
+}
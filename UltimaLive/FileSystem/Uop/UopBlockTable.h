@@ -0,0 +1,61 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#ifndef _UOP_BLOCK_TABLE_H
+#define _UOP_BLOCK_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+#include "UopStructs.h"
+
+/* Finds where a land block of a map lives in the uop layout the client sees.  The mul layout of the map is split 
+ * across the uop entries in order, so the start of each entry's data within that layout is a running sum of the 
+ * entry sizes.  Every entry but the last holds the same number of blocks in the shipped map files, in which case the
+ * entry holding a block is found by a single division, otherwise by a binary search over the running sums.
+ */
+class UopBlockTable
+{
+  public:
+    UopBlockTable();
+
+    void clear();
+    void addEntry(const FileEntry& rEntry);
+    bool find(uint32_t blockNum, uint32_t& rPoolOffset) const;
+
+    uint32_t getNumberOfEntries() const;
+    uint32_t getTotalDataSize() const;
+    bool isUniform() const;
+
+    static const uint32_t BLOCK_LENGTH = 196;
+
+  private:
+    std::vector<uint32_t> m_entryDataStarts;
+    std::vector<uint32_t> m_entryPoolOffsets;
+    uint32_t m_entryDataSize;
+    uint32_t m_lastEntryDataSize;
+    bool m_uniform;
+    uint32_t m_totalDataSize;
+};
+
+#endif
@@ -0,0 +1,99 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UopEntryIndex.h"
+
+const int32_t UopEntryIndex::EMPTY_SLOT;
+
+UopEntryIndex::UopEntryIndex()
+  : m_pEntries(NULL),
+  m_numberOfEntries(0),
+  m_mask(0),
+  m_slots()
+{
+  //do nothing
+}
+
+/* Indexes the entries in one pass.  The entries are not copied, they have to stay around as long as the index is used */
+void UopEntryIndex::build(const FileEntry* pEntries, uint32_t numberOfEntries)
+{
+  uint32_t numberOfSlots = MIN_SLOTS;
+  while (numberOfSlots < numberOfEntries * 2)
+  {
+    numberOfSlots <<= 1;
+  }
+
+  m_pEntries = pEntries;
+  m_numberOfEntries = numberOfEntries;
+  m_mask = numberOfSlots - 1;
+  m_slots.assign(numberOfSlots, EMPTY_SLOT);
+
+  for (uint32_t entry = 0; entry < numberOfEntries; entry++)
+  {
+    uint64_t pathChecksum = pEntries[entry].PathChecksum;
+    uint32_t slot = getSlot(pathChecksum, m_mask);
+
+    while (m_slots[slot] != EMPTY_SLOT && pEntries[m_slots[slot]].PathChecksum != pathChecksum)
+    {
+      slot = (slot + 1) & m_mask;
+    }
+
+    if (m_slots[slot] == EMPTY_SLOT)
+    {
+      m_slots[slot] = static_cast<int32_t>(entry);
+    }
+  }
+}
+
+/* Returns the number of the entry with the given path hash, or EMPTY_SLOT if there is none */
+int32_t UopEntryIndex::find(uint64_t pathChecksum) const
+{
+  if (m_slots.empty())
+  {
+    return EMPTY_SLOT;
+  }
+
+  uint32_t slot = getSlot(pathChecksum, m_mask);
+  while (m_slots[slot] != EMPTY_SLOT)
+  {
+    if (m_pEntries[m_slots[slot]].PathChecksum == pathChecksum)
+    {
+      return m_slots[slot];
+    }
+
+    slot = (slot + 1) & m_mask;
+  }
+
+  return EMPTY_SLOT;
+}
+
+uint32_t UopEntryIndex::getNumberOfEntries() const
+{
+  return m_numberOfEntries;
+}
+
+uint32_t UopEntryIndex::getSlot(uint64_t pathChecksum, uint32_t mask)
+{
+  return static_cast<uint32_t>(pathChecksum ^ (pathChecksum >> 32)) & mask;
+}
@@ -0,0 +1,59 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#ifndef _UOP_ENTRY_INDEX_H
+#define _UOP_ENTRY_INDEX_H
+
+#include <stdint.h>
+#include <vector>
+#include "UopStructs.h"
+
+/* Finds the file entry of a uop file by the hash of its path.
+ *
+ * The index is an open addressed table of entry numbers, built in one pass over the file table, with linear probing 
+ * and at most half of the slots used.  Path hashes are already well mixed, so the slot is taken straight from their 
+ * bits.  When two entries share a hash the first one wins, the same as with the search the index replaces.
+ */
+class UopEntryIndex
+{
+  public:
+    UopEntryIndex();
+
+    void build(const FileEntry* pEntries, uint32_t numberOfEntries);
+    int32_t find(uint64_t pathChecksum) const;
+    uint32_t getNumberOfEntries() const;
+
+    static const int32_t EMPTY_SLOT = -1;
+    static const uint32_t MIN_SLOTS = 16;
+
+  private:
+    static uint32_t getSlot(uint64_t pathChecksum, uint32_t mask);
+
+    const FileEntry* m_pEntries;
+    uint32_t m_numberOfEntries;
+    uint32_t m_mask;
+    std::vector<int32_t> m_slots;
+};
+
+#endif
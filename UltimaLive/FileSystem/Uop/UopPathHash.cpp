@@ -0,0 +1,158 @@
+/* Copyright (C) 2013 Ian Karlinsey
+ * 
+ * UltimeLive is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * UltimaLive is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with UltimaLive.  If not, see <http://www.gnu.org/licenses/>. 
+ */
+
+#include "UopPathHash.h"
+
+/* The names of the entries of a uop map are build/<pattern>/00000000.dat, build/<pattern>/00000001.dat and so on.  
+ * The name is laid out once and the eight digits are counted up in place, so no entry formats or allocates anything.
+ */
+void UopPathHash::getMapHashes(uint32_t count, const std::string& pattern, std::vector<uint64_t>& rHashes)
+{
+  rHashes.resize(count);
+
+  std::string filename("build/");
+  filename.append(pattern);
+  filename.append("/00000000.dat");
+
+  uint32_t length = static_cast<uint32_t>(filename.length());
+  char* pDigits = &filename[length - MAP_ENTRY_NAME_SUFFIX_LENGTH];
+
+  for (uint32_t i = 0; i < count; i++)
+  {
+    rHashes[i] = HashFileName(filename.c_str(), length);
+
+    //count up by one, carrying into the digits on the left
+    for (int32_t digit = MAP_ENTRY_NAME_DIGITS - 1; digit >= 0 && ++pDigits[digit] > '9'; digit--)
+    {
+      pDigits[digit] = '0';
+    }
+  }
+}
+
+uint64_t UopPathHash::HashFileName(std::string s)
+{
+  return HashFileName(s.c_str(), static_cast<uint32_t>(s.length()));
+}
+
+uint64_t UopPathHash::HashFileName(const char* s, uint32_t length)
+{
+  uint32_t esi = length + 0xDEADBEEF;
+  uint32_t eax = 0;
+  uint32_t ecx = 0;
+  uint32_t edx = 0;
+  uint32_t ebx = esi;
+  uint32_t edi = esi;
+
+  uint32_t i = 0;
+
+  for (i = 0; i + 12 < length; i += 12)
+  {
+    edi = (uint32_t)((s[i + 7] << 24) | (s[i + 6] << 16) | (s[i + 5] << 8) | s[i + 4]) + edi;
+    esi = (uint32_t)((s[i + 11] << 24) | (s[i + 10] << 16) | (s[i + 9] << 8) | s[i + 8]) + esi;
+    edx = (uint32_t)((s[i + 3] << 24) | (s[i + 2] << 16) | (s[i + 1] << 8) | s[i]) - esi;
+
+    edx = (edx + ebx) ^ (esi >> 28) ^ (esi << 4);
+    esi += edi;
+    edi = (edi - edx) ^ (edx >> 26) ^ (edx << 6);
+    edx += esi;
+    esi = (esi - edi) ^ (edi >> 24) ^ (edi << 8);
+    edi += edx;
+    ebx = (edx - esi) ^ (esi >> 16) ^ (esi << 16);
+    esi += edi;
+    edi = (edi - ebx) ^ (ebx >> 13) ^ (ebx << 19);
+    ebx += esi;
+    esi = (esi - edi) ^ (edi >> 28) ^ (edi << 4);
+    edi += ebx;
+  }
+
+  if (static_cast<int32_t>(length - i) > 0)
+  {
+    uint32_t len = length - i;
+
+    if (len > 11)
+    {
+      esi += (uint32_t)s[i + 11] << 24;
+    }
+
+    if (len > 10)
+    {
+      esi += (uint32_t)s[i + 10] << 16;
+    }
+
+    if (len > 9)
+    {
+      esi += (uint32_t)s[i + 9] << 8;
+    }
+
+    if (len > 8)
+    {
+      esi += (uint32_t)s[i + 8];
+    }
+
+    if (len > 7)
+    {
+      edi += (uint32_t)s[i + 7] << 24;
+    }
+
+    if (len > 6)
+    {
+      edi += (uint32_t)s[i + 6] << 16;
+    }
+
+    if (len > 5)
+    {
+      edi += (uint32_t)s[i + 5] << 8;
+    }
+
+    if (len > 4)
+    {
+      edi += (uint32_t)s[i + 4];
+    }
+
+    if (len > 3)
+    {
+      ebx += (uint32_t)s[i + 3] << 24;
+    }
+
+    if (len > 2)
+    {
+      ebx += (uint32_t)s[i + 2] << 16;
+    }
+
+    if (len > 1)
+    {
+      ebx += (uint32_t)s[i + 1] << 8;
+    }
+
+    if (len > 0)
+    {
+      ebx += (uint32_t)s[i];
+    }
+
+    esi = (esi ^ edi) - ((edi >> 18) ^ (edi << 14));
+    ecx = (esi ^ ebx) - ((esi >> 21) ^ (esi << 11));
+    edi = (edi ^ ecx) - ((ecx >> 7) ^ (ecx << 25));
+    esi = (esi ^ edi) - ((edi >> 16) ^ (edi << 16));
+    edx = (esi ^ ecx) - ((esi >> 28) ^ (esi << 4));
+    edi = (edi ^ edx) - ((edx >> 18) ^ (edx << 14));
+    eax = (esi ^ edi) - ((edi >> 8) ^ (edi << 24));
+
+    return ((uint64_t)edi << 32) | eax;
+  }
+
+  return ((uint64_t)esi << 32) | eax;
+}
+
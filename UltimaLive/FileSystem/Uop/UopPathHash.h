@@ -0,0 +1,39 @@
+/* Copyright (C) 2013 Ian Karlinsey
+ * 
+ * UltimeLive is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * UltimaLive is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with UltimaLive.  If not, see <http://www.gnu.org/licenses/>. 
+ */
+
+
+#ifndef _UOP_PATH_HASH_H
+#define _UOP_PATH_HASH_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/* The hash a uop file looks its entries up by, taken over the path of the entry.  It has no Windows dependencies so 
+ * that the tests can check it.
+ */
+class UopPathHash
+{
+  public:
+    static uint64_t HashFileName(std::string s);
+    static uint64_t HashFileName(const char* s, uint32_t length);
+    static void getMapHashes(uint32_t count, const std::string& pattern, std::vector<uint64_t>& rHashes);
+
+    static const int32_t MAP_ENTRY_NAME_DIGITS = 8;
+    static const uint32_t MAP_ENTRY_NAME_SUFFIX_LENGTH = 12; //8 digits and .dat
+};
+
+#endif
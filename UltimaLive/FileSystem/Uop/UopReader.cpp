@@ -0,0 +1,361 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+
+#include "UopReader.h"
+#include "Inflate.h"
+#include <string.h>
+#include <cstdio>
+
+UopReader::UopReader()
+  :
+#ifdef _WIN32
+  m_hFile(INVALID_HANDLE_VALUE),
+  m_hMapping(NULL),
+#endif
+  m_pData(NULL),
+  m_size(0),
+  m_header(),
+  m_fileTables()
+{
+  //do nothing
+}
+
+UopReader::~UopReader()
+{
+  close();
+}
+
+#ifdef _WIN32
+/* Maps the whole file read only.  The client may have the file open itself, so it is shared for reading and writing */
+bool UopReader::open(std::string path)
+{
+  close();
+
+  m_hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (m_hFile == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  DWORD fileSizeHigh = 0;
+  DWORD fileSize = GetFileSize(m_hFile, &fileSizeHigh);
+  if (fileSize == INVALID_FILE_SIZE || fileSizeHigh != 0 || fileSize < HEADER_SIZE)
+  {
+    close();
+    return false;
+  }
+
+  m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+  const uint8_t* pView = NULL;
+  if (m_hMapping != NULL)
+  {
+    pView = reinterpret_cast<const uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+  }
+
+  if (pView == NULL)
+  {
+#ifdef DEBUG
+    printf("Failed to map %s: %u\n", path.c_str(), GetLastError());
+#endif
+    close();
+    return false;
+  }
+
+  m_pData = pView;
+  m_size = fileSize;
+
+  if (!readFileTables())
+  {
+#ifdef DEBUG
+    printf("%s is not a valid uop file\n", path.c_str());
+#endif
+    close();
+    return false;
+  }
+
+  return true;
+}
+#endif
+
+/* Reads a uop file that is already in memory.  The memory has to stay around until the reader is closed */
+bool UopReader::attach(const uint8_t* pData, uint32_t size)
+{
+  close();
+
+  if (pData == NULL || size < HEADER_SIZE)
+  {
+    return false;
+  }
+
+  m_pData = pData;
+  m_size = size;
+
+  if (!readFileTables())
+  {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void UopReader::close()
+{
+#ifdef _WIN32
+  if (m_hMapping != NULL)
+  {
+    if (m_pData != NULL)
+    {
+      UnmapViewOfFile(m_pData);
+    }
+
+    CloseHandle(m_hMapping);
+    m_hMapping = NULL;
+  }
+
+  if (m_hFile != INVALID_HANDLE_VALUE)
+  {
+    CloseHandle(m_hFile);
+    m_hFile = INVALID_HANDLE_VALUE;
+  }
+#endif
+
+  m_pData = NULL;
+  m_size = 0;
+  m_fileTables.clear();
+}
+
+bool UopReader::isOpen() const
+{
+  return m_pData != NULL;
+}
+
+const UopHeader& UopReader::getHeader() const
+{
+  return m_header;
+}
+
+UopReader::EntryIterator UopReader::getEntries() const
+{
+  return EntryIterator(this);
+}
+
+/* Copies out every entry that has data, in file order */
+void UopReader::getEntries(std::vector<FileEntry>& rEntries) const
+{
+  uint32_t capacity = 0;
+  for (uint32_t i = 0; i < m_fileTables.size(); i++)
+  {
+    capacity += m_fileTables[i].capacity;
+  }
+
+  rEntries.clear();
+  rEntries.reserve(capacity);
+
+  for (EntryIterator itr = getEntries(); itr.isValid(); itr.next())
+  {
+    rEntries.push_back(FileEntry());
+    itr.unmarshal(rEntries.back());
+  }
+}
+
+uint32_t UopReader::getUncompressedSize() const
+{
+  uint32_t totalBytes = 0;
+  for (EntryIterator itr = getEntries(); itr.isValid(); itr.next())
+  {
+    totalBytes += itr.getUncompressedSize();
+  }
+
+  return totalBytes;
+}
+
+/* Returns the data of the entry as it is stored in the file, or NULL if it does not fit inside the file */
+const uint8_t* UopReader::getData(const FileEntry& rEntry) const
+{
+  uint64_t dataOffset = rEntry.UopFileOffset + rEntry.MetaDataSize;
+  if (dataOffset > m_size || getStoredSize(rEntry) > m_size - dataOffset)
+  {
+    return NULL;
+  }
+
+  return m_pData + dataOffset;
+}
+
+/* Writes the UncompressedDataSize bytes of the entry to pDestination.  Fails for a compression method other than 
+ * none or zlib, and for data that does not fit inside the file or does not decompress to the expected size.
+ */
+bool UopReader::readData(const FileEntry& rEntry, uint8_t* pDestination) const
+{
+  const uint8_t* pSource = getData(rEntry);
+  if (pSource == NULL)
+  {
+    return false;
+  }
+
+  if (rEntry.CompressionMethod == COMPRESSION_NONE)
+  {
+    memcpy(pDestination, pSource, rEntry.UncompressedDataSize);
+    return true;
+  }
+
+  if (rEntry.CompressionMethod == COMPRESSION_ZLIB)
+  {
+    return Inflate::decompress(pSource, rEntry.CompressedDataSize, pDestination, rEntry.UncompressedDataSize);
+  }
+
+#ifdef DEBUG
+  printf("Uop entry %llx uses unsupported compression method %u\n", rEntry.PathChecksum, rEntry.CompressionMethod);
+#endif
+
+  return false;
+}
+
+/* Follows the chain of file tables from the header, checking that each one lies inside the file and does not start 
+ * inside a table that was already read, which would make the chain loop.
+ */
+bool UopReader::readFileTables()
+{
+  m_header.unmarshal(m_pData);
+  if (m_header.FileIdentifier != UOP_IDENTIFIER)
+  {
+    return false;
+  }
+
+  uint64_t fileTableOffset = m_header.FileTableOffset;
+  while (fileTableOffset != 0)
+  {
+    if (fileTableOffset > m_size || m_size - fileTableOffset < FILE_TABLE_HEADER_SIZE)
+    {
+      return false;
+    }
+
+    const uint8_t* pFileTable = m_pData + fileTableOffset;
+    FileTableView fileTable;
+    fileTable.capacity = *reinterpret_cast<const uint32_t*>(pFileTable);
+    fileTable.pEntries = pFileTable + FILE_TABLE_HEADER_SIZE;
+
+    if (static_cast<uint64_t>(fileTable.capacity) * FILE_ENTRY_SIZE > m_size - fileTableOffset - FILE_TABLE_HEADER_SIZE)
+    {
+      return false;
+    }
+
+    for (uint32_t i = 0; i < m_fileTables.size(); i++)
+    {
+      const uint8_t* pStart = m_fileTables[i].pEntries - FILE_TABLE_HEADER_SIZE;
+      if (pFileTable >= pStart && pFileTable < m_fileTables[i].pEntries + m_fileTables[i].capacity * FILE_ENTRY_SIZE)
+      {
+        return false;
+      }
+    }
+
+    m_fileTables.push_back(fileTable);
+    fileTableOffset = *reinterpret_cast<const uint64_t*>(pFileTable + 4);
+  }
+
+  return true;
+}
+
+/* Raw entries are read for their uncompressed size, the same as the client does */
+uint32_t UopReader::getStoredSize(const FileEntry& rEntry)
+{
+  return rEntry.CompressionMethod == COMPRESSION_NONE ? rEntry.UncompressedDataSize : rEntry.CompressedDataSize;
+}
+
+UopReader::EntryIterator::EntryIterator(const UopReader* pReader)
+  : m_pReader(pReader),
+  m_fileTable(0),
+  m_pRecord(NULL),
+  m_pFileTableEnd(NULL)
+{
+  if (!m_pReader->m_fileTables.empty())
+  {
+    m_pRecord = m_pReader->m_fileTables[0].pEntries;
+    m_pFileTableEnd = m_pRecord + m_pReader->m_fileTables[0].capacity * FILE_ENTRY_SIZE;
+  }
+
+  skipEmptyEntries();
+}
+
+bool UopReader::EntryIterator::isValid() const
+{
+  return m_fileTable < m_pReader->m_fileTables.size();
+}
+
+void UopReader::EntryIterator::next()
+{
+  m_pRecord += FILE_ENTRY_SIZE;
+  skipEmptyEntries();
+}
+
+/* Moves on to the next slot that has data, carrying on into the next file table at the end of each one */
+void UopReader::EntryIterator::skipEmptyEntries()
+{
+  while (isValid())
+  {
+    if (m_pRecord == m_pFileTableEnd)
+    {
+      m_fileTable++;
+      if (isValid())
+      {
+        m_pRecord = m_pReader->m_fileTables[m_fileTable].pEntries;
+        m_pFileTableEnd = m_pRecord + m_pReader->m_fileTables[m_fileTable].capacity * FILE_ENTRY_SIZE;
+      }
+    }
+    else if (*reinterpret_cast<const uint64_t*>(m_pRecord) == 0)
+    {
+      m_pRecord += FILE_ENTRY_SIZE;
+    }
+    else
+    {
+      break;
+    }
+  }
+}
+
+const uint8_t* UopReader::EntryIterator::getRecord() const
+{
+  return m_pRecord;
+}
+
+uint64_t UopReader::EntryIterator::getPathChecksum() const
+{
+  return *reinterpret_cast<const uint64_t*>(m_pRecord + 20);
+}
+
+uint32_t UopReader::EntryIterator::getUncompressedSize() const
+{
+  return *reinterpret_cast<const uint32_t*>(m_pRecord + 16);
+}
+
+uint16_t UopReader::EntryIterator::getCompressionMethod() const
+{
+  return *reinterpret_cast<const uint16_t*>(m_pRecord + 32);
+}
+
+void UopReader::EntryIterator::unmarshal(FileEntry& rEntry) const
+{
+  rEntry.unmarshal(m_pRecord);
+}
@@ -0,0 +1,121 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+
+#ifndef _UOP_READER_H
+#define _UOP_READER_H
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "UopStructs.h"
+
+/* Reads a uop file in place.  The file is mapped read only, or attached where it has already been read into memory, 
+ * and nothing is copied out of it until an entry's data is asked for.
+ *
+ * The header points at the first file table, a count of entry slots, the offset of the next table and the slots 
+ * themselves, 34 bytes each.  Every table in the chain is checked to lie inside the file when the file is opened, so 
+ * the entries can then be walked with an EntryIterator that reads them straight from the tables.  Slots without data 
+ * are skipped.
+ *
+ * Entry data is stored either raw or as a zlib stream, readData decompresses it when needed.
+ *
+ * The reader is also built into the tests outside of Windows, where files can only be attached.
+ */
+class UopReader
+{
+  public:
+    class EntryIterator
+    {
+      public:
+        bool isValid() const;
+        void next();
+
+        const uint8_t* getRecord() const;
+        uint64_t getPathChecksum() const;
+        uint32_t getUncompressedSize() const;
+        uint16_t getCompressionMethod() const;
+        void unmarshal(FileEntry& rEntry) const;
+
+      private:
+        friend class UopReader;
+        EntryIterator(const UopReader* pReader);
+        void skipEmptyEntries();
+
+        const UopReader* m_pReader;
+        uint32_t m_fileTable;
+        const uint8_t* m_pRecord;
+        const uint8_t* m_pFileTableEnd;
+    };
+
+    UopReader();
+    ~UopReader();
+
+#ifdef _WIN32
+    bool open(std::string path);
+#endif
+    bool attach(const uint8_t* pData, uint32_t size);
+    void close();
+    bool isOpen() const;
+
+    const UopHeader& getHeader() const;
+    EntryIterator getEntries() const;
+    void getEntries(std::vector<FileEntry>& rEntries) const;
+    uint32_t getUncompressedSize() const;
+
+    const uint8_t* getData(const FileEntry& rEntry) const;
+    bool readData(const FileEntry& rEntry, uint8_t* pDestination) const;
+
+    static const uint32_t UOP_IDENTIFIER = 0x0050594D; //myp\0
+    static const uint32_t HEADER_SIZE = 32;
+    static const uint32_t FILE_TABLE_HEADER_SIZE = 12;
+    static const uint32_t FILE_ENTRY_SIZE = 34;
+    static const uint16_t COMPRESSION_NONE = 0;
+    static const uint16_t COMPRESSION_ZLIB = 1;
+
+  private:
+    struct FileTableView
+    {
+      const uint8_t* pEntries;
+      uint32_t capacity;
+    };
+
+    bool readFileTables();
+    static uint32_t getStoredSize(const FileEntry& rEntry);
+
+#ifdef _WIN32
+    HANDLE m_hFile;
+    HANDLE m_hMapping;
+#endif
+    const uint8_t* m_pData;
+    uint32_t m_size;
+    UopHeader m_header;
+    std::vector<FileTableView> m_fileTables;
+};
+
+#endif
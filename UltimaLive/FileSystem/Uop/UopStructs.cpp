@@ -16,44 +16,24 @@
 
 #include "UopStructs.h"
 
-void UopHeader::unmarshal(uint8_t* pData)
+void UopHeader::unmarshal(const uint8_t* pData)
 {
-  FileIdentifier = *reinterpret_cast<uint32_t*>(pData);  //myp\0
-  Version = *reinterpret_cast<uint32_t*>(pData + 4); //0x00000005
-  Signature = *reinterpret_cast<uint32_t*>(pData + 8); 
-  FileTableOffset = *reinterpret_cast<uint64_t*>(pData + 12);
-  FileTableCapacity = *reinterpret_cast<uint32_t*>(pData + 20);
-  TotalFiles = *reinterpret_cast<uint32_t*>(pData + 24);
-  NumFileTables = *reinterpret_cast<uint32_t*>(pData + 28);
+  FileIdentifier = *reinterpret_cast<const uint32_t*>(pData);  //myp\0
+  Version = *reinterpret_cast<const uint32_t*>(pData + 4); //0x00000005
+  Signature = *reinterpret_cast<const uint32_t*>(pData + 8); 
+  FileTableOffset = *reinterpret_cast<const uint64_t*>(pData + 12);
+  FileTableCapacity = *reinterpret_cast<const uint32_t*>(pData + 20);
+  TotalFiles = *reinterpret_cast<const uint32_t*>(pData + 24);
+  NumFileTables = *reinterpret_cast<const uint32_t*>(pData + 28);
 }
 
-void FileEntry::unmarshal(uint8_t* pData)
+void FileEntry::unmarshal(const uint8_t* pData)
 {
-  UopFileOffset = *reinterpret_cast<uint64_t*>(pData);
-  MetaDataSize = *reinterpret_cast<uint32_t*>(pData + 8);
-  CompressedDataSize = *reinterpret_cast<uint32_t*>(pData + 12);
-  UncompressedDataSize = *reinterpret_cast<uint32_t*>(pData + 16);
-  PathChecksum = *reinterpret_cast<uint64_t*>(pData + 20);
-  MetadataCrc = *reinterpret_cast<uint32_t*>(pData + 28);
-  CompressionMethod = *reinterpret_cast<uint16_t*>(pData + 32);
-}
-
-void FileTable::unmarshal(uint8_t* pData)
-{
-    //uint32_t Capacity  = *reinterpret_cast<uint32_t*>(pData);
-    uint64_t OffsetOfNextFileTable  = *reinterpret_cast<uint64_t*>(pData + 4);
-    int count = 0;
-
-    //34
-    for (uint8_t* i = pData + 12; *reinterpret_cast<uint64_t*>(i) != 0; i += 34)
-    {
-      count++;
-    }
-
-    pEntries = new FileEntry[count];
-    for (int i = 0; i < count; ++i)
-    {
-      pEntries[i] = FileEntry();
-      pEntries[i].unmarshal(pData + i * 34 + 12);
-    }
+  UopFileOffset = *reinterpret_cast<const uint64_t*>(pData);
+  MetaDataSize = *reinterpret_cast<const uint32_t*>(pData + 8);
+  CompressedDataSize = *reinterpret_cast<const uint32_t*>(pData + 12);
+  UncompressedDataSize = *reinterpret_cast<const uint32_t*>(pData + 16);
+  PathChecksum = *reinterpret_cast<const uint64_t*>(pData + 20);
+  MetadataCrc = *reinterpret_cast<const uint32_t*>(pData + 28);
+  CompressionMethod = *reinterpret_cast<const uint16_t*>(pData + 32);
 }
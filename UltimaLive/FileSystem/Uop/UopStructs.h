@@ -24,7 +24,7 @@
 class UopHeader
 {
   public:
-    void unmarshal(uint8_t* pData);
+    void unmarshal(const uint8_t* pData);
     uint32_t FileIdentifier;  //myp\0
     uint32_t Version; //0x00000005
     uint32_t Signature; 
@@ -37,7 +37,7 @@ class UopHeader
 class FileEntry
 {
   public:
-    void unmarshal(uint8_t* pData);
+    void unmarshal(const uint8_t* pData);
     uint64_t UopFileOffset;
     uint32_t MetaDataSize;
     uint32_t CompressedDataSize;
@@ -47,15 +47,6 @@ class FileEntry
     uint16_t CompressionMethod;
 };
 
-class FileTable
-{
-  public:
-    void unmarshal(uint8_t* pData);
-    uint32_t Capacity;
-    uint64_t OffsetOfNextFileTable;
-    FileEntry* pEntries;
-};
-
 class UopMetaData
 {
   public:
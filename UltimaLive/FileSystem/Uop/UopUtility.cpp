@@ -15,285 +15,204 @@
  */
 
 #include "UopUtility.h"
-#include "..\..\ProgressBarDialog.h"
-
-void UopUtility::convertUopMapToMul(std::string uopSourceFilename, std::string uopDestFilename, ProgressBarDialog* pProgress)
+#include "UopReader.h"
+#include "UopEntryIndex.h"
+
+/* Copies the map data out of a uop map file into a mul map file.  The uop file is mapped and its entries are matched to 
+ * the map blocks through an index of their path hashes.  Raw entries are copied straight out of the mapping into one 
+ * of two large buffers, compressed entries are decompressed into a scratch buffer first.  Each full buffer is written 
+ * with an overlapped write while the other one is being filled, so reading and writing overlap instead of taking 
+ * turns one entry at a time.  pBytesConverted is advanced as the data is written.
+ */
+bool UopUtility::convertUopMapToMul(std::string uopSourceFilename, std::string mulDestFilename, volatile LONG* pBytesConverted)
 {
-  std::ifstream uopSourceFile;
-  uopSourceFile.open(uopSourceFilename, std::ios::binary | std::ios::in);
+  UopReader reader;
+  if (!reader.open(uopSourceFilename))
+  {
+    return false;
+  }
 
-  if (uopSourceFile.is_open())
+  HANDLE hMulDestFile = CreateFileA(mulDestFilename.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+  if (hMulDestFile == INVALID_HANDLE_VALUE)
   {
-    std::ofstream mulDestFile;
-    mulDestFile.open(uopDestFilename, std::ios::binary | std::ios::out);
+    return false;
+  }
 
-    //read the offset to the file table
-    uopSourceFile.seekg(12, std::ios::beg);
-    uint32_t fileTableOffset = 0;
-    uopSourceFile.read(reinterpret_cast<char*>(&fileTableOffset), sizeof(uint32_t));
+  uint32_t totalFiles = reader.getHeader().TotalFiles;
 
-    uint32_t totalFiles = 0;
-    uopSourceFile.seekg(24, std::ios::beg);
-    uopSourceFile.read(reinterpret_cast<char*>(&totalFiles), sizeof(uint32_t));
+  std::string hashfilename = Utils::getFilenameFromPath(uopSourceFilename);
+  hashfilename = Utils::getBaseFilenameWithoutExtension(hashfilename);
+  std::transform(hashfilename.begin(), hashfilename.end(), hashfilename.begin(), ::tolower);
 
-    std::string hashfilename = Utils::getFilenameFromPath(uopSourceFilename);
-    hashfilename = Utils::getBaseFilenameWithoutExtension(hashfilename);
-    std::transform(hashfilename.begin(), hashfilename.end(), hashfilename.begin(), ::tolower);
+  std::vector<uint64_t> hashes;
+  UopPathHash::getMapHashes(totalFiles, hashfilename, hashes);
 
-    std::map<uint32_t, uint64_t>* pHashes = UopUtility::getMapHashes(totalFiles, hashfilename);
+  std::vector<FileEntry> entries;
+  reader.getEntries(entries);
 
-    //seek the first file entry
-    char fileEntryBuffer[34];
-    uint32_t filePosition = fileTableOffset + 12;
-    uopSourceFile.seekg(filePosition, std::ios::beg);
-    uopSourceFile.read(fileEntryBuffer, 34);
-    std::map<uint64_t, FileEntry*> entries;
+  UopEntryIndex index;
+  index.build(entries.empty() ? NULL : &entries[0], static_cast<uint32_t>(entries.size()));
 
-    uint32_t totalFileSizeInBytes = 0;
+  //match every map block to its entry up front, which also gives the size of the mul file
+  std::vector<int32_t> blockEntries(totalFiles);
+  uint32_t totalFileSizeInBytes = 0;
+  bool succeeded = true;
 
-    //read through all the file entries and count the bytes
-    while (*reinterpret_cast<uint64_t*>(fileEntryBuffer) != 0)
+  for (uint32_t i = 0; i < totalFiles && succeeded; ++i)
+  {
+    blockEntries[i] = index.find(hashes[i]);
+    if (blockEntries[i] == UopEntryIndex::EMPTY_SLOT)
     {
-       FileEntry* pEntry = new FileEntry(); 
-       pEntry->unmarshal(reinterpret_cast<uint8_t*>(fileEntryBuffer));
-    
-       if (entries.find(pEntry->PathChecksum) == entries.end())
-       {
-         entries[pEntry->PathChecksum] = pEntry;
-         totalFileSizeInBytes += pEntry->UncompressedDataSize;
-       }
-
-       filePosition += 34;
-       uopSourceFile.seekg(filePosition, std::ios::beg);
-       uopSourceFile.read(fileEntryBuffer, 34);
-    }
-    
 #ifdef DEBUG
-    printf("There are %i file entries in the list\n", entries.size());
+      printf("No file entry for map block %u in %s\n", i, uopSourceFilename.c_str());
 #endif
-    uint32_t bytesCopied = 0;
-    uint32_t prevPercent = 0;
-
-    for(uint32_t i = 0; i < totalFiles; ++i)
-    {
-      uint64_t hash = (*pHashes)[i];
-      FileEntry* pEntry = entries[hash];
-
-      char* pEntryData = new char[pEntry->UncompressedDataSize];
-      uopSourceFile.seekg(pEntry->UopFileOffset + pEntry->MetaDataSize, std::ios::beg);
-      uopSourceFile.read(pEntryData, pEntry->UncompressedDataSize);
-      mulDestFile.write(pEntryData, pEntry->UncompressedDataSize);
-
-      bytesCopied += pEntry->UncompressedDataSize;
-      if (pProgress != NULL)
-      {
-        uint32_t percent = (uint32_t)(((float)bytesCopied / (float)totalFileSizeInBytes) * 100.0f);
-        if ((uint32_t)percent > prevPercent)
-        {
-          prevPercent = percent;
-          pProgress->setProgress((uint32_t)percent);
-        }
-      }
-
-      delete pEntryData;
+      succeeded = false;
+      break;
     }
 
-    delete pHashes;
-    mulDestFile.flush();
-    mulDestFile.close();
-    uopSourceFile.close();
+    totalFileSizeInBytes += entries[blockEntries[i]].UncompressedDataSize;
   }
-}
-
-/*
-  This method assumes that there is only one file table.
-*/
-uint32_t UopUtility::getUopMapSizeInBytes(std::string filename)
-{
-  uint32_t totalBytes = 0;
-  std::ifstream mapFile;
-  mapFile.open(filename, std::ios::binary | std::ios::in);
-
-  if (mapFile.is_open())
-  {
-    //read the offset to the file table
-    mapFile.seekg(12, std::ios::beg);
-    uint32_t fileTableOffset = 0;
-    mapFile.read(reinterpret_cast<char*>(&fileTableOffset), sizeof(uint32_t));
-
-    //seek the first file entry
-    char fileEntryBuffer[34];
-    uint32_t filePosition = fileTableOffset + 12;
-    mapFile.seekg(filePosition, std::ios::beg);
-    mapFile.read(fileEntryBuffer, 34);
-
-    //read through all the file entries and count the bytes
-    while (*reinterpret_cast<uint64_t*>(fileEntryBuffer) != 0)
-    {
-       FileEntry entry; 
-       entry.unmarshal(reinterpret_cast<uint8_t*>(fileEntryBuffer));
-       totalBytes += entry.UncompressedDataSize;
-
-       if (entry.UncompressedDataSize != entry.CompressedDataSize)
-       {
-         printf("Size mismatches\n");
-       }
-
-       filePosition += 34;
-       mapFile.seekg(filePosition, std::ios::beg);
-       mapFile.read(fileEntryBuffer, 34);
-    }
+    
+#ifdef DEBUG
+  printf("There are %u file entries in the list\n", index.getNumberOfEntries());
+#endif
 
-    mapFile.close();
-  }
+  //size the mul file up front so that it is laid out in one piece
+  SetFilePointer(hMulDestFile, totalFileSizeInBytes, NULL, FILE_BEGIN);
+  SetEndOfFile(hMulDestFile);
 
-  return totalBytes;
-}
+  uint8_t* pBuffers = reinterpret_cast<uint8_t*>(VirtualAlloc(NULL, CONVERSION_BUFFER_SIZE * 2, MEM_COMMIT, PAGE_READWRITE));
+  OVERLAPPED writes[2];
+  bool writePending[2] = { false, false };
+  memset(writes, 0, sizeof(writes));
+  writes[0].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+  writes[1].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
 
-std::string ZeroPadNumber(int num, int fieldWidth)
-{
-	std::stringstream ss;
-	
-	// the number is converted to string with the help of stringstream
-	ss << num; 
-	std::string ret;
-	ss >> ret;
-	
-	// Append zero chars
-	int str_length = ret.length();
-	for (int i = 0; i < fieldWidth - str_length; i++)
-		ret = "0" + ret;
-	return ret;
-}
+  succeeded = succeeded && pBuffers != NULL;
+  uint32_t currentBuffer = 0;
+  uint32_t bytesInBuffer = 0;
+  uint32_t destOffset = 0;
+  std::vector<uint8_t> decompressed;
 
-std::map<uint32_t, uint64_t>* UopUtility::getMapHashes(int count, std::string pattern)
-{
-  std::map<uint32_t, uint64_t>* pHashes = new std::map<uint32_t, uint64_t>();
-
-  for (int i = 0; i < count; i++)
+  for (uint32_t i = 0; i < totalFiles && succeeded; ++i)
   {
-    std::string filename("build/");
-    filename.append(pattern);
-    filename.append("/");
-    filename.append(ZeroPadNumber(i, 8));
-    filename.append(".dat");
-
-    uint64_t hash = HashFileName(filename);
-    if (pHashes->find(i) == pHashes->end())
+    const FileEntry& rEntry = entries[blockEntries[i]];
+    uint32_t bytesLeftInEntry = rEntry.UncompressedDataSize;
+    if (bytesLeftInEntry == 0)
     {
-      (*pHashes)[i] = hash;
+      //an empty block adds nothing to the mul file, and there is nothing to read or decompress for it
+      continue;
     }
-  }
 
-  return pHashes;
-}
-
-uint64_t UopUtility::HashFileName(std::string s)
-{
-  uint32_t esi = (uint32_t)s.length() + 0xDEADBEEF;
-  uint32_t eax = 0;
-  uint32_t ecx = 0;
-  uint32_t edx = 0;
-  uint32_t ebx = esi;
-  uint32_t edi = esi;
-
-  uint32_t i = 0;
-
-  for (i = 0; i + 12 < s.length(); i += 12)
-  {
-    edi = (uint32_t)((s[i + 7] << 24) | (s[i + 6] << 16) | (s[i + 5] << 8) | s[i + 4]) + edi;
-    esi = (uint32_t)((s[i + 11] << 24) | (s[i + 10] << 16) | (s[i + 9] << 8) | s[i + 8]) + esi;
-    edx = (uint32_t)((s[i + 3] << 24) | (s[i + 2] << 16) | (s[i + 1] << 8) | s[i]) - esi;
-
-    edx = (edx + ebx) ^ (esi >> 28) ^ (esi << 4);
-    esi += edi;
-    edi = (edi - edx) ^ (edx >> 26) ^ (edx << 6);
-    edx += esi;
-    esi = (esi - edi) ^ (edi >> 24) ^ (edi << 8);
-    edi += edx;
-    ebx = (edx - esi) ^ (esi >> 16) ^ (esi << 16);
-    esi += edi;
-    edi = (edi - ebx) ^ (ebx >> 13) ^ (ebx << 19);
-    ebx += esi;
-    esi = (esi - edi) ^ (edi >> 28) ^ (edi << 4);
-    edi += ebx;
-  }
-
-  if (static_cast<int32_t>(s.length() - i) > 0)
-  {
-    uint32_t len = s.length() - i;
-
-    if (len > 11)
+    const uint8_t* pSource = NULL;
+    if (rEntry.CompressionMethod == UopReader::COMPRESSION_NONE)
     {
-      esi += (uint32_t)s[i + 11] << 24;
+      pSource = reader.getData(rEntry);
     }
-
-    if (len > 10)
+    else
     {
-      esi += (uint32_t)s[i + 10] << 16;
+      decompressed.resize(bytesLeftInEntry);
+      if (reader.readData(rEntry, &decompressed[0]))
+      {
+        pSource = &decompressed[0];
+      }
     }
 
-    if (len > 9)
+    if (pSource == NULL)
     {
-      esi += (uint32_t)s[i + 9] << 8;
+#ifdef DEBUG
+      printf("Failed to read the entry of map block %u in %s\n", i, uopSourceFilename.c_str());
+#endif
+      succeeded = false;
+      break;
     }
 
-    if (len > 8)
+    while (bytesLeftInEntry > 0 && succeeded)
     {
-      esi += (uint32_t)s[i + 8];
-    }
+      uint32_t bytesToCopy = CONVERSION_BUFFER_SIZE - bytesInBuffer;
+      if (bytesToCopy > bytesLeftInEntry)
+      {
+        bytesToCopy = bytesLeftInEntry;
+      }
 
-    if (len > 7)
-    {
-      edi += (uint32_t)s[i + 7] << 24;
-    }
+      memcpy(pBuffers + (currentBuffer * CONVERSION_BUFFER_SIZE) + bytesInBuffer, pSource, bytesToCopy);
+      pSource += bytesToCopy;
+      bytesInBuffer += bytesToCopy;
+      bytesLeftInEntry -= bytesToCopy;
 
-    if (len > 6)
-    {
-      edi += (uint32_t)s[i + 6] << 16;
+      if (bytesInBuffer == CONVERSION_BUFFER_SIZE)
+      {
+        succeeded = writeBuffer(hMulDestFile, pBuffers, writes, writePending, currentBuffer, bytesInBuffer, destOffset, pBytesConverted);
+      }
     }
+  }
 
-    if (len > 5)
-    {
-      edi += (uint32_t)s[i + 5] << 8;
-    }
+  //write out whatever is left in the last buffer, it is not full and the last entries may not have added anything to it
+  if (succeeded && bytesInBuffer > 0)
+  {
+    succeeded = writeBuffer(hMulDestFile, pBuffers, writes, writePending, currentBuffer, bytesInBuffer, destOffset, pBytesConverted);
+  }
 
-    if (len > 4)
-    {
-      edi += (uint32_t)s[i + 4];
-    }
+  succeeded = waitForWrite(hMulDestFile, &writes[0], writePending[0]) && succeeded;
+  succeeded = waitForWrite(hMulDestFile, &writes[1], writePending[1]) && succeeded;
 
-    if (len > 3)
-    {
-      ebx += (uint32_t)s[i + 3] << 24;
-    }
+  CloseHandle(writes[0].hEvent);
+  CloseHandle(writes[1].hEvent);
 
-    if (len > 2)
-    {
-      ebx += (uint32_t)s[i + 2] << 16;
-    }
+  if (pBuffers != NULL)
+  {
+    VirtualFree(pBuffers, 0, MEM_RELEASE);
+  }
 
-    if (len > 1)
-    {
-      ebx += (uint32_t)s[i + 1] << 8;
-    }
+  CloseHandle(hMulDestFile);
+  reader.close();
 
-    if (len > 0)
-    {
-      ebx += (uint32_t)s[i];
-    }
+  //anything short of the size the file was laid out with leaves blocks of zeroes at the end of the map
+  return succeeded && destOffset == totalFileSizeInBytes;
+}
+
+/* Starts the overlapped write of the current buffer and switches to the other one, waiting for its write to be done 
+ * before it is filled again.
+ */
+bool UopUtility::writeBuffer(HANDLE hFile, uint8_t* pBuffers, OVERLAPPED* pWrites, bool* pWritePending, uint32_t& rCurrentBuffer, uint32_t& rBytesInBuffer, uint32_t& rDestOffset, volatile LONG* pBytesConverted)
+{
+  pWrites[rCurrentBuffer].Offset = rDestOffset;
+  ResetEvent(pWrites[rCurrentBuffer].hEvent);
+  if (!WriteFile(hFile, pBuffers + (rCurrentBuffer * CONVERSION_BUFFER_SIZE), rBytesInBuffer, NULL, &pWrites[rCurrentBuffer]) && GetLastError() != ERROR_IO_PENDING)
+  {
+    return false;
+  }
+
+  pWritePending[rCurrentBuffer] = true;
+  rDestOffset += rBytesInBuffer;
+  InterlockedExchangeAdd(pBytesConverted, rBytesInBuffer);
 
-    esi = (esi ^ edi) - ((edi >> 18) ^ (edi << 14));
-    ecx = (esi ^ ebx) - ((esi >> 21) ^ (esi << 11));
-    edi = (edi ^ ecx) - ((ecx >> 7) ^ (ecx << 25));
-    esi = (esi ^ edi) - ((edi >> 16) ^ (edi << 16));
-    edx = (esi ^ ecx) - ((esi >> 28) ^ (esi << 4));
-    edi = (edi ^ edx) - ((edx >> 18) ^ (edx << 14));
-    eax = (esi ^ edi) - ((edi >> 8) ^ (edi << 24));
+  //the other buffer is filled next, its write has to be done first
+  rCurrentBuffer ^= 1;
+  rBytesInBuffer = 0;
+  return waitForWrite(hFile, &pWrites[rCurrentBuffer], pWritePending[rCurrentBuffer]);
+}
 
-    return ((uint64_t)edi << 32) | eax;
+bool UopUtility::waitForWrite(HANDLE hFile, OVERLAPPED* pWrite, bool& rPending)
+{
+  if (!rPending)
+  {
+    return true;
   }
 
-  return ((uint64_t)esi << 32) | eax;
+  rPending = false;
+  DWORD bytesWritten = 0;
+  return GetOverlappedResult(hFile, pWrite, &bytesWritten, TRUE) != FALSE;
 }
 
+/* Adds up the uncompressed sizes of the entries in all of the file tables */
+uint32_t UopUtility::getUopMapSizeInBytes(std::string filename)
+{
+  UopReader reader;
+  if (!reader.open(filename))
+  {
+    return 0;
+  }
+
+  return reader.getUncompressedSize();
+}
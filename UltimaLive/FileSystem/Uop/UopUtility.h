@@ -17,25 +17,30 @@
 
 #ifndef _UOP_UTILITIES_H
 #define _UOP_UTILITIES_H
+#include <Windows.h>
 #include <stdint.h>
 #include <string>
 #include <map>
 #include <list>
+#include <vector>
 #include <sstream>
 #include <fstream>
 #include "UopStructs.h"
+#include "UopPathHash.h"
 #include "..\..\Utils.h"
 #include <algorithm>
 
-class ProgressBarDialog;
-
 class UopUtility
 {
   public:
-    static uint64_t HashFileName(std::string s);
-    static std::map<uint32_t, uint64_t>* getMapHashes(int count, std::string pattern);
     static uint32_t getUopMapSizeInBytes(std::string filename);
-    static void convertUopMapToMul(std::string uopSourceFilename, std::string uopDestFilename, ProgressBarDialog* pProgress);
+    static bool convertUopMapToMul(std::string uopSourceFilename, std::string mulDestFilename, volatile LONG* pBytesConverted);
+
+    static const uint32_t CONVERSION_BUFFER_SIZE = 0x400000;
+
+  private:
+    static bool writeBuffer(HANDLE hFile, uint8_t* pBuffers, OVERLAPPED* pWrites, bool* pWritePending, uint32_t& rCurrentBuffer, uint32_t& rBytesInBuffer, uint32_t& rDestOffset, volatile LONG* pBytesConverted);
+    static bool waitForWrite(HANDLE hFile, OVERLAPPED* pWrite, bool& rPending);
 };
 
 #endif
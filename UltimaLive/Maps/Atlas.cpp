@@ -29,6 +29,11 @@ Atlas::Atlas(BaseFileManager* pManager, UoLiveAppState* pAppState, NetworkManage
   m_pNetManager(pNetManager),
   m_shardIdentifier(),
   m_firstMapLoad(true),
+  m_lastTouchedBlock(0xFFFFFFFF),
+  m_lastHashWindow(),
+  m_regionHashes(),
+  m_regionHashMapNumber(0),
+  m_refreshScheduler(RefreshScheduler::DEFAULT_BUDGET_US),
   m_pMapThingieTable(NULL),
   m_pClientMinDisplayX(NULL),
   m_pClientMinDisplayY(NULL),
@@ -105,6 +110,10 @@ void Atlas::onShardIdentifierUpdate(std::string shardIdentifier)
 
 void Atlas::onLogout()
 {
+  m_lastHashWindow.clear();
+  m_regionHashes.clear();
+  m_refreshScheduler.printStatistics();
+  m_refreshScheduler.clear();
   m_pFileManager->onLogout();
 }
 
@@ -128,6 +137,10 @@ void Atlas::LoadMap(uint8_t map)
     *reinterpret_cast<uint16_t*>(m_pAppState->m_pMapDimensions + 12) = m_mapDefinitions[map].mapWrapHeightInTiles;
     m_pFileManager->LoadMap(map);
     m_currentMap = map;
+    m_lastTouchedBlock = 0xFFFFFFFF;
+    m_lastHashWindow.clear();
+    m_regionHashes.clear();
+    m_refreshScheduler.clear();
   }
 #ifdef DEBUG
   else 
@@ -144,12 +157,17 @@ void Atlas::LoadMap(uint8_t map)
 
 void Atlas::init()
 {
+  m_refreshScheduler.setRefreshFunctions(std::bind(&Atlas::purgeClientStatics, this, std::placeholders::_1, std::placeholders::_2), 
+    std::bind(&Atlas::refreshClientLand, this, std::placeholders::_1));
   m_pNetManager->subscribeToOnBeforeMapChange(std::bind(&Atlas::onBeforeMapChange, this, std::placeholders::_1));
   m_pNetManager->subscribeToOnMapChange(std::bind(&Atlas::onMapChange, this, std::placeholders::_1));
   m_pNetManager->subscribeToRefreshClient(std::bind(&Atlas::onRefreshClientView, this));
   m_pNetManager->subscribeToBlockQueryRequest(std::bind(&Atlas::onHashQuery, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+  m_pNetManager->subscribeToDeltaBlockQueryRequest(std::bind(&Atlas::onDeltaHashQuery, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+  m_pNetManager->subscribeToRegionHashQuery(std::bind(&Atlas::onRegionHashQuery, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
   m_pNetManager->subscribeToStaticsUpdate(std::bind(&Atlas::onUpdateStatics, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
   m_pNetManager->subscribeToMapDefinitionUpdate(std::bind(&Atlas::onUpdateMapDefinitions, this, std::placeholders::_1));
+  m_pNetManager->subscribeToBlockBatchUpdate(std::bind(&Atlas::onUpdateBlockBatch, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
   m_pNetManager->subscribeToLandUpdate(std::bind(&Atlas::onUpdateLand, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
   m_pNetManager->subscribeToUltimaLiveLoginComplete(std::bind(&Atlas::onShardIdentifierUpdate, this, std::placeholders::_1));
   m_pNetManager->subscribeToLogout(std::bind(&Atlas::onLogout, this));
@@ -230,7 +248,8 @@ struct StaticObject
  /* 0x69 */ StaticObject* pPrevMultiComponent;
 };
 
-void Atlas::refreshClientLand(uint8_t mapNumber, uint32_t blockNumber)
+/* Takes the terrain off the draw table and has the client reload it, which redraws all of the terrain on screen */
+void Atlas::refreshClientLand(uint8_t mapNumber)
 {
   if (m_mapDefinitions.find(mapNumber) != m_mapDefinitions.end())
   {
@@ -270,13 +289,74 @@ void Atlas::refreshClientLand(uint8_t mapNumber, uint32_t blockNumber)
 void Atlas::onUpdateStatics(uint8_t mapNumber, uint32_t blockNumber, uint8_t* pData, uint32_t length)
 {
   m_pFileManager->writeStaticsBlock(mapNumber, blockNumber, pData, length);
-  refreshClientStatics(mapNumber, blockNumber);
+  if (!m_regionHashes.isEmpty() && mapNumber == m_regionHashMapNumber)
+  {
+    m_regionHashes.invalidateBlock(blockNumber);
+  }
+  m_refreshScheduler.queueStatics(mapNumber, blockNumber);
+  runOverdueRefreshes();
 }
 
 void Atlas::onUpdateLand(uint8_t mapNumber, uint32_t blockNumber, uint8_t* pLandData)
 {
   m_pFileManager->updateLandBlock(mapNumber, blockNumber, pLandData);
-  refreshClientLand(mapNumber, blockNumber);
+  if (!m_regionHashes.isEmpty() && mapNumber == m_regionHashMapNumber)
+  {
+    m_regionHashes.invalidateBlock(blockNumber);
+  }
+  m_refreshScheduler.queueLand(mapNumber, blockNumber);
+  runOverdueRefreshes();
+}
+
+/* A batch is written through the file manager in one go, and its blocks are queued for the next frame's refresh */
+void Atlas::onUpdateBlockBatch(uint8_t mapNumber, uint8_t* pRecords, uint32_t length)
+{
+  std::vector<uint32_t> landBlocks;
+  std::vector<uint32_t> staticsBlocks;
+  m_pFileManager->applyBlockBatch(mapNumber, pRecords, length, landBlocks, staticsBlocks);
+
+  if (!m_regionHashes.isEmpty() && mapNumber == m_regionHashMapNumber)
+  {
+    for (std::vector<uint32_t>::iterator itr = landBlocks.begin(); itr != landBlocks.end(); itr++)
+    {
+      m_regionHashes.invalidateBlock(*itr);
+    }
+
+    for (std::vector<uint32_t>::iterator itr = staticsBlocks.begin(); itr != staticsBlocks.end(); itr++)
+    {
+      m_regionHashes.invalidateBlock(*itr);
+    }
+  }
+
+  for (std::vector<uint32_t>::iterator itr = landBlocks.begin(); itr != landBlocks.end(); itr++)
+  {
+    m_refreshScheduler.queueLand(mapNumber, *itr);
+  }
+
+  for (std::vector<uint32_t>::iterator itr = staticsBlocks.begin(); itr != staticsBlocks.end(); itr++)
+  {
+    m_refreshScheduler.queueStatics(mapNumber, *itr);
+  }
+
+  runOverdueRefreshes();
+}
+
+/* Called from the client's update statics blocks function every frame, before the client reloads its blocks */
+void Atlas::onClientFrame()
+{
+  m_refreshScheduler.runFrame();
+}
+
+/* Refreshes the queued blocks right away if the client hasn't drawn a frame in a while, so updates still show up 
+ * when the frame hook isn't being called
+ */
+void Atlas::runOverdueRefreshes()
+{
+  if (m_refreshScheduler.isOverdue())
+  {
+    m_refreshScheduler.runFrame();
+    ClientRedirections::UpdateStaticBlocks();
+  }
 }
 
 void Atlas::onHashQuery(uint32_t blockNumber, uint8_t mapNumber, uint16_t sequence)
@@ -285,9 +365,13 @@ void Atlas::onHashQuery(uint32_t blockNumber, uint8_t mapNumber, uint16_t sequen
   printf("Atlas: Got Hash Query\n");
 #endif
 
-  uint16_t* crcs = GetGroupOfBlockCrcs(mapNumber, blockNumber);
+  touchBlocksAround(mapNumber, blockNumber);
+
+  uint16_t crcs[25];
+  GetGroupOfBlockCrcs(mapNumber, blockNumber, crcs);
+  rememberHashWindow(mapNumber, blockNumber);
   
-  uint8_t* pResponse = new uint8_t[71];
+  uint8_t pResponse[71];
   
   pResponse[0] = 0x3F;                                               //byte 000              -  cmd
   *reinterpret_cast<uint16_t*>(pResponse + 1) = 71;                  //byte 001 through 002  -  packet size
@@ -310,7 +394,144 @@ void Atlas::onHashQuery(uint32_t blockNumber, uint8_t mapNumber, uint16_t sequen
   pResponse[70] = 0xFF;                                           //byte 070              -  padding
   
   m_pNetManager->sendPacketToServer(pResponse);
-  delete pResponse;
+}
+
+/* Answers a hash query with only the blocks of the window that were not in the last window answered for the map.  The 
+ * server has already compared the others, so when the player steps one block only the five newly exposed blocks are 
+ * hashed and sent.  Each block goes out as its position in the window followed by its crc.
+ */
+void Atlas::onDeltaHashQuery(uint32_t blockNumber, uint8_t mapNumber, uint16_t sequence)
+{
+  touchBlocksAround(mapNumber, blockNumber);
+
+  int32_t blocks[HASH_WINDOW_SIZE];
+  getHashWindowBlocks(mapNumber, blockNumber, blocks);
+
+  uint8_t positions[HASH_WINDOW_SIZE];
+  uint16_t crcs[HASH_WINDOW_SIZE];
+  uint32_t numberOfBlocks = m_lastHashWindow.getNewPositions(mapNumber, blocks, positions);
+  for (uint32_t i = 0; i < numberOfBlocks; i++)
+  {
+    crcs[i] = (blocks[positions[i]] >= 0) ? getBlockCrc(mapNumber, blocks[positions[i]]) : 0;
+  }
+  m_lastHashWindow.remember(mapNumber, blocks);
+
+#ifdef DEBUG
+  printf("Atlas: Answering delta hash query with %u of %u blocks\n", numberOfBlocks, HASH_WINDOW_SIZE);
+#endif
+
+  uint32_t payloadLength = 1 + (numberOfBlocks * 3);
+  uint32_t count = (payloadLength + 6) / 7;
+  uint32_t packetLength = 15 + (count * 7);
+
+  uint8_t pResponse[15 + (((1 + (HASH_WINDOW_SIZE * 3)) + 6) / 7) * 7];
+  memset(pResponse, 0xFF, sizeof(pResponse));
+  pResponse[0] = 0x3F;                                               //byte 000              -  cmd
+  *reinterpret_cast<uint16_t*>(pResponse + 1) = static_cast<uint16_t>(packetLength); //byte 001 through 002  -  packet size
+  *reinterpret_cast<uint32_t*>(pResponse + 3) = htonl(blockNumber);  //byte 003 through 006  -  central block number for the query (block that player is standing in)
+  *reinterpret_cast<uint32_t*>(pResponse + 7) = htonl(count);        //byte 007 through 010  -  number of statics in the packet (payload rounded up to 7 bytes)
+  *reinterpret_cast<uint16_t*>(pResponse + 11) = htons(sequence);    //byte 011 through 012  -  UltimaLive sequence number
+  pResponse[13] = 0x05;                                              //byte 013              -  UltimaLive command (0x05 is a Delta Block Query Response)
+  pResponse[14] = mapNumber;                                         //byte 014              -  UltimaLive mapnumber
+  pResponse[15] = static_cast<uint8_t>(numberOfBlocks);              //byte 015              -  number of blocks
+                                                                     //byte 016 through end  -  window position and crc of each block, 0xFF padding
+  for (uint32_t i = 0; i < numberOfBlocks; i++)
+  {
+    pResponse[16 + (i * 3)] = positions[i];
+    *reinterpret_cast<uint16_t*>(pResponse + 17 + (i * 3)) = htons(crcs[i]);
+  }
+
+  m_pNetManager->sendPacketToServer(pResponse);
+}
+
+void Atlas::rememberHashWindow(uint8_t mapNumber, uint32_t blockNumber)
+{
+  int32_t blocks[HASH_WINDOW_SIZE];
+  getHashWindowBlocks(mapNumber, blockNumber, blocks);
+  m_lastHashWindow.remember(mapNumber, blocks);
+}
+
+/* At login the server walks the region hash tree down from a level with only a few nodes, asking for the hashes of 
+ * the nodes it disagrees with one level at a time, until it is down to the blocks it needs to send.  The tree for 
+ * the loaded map is built the first time it is asked for, so every block crc is read once per map load at most.
+ */
+void Atlas::onRegionHashQuery(uint8_t mapNumber, uint32_t level, uint16_t sequence, std::vector<uint32_t> nodes)
+{
+#ifdef DEBUG
+  LARGE_INTEGER startTime;
+  LARGE_INTEGER endTime;
+  LARGE_INTEGER frequency;
+  QueryPerformanceCounter(&startTime);
+#endif
+
+  if (m_regionHashes.isEmpty() || mapNumber != m_regionHashMapNumber)
+  {
+    m_regionHashes.clear();
+    m_regionHashMapNumber = mapNumber;
+
+    if (m_mapDefinitions.find(mapNumber) != m_mapDefinitions.end())
+    {
+      MapDefinition def = m_mapDefinitions[mapNumber];
+      m_regionHashes.reset(def.mapWidthInTiles >> 3, def.mapHeightInTiles >> 3, std::bind(&Atlas::getBlockCrc, this, mapNumber, std::placeholders::_1));
+    }
+  }
+
+  uint32_t nodeCount = min(static_cast<uint32_t>(nodes.size()), MAX_REGION_HASHES_PER_QUERY);
+  uint32_t payloadLength = 2 + (nodeCount * 8);
+  uint32_t count = (payloadLength + 6) / 7;
+  uint32_t packetLength = 15 + (count * 7);
+
+  std::vector<uint8_t> response(packetLength, 0xFF);
+  uint8_t* pResponse = &response[0];
+  pResponse[0] = 0x3F;                                               //byte 000              -  cmd
+  *reinterpret_cast<uint16_t*>(pResponse + 1) = static_cast<uint16_t>(packetLength); //byte 001 through 002  -  packet size
+  *reinterpret_cast<uint32_t*>(pResponse + 3) = htonl(level);        //byte 003 through 006  -  tree level of the nodes in the packet
+  *reinterpret_cast<uint32_t*>(pResponse + 7) = htonl(count);        //byte 007 through 010  -  number of statics in the packet (payload rounded up to 7 bytes)
+  *reinterpret_cast<uint16_t*>(pResponse + 11) = htons(sequence);    //byte 011 through 012  -  UltimaLive sequence number
+  pResponse[13] = 0x04;                                              //byte 013              -  UltimaLive command (0x04 is a Region Hash Query Response)
+  pResponse[14] = mapNumber;                                         //byte 014              -  UltimaLive mapnumber
+  *reinterpret_cast<uint16_t*>(pResponse + 15) = htons(static_cast<uint16_t>(nodeCount)); //byte 015 through 016  -  number of nodes
+                                                                     //byte 017 through end  -  node index and hash pairs, 0xFF padding
+  for (uint32_t i = 0; i < nodeCount; i++)
+  {
+    *reinterpret_cast<uint32_t*>(pResponse + 17 + (i * 8)) = htonl(nodes[i]);
+    *reinterpret_cast<uint32_t*>(pResponse + 21 + (i * 8)) = htonl(m_regionHashes.getNodeHash(level, nodes[i]));
+  }
+
+#ifdef DEBUG
+  QueryPerformanceCounter(&endTime);
+  QueryPerformanceFrequency(&frequency);
+  printf("Atlas: Hashed %u level %u regions in %.1f us\n", nodeCount, level, ((endTime.QuadPart - startTime.QuadPart) * 1000000.0) / frequency.QuadPart);
+#endif
+
+  m_pNetManager->sendPacketToServer(pResponse);
+}
+
+/* The server asks for block hashes whenever the player walks into a new block, which makes it the place to bring in the 
+ * map data around the player before the client draws it.  Each column of blocks is contiguous in the map files.
+ */
+void Atlas::touchBlocksAround(uint8_t mapNumber, uint32_t blockNumber)
+{
+  if (blockNumber == m_lastTouchedBlock || m_mapDefinitions.find(mapNumber) == m_mapDefinitions.end())
+  {
+    return;
+  }
+
+  m_lastTouchedBlock = blockNumber;
+
+  MapDefinition def = m_mapDefinitions[mapNumber];
+  int32_t mapWidthInBlocks = def.mapWidthInTiles >> 3;
+  int32_t mapHeightInBlocks = def.mapHeightInTiles >> 3;
+  int32_t blockX = (int32_t)blockNumber / mapHeightInBlocks;
+  int32_t blockY = (int32_t)blockNumber % mapHeightInBlocks;
+
+  int32_t minY = max(blockY - TOUCH_RADIUS_IN_BLOCKS, 0);
+  int32_t maxY = min(blockY + TOUCH_RADIUS_IN_BLOCKS, mapHeightInBlocks - 1);
+
+  for (int32_t x = max(blockX - TOUCH_RADIUS_IN_BLOCKS, 0); x <= min(blockX + TOUCH_RADIUS_IN_BLOCKS, mapWidthInBlocks - 1); x++)
+  {
+    m_pFileManager->touchBlocks(mapNumber, (x * mapHeightInBlocks) + minY, (maxY - minY) + 1);
+  }
 }
 
 void Atlas::onUpdateMapDefinitions(std::vector<MapDefinition> definitions)
@@ -326,16 +547,16 @@ void Atlas::onUpdateMapDefinitions(std::vector<MapDefinition> definitions)
   }
 }
 
-void Atlas::refreshClientStatics(uint8_t mapNumber, uint32_t blockNumber)
+/* Takes the statics of the blocks out of the draw list and marks them for the client to reload, walking the master 
+ * statics list once however many blocks there are.  The client reloads them when it next updates its static blocks.
+ * The block numbers come sorted from the refresh scheduler, so each static is looked up with a binary search.
+ */
+void Atlas::purgeClientStatics(uint8_t mapNumber, const std::vector<uint32_t>& blockNumbers)
 {
   if (m_mapDefinitions.find(mapNumber) != m_mapDefinitions.end())
   {
     MapDefinition def = m_mapDefinitions[mapNumber];
-    int32_t upperLeftX = ((int32_t)blockNumber /  (def.mapHeightInTiles >> 3)) * 8;
-    int32_t upperLeftY = ((int32_t)blockNumber % (def.mapHeightInTiles >> 3)) * 8;
 
-    CDrawItem* pDrawItem = reinterpret_cast<CDrawItem*>(m_pMapThingieTable + ( (((upperLeftY & 0x3F) * 64) + (upperLeftX & 0x3F)) * sizeof(uint32_t)));
-    
     //This may need to be added back in later, it was causing a client crash; It's using a hard coded address, which needs a signature anyway
     //StaticObject* pPrevStatic = NULL;
     //PURGE MASTER STATIC LIST
@@ -347,7 +568,7 @@ void Atlas::refreshClientStatics(uint8_t mapNumber, uint32_t blockNumber)
     
       uint32_t staticBlockNumber = ((pStaticItem->X >> 3) * (def.mapHeightInTiles >> 3)) + (pStaticItem->Y >> 3);
     
-      if (staticBlockNumber == blockNumber && !isDynamic)
+      if (!isDynamic && std::binary_search(blockNumbers.begin(), blockNumbers.end(), staticBlockNumber))
       {
         if (pStaticItem->InDrawList != 0)
         {
@@ -362,7 +583,7 @@ void Atlas::refreshClientStatics(uint8_t mapNumber, uint32_t blockNumber)
     //Clear Client Blocks Array
     for (int i = 0; i < 36; i++)
     {
-      if ( reinterpret_cast<int*>(m_pClientBlockArray)[i] == blockNumber)
+      if (std::binary_search(blockNumbers.begin(), blockNumbers.end(), static_cast<uint32_t>(reinterpret_cast<int*>(m_pClientBlockArray)[i])))
       {
         reinterpret_cast<int*>(m_pClientBlockArray)[i] = -1;
       }
@@ -371,8 +592,6 @@ void Atlas::refreshClientStatics(uint8_t mapNumber, uint32_t blockNumber)
     //Set Client Minimum Displayed X to -9999
     *reinterpret_cast<int*>(m_pClientMinDisplayX) = -9999;
     *reinterpret_cast<int*>(m_pClientMinDisplayY) = -9999;
-
-    ClientRedirections::UpdateStaticBlocks();
   }
 }
 
@@ -429,110 +648,41 @@ uint8_t Atlas::getCurrentMap()
   return m_currentMap;
 }
 
-uint16_t Atlas::fletcher16(uint8_t* pBlockData, uint8_t* pStaticsData, uint32_t staticsLength)
+int32_t Atlas::BLOCK_POSITION_OFFSETS[5] = { -2, -1, 0, 1, 2 };
+
+/* Fills pCrcs with the crcs of the 5x5 blocks centered on blockNumber, or zeros if the map is not known */
+void Atlas::GetGroupOfBlockCrcs(uint32_t mapNumber, uint32_t blockNumber, uint16_t* pCrcs)
 {
-  uint16_t sum1 = 0;
-  uint16_t sum2 = 0;
-  
-  if (pBlockData != NULL)
+  int32_t blocks[HASH_WINDOW_SIZE];
+  getHashWindowBlocks(mapNumber, blockNumber, blocks);
+
+  for (uint32_t i = 0; i < HASH_WINDOW_SIZE; i++)
   {
-    for (int index = 0; index < 192; ++index)
+    if (blocks[i] >= 0)
     {
-      sum1 = (uint16_t)((sum1 + pBlockData[index]) % 255);
-      sum2 = (uint16_t)((sum2 + sum1) % 255);
+      pCrcs[i] = getBlockCrc(mapNumber, blocks[i]);
     }
-  }
-
-  if (pStaticsData != NULL)
-  {
-    for (uint32_t index = 0; index < staticsLength; ++index)
+    else
     {
-      sum1 = (uint16_t)((sum1 + pStaticsData[index]) % 255);
-      sum2 = (uint16_t)((sum2 + sum1) % 255);
+      pCrcs[i] = (uint16_t)0x0;
     }
   }
-
-  return (uint16_t)((sum2 << 8) | sum1);
 }
 
-int32_t Atlas::BLOCK_POSITION_OFFSETS[5] = { -2, -1, 0, 1, 2 };
-
-uint16_t* Atlas::GetGroupOfBlockCrcs(uint32_t mapNumber, uint32_t blockNumber)
+/* Fills pBlocks with the block numbers of the 5x5 blocks centered on blockNumber, or -1 for blocks that are not on
+ * the map 
+ */
+void Atlas::getHashWindowBlocks(uint32_t mapNumber, uint32_t blockNumber, int32_t* pBlocks)
 {
-  uint16_t* pCrcs = NULL;
-  if (m_mapDefinitions.find(mapNumber) != m_mapDefinitions.end())
+  if (m_mapDefinitions.find(mapNumber) == m_mapDefinitions.end())
   {
-    pCrcs = new uint16_t[25];
-    MapDefinition def = m_mapDefinitions[mapNumber];
-    int32_t blockX = ((int32_t)blockNumber /  (def.mapHeightInTiles >> 3));
-    int32_t blockY = ((int32_t)blockNumber % (def.mapHeightInTiles >> 3));
-
-    int32_t wrapWidthInBlocks = (def.mapWrapWidthInTiles >> 3);
-    int32_t wrapHeightInBlocks = (def.mapWrapHeightInTiles >> 3);
-    int32_t mapWidthInBlocks = (def.mapWidthInTiles >> 3);
-    int32_t mapHeightInBlocks = (def.mapHeightInTiles >> 3);
-
-    if (blockX < 0 || blockX >= mapWidthInBlocks|| blockY < 0 || blockY >= mapHeightInBlocks)
-    {
-      memset(pCrcs, 0x00, sizeof(uint16_t) * 25);
-    }
-    else
-    {
-      for (int x = -2; x <= 2; x++)
-      {
-        int xBlockItr = -1;
-        if (blockX < wrapWidthInBlocks)
-        {
-          xBlockItr = (blockX + x) % wrapWidthInBlocks;
-          if (xBlockItr < 0 && xBlockItr > -3)
-          {
-            xBlockItr += wrapWidthInBlocks;
-          }
-        }
-        else
-        {
-          xBlockItr = (blockX + x) % mapWidthInBlocks;
-          if (xBlockItr < 0 && xBlockItr > -3)
-          {
-            xBlockItr += mapWidthInBlocks;
-          }
-        }
-        for (int y = -2; y <= 2; y++)
-        {
-          int yBlockItr = 0;
-          if (blockY < wrapHeightInBlocks)
-          {
-            yBlockItr = (blockY + y) % wrapHeightInBlocks;
-            if (yBlockItr < 0)
-            {
-              yBlockItr += wrapHeightInBlocks;
-            }
-          }
-          else
-          {
-            yBlockItr = (blockY + y) % mapHeightInBlocks;
-            if (yBlockItr < 0)
-            {
-              yBlockItr += mapHeightInBlocks;
-            }
-          }
-    
-          int32_t currentBlock = (xBlockItr * mapHeightInBlocks) + yBlockItr;
-    
-          if (currentBlock >= 0 && currentBlock <= (mapHeightInBlocks * mapWidthInBlocks))
-          {
-            pCrcs[((x + 2) * 5) + (y + 2)] = getBlockCrc (mapNumber, currentBlock);
-          }
-          else
-          {
-            pCrcs[((x + 2) * 5) + (y + 2)] = (uint16_t)0x0;
-          }
-        }
-      }
-    }
+    HashWindow::getBlocks(0, 0, 0, 0, blockNumber, pBlocks);
+    return;
   }
 
-  return pCrcs;
+  MapDefinition& rDefinition = m_mapDefinitions[mapNumber];
+  HashWindow::getBlocks(rDefinition.mapWidthInTiles >> 3, rDefinition.mapHeightInTiles >> 3, rDefinition.mapWrapWidthInTiles >> 3, 
+    rDefinition.mapWrapHeightInTiles >> 3, blockNumber, pBlocks);
 }
 
 uint16_t Atlas::getBlockCrc(uint32_t mapNumber, uint32_t blockNumber)
@@ -540,20 +690,21 @@ uint16_t Atlas::getBlockCrc(uint32_t mapNumber, uint32_t blockNumber)
   uint16_t crc = 0; 
   if (m_mapDefinitions.find(mapNumber) != m_mapDefinitions.end())
   {
-    uint8_t* pBlockData = m_pFileManager->readLandBlock(mapNumber, blockNumber);
-    uint32_t staticsLength = 0;
-
-    uint8_t* pStaticsData = m_pFileManager->readStaticsBlock(mapNumber, blockNumber, staticsLength);
-
-    if (pBlockData != NULL)
+    //a block keeps its crc until an update is written to it
+    if (m_pFileManager->lookupBlockCrc(mapNumber, blockNumber, crc))
     {
-      crc = fletcher16(pBlockData, pStaticsData, staticsLength);
-      delete pBlockData;
+      return crc;
     }
 
-    if (pStaticsData != NULL)
+    //both views point straight into the pools, nothing is copied or allocated
+    uint8_t* pBlockData = m_pFileManager->getLandBlockView(static_cast<uint8_t>(mapNumber), blockNumber);
+    uint32_t staticsLength = 0;
+    uint8_t* pStaticsData = m_pFileManager->getStaticsBlockView(mapNumber, blockNumber, staticsLength);
+
+    if (pBlockData != NULL)
     {
-      delete pStaticsData;
+      crc = Fletcher16::hashBlock(pBlockData, pStaticsData, staticsLength);
+      m_pFileManager->storeBlockCrc(mapNumber, blockNumber, crc);
     }
   }
 
@@ -27,6 +27,11 @@
 #include <codecvt>
 #include "..\FileSystem\BaseFileManager.h"
 #include "MapDefinition.h"
+#include "Fletcher16.h"
+#include "LandDelta.h"
+#include "RegionHashTree.h"
+#include "HashWindow.h"
+#include "RefreshScheduler.h"
 #include "..\LocalPeHelper32.hpp"
 
 class UoLiveAppState;
@@ -37,33 +42,43 @@ class Atlas
 {
   public:
     Atlas(BaseFileManager* pManager, UoLiveAppState* pAppState, NetworkManager* pNetManager);
-    uint16_t* GetGroupOfBlockCrcs(uint32_t mapNumber, uint32_t blockNumber);
+    void GetGroupOfBlockCrcs(uint32_t mapNumber, uint32_t blockNumber, uint16_t* pCrcs);
     void RegisterMapDefinitions(MapDefinition* aDefinitions, uint32_t numDefinitions);
 
     void init();
 
-    static uint16_t fletcher16(uint8_t* pBlockData, uint8_t* pStaticsData, uint32_t staticsLength);
 
     void LoadMap(uint8_t map);
     uint8_t getCurrentMap();
+    void onClientFrame();
 
   protected:
     void onBeforeMapChange(uint8_t& rMap);
     void onMapChange(uint8_t& rMap);
 
     void onHashQuery(uint32_t blockNumber, uint8_t mapNumber, uint16_t sequence);
+    void onDeltaHashQuery(uint32_t blockNumber, uint8_t mapNumber, uint16_t sequence);
+    void rememberHashWindow(uint8_t mapNumber, uint32_t blockNumber);
+    void getHashWindowBlocks(uint32_t mapNumber, uint32_t blockNumber, int32_t* pBlocks);
+    void onRegionHashQuery(uint8_t mapNumber, uint32_t level, uint16_t sequence, std::vector<uint32_t> nodes);
     void onRefreshClientView();
     void onUpdateMapDefinitions(std::vector<MapDefinition> definitions);
     void onUpdateStatics(uint8_t mapNumber, uint32_t blockNumber, uint8_t* pData, uint32_t length);
     void onShardIdentifierUpdate(std::string shardIdentifier);
-    void refreshClientLand(uint8_t mapNumber, uint32_t blockNumber);
-    void refreshClientStatics(uint8_t mapNumber, uint32_t blockNumber);
+    void refreshClientLand(uint8_t mapNumber);
+    void purgeClientStatics(uint8_t mapNumber, const std::vector<uint32_t>& blockNumbers);
+    void runOverdueRefreshes();
 
     void onUpdateLand(uint8_t mapNumber, uint32_t blockNumber, uint8_t* pLandData);
+    void onUpdateBlockBatch(uint8_t mapNumber, uint8_t* pRecords, uint32_t length);
+    void touchBlocksAround(uint8_t mapNumber, uint32_t blockNumber);
 
     void onLogout();
 
     static int32_t BLOCK_POSITION_OFFSETS[5];
+    static const int32_t TOUCH_RADIUS_IN_BLOCKS = 8;
+    static const uint32_t MAX_REGION_HASHES_PER_QUERY = 256;
+    static const uint32_t HASH_WINDOW_SIZE = HashWindow::SIZE;
 
     uint16_t getBlockCrc(uint32_t mapNumber, uint32_t blockNumber);
 
@@ -74,6 +89,11 @@ class Atlas
     NetworkManager* m_pNetManager;
     std::string m_shardIdentifier;
     bool m_firstMapLoad;
+    uint32_t m_lastTouchedBlock;
+    HashWindow m_lastHashWindow;
+    RegionHashTree m_regionHashes;
+    uint32_t m_regionHashMapNumber;
+    RefreshScheduler m_refreshScheduler;
 
     unsigned char* m_pMapThingieTable;
     unsigned char* m_pClientMinDisplayX;
@@ -0,0 +1,172 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "Fletcher16.h"
+#include <emmintrin.h>
+
+/* The checksum is also built into the tests outside of Windows, where it only ever runs on x86-64 and SSE2 is always
+ * there.
+ */
+#ifdef _WIN32
+#include <Windows.h>
+
+const bool Fletcher16::s_sse2Available = IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE) != FALSE;
+#else
+const bool Fletcher16::s_sse2Available = true;
+#endif
+
+/* Adds length bytes to the sums.  The sums have to start out below 255 and are below 255 again afterwards, so a 
+ * checksum can be built up over several buffers.
+ */
+void Fletcher16::update(uint32_t& rSum1, uint32_t& rSum2, const uint8_t* pData, uint32_t length)
+{
+  if (s_sse2Available)
+  {
+    updateSse2(rSum1, rSum2, pData, length);
+  }
+  else
+  {
+    updateScalar(rSum1, rSum2, pData, length);
+  }
+}
+
+uint16_t Fletcher16::finish(uint32_t sum1, uint32_t sum2)
+{
+  return static_cast<uint16_t>((sum2 << 8) | sum1);
+}
+
+/* The hash of a block that hash queries are answered with, over its 192 bytes of land followed by its statics */
+uint16_t Fletcher16::hashBlock(const uint8_t* pBlockData, const uint8_t* pStaticsData, uint32_t staticsLength)
+{
+  uint32_t sum1 = 0;
+  uint32_t sum2 = 0;
+  
+  if (pBlockData != NULL)
+  {
+    update(sum1, sum2, pBlockData, 192);
+  }
+
+  if (pStaticsData != NULL)
+  {
+    update(sum1, sum2, pStaticsData, staticsLength);
+  }
+
+  return finish(sum1, sum2);
+}
+
+bool Fletcher16::isSse2Available()
+{
+  return s_sse2Available;
+}
+
+/* The original byte at a time loop, kept to check the other versions against */
+void Fletcher16::updateReference(uint32_t& rSum1, uint32_t& rSum2, const uint8_t* pData, uint32_t length)
+{
+  uint16_t sum1 = static_cast<uint16_t>(rSum1);
+  uint16_t sum2 = static_cast<uint16_t>(rSum2);
+
+  for (uint32_t index = 0; index < length; ++index)
+  {
+    sum1 = (uint16_t)((sum1 + pData[index]) % 255);
+    sum2 = (uint16_t)((sum2 + sum1) % 255);
+  }
+
+  rSum1 = sum1;
+  rSum2 = sum2;
+}
+
+void Fletcher16::updateScalar(uint32_t& rSum1, uint32_t& rSum2, const uint8_t* pData, uint32_t length)
+{
+  uint32_t sum1 = rSum1;
+  uint32_t sum2 = rSum2;
+
+  while (length > 0)
+  {
+    uint32_t runLength = length < MAX_DEFERRED_BYTES ? length : MAX_DEFERRED_BYTES;
+    length -= runLength;
+
+    for (uint32_t index = 0; index < runLength; ++index)
+    {
+      sum1 += pData[index];
+      sum2 += sum1;
+    }
+
+    pData += runLength;
+    sum1 %= 255;
+    sum2 %= 255;
+  }
+
+  rSum1 = sum1;
+  rSum2 = sum2;
+}
+
+static inline uint32_t horizontalSum(__m128i values)
+{
+  values = _mm_add_epi32(values, _mm_shuffle_epi32(values, _MM_SHUFFLE(1, 0, 3, 2)));
+  values = _mm_add_epi32(values, _mm_shuffle_epi32(values, _MM_SHUFFLE(2, 3, 0, 1)));
+  return static_cast<uint32_t>(_mm_cvtsi128_si32(values));
+}
+
+/* Each 16 byte chunk adds 16 * sum1 + (16 * b0 + 15 * b1 + ... + 1 * b15) to sum2 and the sum of its bytes to sum1.  
+ * The sum1 that every chunk starts with is the sum1 of the run plus the bytes of the chunks before it, those are 
+ * collected in prefixSums and added in once per run.
+ */
+void Fletcher16::updateSse2(uint32_t& rSum1, uint32_t& rSum2, const uint8_t* pData, uint32_t length)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i lowWeights = _mm_set_epi16(9, 10, 11, 12, 13, 14, 15, 16);
+  const __m128i highWeights = _mm_set_epi16(1, 2, 3, 4, 5, 6, 7, 8);
+
+  uint32_t sum1 = rSum1;
+  uint32_t sum2 = rSum2;
+
+  while (length >= 16)
+  {
+    uint32_t numberOfChunks = (length < MAX_DEFERRED_BYTES ? length : MAX_DEFERRED_BYTES) / 16;
+    length -= numberOfChunks * 16;
+
+    __m128i byteSums = zero;
+    __m128i prefixSums = zero;
+    __m128i weightedSums = zero;
+
+    for (uint32_t chunk = 0; chunk < numberOfChunks; chunk++)
+    {
+      __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData));
+      prefixSums = _mm_add_epi32(prefixSums, byteSums);
+      byteSums = _mm_add_epi32(byteSums, _mm_sad_epu8(bytes, zero));
+      weightedSums = _mm_add_epi32(weightedSums, _mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), lowWeights));
+      weightedSums = _mm_add_epi32(weightedSums, _mm_madd_epi16(_mm_unpackhi_epi8(bytes, zero), highWeights));
+      pData += 16;
+    }
+
+    sum2 += (numberOfChunks * 16 * sum1) + (16 * horizontalSum(prefixSums)) + horizontalSum(weightedSums);
+    sum1 += horizontalSum(byteSums);
+    sum1 %= 255;
+    sum2 %= 255;
+  }
+
+  updateScalar(sum1, sum2, pData, length);
+
+  rSum1 = sum1;
+  rSum2 = sum2;
+}
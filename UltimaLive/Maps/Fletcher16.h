@@ -0,0 +1,56 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _FLETCHER16_H
+#define _FLETCHER16_H
+
+#include <stdint.h>
+
+/* The fletcher16 checksum that UltimaLive uses for block hashes, computed the same way as CRC.Fletcher16 on the 
+ * server: both sums are kept modulo 255 and the result is (sum2 << 8) | sum1.
+ *
+ * Taking the modulo once per byte is what makes the plain loop slow.  Since the sums start out below 255, up to 
+ * MAX_DEFERRED_BYTES bytes can be added before sum2 could overflow 32 bits, so the sums are only reduced once per run 
+ * of that many bytes.  The result is the same because the reduction is taken modulo 255 either way.  Runs of 16 bytes 
+ * are summed with SSE2 where the processor has it.
+ */
+class Fletcher16
+{
+  public:
+    static void update(uint32_t& rSum1, uint32_t& rSum2, const uint8_t* pData, uint32_t length);
+    static uint16_t finish(uint32_t sum1, uint32_t sum2);
+    static uint16_t hashBlock(const uint8_t* pBlockData, const uint8_t* pStaticsData, uint32_t staticsLength);
+
+    //each version on its own, so the tests can check all of them against the reference
+    static void updateReference(uint32_t& rSum1, uint32_t& rSum2, const uint8_t* pData, uint32_t length);
+    static void updateScalar(uint32_t& rSum1, uint32_t& rSum2, const uint8_t* pData, uint32_t length);
+    static void updateSse2(uint32_t& rSum1, uint32_t& rSum2, const uint8_t* pData, uint32_t length);
+    static bool isSse2Available();
+
+    static const uint32_t MAX_DEFERRED_BYTES = 5792;
+
+  private:
+    static const bool s_sse2Available;
+};
+
+#endif
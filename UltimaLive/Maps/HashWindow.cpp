@@ -0,0 +1,154 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "HashWindow.h"
+
+HashWindow::HashWindow()
+  : m_remembered(false),
+  m_mapNumber(0)
+{
+  clear();
+}
+
+/* Fills pBlocks with the block numbers of the 5x5 blocks centered on blockNumber, column by column, wrapping the same
+ * way the server does, or -1 for blocks that are not on the map 
+ */
+void HashWindow::getBlocks(int32_t mapWidthInBlocks, int32_t mapHeightInBlocks, int32_t wrapWidthInBlocks, int32_t wrapHeightInBlocks, uint32_t blockNumber, int32_t* pBlocks)
+{
+  for (uint32_t i = 0; i < SIZE; i++)
+  {
+    pBlocks[i] = -1;
+  }
+
+  if (mapHeightInBlocks <= 0)
+  {
+    return;
+  }
+
+  int32_t blockX = ((int32_t)blockNumber / mapHeightInBlocks);
+  int32_t blockY = ((int32_t)blockNumber % mapHeightInBlocks);
+
+  if (blockX >= 0 && blockX < mapWidthInBlocks && blockY >= 0 && blockY < mapHeightInBlocks)
+  {
+    for (int x = -2; x <= 2; x++)
+    {
+      int xBlockItr = -1;
+      if (blockX < wrapWidthInBlocks)
+      {
+        xBlockItr = (blockX + x) % wrapWidthInBlocks;
+        if (xBlockItr < 0 && xBlockItr > -3)
+        {
+          xBlockItr += wrapWidthInBlocks;
+        }
+      }
+      else
+      {
+        xBlockItr = (blockX + x) % mapWidthInBlocks;
+        if (xBlockItr < 0 && xBlockItr > -3)
+        {
+          xBlockItr += mapWidthInBlocks;
+        }
+      }
+      for (int y = -2; y <= 2; y++)
+      {
+        int yBlockItr = 0;
+        if (blockY < wrapHeightInBlocks)
+        {
+          yBlockItr = (blockY + y) % wrapHeightInBlocks;
+          if (yBlockItr < 0)
+          {
+            yBlockItr += wrapHeightInBlocks;
+          }
+        }
+        else
+        {
+          yBlockItr = (blockY + y) % mapHeightInBlocks;
+          if (yBlockItr < 0)
+          {
+            yBlockItr += mapHeightInBlocks;
+          }
+        }
+  
+        int32_t currentBlock = (xBlockItr * mapHeightInBlocks) + yBlockItr;
+  
+        if (currentBlock >= 0 && currentBlock <= (mapHeightInBlocks * mapWidthInBlocks))
+        {
+          pBlocks[((x + 2) * 5) + (y + 2)] = currentBlock;
+        }
+      }
+    }
+  }
+}
+
+void HashWindow::remember(uint8_t mapNumber, const int32_t* pBlocks)
+{
+  for (uint32_t i = 0; i < SIZE; i++)
+  {
+    m_blocks[i] = pBlocks[i];
+  }
+
+  m_mapNumber = mapNumber;
+  m_remembered = true;
+}
+
+void HashWindow::clear()
+{
+  m_remembered = false;
+  for (uint32_t i = 0; i < SIZE; i++)
+  {
+    m_blocks[i] = -1;
+  }
+}
+
+/* Fills pPositions with the positions in the window of the blocks that were not in the last window answered for the
+ * map and returns how many there are, all of them if no window was answered for the map since it was loaded
+ */
+uint32_t HashWindow::getNewPositions(uint8_t mapNumber, const int32_t* pBlocks, uint8_t* pPositions)
+{
+  bool compare = m_remembered && m_mapNumber == mapNumber;
+
+  uint32_t numberOfPositions = 0;
+  for (uint32_t i = 0; i < SIZE; i++)
+  {
+    if (!compare || !contains(pBlocks[i]))
+    {
+      pPositions[numberOfPositions++] = static_cast<uint8_t>(i);
+    }
+  }
+
+  return numberOfPositions;
+}
+
+bool HashWindow::contains(int32_t block)
+{
+  for (uint32_t i = 0; i < SIZE; i++)
+  {
+    if (m_blocks[i] == block)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
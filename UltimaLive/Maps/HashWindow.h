@@ -0,0 +1,55 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#ifndef _HASH_WINDOW_H
+#define _HASH_WINDOW_H
+
+#include <stdint.h>
+
+/* The 5x5 blocks around the block a player stands in, which the server asks the hashes of, and the window that was 
+ * last answered for.  A delta hash query is answered with only the blocks that were not in the last window, found by 
+ * looking each one up in the 25 blocks remembered from it.
+ */
+class HashWindow
+{
+  public:
+    HashWindow();
+
+    static void getBlocks(int32_t mapWidthInBlocks, int32_t mapHeightInBlocks, int32_t wrapWidthInBlocks, int32_t wrapHeightInBlocks, uint32_t blockNumber, int32_t* pBlocks);
+
+    void remember(uint8_t mapNumber, const int32_t* pBlocks);
+    void clear();
+    uint32_t getNewPositions(uint8_t mapNumber, const int32_t* pBlocks, uint8_t* pPositions);
+
+    static const uint32_t SIZE = 25;
+
+  private:
+    bool contains(int32_t block);
+
+    bool m_remembered;
+    uint8_t m_mapNumber;
+    int32_t m_blocks[SIZE];
+};
+
+#endif
@@ -0,0 +1,80 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "LandDelta.h"
+#include "Fletcher16.h"
+#include <cstring>
+
+/* Returns the number of bytes the delta at pDelta takes up, or 0 if it doesn't fit in length */
+uint32_t LandDelta::getLength(const uint8_t* pDelta, uint32_t length)
+{
+  if (length < HEADER_LENGTH)
+  {
+    return 0;
+  }
+
+  uint32_t tiles = 0;
+  for (uint64_t mask = readMask(pDelta); mask != 0; mask &= mask - 1)
+  {
+    tiles++;
+  }
+
+  uint32_t deltaLength = HEADER_LENGTH + (tiles * TILE_LENGTH);
+  return deltaLength <= length ? deltaLength : 0;
+}
+
+/* Copies pBlock to pPatchedBlock with the changed tiles written over it.  Returns false if the result doesn't match 
+ * the checksum in the delta, in which case pPatchedBlock shouldn't be used.
+ */
+bool LandDelta::apply(const uint8_t* pBlock, const uint8_t* pDelta, uint8_t* pPatchedBlock)
+{
+  uint64_t mask = readMask(pDelta);
+  uint16_t expectedCrc = static_cast<uint16_t>((pDelta[8] << 8) | pDelta[9]);
+  const uint8_t* pTile = pDelta + HEADER_LENGTH;
+
+  memcpy(pPatchedBlock, pBlock, BLOCK_LENGTH);
+
+  for (uint32_t tile = 0; tile < 64; tile++)
+  {
+    if ((mask & (1ULL << tile)) != 0)
+    {
+      memcpy(pPatchedBlock + (tile * TILE_LENGTH), pTile, TILE_LENGTH);
+      pTile += TILE_LENGTH;
+    }
+  }
+
+  uint32_t sum1 = 0;
+  uint32_t sum2 = 0;
+  Fletcher16::update(sum1, sum2, pPatchedBlock, BLOCK_LENGTH);
+  return Fletcher16::finish(sum1, sum2) == expectedCrc;
+}
+
+uint64_t LandDelta::readMask(const uint8_t* pDelta)
+{
+  uint64_t mask = 0;
+  for (uint32_t i = 0; i < 8; i++)
+  {
+    mask = (mask << 8) | pDelta[i];
+  }
+  return mask;
+}
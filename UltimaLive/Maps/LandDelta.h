@@ -0,0 +1,51 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _LAND_DELTA_H
+#define _LAND_DELTA_H
+
+#include <stdint.h>
+
+/* A land block update that carries only the tiles that changed, all big endian:
+ *   uint64   changed tile mask, bit n is tile n ((y * 8) + x within the block)
+ *   uint16   fletcher16 of the whole 192 byte block after the change
+ *   3 bytes  per changed tile, in tile order, laid out like the tile in the map file
+ *
+ * The delta is applied to a copy of the block and only kept if the checksum matches, so a delta made against a block 
+ * the client doesn't have is dropped instead of written.  The block hash queries repair it later.
+ */
+class LandDelta
+{
+  public:
+    static uint32_t getLength(const uint8_t* pDelta, uint32_t length);
+    static bool apply(const uint8_t* pBlock, const uint8_t* pDelta, uint8_t* pPatchedBlock);
+
+    static const uint32_t HEADER_LENGTH = 10;
+    static const uint32_t TILE_LENGTH = 3;
+    static const uint32_t BLOCK_LENGTH = 192;
+
+  private:
+    static uint64_t readMask(const uint8_t* pDelta);
+};
+
+#endif
@@ -0,0 +1,226 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "RefreshScheduler.h"
+#include <cstdio>
+
+RefreshScheduler::RefreshScheduler(uint32_t budgetInMicroseconds)
+  : m_hMutex(CreateMutex(NULL, false, NULL)),
+  m_purgeStatics(),
+  m_reloadTerrain(),
+  m_mapNumber(0),
+  m_staticsBlocks(),
+  m_landBlocks(),
+  m_purgeBlocks(),
+  m_queuedSince(0),
+  m_landFirst(false),
+  m_budget(budgetInMicroseconds),
+  m_debt(0),
+  m_queuedRefreshes(0),
+  m_coalescedRefreshes(0),
+  m_staticsRefreshes(0),
+  m_landRefreshes(0),
+  m_refreshedBlocks(0),
+  m_skippedFrames(0),
+  m_overdueRuns(0),
+  m_refreshMicroseconds(0)
+{
+  QueryPerformanceFrequency(&m_frequency);
+}
+
+RefreshScheduler::~RefreshScheduler()
+{
+  CloseHandle(m_hMutex);
+}
+
+void RefreshScheduler::setRefreshFunctions(std::function<void(uint8_t, const std::vector<uint32_t>&)> purgeStatics, std::function<void(uint8_t)> reloadTerrain)
+{
+  m_purgeStatics = purgeStatics;
+  m_reloadTerrain = reloadTerrain;
+}
+
+void RefreshScheduler::queueStatics(uint8_t mapNumber, uint32_t blockNumber)
+{
+  queue(m_staticsBlocks, mapNumber, blockNumber);
+}
+
+void RefreshScheduler::queueLand(uint8_t mapNumber, uint32_t blockNumber)
+{
+  queue(m_landBlocks, mapNumber, blockNumber);
+}
+
+void RefreshScheduler::queue(std::set<uint32_t>& rBlocks, uint8_t mapNumber, uint32_t blockNumber)
+{
+  WaitForSingleObject(m_hMutex, INFINITE);
+
+  //only the map on screen can be refreshed, blocks queued for another one are stale
+  if (mapNumber != m_mapNumber)
+  {
+    m_staticsBlocks.clear();
+    m_landBlocks.clear();
+    m_mapNumber = mapNumber;
+  }
+
+  if (m_staticsBlocks.empty() && m_landBlocks.empty())
+  {
+    m_queuedSince = GetTickCount();
+  }
+
+  m_queuedRefreshes++;
+  if (!rBlocks.insert(blockNumber).second)
+  {
+    m_coalescedRefreshes++;
+  }
+
+  ReleaseMutex(m_hMutex);
+}
+
+/* Runs as much of the queue as the budget allows, returns true if anything was refreshed.  Called once per client 
+ * frame, before the client reloads its statics blocks.
+ */
+bool RefreshScheduler::runFrame()
+{
+  WaitForSingleObject(m_hMutex, INFINITE);
+
+  if (m_staticsBlocks.empty() && m_landBlocks.empty())
+  {
+    m_debt = 0;
+    ReleaseMutex(m_hMutex);
+    return false;
+  }
+
+  if (m_debt > 0)
+  {
+    m_debt -= m_budget;
+    m_skippedFrames++;
+    ReleaseMutex(m_hMutex);
+    return false;
+  }
+
+  LARGE_INTEGER startTime;
+  QueryPerformanceCounter(&startTime);
+
+  for (int pass = 0; pass < 2; pass++)
+  {
+    bool landPass = (pass == 0) == m_landFirst;
+
+    //the first pass always runs, the second one only if there is budget left
+    if (pass == 1 && elapsedMicroseconds(startTime) >= m_budget)
+    {
+      m_landFirst = landPass;
+      break;
+    }
+
+    if (landPass && !m_landBlocks.empty())
+    {
+      if (m_reloadTerrain)
+      {
+        m_reloadTerrain(m_mapNumber);
+      }
+      m_landRefreshes++;
+      m_refreshedBlocks += m_landBlocks.size();
+      m_landBlocks.clear();
+    }
+    else if (!landPass && !m_staticsBlocks.empty())
+    {
+      //the set hands the blocks over sorted, and the list keeps its memory from frame to frame
+      if (m_purgeStatics)
+      {
+        m_purgeBlocks.assign(m_staticsBlocks.begin(), m_staticsBlocks.end());
+        m_purgeStatics(m_mapNumber, m_purgeBlocks);
+      }
+      m_staticsRefreshes++;
+      m_refreshedBlocks += m_staticsBlocks.size();
+      m_staticsBlocks.clear();
+    }
+  }
+
+  int64_t elapsed = elapsedMicroseconds(startTime);
+  m_refreshMicroseconds += elapsed;
+  m_debt = elapsed - m_budget;
+  m_queuedSince = GetTickCount();
+
+  ReleaseMutex(m_hMutex);
+  return true;
+}
+
+/* True when blocks have been waiting longer than the client should ever take to draw a frame */
+bool RefreshScheduler::isOverdue()
+{
+  WaitForSingleObject(m_hMutex, INFINITE);
+  bool overdue = (!m_staticsBlocks.empty() || !m_landBlocks.empty()) && GetTickCount() - m_queuedSince > MAX_QUEUE_DELAY_MS;
+  if (overdue)
+  {
+    m_overdueRuns++;
+    m_debt = 0;
+  }
+  ReleaseMutex(m_hMutex);
+  return overdue;
+}
+
+void RefreshScheduler::clear()
+{
+  WaitForSingleObject(m_hMutex, INFINITE);
+  m_staticsBlocks.clear();
+  m_landBlocks.clear();
+  m_debt = 0;
+  m_landFirst = false;
+  ReleaseMutex(m_hMutex);
+}
+
+void RefreshScheduler::setBudget(uint32_t budgetInMicroseconds)
+{
+  m_budget = budgetInMicroseconds;
+}
+
+uint32_t RefreshScheduler::getBudget()
+{
+  return m_budget;
+}
+
+uint32_t RefreshScheduler::getQueuedRefreshes()
+{
+  return m_queuedRefreshes;
+}
+
+uint32_t RefreshScheduler::getExecutedRefreshes()
+{
+  return m_staticsRefreshes + m_landRefreshes;
+}
+
+void RefreshScheduler::printStatistics()
+{
+#ifdef DEBUG
+  uint32_t executed = getExecutedRefreshes();
+  printf("Refreshes: %u queued (%u coalesced), %u run (%u statics, %u terrain) covering %u blocks, %.2f ms average, %u frames skipped, %u overdue\n",
+    m_queuedRefreshes, m_coalescedRefreshes, executed, m_staticsRefreshes, m_landRefreshes, m_refreshedBlocks, 
+    executed > 0 ? (m_refreshMicroseconds / 1000.0) / executed : 0.0, m_skippedFrames, m_overdueRuns);
+#endif
+}
+
+int64_t RefreshScheduler::elapsedMicroseconds(LARGE_INTEGER startTime)
+{
+  LARGE_INTEGER endTime;
+  QueryPerformanceCounter(&endTime);
+  return ((endTime.QuadPart - startTime.QuadPart) * 1000000) / m_frequency.QuadPart;
+}
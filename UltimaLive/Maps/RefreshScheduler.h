@@ -0,0 +1,102 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _REFRESH_SCHEDULER_H
+#define _REFRESH_SCHEDULER_H
+
+#include <Windows.h>
+#include <set>
+#include <vector>
+#include <functional>
+#include <stdint.h>
+
+/* Collects the blocks that need to be redrawn after map updates and refreshes them from the client's own frame, 
+ * instead of purging the statics list and reloading the terrain once for every update that comes in.
+ *
+ * Blocks are queued once however many updates touch them.  Each frame the queued statics blocks are purged with one 
+ * walk of the master statics list and the terrain is reloaded once, since a terrain reload redraws everything on 
+ * screen anyway.  When a frame's refresh takes longer than the budget the overrun is paid back by skipping the 
+ * following frames, and when the statics purge uses up the budget the terrain reload waits for the next frame, so a 
+ * burst of updates is spread out instead of freezing the client.  The statics pass always purges every queued block in
+ * one call whatever the budget, since splitting it up would only walk the master statics list more often, so the 
+ * budget decides whether the terrain reload runs in the same frame and how many frames are skipped afterwards.  The
+ * purge function is handed the blocks in ascending order.
+ *
+ * The client polls its update statics blocks function every frame, which is where runFrame is called from.  If that 
+ * stops happening, for example while the client is minimized, the queue is run from the next update once it is 
+ * older than MAX_QUEUE_DELAY_MS.
+ */
+class RefreshScheduler
+{
+  public:
+    RefreshScheduler(uint32_t budgetInMicroseconds);
+    ~RefreshScheduler();
+
+    void setRefreshFunctions(std::function<void(uint8_t, const std::vector<uint32_t>&)> purgeStatics, std::function<void(uint8_t)> reloadTerrain);
+
+    void queueStatics(uint8_t mapNumber, uint32_t blockNumber);
+    void queueLand(uint8_t mapNumber, uint32_t blockNumber);
+    bool runFrame();
+    bool isOverdue();
+    void clear();
+
+    void setBudget(uint32_t budgetInMicroseconds);
+    uint32_t getBudget();
+
+    uint32_t getQueuedRefreshes();
+    uint32_t getExecutedRefreshes();
+    void printStatistics();
+
+    static const uint32_t DEFAULT_BUDGET_US = 4000;
+    static const uint32_t MAX_QUEUE_DELAY_MS = 250;
+
+  private:
+    void queue(std::set<uint32_t>& rBlocks, uint8_t mapNumber, uint32_t blockNumber);
+    int64_t elapsedMicroseconds(LARGE_INTEGER startTime);
+
+    HANDLE m_hMutex;
+    std::function<void(uint8_t, const std::vector<uint32_t>&)> m_purgeStatics;
+    std::function<void(uint8_t)> m_reloadTerrain;
+
+    uint8_t m_mapNumber;
+    std::set<uint32_t> m_staticsBlocks;
+    std::set<uint32_t> m_landBlocks;
+    std::vector<uint32_t> m_purgeBlocks;
+    DWORD m_queuedSince;
+    bool m_landFirst;
+
+    uint32_t m_budget;
+    int64_t m_debt;
+    LARGE_INTEGER m_frequency;
+
+    uint32_t m_queuedRefreshes;
+    uint32_t m_coalescedRefreshes;
+    uint32_t m_staticsRefreshes;
+    uint32_t m_landRefreshes;
+    uint32_t m_refreshedBlocks;
+    uint32_t m_skippedFrames;
+    uint32_t m_overdueRuns;
+    int64_t m_refreshMicroseconds;
+};
+
+#endif
@@ -0,0 +1,139 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "RegionHashTree.h"
+
+RegionHashTree::RegionHashTree()
+  : m_levels(),
+  m_getBlockCrc()
+{
+  //do nothing
+}
+
+/* Sizes the levels for a map and throws away every node hash.  Block crcs are read through getBlockCrc. */
+void RegionHashTree::reset(uint32_t mapWidthInBlocks, uint32_t mapHeightInBlocks, std::function<uint16_t(uint32_t)> getBlockCrc)
+{
+  m_levels.clear();
+  m_getBlockCrc = getBlockCrc;
+
+  Level blocks;
+  blocks.widthInNodes = mapWidthInBlocks;
+  blocks.heightInNodes = mapHeightInBlocks;
+  m_levels.push_back(blocks);
+
+  while (m_levels.back().widthInNodes > 1 || m_levels.back().heightInNodes > 1)
+  {
+    Level level;
+    level.widthInNodes = (m_levels.back().widthInNodes + REGION_SIZE - 1) >> REGION_SIZE_SHIFT;
+    level.heightInNodes = (m_levels.back().heightInNodes + REGION_SIZE - 1) >> REGION_SIZE_SHIFT;
+    level.hashes.resize(level.widthInNodes * level.heightInNodes, 0);
+    level.valid.resize(level.widthInNodes * level.heightInNodes, false);
+    m_levels.push_back(level);
+  }
+}
+
+void RegionHashTree::clear()
+{
+  m_levels.clear();
+  m_getBlockCrc = nullptr;
+}
+
+bool RegionHashTree::isEmpty()
+{
+  return m_levels.empty();
+}
+
+uint32_t RegionHashTree::getNumberOfLevels()
+{
+  return static_cast<uint32_t>(m_levels.size());
+}
+
+uint32_t RegionHashTree::getNodeCount(uint32_t level)
+{
+  uint32_t count = 0;
+  if (level < m_levels.size())
+  {
+    count = m_levels[level].widthInNodes * m_levels[level].heightInNodes;
+  }
+
+  return count;
+}
+
+/* Returns the hash of a node, or zero for a node that is not in the tree */
+uint32_t RegionHashTree::getNodeHash(uint32_t level, uint32_t nodeIndex)
+{
+  if (nodeIndex >= getNodeCount(level))
+  {
+    return 0;
+  }
+
+  if (level == 0)
+  {
+    return m_getBlockCrc(nodeIndex);
+  }
+
+  Level& rLevel = m_levels[level];
+  if (!rLevel.valid[nodeIndex])
+  {
+    Level& rChildren = m_levels[level - 1];
+    uint32_t firstX = (nodeIndex / rLevel.heightInNodes) << REGION_SIZE_SHIFT;
+    uint32_t firstY = (nodeIndex % rLevel.heightInNodes) << REGION_SIZE_SHIFT;
+    uint32_t hash = FNV_OFFSET_BASIS;
+
+    for (uint32_t x = firstX; x < firstX + REGION_SIZE && x < rChildren.widthInNodes; x++)
+    {
+      for (uint32_t y = firstY; y < firstY + REGION_SIZE && y < rChildren.heightInNodes; y++)
+      {
+        uint32_t childHash = getNodeHash(level - 1, (x * rChildren.heightInNodes) + y);
+        for (int i = 0; i < 4; i++)
+        {
+          hash ^= (childHash >> (i * 8)) & 0xFF;
+          hash *= FNV_PRIME;
+        }
+      }
+    }
+
+    rLevel.hashes[nodeIndex] = hash;
+    rLevel.valid[nodeIndex] = true;
+  }
+
+  return rLevel.hashes[nodeIndex];
+}
+
+/* Drops the hashes of every region above a block, called whenever the block's land or statics change */
+void RegionHashTree::invalidateBlock(uint32_t blockNumber)
+{
+  if (blockNumber < getNodeCount(0))
+  {
+    uint32_t x = blockNumber / m_levels[0].heightInNodes;
+    uint32_t y = blockNumber % m_levels[0].heightInNodes;
+
+    for (uint32_t level = 1; level < m_levels.size(); level++)
+    {
+      x >>= REGION_SIZE_SHIFT;
+      y >>= REGION_SIZE_SHIFT;
+      m_levels[level].valid[(x * m_levels[level].heightInNodes) + y] = false;
+    }
+  }
+}
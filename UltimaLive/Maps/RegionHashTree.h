@@ -0,0 +1,74 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#ifndef _REGION_HASH_TREE_H
+#define _REGION_HASH_TREE_H
+
+#include <stdint.h>
+#include <vector>
+#include <functional>
+
+/* A hash tree over the blocks of one map, used to find the blocks that differ from the server without asking for 
+ * every block.  Level 0 is the blocks themselves, and their hashes are the block crcs.  Every node above covers a 
+ * square of REGION_SIZE x REGION_SIZE nodes of the level below and its hash is a 32 bit FNV-1a over the hashes of 
+ * those children, four bytes each with the low byte first, walking the children a column at a time the same way 
+ * block numbers are laid out.  Nodes on the right and bottom edges cover fewer children.  The top level is the 
+ * first one that is a single node.
+ *
+ * The server builds the same tree in RegionHashTree.cs, so any change to how nodes are hashed has to be made there too.
+ * Node hashes are computed when they are first asked for and kept until a block under them is invalidated.
+ */
+class RegionHashTree
+{
+  public:
+    RegionHashTree();
+
+    void reset(uint32_t mapWidthInBlocks, uint32_t mapHeightInBlocks, std::function<uint16_t(uint32_t)> getBlockCrc);
+    void clear();
+    bool isEmpty();
+
+    uint32_t getNumberOfLevels();
+    uint32_t getNodeCount(uint32_t level);
+    uint32_t getNodeHash(uint32_t level, uint32_t nodeIndex);
+    void invalidateBlock(uint32_t blockNumber);
+
+    static const uint32_t REGION_SIZE_SHIFT = 2;
+    static const uint32_t REGION_SIZE = 1 << REGION_SIZE_SHIFT;
+    static const uint32_t FNV_OFFSET_BASIS = 2166136261U;
+    static const uint32_t FNV_PRIME = 16777619U;
+
+  private:
+    struct Level
+    {
+      uint32_t widthInNodes;
+      uint32_t heightInNodes;
+      std::vector<uint32_t> hashes;
+      std::vector<bool> valid;
+    };
+
+    std::vector<Level> m_levels;
+    std::function<uint16_t(uint32_t)> m_getBlockCrc;
+};
+
+#endif
@@ -20,42 +20,116 @@
 
 const unsigned char* MasterControlUtils::BASE_ADDRESS = reinterpret_cast<const unsigned char*>(0x400000);
 
-unsigned char MasterControlUtils::g_sendSignature1[] = { 0x8D, 0x8B, 0x94, 0x00, 0x00, 0x00, 0xE8, 0xCC, 0xCC, 0xCC, 0xCC, 0x55, 0x8D, 0x8B, 0xBC, 0x00, 0x00, 0x00 };
-unsigned char MasterControlUtils::g_sendSignature2[] = { 0x0F, 0xB7, 0xD8, 0x0F, 0xB6, 0x06, 0x83, 0xC4, 0x04, 0x53, 0x50, 0x8D, 0x4F, 0x6C };
+std::vector<const unsigned char*> MasterControlUtils::g_clientMatches;
+bool MasterControlUtils::g_clientImageScanned = false;
+
+/* Finds every client signature, from the signature cache when this client build has been seen before and otherwise by
+ * scanning the client image for all of them at once.  The first lookup does this during 
+ * ClientRedirections::InstallClientHooks, before any hooks are written and before any other thread is running, so 
+ * the image hash sees unpatched code and there is no lock.
+ */
+void MasterControlUtils::ScanClientImage()
+{
+  if (!g_clientImageScanned)
+  {
+    uint64_t imageHash = SignatureCache::hashImage(BASE_ADDRESS);
+    uint64_t key = imageHash;
+    for (unsigned int i = 0; i < ClientSignatures::COUNT; i++)
+    {
+      key = SignatureCache::hashBytes(key, reinterpret_cast<const uint8_t*>(&ClientSignatures::TABLE[i].length), sizeof(ClientSignatures::TABLE[i].length));
+      key = SignatureCache::hashBytes(key, ClientSignatures::TABLE[i].pBytes, ClientSignatures::TABLE[i].length);
+    }
+
+    SignatureCache cache;
+    g_clientMatches.assign(ClientSignatures::COUNT, NULL);
 
-unsigned char MasterControlUtils::g_recvSignature1[] = { 0x53, 0x56, 0x57, 0x8B, 0xF9, 0x8B, 0x0D, 0xCC, 0xCC, 0xCC, 0xCC, 0x33, 0xD2 };
-unsigned char MasterControlUtils::g_recvSignature2[] = { 0xA1, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xC7, 0x05, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0x8B, 0x38, 0x8B, 0xCC, 0xBE };
+    if (imageHash == 0 || !LoadCachedMatches(cache, key))
+    {
+      SignatureScanner scanner;
+      for (unsigned int i = 0; i < ClientSignatures::COUNT; i++)
+      {
+        scanner.addSignature(ClientSignatures::TABLE[i].pBytes, ClientSignatures::TABLE[i].length);
+      }
 
-unsigned char MasterControlUtils::g_NetworkObjectSignature1[] = { 0xA1, 0xCC, 0xCC, 0xCC, 0xCC, 0x8B, 0x0D, 0xCC, 0xCC, 0xCC, 0xCC, 0x8B, 0x16 };
-unsigned char MasterControlUtils::g_NetworkObjectSignature2[] = { 0xC7, 0x06, 0xCC, 0xCC, 0xCC, 0xCC, 0x89, 0x35, 0xCC, 0xCC, 0xCC, 0xCC, 0x8B, 0x4C, 0x24, 0x0C };
+      scanner.scan(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE);
 
-unsigned char MasterControlUtils::g_PlayerBaseSignature1[] = { 0x66, 0x89, 0x71, 0x24, 0x8B, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC };
-unsigned char MasterControlUtils::g_PlayerBaseSignature2[] = { 0x66, 0x89, 0x71, 0x28, 0x8B, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC };
-unsigned char MasterControlUtils::g_mapDimensionSignature[] = { 0x00, 0x1c, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00 };
+      cache.reset(ClientSignatures::COUNT);
+      for (unsigned int i = 0; i < ClientSignatures::COUNT; i++)
+      {
+        g_clientMatches[i] = scanner.getMatch(i);
+        if (g_clientMatches[i] != NULL)
+        {
+          cache.setOffset(i, static_cast<uint32_t>(g_clientMatches[i] - BASE_ADDRESS));
+        }
+      }
+
+      if (imageHash != 0)
+      {
+        cache.save(key);
+      }
+    }
+
+    g_clientImageScanned = true;
+  }
+}
+
+/* Takes the matches from the cache, spot checking each cached offset against its signature.  One signature that no 
+ * longer matches where it was found throws out the whole table, since the rest were found in the same image.
+ */
+bool MasterControlUtils::LoadCachedMatches(SignatureCache& rCache, uint64_t key)
+{
+  if (!rCache.load(key, ClientSignatures::COUNT))
+  {
+    return false;
+  }
 
-unsigned char MasterControlUtils::g_functionStartSig1[] = { 0x55, 0x8B, 0xEC };
-unsigned char MasterControlUtils::g_functionStartSig2[] = { 0x90, 0x90, 0x6A };
+  for (unsigned int i = 0; i < ClientSignatures::COUNT; i++)
+  {
+    uint32_t offset = rCache.getOffset(i);
 
-unsigned char MasterControlUtils::g_aDrawMapThingieTableSig1[] = { 0x83, 0xE1, 0x3F, 0x83, 0xE2, 0x3F, 0xC1, 0xE2, 0x06 }; 
-unsigned char MasterControlUtils::g_aDrawMapThingieTableSig2[] = { 0x83, 0xE1, 0x3F, 0xC1, 0xE1, 0x06, 0x83, 0xE2, 0x3F }; 
+    if (offset != SignatureCache::NOT_FOUND)
+    {
+      if (offset + ClientSignatures::TABLE[i].length >= static_cast<uint32_t>(CLIENT_IMAGE_MAX_SIZE) || 
+        !SignatureScanner::matches(BASE_ADDRESS + offset, ClientSignatures::TABLE[i].pBytes, ClientSignatures::TABLE[i].length))
+      {
+#ifdef DEBUG
+        printf("Cached offset 0x%x of signature %u does not match, scanning the client\n", offset, i);
+#endif
+        return false;
+      }
 
-unsigned char MasterControlUtils::g_minClientDisplaySig1[] = { 0xB8, 0xF1, 0xD8, 0xFF, 0xFF, 0x89, 0x3D, 0xCC, 0xCC, 0xCC, 0xCC, 0xA3, 0xCC, 0xCC, 0xCC, 0xCC, 0xA3 };
-unsigned char MasterControlUtils::g_minClientDisplaySig2[] = { 0xB8, 0xF1, 0xD8, 0xFF, 0xFF, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xA3, 0xCC, 0xCC, 0xCC, 0xCC, 0xA3 };
-unsigned char MasterControlUtils::g_minClientDisplaySig3[] = { 0xB8, 0xF1, 0xD8, 0xFF, 0xFF, 0xA3, 0xCC, 0xCC, 0xCC, 0xCC, 0xA3 };
+      g_clientMatches[i] = BASE_ADDRESS + offset;
+    }
+  }
 
-unsigned char MasterControlUtils::g_updateBlocksSig1[] = { 0xEE, 0xC1, 0xCC, 0x03, 0xC1, 0xCC, 0x03 }; //works up through 7.0.1.1
-unsigned char MasterControlUtils::g_updateBlocksSig2[] = { 0x2B, 0xD8, 0xC1, 0xCC, 0x03, 0xC1, 0xCC, 0x03 }; //works up through 7.0.1.1
+  return true;
+}
 
-unsigned char MasterControlUtils::g_refreshTerrainFunctionSig1[] = { 0x75, 0xCC, 0x83, 0xCC, 0xFF, 0x74, 0xCC, 0xE8 };
+/* Looks a signature up in the cached or single pass results when it is one of the client signatures searched for across the 
+ * whole client image, and falls back to a plain search otherwise
+ */
+const unsigned char* MasterControlUtils::LocateSignature(const unsigned char* buffer, unsigned int bufferLen, unsigned char* sigBuffer, unsigned int sigLen)
+{
+  if (buffer == BASE_ADDRESS && bufferLen == static_cast<unsigned int>(CLIENT_IMAGE_MAX_SIZE))
+  {
+    for (unsigned int i = 0; i < ClientSignatures::COUNT; i++)
+    {
+      if (ClientSignatures::TABLE[i].pBytes == sigBuffer && ClientSignatures::TABLE[i].length == sigLen)
+      {
+        ScanClientImage();
+        return g_clientMatches[i];
+      }
+    }
+  }
 
-unsigned char MasterControlUtils::g_masterStaticsListSig1[] = { 0x33, 0xf6, 0x68, 0x00, 0x00, 0xCC, 0x00, 0x89 }; //2.0.8n to 7.0.8.2
-unsigned char MasterControlUtils::g_masterStaticsListSig2[] = { 0x68, 0x40, 0xF9, 0x2F, 0x00, 0x89, 0x35 };
+  return FindSignatureOffset(buffer, bufferLen, sigBuffer, sigLen);
+}
 
 unsigned char* MasterControlUtils::GetRefreshTerrainFunctionPointer()
 {
   unsigned char* retValue = 0;
 
-  const unsigned char* func1SigAddr = FindSignatureOffset(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, g_refreshTerrainFunctionSig1, sizeof(g_refreshTerrainFunctionSig1));
+  const unsigned char* func1SigAddr = LocateSignature(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, ClientSignatures::g_refreshTerrainFunctionSig1, sizeof(ClientSignatures::g_refreshTerrainFunctionSig1));
 
   if (func1SigAddr != 0)
   {
@@ -98,14 +172,14 @@ const unsigned char* MasterControlUtils::findFunctionCall(const unsigned char* p
 {
   unsigned char* pAddress = 0;
 
-  unsigned char* pSigAddress = const_cast<unsigned char*>(MasterControlUtils::FindSignatureOffset(reinterpret_cast<const unsigned char*>(pBuffer), bufferSize, pSignature, signatureSize));
+  unsigned char* pSigAddress = const_cast<unsigned char*>(MasterControlUtils::LocateSignature(reinterpret_cast<const unsigned char*>(pBuffer), bufferSize, pSignature, signatureSize));
 
   if (pSigAddress != 0)
   {
-    pAddress = const_cast<unsigned char *>(MasterControlUtils::FindSignatureOffsetBackwards(pSigAddress, 100, g_functionStartSig1, sizeof(g_functionStartSig1)));
+    pAddress = const_cast<unsigned char *>(MasterControlUtils::FindSignatureOffsetBackwards(pSigAddress, 100, ClientSignatures::g_functionStartSig1, sizeof(ClientSignatures::g_functionStartSig1)));
     if (pAddress == 0)
     {
-      pAddress = const_cast<unsigned char*>(MasterControlUtils::FindSignatureOffsetBackwards(pSigAddress, 100, g_functionStartSig2, sizeof(g_functionStartSig2)));
+      pAddress = const_cast<unsigned char*>(MasterControlUtils::FindSignatureOffsetBackwards(pSigAddress, 100, ClientSignatures::g_functionStartSig2, sizeof(ClientSignatures::g_functionStartSig2)));
       if (pAddress != 0)
       {
         pAddress +=2;
@@ -120,7 +194,7 @@ const unsigned char* MasterControlUtils::findSignature (const unsigned char* pBu
 {
   unsigned char* retValue = 0;
 
-  unsigned char* pAddress = const_cast<unsigned char *>(FindSignatureOffset(reinterpret_cast<const unsigned char*>(pBuffer), bufferSize, pSignature, signatureSize));
+  unsigned char* pAddress = const_cast<unsigned char *>(LocateSignature(reinterpret_cast<const unsigned char*>(pBuffer), bufferSize, pSignature, signatureSize));
 
   if (pAddress != 0)
   {
@@ -135,7 +209,7 @@ const unsigned char* MasterControlUtils::findSignature (const unsigned char* pBu
 {
   unsigned char* retValue = 0;
 
-  unsigned char* pAddress = const_cast<unsigned char *>(FindSignatureOffset(reinterpret_cast<const unsigned char*>(pBuffer), bufferSize, pSignature, signatureSize));
+  unsigned char* pAddress = const_cast<unsigned char *>(LocateSignature(reinterpret_cast<const unsigned char*>(pBuffer), bufferSize, pSignature, signatureSize));
 
   if (pAddress != 0)
   {
@@ -147,11 +221,11 @@ const unsigned char* MasterControlUtils::findSignature (const unsigned char* pBu
 
 unsigned char* MasterControlUtils::GetPlayerBasePointer()
 {
-  const unsigned char* pOffset = FindSignatureOffset(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, g_PlayerBaseSignature1, sizeof(g_PlayerBaseSignature1));
+  const unsigned char* pOffset = LocateSignature(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, ClientSignatures::g_PlayerBaseSignature1, sizeof(ClientSignatures::g_PlayerBaseSignature1));
  
   if(pOffset==0)
   {
-    pOffset = FindSignatureOffset(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, g_PlayerBaseSignature2, sizeof(g_PlayerBaseSignature2));
+    pOffset = LocateSignature(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, ClientSignatures::g_PlayerBaseSignature2, sizeof(ClientSignatures::g_PlayerBaseSignature2));
   }
 
   unsigned char* retPointer = (unsigned char*)*(uint32_t*)(pOffset + 6);
@@ -167,7 +241,7 @@ unsigned char* MasterControlUtils::GetSendAddress()
 {
   unsigned char* pReturnAddress = NULL;
 
-  const unsigned char* pOffset =  FindSignatureOffset(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, g_sendSignature1, sizeof(g_sendSignature1));
+  const unsigned char* pOffset =  LocateSignature(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, ClientSignatures::g_sendSignature1, sizeof(ClientSignatures::g_sendSignature1));
 
 	if (pOffset != 0)
 	{
@@ -175,7 +249,7 @@ unsigned char* MasterControlUtils::GetSendAddress()
 	}
 	else
 	{
-    pOffset = FindSignatureOffset(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, g_sendSignature2, sizeof(g_sendSignature2));
+    pOffset = LocateSignature(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, ClientSignatures::g_sendSignature2, sizeof(ClientSignatures::g_sendSignature2));
 		if (pOffset != 0)
 		{
       pReturnAddress = (unsigned char*)(pOffset - 0xF);
@@ -192,7 +266,7 @@ unsigned char* MasterControlUtils::GetSendAddress()
 unsigned char* MasterControlUtils::GetRecvAddress()
 {
   unsigned char* pReturnAddress = NULL;
-  const unsigned char* pOffset =  FindSignatureOffset(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, g_recvSignature1, sizeof(g_recvSignature1));
+  const unsigned char* pOffset =  LocateSignature(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, ClientSignatures::g_recvSignature1, sizeof(ClientSignatures::g_recvSignature1));
 
 	if (pOffset != 0)
 	{
@@ -200,7 +274,7 @@ unsigned char* MasterControlUtils::GetRecvAddress()
 	}
 	else
 	{
-    pOffset =  FindSignatureOffset(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, g_recvSignature2, sizeof(g_recvSignature2));
+    pOffset =  LocateSignature(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, ClientSignatures::g_recvSignature2, sizeof(ClientSignatures::g_recvSignature2));
 
     if (pOffset != 0)
 		{
@@ -217,14 +291,14 @@ unsigned char* MasterControlUtils::GetRecvAddress()
 
 unsigned int* MasterControlUtils::GetNetworkObjectAddress()
 {
-  const unsigned char* pOffset =  FindSignatureOffset(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, g_NetworkObjectSignature1, sizeof(g_NetworkObjectSignature1));
+  const unsigned char* pOffset =  LocateSignature(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, ClientSignatures::g_NetworkObjectSignature1, sizeof(ClientSignatures::g_NetworkObjectSignature1));
 
 
   unsigned int* pNetworkObject = NULL;
 
   if (pOffset == 0)
 	{
-    pOffset =  FindSignatureOffset(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, g_NetworkObjectSignature2, sizeof(g_NetworkObjectSignature2));
+    pOffset =  LocateSignature(BASE_ADDRESS, CLIENT_IMAGE_MAX_SIZE, ClientSignatures::g_NetworkObjectSignature2, sizeof(ClientSignatures::g_NetworkObjectSignature2));
 
 		if (pOffset != 0)
 		{
@@ -247,7 +321,7 @@ unsigned int* MasterControlUtils::GetNetworkObjectAddress()
 
 uint8_t* MasterControlUtils::GetMapDimensionAddress()
 {
-  return const_cast<uint8_t*>(FindSignatureOffset(BASE_ADDRESS, 0x300000, g_mapDimensionSignature, sizeof(g_mapDimensionSignature)));
+  return const_cast<uint8_t*>(LocateSignature(BASE_ADDRESS, 0x300000, ClientSignatures::g_mapDimensionSignature, sizeof(ClientSignatures::g_mapDimensionSignature)));
 }
 
 /*********************************************************************************************************************************************
@@ -283,10 +357,10 @@ const unsigned char* MasterControlUtils::FindSignatureOffset(const unsigned char
 unsigned char* MasterControlUtils::GetDrawMapThingieTable()
 {
 
-  unsigned char* drawMapThingieTableAddress = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, g_aDrawMapThingieTableSig1, sizeof(g_aDrawMapThingieTableSig1), 14));
+  unsigned char* drawMapThingieTableAddress = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, ClientSignatures::g_aDrawMapThingieTableSig1, sizeof(ClientSignatures::g_aDrawMapThingieTableSig1), 14));
   if (drawMapThingieTableAddress == 0)
   {
-    drawMapThingieTableAddress = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, g_aDrawMapThingieTableSig2, sizeof(g_aDrawMapThingieTableSig2), 14));
+    drawMapThingieTableAddress = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, ClientSignatures::g_aDrawMapThingieTableSig2, sizeof(ClientSignatures::g_aDrawMapThingieTableSig2), 14));
   }
 
   return drawMapThingieTableAddress;
@@ -294,10 +368,10 @@ unsigned char* MasterControlUtils::GetDrawMapThingieTable()
 
 unsigned char* MasterControlUtils::GetMasterStaticsListPointer()
 {
-  unsigned char* masterStaticListAddress = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, g_masterStaticsListSig1, sizeof(g_masterStaticsListSig1), 9));
+  unsigned char* masterStaticListAddress = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, ClientSignatures::g_masterStaticsListSig1, sizeof(ClientSignatures::g_masterStaticsListSig1), 9));
   if (masterStaticListAddress == 0)
   {
-    masterStaticListAddress = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, g_masterStaticsListSig2, sizeof(g_masterStaticsListSig2), 7));
+    masterStaticListAddress = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, ClientSignatures::g_masterStaticsListSig2, sizeof(ClientSignatures::g_masterStaticsListSig2), 7));
   }
   
   return masterStaticListAddress;
@@ -306,15 +380,15 @@ unsigned char* MasterControlUtils::GetMasterStaticsListPointer()
 
 unsigned char* MasterControlUtils::GetMinClientDisplayX()
 {
-  unsigned char* minClientDisplayX = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, g_minClientDisplaySig1, sizeof(g_minClientDisplaySig1), 12));
+  unsigned char* minClientDisplayX = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, ClientSignatures::g_minClientDisplaySig1, sizeof(ClientSignatures::g_minClientDisplaySig1), 12));
 
   if (minClientDisplayX == 0)
   {
-    minClientDisplayX = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, g_minClientDisplaySig2, sizeof(g_minClientDisplaySig2), 11));
+    minClientDisplayX = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, ClientSignatures::g_minClientDisplaySig2, sizeof(ClientSignatures::g_minClientDisplaySig2), 11));
 
     if (minClientDisplayX == 0)
     {
-      minClientDisplayX = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, g_minClientDisplaySig3, sizeof(g_minClientDisplaySig3), 6));
+      minClientDisplayX = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, ClientSignatures::g_minClientDisplaySig3, sizeof(ClientSignatures::g_minClientDisplaySig3), 6));
     }
   }
    
@@ -323,15 +397,15 @@ unsigned char* MasterControlUtils::GetMinClientDisplayX()
 
 unsigned char* MasterControlUtils::GetMinClientDisplayY()
 {
-  unsigned char* minClientDisplayY = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, g_minClientDisplaySig1, sizeof(g_minClientDisplaySig1), 17));
+  unsigned char* minClientDisplayY = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, ClientSignatures::g_minClientDisplaySig1, sizeof(ClientSignatures::g_minClientDisplaySig1), 17));
 
   if (minClientDisplayY == 0)
   {
-    minClientDisplayY = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, g_minClientDisplaySig2, sizeof(g_minClientDisplaySig2), 16));
+    minClientDisplayY = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, ClientSignatures::g_minClientDisplaySig2, sizeof(ClientSignatures::g_minClientDisplaySig2), 16));
 
     if (minClientDisplayY == 0)
     {
-      minClientDisplayY = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, g_minClientDisplaySig3, sizeof(g_minClientDisplaySig3), 11));
+      minClientDisplayY = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, ClientSignatures::g_minClientDisplaySig3, sizeof(ClientSignatures::g_minClientDisplaySig3), 11));
     }
   }
 
@@ -340,15 +414,15 @@ unsigned char* MasterControlUtils::GetMinClientDisplayY()
 
 unsigned char* MasterControlUtils::GetClientDisplayedBlocksTable()
 {
-  unsigned char* minClientDisplayX = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, g_minClientDisplaySig1, sizeof(g_minClientDisplaySig1), 12));
+  unsigned char* minClientDisplayX = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, ClientSignatures::g_minClientDisplaySig1, sizeof(ClientSignatures::g_minClientDisplaySig1), 12));
 
   if (minClientDisplayX == 0)
   {
-    minClientDisplayX = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, g_minClientDisplaySig2, sizeof(g_minClientDisplaySig2), 11));
+    minClientDisplayX = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, ClientSignatures::g_minClientDisplaySig2, sizeof(ClientSignatures::g_minClientDisplaySig2), 11));
 
     if (minClientDisplayX == 0)
     {
-      minClientDisplayX = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, g_minClientDisplaySig3, sizeof(g_minClientDisplaySig3), 6));
+      minClientDisplayX = const_cast<unsigned char*>(MasterControlUtils::findSignature(BASE_ADDRESS, 0x300000, ClientSignatures::g_minClientDisplaySig3, sizeof(ClientSignatures::g_minClientDisplaySig3), 6));
     }
   }
 
@@ -363,11 +437,11 @@ unsigned char* MasterControlUtils::GetClientDisplayedBlocksTable()
 
 unsigned char* MasterControlUtils::GetUpdateBlocksFunctionPointer()
 {
-  unsigned char* updateBlock = const_cast<unsigned char*>(findFunctionCall(BASE_ADDRESS, 0x300000, g_updateBlocksSig1, sizeof(g_updateBlocksSig1)));
+  unsigned char* updateBlock = const_cast<unsigned char*>(findFunctionCall(BASE_ADDRESS, 0x300000, ClientSignatures::g_updateBlocksSig1, sizeof(ClientSignatures::g_updateBlocksSig1)));
 
   if (updateBlock == 0)
   {
-    updateBlock = const_cast<unsigned char*>(findFunctionCall(BASE_ADDRESS, 0x300000, g_updateBlocksSig2, sizeof(g_updateBlocksSig2)));
+    updateBlock = const_cast<unsigned char*>(findFunctionCall(BASE_ADDRESS, 0x300000, ClientSignatures::g_updateBlocksSig2, sizeof(ClientSignatures::g_updateBlocksSig2)));
   }
 
   return updateBlock;
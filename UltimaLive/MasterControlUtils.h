@@ -22,6 +22,10 @@
 #include <windows.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <vector>
+#include "ClientSignatures.h"
+#include "SignatureScanner.h"
+#include "SignatureCache.h"
 
 class MasterControlUtils
 {
@@ -29,35 +33,6 @@ class MasterControlUtils
     static const unsigned char* BASE_ADDRESS;
     static const int CLIENT_IMAGE_MAX_SIZE = 0x300000;
 
-    //look up signatures
-	  static unsigned char g_sendSignature1[];
-	  static unsigned char g_sendSignature2[];
-	  static unsigned char g_recvSignature1[];
-	  static unsigned char g_recvSignature2[];
-    static unsigned char g_NetworkObjectSignature1[];
-    static unsigned char g_NetworkObjectSignature2[];
-    static unsigned char g_PlayerBaseSignature1[];
-    static unsigned char g_PlayerBaseSignature2[];
-    static unsigned char g_mapDimensionSignature[];
-    static unsigned char g_functionStartSig1[];
-    static unsigned char g_functionStartSig2[];
-
-    static unsigned char g_aDrawMapThingieTableSig1[];
-    static unsigned char g_aDrawMapThingieTableSig2[]; 
-    
-    static unsigned char g_minClientDisplaySig1[];
-    static unsigned char g_minClientDisplaySig2[]; 
-    static unsigned char g_minClientDisplaySig3[]; 
-    
-    static unsigned char g_updateBlocksSig1[];
-    static unsigned char g_updateBlocksSig2[];
-
-    static unsigned char g_refreshTerrainFunctionSig1[];
-
-    static unsigned char g_masterStaticsListSig1[];
-    static unsigned char g_masterStaticsListSig2[];
-
-
     //lookup functions
     static unsigned char* GetPlayerBasePointer();
     static unsigned char* GetSendAddress();
@@ -77,11 +52,20 @@ class MasterControlUtils
 
 
 
+    static void ScanClientImage();
+    static const unsigned char* LocateSignature(const unsigned char* buffer, unsigned int bufferLen, unsigned char* sigBuffer, unsigned int sigLen);
     static const unsigned char* FindSignatureOffset(const unsigned char* buffer, unsigned int bufferLen, unsigned char* sigBuffer, unsigned int sigLen);
     static const unsigned char* findFunctionCall(const unsigned char* pBuffer, int bufferSize, unsigned char* pSignature, int signatureSize);
     static const unsigned char* FindSignatureOffsetBackwards(const unsigned char *pData, unsigned int searchLen, unsigned char *sigBuffer, unsigned int sigLen);
     static const unsigned char* findSignature (const unsigned char* pBuffer, int bufferSize, unsigned char* pSignature, int signatureSize, int offset, int& structureSizeOut, int structureSizeOffset);
     static const unsigned char* findSignature (const unsigned char* pBuffer, int bufferSize, unsigned char* pSignature, int signatureSize, int offset);
+
+  private:
+    static std::vector<const unsigned char*> g_clientMatches;
+    static bool g_clientImageScanned;
+
+    static bool LoadCachedMatches(SignatureCache& rCache, uint64_t key);
+
 };
 
 #endif
\ No newline at end of file
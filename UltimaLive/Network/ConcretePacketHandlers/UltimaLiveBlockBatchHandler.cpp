@@ -0,0 +1,63 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveBlockBatchHandler.h"
+#include "..\NetworkManager.h"
+#include "..\Lz4Block.h"
+
+UltimaLiveBlockBatchHandler::UltimaLiveBlockBatchHandler(NetworkManager* pManager)
+  : BasePacketHandler(pManager)
+{
+  //do nothing
+}
+
+bool UltimaLiveBlockBatchHandler::handlePacket(uint8_t* pPacketData)
+{
+  uint16_t packetLength = ntohs(*reinterpret_cast<uint16_t*>(&pPacketData[1]));
+  uint32_t batchLength = ntohl(*reinterpret_cast<uint32_t*>(&pPacketData[3]));
+  uint8_t mapNumber = pPacketData[14];
+  uint32_t compressedLength = ntohl(*reinterpret_cast<uint32_t*>(&pPacketData[15]));
+
+  if (packetLength < 19 || compressedLength > packetLength - 19u || batchLength == 0 || batchLength > MAX_BATCH_LENGTH)
+  {
+#ifdef DEBUG
+    printf("Dropping block batch with bad lengths: %u compressed, %u uncompressed, %u packet\n", compressedLength, batchLength, packetLength);
+#endif
+    return false;
+  }
+
+  std::vector<uint8_t> records(batchLength);
+  if (Lz4Block::decompress(&pPacketData[19], compressedLength, &records[0], batchLength))
+  {
+    m_pNetManager->onBlockBatchUpdate(mapNumber, &records[0], batchLength);
+  }
+#ifdef DEBUG
+  else
+  {
+    printf("Failed to decompress block batch\n");
+  }
+#endif
+
+  return false;
+}
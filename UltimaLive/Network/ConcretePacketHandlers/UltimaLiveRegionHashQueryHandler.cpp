@@ -0,0 +1,67 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveRegionHashQueryHandler.h"
+#include "..\NetworkManager.h"
+
+UltimaLiveRegionHashQueryHandler::UltimaLiveRegionHashQueryHandler(NetworkManager* pManager)
+  : BasePacketHandler(pManager)
+{
+  //do nothing
+}
+
+bool UltimaLiveRegionHashQueryHandler::handlePacket(uint8_t* pPacketData)
+{
+  uint16_t packetLength = ntohs(*reinterpret_cast<uint16_t*>(&pPacketData[1]));
+  if (packetLength < 17)
+  {
+#ifdef DEBUG
+    printf("Dropping region hash query with bad length: %u packet\n", packetLength);
+#endif
+    return false;
+  }
+
+  uint32_t level = ntohl(*reinterpret_cast<uint32_t*>(&pPacketData[3]));
+  uint16_t sequence = ntohs(*reinterpret_cast<uint16_t*>(&pPacketData[11]));
+  uint8_t mapNumber = pPacketData[14];
+  uint16_t nodeCount = ntohs(*reinterpret_cast<uint16_t*>(&pPacketData[15]));
+
+  if (17u + (nodeCount * 4u) > packetLength)
+  {
+#ifdef DEBUG
+    printf("Dropping region hash query with bad lengths: %u nodes, %u packet\n", nodeCount, packetLength);
+#endif
+    return false;
+  }
+
+  std::vector<uint32_t> nodes;
+  for (uint16_t i = 0; i < nodeCount; i++)
+  {
+    nodes.push_back(ntohl(*reinterpret_cast<uint32_t*>(&pPacketData[17 + (i * 4)])));
+  }
+
+  m_pNetManager->onRegionHashQuery(mapNumber, level, sequence, nodes);
+
+  return false;
+}
@@ -0,0 +1,107 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "Lz4Block.h"
+#include <string.h>
+
+/* Returns true if the block decoded to exactly destinationLength bytes */
+bool Lz4Block::decompress(const uint8_t* pSource, uint32_t sourceLength, uint8_t* pDestination, uint32_t destinationLength)
+{
+  const uint8_t* pSourceEnd = pSource + sourceLength;
+  uint8_t* pOutput = pDestination;
+  uint8_t* pOutputEnd = pDestination + destinationLength;
+
+  while (pSource < pSourceEnd)
+  {
+    uint8_t token = *pSource++;
+
+    uint32_t literalLength = token >> 4;
+    if (literalLength == 15 && !readLength(pSource, pSourceEnd, literalLength))
+    {
+      return false;
+    }
+
+    if (literalLength > static_cast<uint32_t>(pSourceEnd - pSource) || literalLength > static_cast<uint32_t>(pOutputEnd - pOutput))
+    {
+      return false;
+    }
+
+    memcpy(pOutput, pSource, literalLength);
+    pSource += literalLength;
+    pOutput += literalLength;
+
+    //the last sequence ends after its literals
+    if (pSource == pSourceEnd)
+    {
+      break;
+    }
+
+    if (pSourceEnd - pSource < 2)
+    {
+      return false;
+    }
+
+    uint32_t offset = pSource[0] | (pSource[1] << 8);
+    pSource += 2;
+
+    uint32_t matchLength = token & 0x0F;
+    if (matchLength == 15 && !readLength(pSource, pSourceEnd, matchLength))
+    {
+      return false;
+    }
+    matchLength += MIN_MATCH;
+
+    if (offset == 0 || offset > static_cast<uint32_t>(pOutput - pDestination) || matchLength > static_cast<uint32_t>(pOutputEnd - pOutput))
+    {
+      return false;
+    }
+
+    //matches can overlap the bytes they produce, so they are copied a byte at a time
+    const uint8_t* pMatch = pOutput - offset;
+    for (uint32_t i = 0; i < matchLength; i++)
+    {
+      pOutput[i] = pMatch[i];
+    }
+    pOutput += matchLength;
+  }
+
+  return pOutput == pOutputEnd;
+}
+
+bool Lz4Block::readLength(const uint8_t*& rpSource, const uint8_t* pSourceEnd, uint32_t& rLength)
+{
+  uint8_t extra = 255;
+  while (extra == 255)
+  {
+    if (rpSource >= pSourceEnd)
+    {
+      return false;
+    }
+
+    extra = *rpSource++;
+    rLength += extra;
+  }
+
+  return true;
+}
@@ -0,0 +1,48 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#ifndef _LZ4_BLOCK_H
+#define _LZ4_BLOCK_H
+
+#include <stdint.h>
+
+/* Decoder for the LZ4 block format, which the server uses to compress block batches.  A block is a run of sequences, 
+ * each a token byte holding a literal length and a match length, the literals, then a two byte little endian offset
+ * back into the output and the match length.  Lengths of 15 or more continue in extra bytes that are added up until 
+ * one is less than 255.  The last sequence has literals only.
+ *
+ * Every length and offset is checked against the buffers, so a damaged block fails instead of writing out of bounds.
+ */
+class Lz4Block
+{
+  public:
+    static bool decompress(const uint8_t* pSource, uint32_t sourceLength, uint8_t* pDestination, uint32_t destinationLength);
+
+    static const uint32_t MIN_MATCH = 4;
+
+  private:
+    static bool readLength(const uint8_t*& rpSource, const uint8_t* pSourceEnd, uint32_t& rLength);
+};
+
+#endif
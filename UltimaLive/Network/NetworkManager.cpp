@@ -16,6 +16,7 @@
 
 #include "NetworkManager.h"
 #include "..\UoLiveAppState.h"
+#include <cstring>
 
 void NetworkManager::sendPacketToClient(uint8_t* pBuffer)
 {
@@ -31,8 +32,11 @@ NetworkManager::NetworkManager(UoLiveAppState* pAppState)
   : m_onMapDefinitionUpdateSubscribers(),
   m_onLandUpdateSubscriber(),
   m_onStaticsUpdateSubscriber(),
+  m_onBlockBatchUpdateSubscriber(),
   m_onRefreshClientViewSubscriber(),
   m_onBlockQueryRequestSubscriber(),
+  m_onDeltaBlockQueryRequestSubscriber(),
+  m_onRegionHashQuerySubscriber(),
   m_onUltimaLiveLoginCompleteSubscriber(),
   m_onUltimaLiveCRC32RequestSubscriber(),
   m_onUltimaLiveProcessesRequestSubscriber(),
@@ -42,13 +46,12 @@ NetworkManager::NetworkManager(UoLiveAppState* pAppState)
   m_onBeforeMapChangeSubscribers(),
   m_onChangeMapSubscribers(),
   m_onLogoutSubscribers(),
-  m_ultimaLiveHandlers(),
-  m_sendPacketHandlers(),
-  m_recvPacketHandlers(),
   m_sendExtendedPacketHandlers(),
   m_recvExtendedPacketHandlers()
 {
-  //do nothing
+  memset(m_ultimaLiveHandlers, 0, sizeof(m_ultimaLiveHandlers));
+  memset(m_sendPacketHandlers, 0, sizeof(m_sendPacketHandlers));
+  memset(m_recvPacketHandlers, 0, sizeof(m_recvPacketHandlers));
 }
 
 bool NetworkManager::OnReceiveServerUltimaLivePacket(unsigned char *pBuffer)
@@ -57,15 +60,13 @@ bool NetworkManager::OnReceiveServerUltimaLivePacket(unsigned char *pBuffer)
   uint8_t command = pBuffer[13];
 
 #if defined(DEBUG) && defined(PRINT_PACKETS) 
-  std::stringstream packetName;
-  packetName << "Received SERVER_ULTIMALIVE_" << ULTIMA_LIVE_PACKET_NAMES[command];
-  packetName << " (0x" << std::hex << (int)command << ")";  
-  std::cout << packetName.str() << std::endl;
+  printPacketName("Received SERVER_ULTIMALIVE_", NAMES_ULTIMA_LIVE_PACKETS, command);
 #endif
 
-  if (m_ultimaLiveHandlers.find(command) != m_ultimaLiveHandlers.end())
+  BasePacketHandler* pHandler = m_ultimaLiveHandlers[command];
+  if (pHandler != NULL)
   {
-    m_ultimaLiveHandlers[command]->handlePacket(pBuffer);
+    pHandler->handlePacket(pBuffer);
   }
 
   return retVal;
@@ -92,9 +93,10 @@ bool NetworkManager::OnReceivePacket(unsigned char *pBuffer)
 
     default:
     {
-      if (m_recvPacketHandlers.find(command) != m_recvPacketHandlers.end())
+      BasePacketHandler* pHandler = m_recvPacketHandlers[command];
+      if (pHandler != NULL)
       {
-        retVal = m_recvPacketHandlers[command]->handlePacket(pBuffer);
+        retVal = pHandler->handlePacket(pBuffer);
       }
     }
     break;
@@ -103,10 +105,7 @@ bool NetworkManager::OnReceivePacket(unsigned char *pBuffer)
 #if defined(DEBUG) && defined(PRINT_PACKETS)
   if (command != 0xBF && command != 0x3F && command != 0x22)
   {
-    std::stringstream packetName;
-    packetName << "Received SERVER_" << PACKET_NAMES[command];
-    packetName << " (0x" << std::hex << (int)command << ")";  
-    std::cout << packetName.str() << std::endl;
+    printPacketName("Received SERVER_", NAMES_PACKETS, command);
   }
 #endif
   return retVal;
@@ -128,7 +127,7 @@ bool NetworkManager::OnSendPacket(unsigned char *pBuffer)
       printf("CLIENT HAS CRASHED!   Crash Report:\n");
       LocalPeHelper32::HexPrint(pBuffer, *reinterpret_cast<uint16_t*>(&pBuffer[1]));
     }
-    else if (m_sendPacketHandlers.find(command) != m_sendPacketHandlers.end())
+    else if (m_sendPacketHandlers[command] != NULL)
     {
       retVal = m_sendPacketHandlers[command]->handlePacket(pBuffer);
     }
@@ -136,10 +135,7 @@ bool NetworkManager::OnSendPacket(unsigned char *pBuffer)
 
 
 #if defined(DEBUG) && defined(PRINT_PACKETS)
-    std::stringstream packetName;
-    packetName << "Sent CLIENT_" << PACKET_NAMES[command];
-    packetName << " (0x" << std::hex << (int)command << ")";  
-    std::cout << packetName.str() << std::endl;
+    printPacketName("Sent CLIENT_", NAMES_PACKETS, command);
 #endif
   }
 
@@ -151,16 +147,14 @@ bool NetworkManager::OnReceiveExtendedPacket(unsigned char *pBuffer)
   bool retVal = true;
   uint16_t command = ntohs(*reinterpret_cast<uint16_t*>(&pBuffer[3]));
 
-  if (m_recvExtendedPacketHandlers.find(command) != m_recvExtendedPacketHandlers.end())
+  BasePacketHandler* pHandler = findExtendedHandler(m_recvExtendedPacketHandlers, command);
+  if (pHandler != NULL)
   {
-    retVal = m_recvExtendedPacketHandlers[command]->handlePacket(pBuffer);
+    retVal = pHandler->handlePacket(pBuffer);
   }
 
 #if defined(DEBUG) && defined(PRINT_PACKETS)
-  std::stringstream packetName;
-  packetName << "Received SERVER_EXTENDED_" << EXTENDED_PACKET_NAMES[command];
-  packetName << " (0x" << std::hex << (int)command << ")";  
-  std::cout << packetName.str() << std::endl;
+  printPacketName("Received SERVER_EXTENDED_", NAMES_EXTENDED_PACKETS, command);
 #endif
 
   return retVal;
@@ -171,53 +165,92 @@ bool NetworkManager::OnSendExtendedPacket(unsigned char *pBuffer)
   uint16_t command = ntohs(*reinterpret_cast<uint16_t*>(&pBuffer[3]));
 
   bool retVal = true;
-  if (m_sendExtendedPacketHandlers.find(command) != m_sendExtendedPacketHandlers.end())
+  BasePacketHandler* pHandler = findExtendedHandler(m_sendExtendedPacketHandlers, command);
+  if (pHandler != NULL)
   {
-    retVal = m_sendExtendedPacketHandlers[command]->handlePacket(pBuffer);
+    retVal = pHandler->handlePacket(pBuffer);
   }
 
 #if defined(DEBUG) && defined(PRINT_PACKETS)
-  std::stringstream packetName;
-  packetName << "sent CLIENT_EXTENDED_" << EXTENDED_PACKET_NAMES[command];
-  packetName << "_(0x" << std::hex << (int)command << ")";
-  std::cout << packetName.str() << std::endl;
+  printPacketName("sent CLIENT_EXTENDED_", NAMES_EXTENDED_PACKETS, command);
 #endif
 
   return retVal;
 }
 
+/* The factory hands out maps of handlers, they are flattened here so that dispatching a packet is a single index or
+ * a short search instead of a map lookup
+ */
 void NetworkManager::init(uint32_t versionMajor, uint32_t versionMinor)
 {
 #ifdef DEBUG
   printf("Initializing Network Manager!\n");
 #endif
 
-  m_sendPacketHandlers = PacketHandlerFactory::GenerateClientPacketHandlers(versionMajor, versionMinor, this);
+  std::map<uint8_t, BasePacketHandler*> sendHandlers = PacketHandlerFactory::GenerateClientPacketHandlers(versionMajor, versionMinor, this);
+  uint32_t count = buildDispatchTable(sendHandlers, m_sendPacketHandlers);
 #ifdef DEBUG
-  printf("send packet handlers: %i\n", m_sendPacketHandlers.size());
+  printf("send packet handlers: %i\n", count);
 #endif
 
-  m_recvPacketHandlers = PacketHandlerFactory::GenerateServerPacketHandlers(versionMajor, versionMinor, this);
+  std::map<uint8_t, BasePacketHandler*> recvHandlers = PacketHandlerFactory::GenerateServerPacketHandlers(versionMajor, versionMinor, this);
+  count = buildDispatchTable(recvHandlers, m_recvPacketHandlers);
 #ifdef DEBUG
-  printf("recv packet handlers: %i\n", m_recvPacketHandlers.size());
+  printf("recv packet handlers: %i\n", count);
 #endif
 
-  m_sendExtendedPacketHandlers = PacketHandlerFactory::GenerateClientExtendedPacketHandlers(versionMajor, versionMinor, this);
+  std::map<uint16_t, BasePacketHandler*> sendExtendedHandlers = PacketHandlerFactory::GenerateClientExtendedPacketHandlers(versionMajor, versionMinor, this);
+  count = buildExtendedDispatchTable(sendExtendedHandlers, m_sendExtendedPacketHandlers);
 #ifdef DEBUG
-  printf("send ext packet handlers: %i\n", m_sendExtendedPacketHandlers.size());
+  printf("send ext packet handlers: %i\n", count);
 #endif
 
-  m_recvExtendedPacketHandlers = PacketHandlerFactory::GenerateServerExtendedPacketHandlers(versionMajor, versionMinor, this);
+  std::map<uint16_t, BasePacketHandler*> recvExtendedHandlers = PacketHandlerFactory::GenerateServerExtendedPacketHandlers(versionMajor, versionMinor, this);
+  count = buildExtendedDispatchTable(recvExtendedHandlers, m_recvExtendedPacketHandlers);
 #ifdef DEBUG
-  printf("recv ext packet handlers: %i\n", m_recvExtendedPacketHandlers.size());
+  printf("recv ext packet handlers: %i\n", count);
 #endif
 
-  m_ultimaLiveHandlers = PacketHandlerFactory::GenerateUltimaLiveServerPacketHandlers(versionMajor, versionMinor, this);
+  std::map<uint8_t, BasePacketHandler*> ultimaLiveHandlers = PacketHandlerFactory::GenerateUltimaLiveServerPacketHandlers(versionMajor, versionMinor, this);
+  count = buildDispatchTable(ultimaLiveHandlers, m_ultimaLiveHandlers);
 #ifdef DEBUG
-  printf("recv ultima live packet handlers: %i\n", m_ultimaLiveHandlers.size());
+  printf("recv ultima live packet handlers: %i\n", count);
 #endif
 }
 
+uint32_t NetworkManager::buildDispatchTable(std::map<uint8_t, BasePacketHandler*>& rHandlers, BasePacketHandler** pTable)
+{
+  memset(pTable, 0, 256 * sizeof(BasePacketHandler*));
+
+  for (std::map<uint8_t, BasePacketHandler*>::iterator itr = rHandlers.begin(); itr != rHandlers.end(); itr++)
+  {
+    pTable[itr->first] = itr->second;
+  }
+
+  return rHandlers.size();
+}
+
+uint32_t NetworkManager::buildExtendedDispatchTable(std::map<uint16_t, BasePacketHandler*>& rHandlers, std::vector<std::pair<uint16_t, BasePacketHandler*>>& rTable)
+{
+  //the map is already in command order
+  rTable.assign(rHandlers.begin(), rHandlers.end());
+  return rTable.size();
+}
+
+/* There are only ever a handful of extended handlers, so a scan of the sorted table beats a binary search */
+BasePacketHandler* NetworkManager::findExtendedHandler(std::vector<std::pair<uint16_t, BasePacketHandler*>>& rTable, uint16_t command)
+{
+  for (std::vector<std::pair<uint16_t, BasePacketHandler*>>::iterator itr = rTable.begin(); itr != rTable.end() && itr->first <= command; itr++)
+  {
+    if (itr->first == command)
+    {
+      return itr->second;
+    }
+  }
+
+  return NULL;
+}
+
 void NetworkManager::subscribeToMapDefinitionUpdate(std::function<void(std::vector<MapDefinition>)> pCallback)
 {
   m_onMapDefinitionUpdateSubscribers.push_back(pCallback);
@@ -233,6 +266,11 @@ void NetworkManager::subscribeToStaticsUpdate(std::function<void(uint8_t, uint32
   m_onStaticsUpdateSubscriber.push_back(pCallback);
 }
 
+void NetworkManager::subscribeToBlockBatchUpdate(std::function<void(uint8_t, uint8_t*, uint32_t)> pCallback)
+{
+  m_onBlockBatchUpdateSubscriber.push_back(pCallback);
+}
+
 void NetworkManager::subscribeToRefreshClient(std::function<void()> pCallback)
 {
   m_onRefreshClientViewSubscriber.push_back(pCallback);
@@ -243,6 +281,16 @@ void NetworkManager::subscribeToBlockQueryRequest(std::function<void(int32_t, ui
   m_onBlockQueryRequestSubscriber.push_back(pCallback);
 }
 
+void NetworkManager::subscribeToDeltaBlockQueryRequest(std::function<void(int32_t, uint8_t, uint16_t)> pCallback)
+{
+  m_onDeltaBlockQueryRequestSubscriber.push_back(pCallback);
+}
+
+void NetworkManager::subscribeToRegionHashQuery(std::function<void(uint8_t, uint32_t, uint16_t, std::vector<uint32_t>)> pCallback)
+{
+  m_onRegionHashQuerySubscriber.push_back(pCallback);
+}
+
 void NetworkManager::subscribeToUltimaLiveLoginComplete(std::function<void(std::string)> pCallback)
 {
   m_onUltimaLiveLoginCompleteSubscriber.push_back(pCallback);
@@ -312,6 +360,14 @@ void NetworkManager::onStaticsUpdate(uint8_t mapNumber, uint32_t blockNumber, ui
   }
 }
 
+void NetworkManager::onBlockBatchUpdate(uint8_t mapNumber, uint8_t* pRecords, uint32_t length)
+{
+  for (std::vector<std::function<void(uint8_t, uint8_t*, uint32_t)>>::iterator itr = m_onBlockBatchUpdateSubscriber.begin(); itr != m_onBlockBatchUpdateSubscriber.end(); itr++)
+  {
+    (*itr)(mapNumber, pRecords, length);
+  }
+}
+
 void NetworkManager::onRefreshClient()
 {
   for(std::vector<std::function<void()>>::iterator itr = m_onRefreshClientViewSubscriber.begin(); itr != m_onRefreshClientViewSubscriber.end(); itr++)
@@ -328,6 +384,22 @@ void NetworkManager::onBlockQueryRequest(int32_t blockNumber, uint8_t mapNumber,
   }
 }
 
+void NetworkManager::onDeltaBlockQueryRequest(int32_t blockNumber, uint8_t mapNumber, uint16_t sequence)
+{
+  for (std::vector<std::function<void(uint32_t, uint8_t, uint16_t)>>::iterator itr = m_onDeltaBlockQueryRequestSubscriber.begin(); itr != m_onDeltaBlockQueryRequestSubscriber.end(); itr++)
+  {
+    (*itr)(blockNumber, mapNumber, sequence);
+  }
+}
+
+void NetworkManager::onRegionHashQuery(uint8_t mapNumber, uint32_t level, uint16_t sequence, std::vector<uint32_t> nodes)
+{
+  for (std::vector<std::function<void(uint8_t, uint32_t, uint16_t, std::vector<uint32_t>)>>::iterator itr = m_onRegionHashQuerySubscriber.begin(); itr != m_onRegionHashQuerySubscriber.end(); itr++)
+  {
+    (*itr)(mapNumber, level, sequence, nodes);
+  }
+}
+
 void NetworkManager::onUltimaLiveLoginComplete(std::string shardIdentifier)
 {
   for (std::vector<std::function<void(std::string)>>::iterator itr = m_onUltimaLiveLoginCompleteSubscriber.begin(); itr != m_onUltimaLiveLoginCompleteSubscriber.end(); itr++)
@@ -451,7 +523,7 @@ std::string NetworkManager::EXTENDED_PACKET_NAMES[] =
 
 std::string NetworkManager::ULTIMA_LIVE_PACKET_NAMES[] =
 {
-  /* 0x00 - 0x07 */ "STATICS_UPDATE", "UPDATE_MAP_DEFINITIONS",   "LOGIN_CONFIRMATION",   "REFRESH_CLIENT",   "",   "",   "",
+  /* 0x00 - 0x07 */ "STATICS_UPDATE", "UPDATE_MAP_DEFINITIONS",   "LOGIN_CONFIRMATION",   "REFRESH_CLIENT",   "REGION_HASH_QUERY",   "DELTA_BLOCK_QUERY",   "BLOCK_BATCH",
   /* 0x08 - 0x0F */ "",   "",   "",   "",   "",   "",   "",   "",   "",
   /* 0x10 - 0x17 */ "",   "",   "",   "",   "",   "",   "",   "",   "",
   /* 0x18 - 0x1F */ "",   "",   "",   "",   "",   "",   "",   "",   "",
@@ -484,5 +556,26 @@ std::string NetworkManager::ULTIMA_LIVE_PACKET_NAMES[] =
   /* 0xF0 - 0xF7 */ "CRC32 Query",   "",   "",   "",   "",   "",   "",   "",   "",
   /* 0xF8 - 0xFF */ "",   "",   "",   "",   "",   "",   "",   "",   "BLOCK_QUERY"
 };  
-#endif
 
+/* Prints a packet's name the way the PRINT_PACKETS build logs them, commands past the end of the name table are 
+ * printed as UNKNOWN
+ */
+void NetworkManager::printPacketName(const char* pPrefix, PacketNameTable table, uint32_t command)
+{
+  std::string* pNames = PACKET_NAMES;
+  uint32_t numberOfNames = sizeof(PACKET_NAMES) / sizeof(PACKET_NAMES[0]);
+
+  if (table == NAMES_EXTENDED_PACKETS)
+  {
+    pNames = EXTENDED_PACKET_NAMES;
+    numberOfNames = sizeof(EXTENDED_PACKET_NAMES) / sizeof(EXTENDED_PACKET_NAMES[0]);
+  }
+  else if (table == NAMES_ULTIMA_LIVE_PACKETS)
+  {
+    pNames = ULTIMA_LIVE_PACKET_NAMES;
+    numberOfNames = sizeof(ULTIMA_LIVE_PACKET_NAMES) / sizeof(ULTIMA_LIVE_PACKET_NAMES[0]);
+  }
+
+  printf("%s%s (0x%x)\n", pPrefix, command < numberOfNames ? pNames[command].c_str() : "UNKNOWN", command);
+}
+#endif
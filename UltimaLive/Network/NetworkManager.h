@@ -25,10 +25,12 @@
    |    |     |    |                                     | +------+|  x  Map Definitions Update                           |
    |    |     |    |                                     | |+-----+|  x  Land Update                                      |
    |    |     | +--+------------------------------+      | ||+----+|  x  Statics Update                                   |
-   |    |     | | Login Confirm Handler 7_0_29_2  +------+ |||     |  x  Refresh Client View                              |
-   |    |     | +---------------------------------+        |||     |  x  Block Query Request                              |
-   |    |     |                                            |||     |  x  Login Complete (UO Live)                         |
-   |    |   +-+-----------------------------------+        |||     |                                                      |
+   |    |     | | Login Confirm Handler 7_0_29_2  +------+ |||     |  x  Block Batch Update                               |
+   |    |     | +---------------------------------+        |||     |  x  Refresh Client View                              |
+   |    |     |                                            |||     |  x  Block Query Request                              |
+   |    |     |                                            |||     |  x  Region Hash Query                                |
+   |    |     |                                            |||     |  x  Delta Block Query                                |
+   |    |   +-+-----------------------------------+        |||     |  x  Login Complete (UO Live)                         |
    |    |   |     Login Complete Handler 7_0_29_2 |--------+||     |                                                      |
    |    |   +-------------------------------------+         ||     |   Regular Game Logic:                                |
    |    |                                                   ||     |     Login Confirm                                    |
@@ -70,8 +72,11 @@ class NetworkManager
     void onMapDefinitionUpdate(std::vector<MapDefinition> definitions);
     void onLandUpdate(uint8_t mapNumber, uint32_t blockNumber, uint8_t* pLandData);
     void onStaticsUpdate(uint8_t mapNumber, uint32_t blockNumber, uint8_t* pStaticsData, uint32_t length);
+    void onBlockBatchUpdate(uint8_t mapNumber, uint8_t* pRecords, uint32_t length);
     void onRefreshClient();
     void onBlockQueryRequest(int32_t blockNumber, uint8_t mapNumber, uint16_t);
+    void onDeltaBlockQueryRequest(int32_t blockNumber, uint8_t mapNumber, uint16_t sequence);
+    void onRegionHashQuery(uint8_t mapNumber, uint32_t level, uint16_t sequence, std::vector<uint32_t> nodes);
     void onUltimaLiveLoginComplete(std::string shardIdentifier);
     void onUltimaLiveCRC32Request();
 	void onUltimaLiveProcessesRequest(int32_t requester);
@@ -86,8 +91,11 @@ class NetworkManager
     void subscribeToMapDefinitionUpdate(std::function<void(std::vector<MapDefinition>)> pCallback);
     void subscribeToLandUpdate(std::function<void(uint8_t, uint32_t, uint8_t*)> pCallback);
     void subscribeToStaticsUpdate(std::function<void(uint8_t, uint32_t, uint8_t*, uint32_t)> pCallback);
+    void subscribeToBlockBatchUpdate(std::function<void(uint8_t, uint8_t*, uint32_t)> pCallback);
     void subscribeToRefreshClient(std::function<void()> pCallback);
     void subscribeToBlockQueryRequest(std::function<void(int32_t, uint8_t, uint16_t)> pCallback);
+    void subscribeToDeltaBlockQueryRequest(std::function<void(int32_t, uint8_t, uint16_t)> pCallback);
+    void subscribeToRegionHashQuery(std::function<void(uint8_t, uint32_t, uint16_t, std::vector<uint32_t>)> pCallback);
     void subscribeToUltimaLiveLoginComplete(std::function<void(std::string)> pCallback);
     void subscribeToUltimaLiveCRC32Request(std::function<void()> pCallback);
 	void subscribeToUltimaLiveProcessesRequest(std::function<void(int32_t)> pCallback);
@@ -104,13 +112,25 @@ class NetworkManager
   static std::string PACKET_NAMES[];
   static std::string EXTENDED_PACKET_NAMES[];
 	static std::string ULTIMA_LIVE_PACKET_NAMES[];
+
+    enum PacketNameTable
+    {
+      NAMES_PACKETS,
+      NAMES_EXTENDED_PACKETS,
+      NAMES_ULTIMA_LIVE_PACKETS
+    };
+
+    static void printPacketName(const char* pPrefix, PacketNameTable table, uint32_t command);
 #endif
     //ultima live events - for now there's a max of one subscriber
     std::vector<std::function<void(std::vector<MapDefinition>)>> m_onMapDefinitionUpdateSubscribers;
     std::vector<std::function<void(uint8_t, uint32_t, uint8_t*)>> m_onLandUpdateSubscriber;
     std::vector<std::function<void(uint8_t, uint32_t, uint8_t*, uint32_t)>> m_onStaticsUpdateSubscriber;
+    std::vector<std::function<void(uint8_t, uint8_t*, uint32_t)>> m_onBlockBatchUpdateSubscriber;
     std::vector<std::function<void()>> m_onRefreshClientViewSubscriber;
     std::vector<std::function<void(uint32_t, uint8_t, uint16_t)>> m_onBlockQueryRequestSubscriber;
+    std::vector<std::function<void(uint32_t, uint8_t, uint16_t)>> m_onDeltaBlockQueryRequestSubscriber;
+    std::vector<std::function<void(uint8_t, uint32_t, uint16_t, std::vector<uint32_t>)>> m_onRegionHashQuerySubscriber;
     std::vector<std::function<void(std::string)>> m_onUltimaLiveLoginCompleteSubscriber;
     std::vector<std::function<void()>> m_onUltimaLiveCRC32RequestSubscriber;
 	std::vector<std::function<void(uint32_t)>> m_onUltimaLiveProcessesRequestSubscriber;
@@ -123,12 +143,16 @@ class NetworkManager
     std::vector<std::function<void(uint8_t&)>> m_onChangeMapSubscribers;
     std::vector<std::function<void()>> m_onLogoutSubscribers;
 
-    //packet handler maps
-    std::map<uint8_t, BasePacketHandler*> m_ultimaLiveHandlers;
-    std::map<uint8_t, BasePacketHandler*> m_sendPacketHandlers;
-    std::map<uint8_t, BasePacketHandler*> m_recvPacketHandlers;
-    std::map<uint8_t, BasePacketHandler*> m_sendExtendedPacketHandlers;
-    std::map<uint8_t, BasePacketHandler*> m_recvExtendedPacketHandlers;
+    //packet handler tables, indexed by command byte, or sorted by command for the 16 bit extended commands
+    BasePacketHandler* m_ultimaLiveHandlers[256];
+    BasePacketHandler* m_sendPacketHandlers[256];
+    BasePacketHandler* m_recvPacketHandlers[256];
+    std::vector<std::pair<uint16_t, BasePacketHandler*>> m_sendExtendedPacketHandlers;
+    std::vector<std::pair<uint16_t, BasePacketHandler*>> m_recvExtendedPacketHandlers;
+
+    static uint32_t buildDispatchTable(std::map<uint8_t, BasePacketHandler*>& rHandlers, BasePacketHandler** pTable);
+    static uint32_t buildExtendedDispatchTable(std::map<uint16_t, BasePacketHandler*>& rHandlers, std::vector<std::pair<uint16_t, BasePacketHandler*>>& rTable);
+    static BasePacketHandler* findExtendedHandler(std::vector<std::pair<uint16_t, BasePacketHandler*>>& rTable, uint16_t command);
 
     //extended packet handler redirection and ultima live packet handler redirection
     bool OnReceiveServerUltimaLivePacket(unsigned char *pBuffer);
@@ -23,6 +23,9 @@
 #include "ConcretePacketHandlers\UltimaLiveUpdateMapDefinitionsHandler.h"
 #include "ConcretePacketHandlers\UltimaLiveUpdateStaticsHandler.h"
 #include "ConcretePacketHandlers\UltimaLiveHashQueryHandler.h"
+#include "ConcretePacketHandlers\UltimaLiveRegionHashQueryHandler.h"
+#include "ConcretePacketHandlers\UltimaLiveDeltaHashQueryHandler.h"
+#include "ConcretePacketHandlers\UltimaLiveBlockBatchHandler.h"
 #include "ConcretePacketHandlers\UltimaLiveUpdateLandBlockHandler.h"
 #include "ConcretePacketHandlers\UltimaLiveLoginCompleteHandler.h"
 #include "ConcretePacketHandlers\UltimaLiveCRC32RequestHandler.h"
@@ -58,6 +61,9 @@ std::map<uint8_t, BasePacketHandler*> PacketHandlerFactory::GenerateUltimaLiveSe
     handlers[0x01] = new UltimaLiveUpdateMapDefinitionsHandler(pManager);
     handlers[0x02] = new UltimaLiveLoginCompleteHandler(pManager);
     handlers[0x03] = new UltimaLiveRefreshClientViewHandler(pManager);
+    handlers[0x04] = new UltimaLiveRegionHashQueryHandler(pManager);
+    handlers[0x05] = new UltimaLiveDeltaHashQueryHandler(pManager);
+    handlers[0x06] = new UltimaLiveBlockBatchHandler(pManager);
     handlers[0xF0] = new UltimaLiveCRC32RequestHandler(pManager);
 	handlers[0xF1] = new UltimaLiveProcessesRequestHandler(pManager);
     handlers[0xFF] = new UltimaLiveHashQueryHandler(pManager);
@@ -66,9 +72,9 @@ std::map<uint8_t, BasePacketHandler*> PacketHandlerFactory::GenerateUltimaLiveSe
   return handlers;
 }
 
-std::map<uint8_t, BasePacketHandler*> PacketHandlerFactory::GenerateClientExtendedPacketHandlers (uint32_t versionMajor, uint32_t versionMinor, NetworkManager* pManager)
+std::map<uint16_t, BasePacketHandler*> PacketHandlerFactory::GenerateClientExtendedPacketHandlers (uint32_t versionMajor, uint32_t versionMinor, NetworkManager* pManager)
 {
-  std::map<uint8_t, BasePacketHandler*> handlers;
+  std::map<uint16_t, BasePacketHandler*> handlers;
   //if (version.compare("7.0.29.2") == 0)
   {
   }
@@ -91,9 +97,9 @@ std::map<uint8_t, BasePacketHandler*> PacketHandlerFactory::GenerateServerPacket
   return handlers;
 }
 
-std::map<uint8_t, BasePacketHandler*> PacketHandlerFactory::GenerateServerExtendedPacketHandlers (uint32_t versionMajor, uint32_t versionMinor, NetworkManager* pManager)
+std::map<uint16_t, BasePacketHandler*> PacketHandlerFactory::GenerateServerExtendedPacketHandlers (uint32_t versionMajor, uint32_t versionMinor, NetworkManager* pManager)
 {
-  std::map<uint8_t, BasePacketHandler*> handlers;
+  std::map<uint16_t, BasePacketHandler*> handlers;
   //if (version.compare("7.0.29.2") == 0)
   {
     handlers[0x08] = new ChangeMapHandler_7_0_29_2(pManager);   
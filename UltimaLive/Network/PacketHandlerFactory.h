@@ -25,9 +25,9 @@ class PacketHandlerFactory
 {
   public:
     static std::map<uint8_t, BasePacketHandler*> GenerateClientPacketHandlers (uint32_t versionMajor, uint32_t versionMinor, NetworkManager* pManager);
-    static std::map<uint8_t, BasePacketHandler*> GenerateClientExtendedPacketHandlers (uint32_t versionMajor, uint32_t versionMinor, NetworkManager* pManager);
+    static std::map<uint16_t, BasePacketHandler*> GenerateClientExtendedPacketHandlers (uint32_t versionMajor, uint32_t versionMinor, NetworkManager* pManager);
     static std::map<uint8_t, BasePacketHandler*> GenerateServerPacketHandlers (uint32_t versionMajor, uint32_t versionMinor, NetworkManager* pManager);
-    static std::map<uint8_t, BasePacketHandler*> GenerateServerExtendedPacketHandlers (uint32_t versionMajor, uint32_t versionMinor, NetworkManager* pManager);
+    static std::map<uint16_t, BasePacketHandler*> GenerateServerExtendedPacketHandlers (uint32_t versionMajor, uint32_t versionMinor, NetworkManager* pManager);
     static std::map<uint8_t, BasePacketHandler*> GenerateUltimaLiveServerPacketHandlers (uint32_t versionMajor, uint32_t versionMinor, NetworkManager* pManager);
 };
 #endif
\ No newline at end of file
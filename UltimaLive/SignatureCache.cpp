@@ -0,0 +1,174 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "SignatureCache.h"
+#include <Windows.h>
+#include <shlobj.h>
+#include <fstream>
+#include <cstdio>
+
+SignatureCache::SignatureCache()
+  : m_offsets()
+{
+  //do nothing
+}
+
+/* Reads the saved table back if it was written for the same key and the same number of signatures */
+bool SignatureCache::load(uint64_t key, uint32_t numberOfSignatures)
+{
+  std::string path = getCachePath();
+  std::ifstream cacheFile(path, std::ios::binary | std::ios::in);
+  if (!cacheFile.is_open())
+  {
+    return false;
+  }
+
+  uint32_t header[2] = { 0, 0 };
+  uint64_t savedKey = 0;
+  cacheFile.read(reinterpret_cast<char*>(header), sizeof(header));
+  cacheFile.read(reinterpret_cast<char*>(&savedKey), sizeof(savedKey));
+
+  bool loaded = false;
+  if (cacheFile.good() && header[0] == CACHE_MAGIC && header[1] == numberOfSignatures && savedKey == key && numberOfSignatures > 0)
+  {
+    m_offsets.assign(numberOfSignatures, NOT_FOUND);
+    cacheFile.read(reinterpret_cast<char*>(&m_offsets[0]), m_offsets.size() * sizeof(uint32_t));
+    loaded = cacheFile.good();
+  }
+
+  cacheFile.close();
+
+#ifdef DEBUG
+  printf("Signature cache %s %s\n", path.c_str(), loaded ? "loaded" : "is missing, stale or damaged");
+#endif
+
+  return loaded;
+}
+
+void SignatureCache::save(uint64_t key)
+{
+  if (m_offsets.empty())
+  {
+    return;
+  }
+
+  std::string path = getCachePath();
+  std::ofstream cacheFile(path, std::ios::binary | std::ios::out | std::ios::trunc);
+  if (cacheFile.is_open())
+  {
+    uint32_t header[2] = { CACHE_MAGIC, static_cast<uint32_t>(m_offsets.size()) };
+    cacheFile.write(reinterpret_cast<const char*>(header), sizeof(header));
+    cacheFile.write(reinterpret_cast<const char*>(&key), sizeof(key));
+    cacheFile.write(reinterpret_cast<const char*>(&m_offsets[0]), m_offsets.size() * sizeof(uint32_t));
+    cacheFile.flush();
+    bool saved = cacheFile.good();
+    cacheFile.close();
+
+    if (!saved)
+    {
+      DeleteFileA(path.c_str());
+    }
+  }
+}
+
+uint32_t SignatureCache::getOffset(uint32_t signatureId) const
+{
+  return signatureId < m_offsets.size() ? m_offsets[signatureId] : NOT_FOUND;
+}
+
+void SignatureCache::setOffset(uint32_t signatureId, uint32_t offset)
+{
+  if (signatureId < m_offsets.size())
+  {
+    m_offsets[signatureId] = offset;
+  }
+}
+
+void SignatureCache::reset(uint32_t numberOfSignatures)
+{
+  m_offsets.assign(numberOfSignatures, NOT_FOUND);
+}
+
+/* Hashes the PE headers and every code section of the loaded image.  This has to happen before any hooks are written
+ * into the code, otherwise the hash would depend on what was already hooked.
+ */
+uint64_t SignatureCache::hashImage(const uint8_t* pImageBase)
+{
+  const IMAGE_DOS_HEADER* pDosHeader = reinterpret_cast<const IMAGE_DOS_HEADER*>(pImageBase);
+  if (pDosHeader->e_magic != IMAGE_DOS_SIGNATURE)
+  {
+    return 0;
+  }
+
+  const IMAGE_NT_HEADERS* pNtHeader = reinterpret_cast<const IMAGE_NT_HEADERS*>(pImageBase + pDosHeader->e_lfanew);
+  if (pNtHeader->Signature != IMAGE_NT_SIGNATURE)
+  {
+    return 0;
+  }
+
+  uint64_t hash = hashBytes(FNV_OFFSET_BASIS, pImageBase, pNtHeader->OptionalHeader.SizeOfHeaders);
+
+  const IMAGE_SECTION_HEADER* pSection = IMAGE_FIRST_SECTION(pNtHeader);
+  for (uint32_t i = 0; i < pNtHeader->FileHeader.NumberOfSections; i++, pSection++)
+  {
+    if ((pSection->Characteristics & IMAGE_SCN_CNT_CODE) != 0)
+    {
+      uint32_t length = pSection->Misc.VirtualSize < pSection->SizeOfRawData ? pSection->Misc.VirtualSize : pSection->SizeOfRawData;
+      hash = hashBytes(hash, pImageBase + pSection->VirtualAddress, length);
+    }
+  }
+
+  return hash;
+}
+
+/* FNV-1a style, taken four bytes at a time for the bulk of the data since a code section runs to a few megabytes */
+uint64_t SignatureCache::hashBytes(uint64_t hash, const uint8_t* pData, uint32_t length)
+{
+  uint32_t position = 0;
+  for (; position + 4 <= length; position += 4)
+  {
+    hash = (hash ^ *reinterpret_cast<const uint32_t*>(pData + position)) * FNV_PRIME;
+  }
+
+  for (; position < length; position++)
+  {
+    hash = (hash ^ pData[position]) * FNV_PRIME;
+  }
+
+  return hash;
+}
+
+/* The table goes in the same common application data folder as the shard files */
+std::string SignatureCache::getCachePath()
+{
+  char szPath[MAX_PATH];
+  if (SUCCEEDED(SHGetFolderPath(NULL, CSIDL_COMMON_APPDATA, NULL, 0, szPath)))
+  {
+    std::string completePath(szPath);
+    completePath.append("\\UltimaLiveSignatures.cache");
+    return completePath;
+  }
+
+  return std::string("UltimaLiveSignatures.cache");
+}
@@ -0,0 +1,64 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#ifndef _SIGNATURE_CACHE_H
+#define _SIGNATURE_CACHE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/* Remembers where the client signatures were found in a particular client build, so that later launches of the same
+ * build can skip the signature scan altogether.
+ *
+ * Addresses are stored as offsets from the image base.  The table is keyed by a hash of the client's PE headers and 
+ * code sections together with the signature set itself, so a patched client or a changed signature list misses.  An 
+ * entry that is read back is only used if the signature still matches at the stored offset, which the caller checks.
+ */
+class SignatureCache
+{
+  public:
+    SignatureCache();
+
+    bool load(uint64_t key, uint32_t numberOfSignatures);
+    void save(uint64_t key);
+
+    uint32_t getOffset(uint32_t signatureId) const;
+    void setOffset(uint32_t signatureId, uint32_t offset);
+    void reset(uint32_t numberOfSignatures);
+
+    static uint64_t hashImage(const uint8_t* pImageBase);
+    static uint64_t hashBytes(uint64_t hash, const uint8_t* pData, uint32_t length);
+    static std::string getCachePath();
+
+    static const uint32_t CACHE_MAGIC = 0x53534C55; //ULSS
+    static const uint32_t NOT_FOUND = 0xFFFFFFFF;
+    static const uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+    static const uint64_t FNV_PRIME = 0x100000001B3ULL;
+
+  private:
+    std::vector<uint32_t> m_offsets;
+};
+
+#endif
@@ -0,0 +1,283 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "SignatureScanner.h"
+#include <emmintrin.h>
+#include <cstdio>
+
+/* The scanner is shared with the offline signature analyzer, so it also has to build outside of Windows, where it
+ * only ever runs on x86-64 and SSE2 is always there.
+ */
+#ifdef _WIN32
+#include <Windows.h>
+#include <intrin.h>
+
+const bool SignatureScanner::s_sse2Available = IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE) != FALSE;
+
+static inline uint32_t lowestSetBit(uint32_t mask)
+{
+  unsigned long bit;
+  _BitScanForward(&bit, mask);
+  return bit;
+}
+#else
+const bool SignatureScanner::s_sse2Available = true;
+
+static inline uint32_t lowestSetBit(uint32_t mask)
+{
+  return static_cast<uint32_t>(__builtin_ctz(mask));
+}
+#endif
+
+const uint8_t SignatureScanner::WILDCARD;
+
+SignatureScanner::SignatureScanner()
+  : m_signatures(),
+  m_anchorBytes(),
+  m_remaining(0),
+  m_compiled(false)
+{
+  //do nothing
+}
+
+/* Adds a signature to the set and returns its id for getMatch.  The signature bytes are not copied, so they have to 
+ * outlive the scanner.
+ */
+uint32_t SignatureScanner::addSignature(const uint8_t* pSignature, uint32_t length)
+{
+  Signature signature;
+  signature.pBytes = pSignature;
+  signature.length = length;
+  signature.anchorOffset = 0;
+  signature.nextWithAnchor = -1;
+  signature.pMatch = NULL;
+  m_signatures.push_back(signature);
+  m_compiled = false;
+
+  return static_cast<uint32_t>(m_signatures.size() - 1);
+}
+
+/* Picks the anchor byte of every signature and chains the signatures by anchor byte.  How rare a byte is comes from 
+ * a histogram of every HISTOGRAM_STRIDE'th byte of the image, which is plenty to tell opcode and zero bytes from the 
+ * rest.  A signature made only of wildcards gets no anchor, it matches at the start of the image.
+ */
+void SignatureScanner::compile(const uint8_t* pImage, uint32_t imageLength)
+{
+  uint32_t histogram[256] = { 0 };
+  for (uint32_t position = 0; position < imageLength; position += HISTOGRAM_STRIDE)
+  {
+    histogram[pImage[position]]++;
+  }
+
+  bool usedAsAnchor[256] = { false };
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    m_firstWithAnchor[i] = -1;
+  }
+
+  for (int32_t id = static_cast<int32_t>(m_signatures.size()) - 1; id >= 0; id--)
+  {
+    Signature& rSignature = m_signatures[id];
+    rSignature.anchorOffset = rSignature.length;
+    rSignature.nextWithAnchor = -1;
+
+    for (uint32_t offset = 0; offset < rSignature.length; offset++)
+    {
+      uint8_t value = rSignature.pBytes[offset];
+      if (value != WILDCARD && (rSignature.anchorOffset == rSignature.length || histogram[value] < histogram[rSignature.pBytes[rSignature.anchorOffset]]))
+      {
+        rSignature.anchorOffset = offset;
+      }
+    }
+
+    if (rSignature.anchorOffset < rSignature.length)
+    {
+      uint8_t anchor = rSignature.pBytes[rSignature.anchorOffset];
+      rSignature.nextWithAnchor = m_firstWithAnchor[anchor];
+      m_firstWithAnchor[anchor] = id;
+      usedAsAnchor[anchor] = true;
+    }
+  }
+
+  m_anchorBytes.clear();
+  for (uint32_t value = 0; value < 256; value++)
+  {
+    if (usedAsAnchor[value])
+    {
+      m_anchorBytes.push_back(static_cast<uint8_t>(value));
+    }
+  }
+
+  m_compiled = true;
+
+#ifdef DEBUG
+  printf("SignatureScanner: %u signatures on %u anchor bytes\n", static_cast<uint32_t>(m_signatures.size()), static_cast<uint32_t>(m_anchorBytes.size()));
+#endif
+}
+
+/* Finds every signature in a single pass.  The pass stops early once every signature has matched. */
+void SignatureScanner::scan(const uint8_t* pImage, uint32_t imageLength)
+{
+  if (!m_compiled)
+  {
+    compile(pImage, imageLength);
+  }
+
+  m_remaining = 0;
+  for (uint32_t id = 0; id < m_signatures.size(); id++)
+  {
+    Signature& rSignature = m_signatures[id];
+    rSignature.pMatch = NULL;
+
+    if (rSignature.anchorOffset < rSignature.length)
+    {
+      m_remaining++;
+    }
+    else if (rSignature.length < imageLength)
+    {
+      rSignature.pMatch = pImage;
+    }
+  }
+
+  if (m_remaining > 0)
+  {
+    if (s_sse2Available && m_anchorBytes.size() <= MAX_SSE2_ANCHORS)
+    {
+      scanSse2(pImage, imageLength);
+    }
+    else
+    {
+      scanScalar(pImage, imageLength, 0);
+    }
+  }
+}
+
+const uint8_t* SignatureScanner::getMatch(uint32_t signatureId) const
+{
+  return signatureId < m_signatures.size() ? m_signatures[signatureId].pMatch : NULL;
+}
+
+uint32_t SignatureScanner::getNumberOfSignatures() const
+{
+  return static_cast<uint32_t>(m_signatures.size());
+}
+
+bool SignatureScanner::matches(const uint8_t* pStart, const uint8_t* pSignature, uint32_t length)
+{
+  for (uint32_t offset = 0; offset < length; offset++)
+  {
+    if (pSignature[offset] != WILDCARD && pStart[offset] != pSignature[offset])
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* Checks the signatures anchored on the byte at position.  Matches have to end before the last byte of the image, 
+ * the same limit the plain search has.
+ */
+void SignatureScanner::checkCandidates(const uint8_t* pImage, uint32_t imageLength, uint32_t position)
+{
+  for (int32_t id = m_firstWithAnchor[pImage[position]]; id >= 0; id = m_signatures[id].nextWithAnchor)
+  {
+    Signature& rSignature = m_signatures[id];
+
+    if (rSignature.pMatch == NULL && position >= rSignature.anchorOffset)
+    {
+      uint32_t start = position - rSignature.anchorOffset;
+
+      if (start + rSignature.length < imageLength && matches(pImage + start, rSignature.pBytes, rSignature.length))
+      {
+        rSignature.pMatch = pImage + start;
+        m_remaining--;
+      }
+    }
+  }
+}
+
+void SignatureScanner::scanScalar(const uint8_t* pImage, uint32_t imageLength, uint32_t startPosition)
+{
+  for (uint32_t position = startPosition; position < imageLength && m_remaining > 0; position++)
+  {
+    if (m_firstWithAnchor[pImage[position]] >= 0)
+    {
+      checkCandidates(pImage, imageLength, position);
+    }
+  }
+}
+
+/* Compares 16 image bytes against every anchor byte at once and only looks at the positions that hit one */
+void SignatureScanner::scanSse2(const uint8_t* pImage, uint32_t imageLength)
+{
+  __m128i anchors[MAX_SSE2_ANCHORS];
+  uint32_t numberOfAnchors = static_cast<uint32_t>(m_anchorBytes.size());
+  for (uint32_t i = 0; i < numberOfAnchors; i++)
+  {
+    anchors[i] = _mm_set1_epi8(static_cast<char>(m_anchorBytes[i]));
+  }
+
+  uint32_t position = 0;
+  while (position + 16 <= imageLength && m_remaining > 0)
+  {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pImage + position));
+    __m128i hits = _mm_cmpeq_epi8(bytes, anchors[0]);
+    for (uint32_t i = 1; i < numberOfAnchors; i++)
+    {
+      hits = _mm_or_si128(hits, _mm_cmpeq_epi8(bytes, anchors[i]));
+    }
+
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+    while (mask != 0 && m_remaining > 0)
+    {
+      checkCandidates(pImage, imageLength, position + lowestSetBit(mask));
+      mask &= mask - 1;
+    }
+
+    position += 16;
+  }
+
+  scanScalar(pImage, imageLength, position);
+}
+
+/* The original search loop from MasterControlUtils, kept to check the scanner against */
+const uint8_t* SignatureScanner::findReference(const uint8_t* pImage, uint32_t imageLength, const uint8_t* pSignature, uint32_t length)
+{
+  for (uint32_t x = 0; x + length < imageLength; x++)
+  {
+    bool found = true;
+    for (uint32_t y = 0; y < length && found; y++)
+    {
+      found = pSignature[y] == WILDCARD || pImage[x + y] == pSignature[y];
+    }
+
+    if (found)
+    {
+      return pImage + x;
+    }
+  }
+
+  return NULL;
+}
@@ -0,0 +1,82 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#ifndef _SIGNATURE_SCANNER_H
+#define _SIGNATURE_SCANNER_H
+
+#include <stdint.h>
+#include <vector>
+
+/* Finds a whole set of byte signatures in one pass over the client image instead of one pass per signature.
+ *
+ * Signatures use the same 0xCC wildcard convention as MasterControlUtils::FindSignatureOffset.  When the set is 
+ * compiled each signature is anchored on its rarest non-wildcard byte, judged by a sampled byte histogram of the 
+ * image.  The scan then only has to stop where one of the anchor bytes occurs, and checks the signatures hanging 
+ * off that byte.  With SSE2 the image is tested against every distinct anchor byte 16 bytes at a time, so the common 
+ * case of a run with no anchor byte in it costs a handful of compares.
+ *
+ * Each signature gets the same match the plain search would give it: the lowest offset where it matches.
+ */
+class SignatureScanner
+{
+  public:
+    SignatureScanner();
+
+    uint32_t addSignature(const uint8_t* pSignature, uint32_t length);
+    void compile(const uint8_t* pImage, uint32_t imageLength);
+    void scan(const uint8_t* pImage, uint32_t imageLength);
+    const uint8_t* getMatch(uint32_t signatureId) const;
+    uint32_t getNumberOfSignatures() const;
+
+    static bool matches(const uint8_t* pStart, const uint8_t* pSignature, uint32_t length);
+    static const uint8_t* findReference(const uint8_t* pImage, uint32_t imageLength, const uint8_t* pSignature, uint32_t length);
+
+    static const uint8_t WILDCARD = 0xCC;
+    static const uint32_t MAX_SSE2_ANCHORS = 16;
+    static const uint32_t HISTOGRAM_STRIDE = 61;
+
+  private:
+    struct Signature
+    {
+      const uint8_t* pBytes;
+      uint32_t length;
+      uint32_t anchorOffset;
+      int32_t nextWithAnchor;
+      const uint8_t* pMatch;
+    };
+
+    void checkCandidates(const uint8_t* pImage, uint32_t imageLength, uint32_t position);
+    void scanScalar(const uint8_t* pImage, uint32_t imageLength, uint32_t startPosition);
+    void scanSse2(const uint8_t* pImage, uint32_t imageLength);
+
+    std::vector<Signature> m_signatures;
+    std::vector<uint8_t> m_anchorBytes;
+    int32_t m_firstWithAnchor[256];
+    uint32_t m_remaining;
+    bool m_compiled;
+
+    static const bool s_sse2Available;
+};
+
+#endif
@@ -0,0 +1,194 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include "../UltimaLive/FileSystem/BlockCrcCache.h"
+#include "../UltimaLive/Maps/Fletcher16.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+static const uint32_t MAP_WIDTH_IN_BLOCKS = 128;
+static const uint32_t MAP_HEIGHT_IN_BLOCKS = 128;
+static const uint32_t NUMBER_OF_BLOCKS = MAP_WIDTH_IN_BLOCKS * MAP_HEIGHT_IN_BLOCKS;
+static const uint32_t LAND_BLOCK_LENGTH = 196;
+static const uint64_t FILES_STAMP = 0x0123456789ABCDEFULL;
+
+/* The land of a map and the statics of every block, up to 20 of them */
+struct CrcMap
+{
+  std::vector<uint8_t> land;
+  std::vector<std::vector<uint8_t> > statics;
+};
+
+static void buildMap(CrcMap& rMap)
+{
+  rMap.land.resize(NUMBER_OF_BLOCKS * LAND_BLOCK_LENGTH);
+  for (uint32_t i = 0; i < rMap.land.size(); i++)
+  {
+    rMap.land[i] = static_cast<uint8_t>(getRandom(256));
+  }
+
+  rMap.statics.resize(NUMBER_OF_BLOCKS);
+  for (uint32_t blockNumber = 0; blockNumber < NUMBER_OF_BLOCKS; blockNumber++)
+  {
+    rMap.statics[blockNumber].resize(getRandom(4) == 0 ? 0 : getRandom(21) * 7);
+    for (uint32_t i = 0; i < rMap.statics[blockNumber].size(); i++)
+    {
+      rMap.statics[blockNumber][i] = static_cast<uint8_t>(getRandom(256));
+    }
+  }
+}
+
+//what Atlas::getBlockCrc computes when the table doesn't have the block
+static uint16_t hashBlock(const CrcMap& rMap, uint32_t blockNumber)
+{
+  const std::vector<uint8_t>& rStatics = rMap.statics[blockNumber];
+  return Fletcher16::hashBlock(&rMap.land[(blockNumber * LAND_BLOCK_LENGTH) + 4], rStatics.empty() ? NULL : &rStatics[0], static_cast<uint32_t>(rStatics.size()));
+}
+
+static uint16_t getBlockCrc(const CrcMap& rMap, BlockCrcCache* pCache, uint32_t blockNumber)
+{
+  uint16_t crc = 0;
+  if (pCache != NULL && pCache->lookup(blockNumber, crc))
+  {
+    return crc;
+  }
+
+  crc = hashBlock(rMap, blockNumber);
+  if (pCache != NULL)
+  {
+    pCache->store(blockNumber, crc);
+  }
+
+  return crc;
+}
+
+//answers a hash query for the 5x5 blocks around every center
+static double answerQueries(const CrcMap& rMap, BlockCrcCache* pCache, const std::vector<uint32_t>& rCenters)
+{
+  volatile uint32_t sum = 0;
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+  for (uint32_t query = 0; query < rCenters.size(); query++)
+  {
+    for (uint32_t i = 0; i < 25; i++)
+    {
+      sum += getBlockCrc(rMap, pCache, rCenters[query] + ((i / 5) - 2) * MAP_HEIGHT_IN_BLOCKS + (i % 5) - 2);
+    }
+  }
+
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+//the number of crcs in the table that differ from the computed ones
+static uint32_t countStaleCrcs(const CrcMap& rMap, BlockCrcCache& rCache)
+{
+  uint32_t staleCrcs = 0;
+  for (uint32_t blockNumber = 0; blockNumber < NUMBER_OF_BLOCKS; blockNumber++)
+  {
+    uint16_t crc = 0;
+    if (rCache.lookup(blockNumber, crc) && crc != hashBlock(rMap, blockNumber))
+    {
+      staleCrcs++;
+    }
+  }
+
+  return staleCrcs;
+}
+
+/* Times answering the hash queries of a player walking around a map, one query per block moved, the way Atlas did 
+ * before the crcs were cached, with a table the session starts empty and with the table saved by the session before.  
+ * Some blocks are written in between, the way updates from the server invalidate them, and after each session every
+ * crc left in the table is checked against the computed one.
+ */
+void benchmarkBlockCrcCache()
+{
+  static const uint32_t NUMBER_OF_QUERIES = 50000;
+  static const char* CACHE_PATH = "UltimaLiveBlockCrcBenchmark.crc";
+
+  CrcMap map;
+  buildMap(map);
+
+  //a walk that stays far enough from the edges for the whole window to be on the map
+  std::vector<uint32_t> centers(NUMBER_OF_QUERIES);
+  uint32_t x = MAP_WIDTH_IN_BLOCKS / 2;
+  uint32_t y = MAP_HEIGHT_IN_BLOCKS / 2;
+  for (uint32_t i = 0; i < NUMBER_OF_QUERIES; i++)
+  {
+    uint32_t direction = getRandom(4);
+    if (direction == 0 && x > 2)
+    {
+      x--;
+    }
+    else if (direction == 1 && x < MAP_WIDTH_IN_BLOCKS - 3)
+    {
+      x++;
+    }
+    else if (direction == 2 && y > 2)
+    {
+      y--;
+    }
+    else if (direction == 3 && y < MAP_HEIGHT_IN_BLOCKS - 3)
+    {
+      y++;
+    }
+
+    centers[i] = (x * MAP_HEIGHT_IN_BLOCKS) + y;
+  }
+
+  double uncachedMs = answerQueries(map, NULL, centers);
+
+  BlockCrcCache cache;
+  cache.open(CACHE_PATH, NUMBER_OF_BLOCKS, FILES_STAMP);
+  double coldMs = answerQueries(map, &cache, centers);
+  uint32_t coldHits = cache.getHits();
+  uint32_t coldMisses = cache.getMisses();
+
+  //an update to a block drops its crc
+  for (uint32_t i = 0; i < 100; i++)
+  {
+    uint32_t blockNumber = getRandom(NUMBER_OF_BLOCKS);
+    map.land[(blockNumber * LAND_BLOCK_LENGTH) + 4 + getRandom(192)]++;
+    cache.invalidate(blockNumber);
+  }
+
+  uint32_t staleCrcs = countStaleCrcs(map, cache);
+  cache.close(FILES_STAMP);
+
+  //lookups of a closed table aren't counted against the next session
+  uint16_t crc = 0;
+  cache.lookup(0, crc);
+
+  cache.open(CACHE_PATH, NUMBER_OF_BLOCKS, FILES_STAMP);
+  double savedMs = answerQueries(map, &cache, centers);
+  uint32_t savedHits = cache.getHits();
+  uint32_t savedMisses = cache.getMisses();
+  staleCrcs += countStaleCrcs(map, cache);
+  cache.close(FILES_STAMP);
+  remove(CACHE_PATH);
+
+  printf("Block crc cache over %u hash queries: %.2f ms hashing every block, empty table %.2f ms (%u hits, %u computed), saved table %.2f ms (%u hits, %u computed)%s\n",
+    NUMBER_OF_QUERIES, uncachedMs, coldMs, coldHits, coldMisses, savedMs, savedHits, savedMisses, staleCrcs > 0 ? ", STALE CRCS" : "");
+}
@@ -0,0 +1,186 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include "../UltimaLive/Maps/Fletcher16.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/* Heap allocations made by the copies below.  Only this file's own copies are counted, operator new is left alone for 
+ * the rest of the test executable.
+ */
+static uint32_t s_numberOfAllocations = 0;
+
+static uint8_t* allocateCopy(uint32_t length)
+{
+  s_numberOfAllocations++;
+  return new uint8_t[length];
+}
+
+static const uint32_t MAP_HEIGHT_IN_BLOCKS = 64;
+static const uint32_t MAP_WIDTH_IN_BLOCKS = 64;
+static const uint32_t NUMBER_OF_BLOCKS = MAP_HEIGHT_IN_BLOCKS * MAP_WIDTH_IN_BLOCKS;
+static const uint32_t LAND_BLOCK_LENGTH = 196; //4 byte header and 64 cells of 3 bytes
+static const uint32_t STATIC_LENGTH = 7;
+
+/* A map laid out the way the pools hold it, a map#.mul with staidx#.mul and statics#.mul, with up to 20 statics in 
+ * most blocks
+ */
+struct BlockPools
+{
+  std::vector<uint8_t> map;
+  std::vector<uint8_t> staidx;
+  std::vector<uint8_t> statics;
+};
+
+static void buildPools(BlockPools& rPools)
+{
+  rPools.map.resize(NUMBER_OF_BLOCKS * LAND_BLOCK_LENGTH);
+  rPools.staidx.resize(NUMBER_OF_BLOCKS * 12);
+
+  for (uint32_t i = 0; i < rPools.map.size(); i++)
+  {
+    rPools.map[i] = static_cast<uint8_t>(getRandom(256));
+  }
+
+  for (uint32_t blockNumber = 0; blockNumber < NUMBER_OF_BLOCKS; blockNumber++)
+  {
+    uint32_t length = getRandom(4) == 0 ? 0 : getRandom(21) * STATIC_LENGTH;
+    uint32_t lookup = length > 0 ? static_cast<uint32_t>(rPools.statics.size()) : 0xFFFFFFFF;
+    for (uint32_t i = 0; i < length; i++)
+    {
+      rPools.statics.push_back(static_cast<uint8_t>(getRandom(256)));
+    }
+
+    uint32_t entry[3] = { lookup, length, 0 };
+    memcpy(&rPools.staidx[blockNumber * 12], entry, sizeof(entry));
+  }
+}
+
+//the statics of a block in the pool, as BaseFileManager::getStaticsBlockView finds them
+static uint8_t* getStaticsView(BlockPools& rPools, uint32_t blockNumber, uint32_t& rLength)
+{
+  uint32_t entry[3];
+  memcpy(entry, &rPools.staidx[blockNumber * 12], sizeof(entry));
+  rLength = entry[0] != 0xFFFFFFFF ? entry[1] : 0;
+  return rLength > 0 ? &rPools.statics[entry[0]] : NULL;
+}
+
+//the way Atlas hashed a block before it had views, through a copy of the land and of the statics
+static uint16_t hashBlockCopies(BlockPools& rPools, uint32_t blockNumber)
+{
+  uint8_t* pBlockData = allocateCopy(192);
+  memcpy(pBlockData, &rPools.map[(blockNumber * LAND_BLOCK_LENGTH) + 4], 192);
+
+  uint32_t staticsLength = 0;
+  uint8_t* pView = getStaticsView(rPools, blockNumber, staticsLength);
+  uint8_t* pStaticsData = NULL;
+  if (pView != NULL)
+  {
+    pStaticsData = allocateCopy(staticsLength);
+    for (uint32_t i = 0; i < staticsLength; i++)
+    {
+      pStaticsData[i] = pView[i];
+    }
+  }
+
+  uint16_t crc = Fletcher16::hashBlock(pBlockData, pStaticsData, staticsLength);
+
+  delete[] pBlockData;
+  if (pStaticsData != NULL)
+  {
+    delete[] pStaticsData;
+  }
+
+  return crc;
+}
+
+static uint16_t hashBlockViews(BlockPools& rPools, uint32_t blockNumber)
+{
+  uint32_t staticsLength = 0;
+  uint8_t* pStaticsData = getStaticsView(rPools, blockNumber, staticsLength);
+  return Fletcher16::hashBlock(&rPools.map[(blockNumber * LAND_BLOCK_LENGTH) + 4], pStaticsData, staticsLength);
+}
+
+/* Answers hash queries for the 5x5 blocks around random blocks the way Atlas did before and after it read the blocks 
+ * through views into the pools, and counts the copies made per query.  The file managers depend on Windows, so this 
+ * is a model of the code path: the pools are stand ins laid out the same way and the blocks are found the way the 
+ * file managers find them.  The hashing is the real Fletcher16::hashBlock that Atlas uses.
+ */
+void benchmarkBlockQuery()
+{
+  static const uint32_t NUMBER_OF_QUERIES = 20000;
+
+  BlockPools pools;
+  buildPools(pools);
+
+  std::vector<uint32_t> centers(NUMBER_OF_QUERIES);
+  for (uint32_t i = 0; i < NUMBER_OF_QUERIES; i++)
+  {
+    centers[i] = ((2 + getRandom(MAP_WIDTH_IN_BLOCKS - 4)) * MAP_HEIGHT_IN_BLOCKS) + 2 + getRandom(MAP_HEIGHT_IN_BLOCKS - 4);
+  }
+
+  uint16_t copyCrcs[25];
+  uint16_t viewCrcs[25];
+  uint32_t mismatches = 0;
+  double elapsed[2];
+  uint32_t allocations[2];
+
+  for (uint32_t pass = 0; pass < 2; pass++)
+  {
+    uint32_t startAllocations = s_numberOfAllocations;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    for (uint32_t query = 0; query < NUMBER_OF_QUERIES; query++)
+    {
+      for (uint32_t i = 0; i < 25; i++)
+      {
+        uint32_t blockNumber = centers[query] + ((i / 5) - 2) * MAP_HEIGHT_IN_BLOCKS + (i % 5) - 2;
+        if (pass == 0)
+        {
+          copyCrcs[i] = hashBlockCopies(pools, blockNumber);
+        }
+        else
+        {
+          viewCrcs[i] = hashBlockViews(pools, blockNumber);
+        }
+      }
+    }
+
+    elapsed[pass] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count() / NUMBER_OF_QUERIES;
+    allocations[pass] = s_numberOfAllocations - startAllocations;
+  }
+
+  //both ways have to agree on the last query
+  for (uint32_t i = 0; i < 25; i++)
+  {
+    mismatches += copyCrcs[i] != viewCrcs[i] ? 1 : 0;
+  }
+
+  printf("Block query (modelled pools, real hashing): copies %.2f us and %.1f allocations, views %.2f us and %.1f allocations per query%s\n", elapsed[0], 
+    static_cast<double>(allocations[0]) / NUMBER_OF_QUERIES, elapsed[1], static_cast<double>(allocations[1]) / NUMBER_OF_QUERIES, 
+    mismatches > 0 ? " (the crcs differ)" : "");
+}
@@ -0,0 +1,83 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+/* Times handler lookups the way NetworkManager dispatched packets before and after its handler maps were flattened:
+ * std::map::find followed by operator[], against an index into a 256 entry table.  The handlers are stand ins at the 
+ * command bytes the factory registers for received packets, and the commands are weighted towards movement requests 
+ * and mobile updates the way real traffic is.
+ */
+void benchmarkDispatch()
+{
+  static const uint32_t ITERATIONS = 10000000;
+  static const uint8_t HANDLED_COMMANDS[6] = { 0x08, 0x11, 0x1B, 0x40, 0x55, 0xF4 };
+  static const uint8_t COMMON_COMMANDS[8] = { 0x02, 0x02, 0x02, 0x20, 0x77, 0x78, 0x22, 0x11 };
+
+  int handlers[6];
+  std::map<uint8_t, int*> handlerMap;
+  std::vector<int*> handlerTable(256, static_cast<int*>(NULL));
+  for (uint32_t i = 0; i < 6; i++)
+  {
+    handlerMap[HANDLED_COMMANDS[i]] = &handlers[i];
+    handlerTable[HANDLED_COMMANDS[i]] = &handlers[i];
+  }
+
+  std::vector<uint8_t> commands(4096);
+  for (uint32_t i = 0; i < commands.size(); i++)
+  {
+    commands[i] = (i % 4 == 0) ? static_cast<uint8_t>(getRandom(256)) : COMMON_COMMANDS[getRandom(8)];
+  }
+
+  volatile uintptr_t found = 0;
+
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; i++)
+  {
+    uint8_t command = commands[i & 4095];
+    if (handlerMap.find(command) != handlerMap.end())
+    {
+      found += reinterpret_cast<uintptr_t>(handlerMap[command]);
+    }
+  }
+  std::chrono::steady_clock::time_point mapTime = std::chrono::steady_clock::now();
+
+  for (uint32_t i = 0; i < ITERATIONS; i++)
+  {
+    int* pHandler = handlerTable[commands[i & 4095]];
+    if (pHandler != NULL)
+    {
+      found += reinterpret_cast<uintptr_t>(pHandler);
+    }
+  }
+  std::chrono::steady_clock::time_point tableTime = std::chrono::steady_clock::now();
+
+  double mapNs = std::chrono::duration<double, std::nano>(mapTime - startTime).count() / ITERATIONS;
+  double tableNs = std::chrono::duration<double, std::nano>(tableTime - mapTime).count() / ITERATIONS;
+  printf("Dispatch: map lookup %.2f ns, table lookup %.2f ns per packet\n", mapNs, tableNs);
+}
@@ -0,0 +1,184 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include "../UltimaLive/Maps/Fletcher16.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+//CRC.Fletcher16 from the server, line for line
+static uint16_t serverFletcher16(const uint8_t* pData, uint32_t length)
+{
+  uint16_t sum1 = 0;
+  uint16_t sum2 = 0;
+  for (uint32_t index = 0; index < length; ++index)
+  {
+    sum1 = (uint16_t)((sum1 + pData[index]) % 255);
+    sum2 = (uint16_t)((sum2 + sum1) % 255);
+  }
+
+  return (uint16_t)((sum2 << 8) | sum1);
+}
+
+typedef void (*UpdateFunction)(uint32_t& rSum1, uint32_t& rSum2, const uint8_t* pData, uint32_t length);
+
+static uint16_t checksum(UpdateFunction update, const uint8_t* pData, uint32_t length, uint32_t split)
+{
+  uint32_t sum1 = 0;
+  uint32_t sum2 = 0;
+  update(sum1, sum2, pData, split);
+  update(sum1, sum2, pData + split, length - split);
+  return Fletcher16::finish(sum1, sum2);
+}
+
+/* Checks every version against the server's loop on the published check values, on random data split at random 
+ * points, on runs of 0xFF long enough to hit the overflow limit, and hashes a block over its land and statics.
+ */
+bool testFletcher16()
+{
+  static const char* CHECK_STRINGS[3] = { "abcde", "abcdef", "abcdefgh" };
+  static const uint16_t CHECK_VALUES[3] = { 0xC8F0, 0x2057, 0x0627 };
+
+  UpdateFunction updates[4] = { Fletcher16::updateReference, Fletcher16::updateScalar, Fletcher16::updateSse2, Fletcher16::update };
+  const char* names[4] = { "reference", "scalar", "sse2", "update" };
+
+  for (uint32_t i = 0; i < 3; i++)
+  {
+    const uint8_t* pData = reinterpret_cast<const uint8_t*>(CHECK_STRINGS[i]);
+    uint32_t length = static_cast<uint32_t>(strlen(CHECK_STRINGS[i]));
+
+    for (uint32_t version = 0; version < 4; version++)
+    {
+      if (serverFletcher16(pData, length) != CHECK_VALUES[i] || checksum(updates[version], pData, length, 0) != CHECK_VALUES[i])
+      {
+        printf("  %s gives the wrong check value for \"%s\"\n", names[version], CHECK_STRINGS[i]);
+        return false;
+      }
+    }
+  }
+
+  std::vector<uint8_t> data(0x800000);
+  for (uint32_t i = 0; i < data.size(); i++)
+  {
+    data[i] = static_cast<uint8_t>(getRandom(256));
+  }
+
+  for (uint32_t iteration = 0; iteration < 2000; iteration++)
+  {
+    const uint8_t* pData = &data[getRandom(static_cast<uint32_t>(data.size()) - 0x10000)];
+    uint32_t length = iteration < 1000 ? getRandom(2048) : getRandom(0x10000);
+    uint32_t split = length > 0 ? getRandom(length) : 0;
+    uint16_t expected = serverFletcher16(pData, length);
+
+    for (uint32_t version = 0; version < 4; version++)
+    {
+      if (checksum(updates[version], pData, length, split) != expected)
+      {
+        printf("  %s differs from the server on %u random bytes split at %u\n", names[version], length, split);
+        return false;
+      }
+    }
+  }
+
+  std::vector<uint8_t> saturated(Fletcher16::MAX_DEFERRED_BYTES * 3, 0xFF);
+  for (uint32_t length = Fletcher16::MAX_DEFERRED_BYTES - 40; length < saturated.size(); length += 997)
+  {
+    for (uint32_t version = 0; version < 4; version++)
+    {
+      //the largest sums a checksum can be continued from
+      uint32_t expected1 = 254;
+      uint32_t expected2 = 254;
+      Fletcher16::updateReference(expected1, expected2, &saturated[0], length);
+
+      uint32_t sum1 = 254;
+      uint32_t sum2 = 254;
+      updates[version](sum1, sum2, &saturated[0], length);
+
+      if (Fletcher16::finish(sum1, sum2) != Fletcher16::finish(expected1, expected2))
+      {
+        printf("  %s overflows on %u bytes of 0xFF\n", names[version], length);
+        return false;
+      }
+    }
+  }
+
+  //a block is hashed over its 192 land bytes and then its statics, either of which may be missing
+  for (uint32_t staticsLength = 0; staticsLength <= 20 * 7; staticsLength += 7)
+  {
+    const uint8_t* pLand = &data[getRandom(0x10000)];
+    const uint8_t* pStatics = &data[0x10000 + getRandom(0x10000)];
+    std::vector<uint8_t> block(pLand, pLand + 192);
+    block.insert(block.end(), pStatics, pStatics + staticsLength);
+
+    if (Fletcher16::hashBlock(pLand, pStatics, staticsLength) != serverFletcher16(&block[0], static_cast<uint32_t>(block.size())) || 
+      Fletcher16::hashBlock(pLand, NULL, 0) != serverFletcher16(pLand, 192) || Fletcher16::hashBlock(NULL, pStatics, staticsLength) != serverFletcher16(pStatics, staticsLength))
+    {
+      printf("  the hash of a block with %u bytes of statics differs from the server's\n", staticsLength);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static uint64_t hashBlocks(UpdateFunction update, const std::vector<uint8_t>& rMap, uint32_t numberOfBlocks, volatile uint16_t& rChecksum)
+{
+  uint64_t startCycles = readCycleCounter();
+  for (uint32_t block = 0; block < numberOfBlocks; block++)
+  {
+    uint32_t sum1 = 0;
+    uint32_t sum2 = 0;
+    update(sum1, sum2, &rMap[(block * 196) + 4], 192);
+    rChecksum ^= Fletcher16::finish(sum1, sum2);
+  }
+
+  return readCycleCounter() - startCycles;
+}
+
+/* Hashes a map the size of Felucca the way a full crc rebuild does, 192 land bytes out of every 196, and prints the
+ * throughput of every version in bytes per cycle.
+ */
+void benchmarkFletcher16()
+{
+  static const uint32_t NUMBER_OF_BLOCKS = 896 * 512;
+
+  std::vector<uint8_t> map(NUMBER_OF_BLOCKS * 196);
+  for (uint32_t i = 0; i < map.size(); i++)
+  {
+    map[i] = static_cast<uint8_t>(getRandom(256));
+  }
+
+  UpdateFunction updates[3] = { Fletcher16::updateReference, Fletcher16::updateScalar, Fletcher16::updateSse2 };
+  const char* names[3] = { "reference", "scalar", "sse2" };
+  volatile uint16_t checksum = 0;
+  double bytesHashed = NUMBER_OF_BLOCKS * 192.0;
+
+  printf("Fletcher16, full map crc rebuild of %u blocks:\n", NUMBER_OF_BLOCKS);
+  for (uint32_t version = 0; version < 3; version++)
+  {
+    uint64_t cycles = hashBlocks(updates[version], map, NUMBER_OF_BLOCKS, checksum);
+    printf("  %-10s %.3f bytes/cycle\n", names[version], bytesHashed / (cycles > 0 ? cycles : 1));
+  }
+}
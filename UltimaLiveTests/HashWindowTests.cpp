@@ -0,0 +1,136 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include "../UltimaLive/Maps/HashWindow.h"
+#include <cstdio>
+
+//a map of 64x32 blocks that wraps after 48 columns, like Felucca with its dungeons to the east
+static const int32_t MAP_WIDTH_IN_BLOCKS = 64;
+static const int32_t MAP_HEIGHT_IN_BLOCKS = 32;
+static const int32_t WRAP_WIDTH_IN_BLOCKS = 48;
+static const int32_t WRAP_HEIGHT_IN_BLOCKS = 32;
+
+static uint32_t getBlockNumber(int32_t x, int32_t y)
+{
+  return static_cast<uint32_t>((x * MAP_HEIGHT_IN_BLOCKS) + y);
+}
+
+//checks the window around x, y against the columns and rows it should cover
+static bool checkWindow(int32_t x, int32_t y, const int32_t* pColumns, const int32_t* pRows)
+{
+  int32_t blocks[HashWindow::SIZE];
+  HashWindow::getBlocks(MAP_WIDTH_IN_BLOCKS, MAP_HEIGHT_IN_BLOCKS, WRAP_WIDTH_IN_BLOCKS, WRAP_HEIGHT_IN_BLOCKS, getBlockNumber(x, y), blocks);
+
+  for (uint32_t i = 0; i < HashWindow::SIZE; i++)
+  {
+    int32_t expected = static_cast<int32_t>(getBlockNumber(pColumns[i / 5], pRows[i % 5]));
+    if (blocks[i] != expected)
+    {
+      printf("  position %u of the window around %i,%i is block %i instead of %i\n", i, x, y, blocks[i], expected);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//answers a delta query for the window around x, y and checks which positions were sent
+static bool checkDelta(HashWindow& rWindow, uint8_t mapNumber, int32_t x, int32_t y, const uint8_t* pExpected, uint32_t numberExpected)
+{
+  int32_t blocks[HashWindow::SIZE];
+  uint8_t positions[HashWindow::SIZE];
+  HashWindow::getBlocks(MAP_WIDTH_IN_BLOCKS, MAP_HEIGHT_IN_BLOCKS, WRAP_WIDTH_IN_BLOCKS, WRAP_HEIGHT_IN_BLOCKS, getBlockNumber(x, y), blocks);
+  uint32_t numberOfPositions = rWindow.getNewPositions(mapNumber, blocks, positions);
+  rWindow.remember(mapNumber, blocks);
+
+  bool matches = numberOfPositions == numberExpected;
+  for (uint32_t i = 0; i < numberOfPositions && matches; i++)
+  {
+    matches = positions[i] == (pExpected != NULL ? pExpected[i] : i);
+  }
+
+  if (!matches)
+  {
+    printf("  the delta query at %i,%i on map %u sent %u blocks instead of %u\n", x, y, mapNumber, numberOfPositions, numberExpected);
+  }
+
+  return matches;
+}
+
+/* Checks the 5x5 window around a block in the middle of the map, at the corners of the wrapping part of it and past
+ * it, and off the map, then the blocks a delta query sends as the player walks, crosses the wrap, jumps, and changes 
+ * maps
+ */
+bool testHashWindow()
+{
+  static const int32_t MIDDLE_COLUMNS[5] = { 8, 9, 10, 11, 12 };
+  static const int32_t MIDDLE_ROWS[5] = { 18, 19, 20, 21, 22 };
+  static const int32_t FIRST_COLUMNS[5] = { 46, 47, 0, 1, 2 };
+  static const int32_t FIRST_ROWS[5] = { 30, 31, 0, 1, 2 };
+  static const int32_t LAST_WRAPPED_COLUMNS[5] = { 45, 46, 47, 0, 1 };
+  static const int32_t LAST_ROWS[5] = { 29, 30, 31, 0, 1 };
+  static const int32_t DUNGEON_COLUMNS[5] = { 61, 62, 63, 0, 1 };
+
+  if (!checkWindow(10, 20, MIDDLE_COLUMNS, MIDDLE_ROWS) || !checkWindow(0, 0, FIRST_COLUMNS, FIRST_ROWS) ||
+    !checkWindow(47, 31, LAST_WRAPPED_COLUMNS, LAST_ROWS) || !checkWindow(63, 20, DUNGEON_COLUMNS, MIDDLE_ROWS))
+  {
+    return false;
+  }
+
+  int32_t blocks[HashWindow::SIZE];
+  HashWindow::getBlocks(MAP_WIDTH_IN_BLOCKS, MAP_HEIGHT_IN_BLOCKS, WRAP_WIDTH_IN_BLOCKS, WRAP_HEIGHT_IN_BLOCKS, getBlockNumber(MAP_WIDTH_IN_BLOCKS, 0), blocks);
+  for (uint32_t i = 0; i < HashWindow::SIZE; i++)
+  {
+    if (blocks[i] != -1)
+    {
+      printf("  the window around a block past the end of the map has blocks in it\n");
+      return false;
+    }
+  }
+
+  static const uint8_t EAST_COLUMN[5] = { 20, 21, 22, 23, 24 };
+  static const uint8_t SOUTH_ROW[5] = { 4, 9, 14, 19, 24 };
+  static const uint8_t WEST_COLUMN[5] = { 0, 1, 2, 3, 4 };
+  static const uint8_t SOUTH_EAST_CORNER[9] = { 4, 9, 14, 19, 20, 21, 22, 23, 24 };
+
+  HashWindow window;
+  if (!(checkDelta(window, 0, 10, 20, NULL, 25) &&
+    checkDelta(window, 0, 10, 20, NULL, 0) &&
+    checkDelta(window, 0, 11, 20, EAST_COLUMN, 5) &&
+    checkDelta(window, 0, 11, 21, SOUTH_ROW, 5) &&
+    checkDelta(window, 0, 12, 22, SOUTH_EAST_CORNER, 9) &&
+    checkDelta(window, 0, 30, 5, NULL, 25) &&
+    checkDelta(window, 0, 47, 5, NULL, 25) &&
+    checkDelta(window, 0, 0, 5, EAST_COLUMN, 5) &&
+    checkDelta(window, 0, 47, 5, WEST_COLUMN, 5) &&
+    checkDelta(window, 1, 47, 5, NULL, 25)))
+  {
+    return false;
+  }
+
+  //a map load forgets the window
+  window.clear();
+  return checkDelta(window, 1, 47, 5, NULL, 25);
+}
@@ -0,0 +1,139 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include "../UltimaLive/FileSystem/Uop/Inflate.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/* Decodes a stream with fixed codes and one with dynamic codes, both made by zlib, and a stream of stored blocks built 
+ * here, then checks that a damaged stream and a stream of the wrong length are turned down.
+ */
+bool testInflate()
+{
+  //"UltimaLive UltimaLive UltimaLive!" at level 9
+  static const uint8_t FIXED_STREAM[] = 
+  {
+    0x78, 0xDA, 0x0B, 0xCD, 0x29, 0xC9, 0xCC, 0x4D, 0xF4, 0xC9, 0x2C, 0x4B, 0x55, 0x08, 0xC5, 0xC6, 0x54, 0x04, 0x00, 0xD5, 
+    0x76, 0x0C, 0x56
+  };
+
+  //the cells built below at level 9
+  static const uint8_t DYNAMIC_STREAM[] = 
+  {
+    0x78, 0xDA, 0x25, 0x92, 0x81, 0x12, 0xC0, 0x20, 0x08, 0x42, 0x5D, 0x40, 0xFD, 0xFF, 0x1F, 0x0F,
+    0xB0, 0xBB, 0xB6, 0xB6, 0x14, 0x9F, 0x94, 0x38, 0xE4, 0x03, 0x04, 0x0A, 0xB8, 0x9E, 0x5E, 0x53,
+    0x04, 0x46, 0x1C, 0xE9, 0x52, 0x8F, 0x3C, 0x50, 0x76, 0x94, 0xD7, 0x13, 0x2F, 0x9C, 0xA5, 0x8F,
+    0x8E, 0xF2, 0x94, 0x15, 0x8E, 0x30, 0xE0, 0x21, 0x1E, 0xE8, 0xF8, 0xA1, 0xD3, 0xE5, 0x3F, 0x16,
+    0x4D, 0x44, 0xD4, 0x9C, 0xCC, 0x2F, 0x4B, 0x87, 0xF9, 0x97, 0xD8, 0x9A, 0x0E, 0xFE, 0xFC, 0x94,
+    0x9E, 0xB7, 0xFB, 0x69, 0xFD, 0xE9, 0x96, 0xA3, 0x26, 0x50, 0x5E, 0xE9, 0xCA, 0x0C, 0xF4, 0x38,
+    0x94, 0xC7, 0x6D, 0xC0, 0x05, 0x22, 0x85, 0xEC, 0x32, 0x48, 0xB0, 0xBE, 0xC3, 0x42, 0xCE, 0xA4,
+    0x9D, 0x90, 0x23, 0xB9, 0xA6, 0xC5, 0x36, 0x65, 0x2A, 0x9C, 0xB6, 0xF2, 0x29, 0xA8, 0x26, 0xF1,
+    0xDA, 0x00, 0x13, 0xF8, 0xFD, 0x4A, 0x8D, 0xB6, 0x99, 0x12, 0x55, 0x72, 0x64, 0x0C, 0x9A, 0x30,
+    0x32, 0x8D, 0xA4, 0x97, 0xA0, 0xD6, 0x34, 0xB5, 0x2D, 0x2B, 0x6B, 0x62, 0x51, 0xA4, 0x3C, 0xBE,
+    0xF8, 0x90, 0x5E, 0xC2, 0xAA, 0x82, 0x5A, 0x90, 0x89, 0xB7, 0xCF, 0x37, 0x42, 0xD1, 0xA9, 0x26,
+    0xBA, 0x1B, 0x63, 0xEB, 0x67, 0xC2, 0xAC, 0x98, 0x67, 0xD6, 0x81, 0x4C, 0xE3, 0xF1, 0x73, 0x8B,
+    0xE9, 0xB8, 0x8A, 0x5A, 0x1E, 0x3E, 0x91, 0x1E, 0x59, 0xCC, 0x31, 0x55, 0x6C, 0x6A, 0x75, 0x15,
+    0x7B, 0xD5, 0x82, 0x61, 0xE0, 0xE5, 0x74, 0xAE, 0x7A, 0x2A, 0xA6, 0xFD, 0x7A, 0xDC, 0x67, 0x6D,
+    0x67, 0x72, 0x7B, 0x1F, 0x02, 0xF0, 0x4A, 0xF8, 0x92, 0x83, 0xDB, 0xA2, 0xB3, 0x37, 0x81, 0x7B,
+    0x47, 0x2A, 0xAB, 0xE5, 0xF4, 0xC1, 0xE9, 0xFD, 0x19, 0xD3, 0x08, 0xD6
+  };
+
+  static const uint32_t DYNAMIC_LENGTH = 588;
+  static const uint32_t STORED_LENGTH = 70000;
+
+  const char* pFixedText = "UltimaLive UltimaLive UltimaLive!";
+  uint32_t fixedLength = static_cast<uint32_t>(strlen(pFixedText));
+  std::vector<uint8_t> output(STORED_LENGTH);
+
+  if (!Inflate::decompress(FIXED_STREAM, sizeof(FIXED_STREAM), &output[0], fixedLength) || memcmp(&output[0], pFixedText, fixedLength) != 0)
+  {
+    printf("  the stream with fixed codes did not decode\n");
+    return false;
+  }
+
+  //three byte cells of two small numbers and an odd one, which zlib writes with codes of its own
+  std::vector<uint8_t> expected(STORED_LENGTH);
+  uint32_t random = 1;
+  for (uint32_t i = 0; i < DYNAMIC_LENGTH; i++)
+  {
+    random = (random * 1103515245 + 12345) & 0x7FFFFFFF;
+    expected[i] = static_cast<uint8_t>(i % 3 != 2 ? 3 + ((random >> 16) % 3) : (random >> 20) & 7);
+  }
+
+  if (!Inflate::decompress(DYNAMIC_STREAM, sizeof(DYNAMIC_STREAM), &output[0], DYNAMIC_LENGTH) || memcmp(&output[0], &expected[0], DYNAMIC_LENGTH) != 0)
+  {
+    printf("  the stream with dynamic codes did not decode\n");
+    return false;
+  }
+
+  if (Inflate::decompress(DYNAMIC_STREAM, sizeof(DYNAMIC_STREAM), &output[0], DYNAMIC_LENGTH - 1))
+  {
+    printf("  a stream decoded into a buffer too short for it\n");
+    return false;
+  }
+
+  std::vector<uint8_t> damaged(DYNAMIC_STREAM, DYNAMIC_STREAM + sizeof(DYNAMIC_STREAM));
+  damaged[sizeof(DYNAMIC_STREAM) / 2] ^= 0x10;
+  if (Inflate::decompress(&damaged[0], static_cast<uint32_t>(damaged.size()), &output[0], DYNAMIC_LENGTH))
+  {
+    printf("  a damaged stream decoded\n");
+    return false;
+  }
+
+  //stored blocks hold at most 65535 bytes, so this takes two of them
+  for (uint32_t i = 0; i < STORED_LENGTH; i++)
+  {
+    expected[i] = static_cast<uint8_t>(i * 7);
+  }
+
+  std::vector<uint8_t> stored;
+  stored.push_back(0x78);
+  stored.push_back(0x01);
+  for (uint32_t i = 0; i < STORED_LENGTH; i += 0xFFFF)
+  {
+    uint32_t length = STORED_LENGTH - i < 0xFFFF ? STORED_LENGTH - i : 0xFFFF;
+    stored.push_back(i + length == STORED_LENGTH ? 1 : 0);
+    stored.push_back(static_cast<uint8_t>(length));
+    stored.push_back(static_cast<uint8_t>(length >> 8));
+    stored.push_back(static_cast<uint8_t>(~length));
+    stored.push_back(static_cast<uint8_t>(~length >> 8));
+    stored.insert(stored.end(), expected.begin() + i, expected.begin() + i + length);
+  }
+
+  uint32_t checksum = Inflate::adler32(&expected[0], STORED_LENGTH);
+  stored.push_back(static_cast<uint8_t>(checksum >> 24));
+  stored.push_back(static_cast<uint8_t>(checksum >> 16));
+  stored.push_back(static_cast<uint8_t>(checksum >> 8));
+  stored.push_back(static_cast<uint8_t>(checksum));
+
+  if (!Inflate::decompress(&stored[0], static_cast<uint32_t>(stored.size()), &output[0], STORED_LENGTH) || output != expected)
+  {
+    printf("  the stream of stored blocks did not decode\n");
+    return false;
+  }
+
+  return true;
+}
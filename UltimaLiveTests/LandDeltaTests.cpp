@@ -0,0 +1,121 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include "../UltimaLive/Maps/LandDelta.h"
+#include "../UltimaLive/Maps/Fletcher16.h"
+#include <cstdio>
+#include <cstring>
+
+/* Builds deltas between random blocks the way the server does, and checks that patching the old block gives back the 
+ * new block byte for byte, the same as writing the full block would.  Also checks that a delta is refused when the 
+ * block it is applied to differs from the one it was made against.
+ */
+bool testLandDelta()
+{
+  static const uint32_t BLOCK_LENGTH = LandDelta::BLOCK_LENGTH;
+  static const uint32_t TILE_LENGTH = LandDelta::TILE_LENGTH;
+
+  for (uint32_t iteration = 0; iteration < 1000; iteration++)
+  {
+    uint8_t oldBlock[BLOCK_LENGTH];
+    uint8_t newBlock[BLOCK_LENGTH];
+    uint8_t patchedBlock[BLOCK_LENGTH];
+    uint8_t delta[LandDelta::HEADER_LENGTH + (64 * TILE_LENGTH)];
+
+    for (uint32_t i = 0; i < BLOCK_LENGTH; i++)
+    {
+      oldBlock[i] = static_cast<uint8_t>(getRandom(256));
+      newBlock[i] = oldBlock[i];
+    }
+
+    //mostly sparse edits like a single altitude change, with some dense ones
+    uint32_t density = iteration % 4 == 0 ? 2 : 24;
+    uint64_t mask = 0;
+    for (uint32_t tile = 0; tile < 64; tile++)
+    {
+      if (getRandom(density) == 0)
+      {
+        mask |= 1ULL << tile;
+        for (uint32_t i = 0; i < TILE_LENGTH; i++)
+        {
+          newBlock[(tile * TILE_LENGTH) + i] = static_cast<uint8_t>(getRandom(256));
+        }
+      }
+    }
+
+    uint32_t sum1 = 0;
+    uint32_t sum2 = 0;
+    Fletcher16::update(sum1, sum2, newBlock, BLOCK_LENGTH);
+    uint16_t crc = Fletcher16::finish(sum1, sum2);
+
+    for (uint32_t i = 0; i < 8; i++)
+    {
+      delta[i] = static_cast<uint8_t>(mask >> (56 - (i * 8)));
+    }
+    delta[8] = static_cast<uint8_t>(crc >> 8);
+    delta[9] = static_cast<uint8_t>(crc);
+
+    uint32_t length = LandDelta::HEADER_LENGTH;
+    for (uint32_t tile = 0; tile < 64; tile++)
+    {
+      if ((mask & (1ULL << tile)) != 0)
+      {
+        memcpy(delta + length, newBlock + (tile * TILE_LENGTH), TILE_LENGTH);
+        length += TILE_LENGTH;
+      }
+    }
+
+    if (LandDelta::getLength(delta, sizeof(delta)) != length || LandDelta::getLength(delta, length - 1) != 0)
+    {
+      printf("  wrong length for a delta of %u bytes\n", length);
+      return false;
+    }
+
+    if (!LandDelta::apply(oldBlock, delta, patchedBlock) || memcmp(patchedBlock, newBlock, BLOCK_LENGTH) != 0)
+    {
+      printf("  patching with a delta of %u bytes does not give the new block\n", length);
+      return false;
+    }
+
+    //an unchanged tile that differs by one is always caught by the checksum
+    if (mask != ~0ULL)
+    {
+      uint32_t tile = getRandom(64);
+      while ((mask & (1ULL << tile)) != 0)
+      {
+        tile = (tile + 1) % 64;
+      }
+
+      oldBlock[(tile * TILE_LENGTH) + 2] ^= 0x01;
+      if (LandDelta::apply(oldBlock, delta, patchedBlock))
+      {
+        printf("  a delta was applied to a block that differs in tile %u\n", tile);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,233 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include "../UltimaLive/Network/Lz4Block.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const uint32_t GUARD_LENGTH = 64;
+static const uint8_t GUARD_BYTE = 0xA5;
+
+static void writeLength(std::vector<uint8_t>& rBlock, uint32_t length)
+{
+  while (length >= 255)
+  {
+    rBlock.push_back(255);
+    length -= 255;
+  }
+  rBlock.push_back(static_cast<uint8_t>(length));
+}
+
+static void writeSequence(std::vector<uint8_t>& rBlock, const uint8_t* pLiterals, uint32_t literalLength, uint32_t offset, uint32_t matchLength)
+{
+  uint32_t matchCode = matchLength >= Lz4Block::MIN_MATCH ? matchLength - Lz4Block::MIN_MATCH : 0;
+  rBlock.push_back(static_cast<uint8_t>(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15)));
+  if (literalLength >= 15)
+  {
+    writeLength(rBlock, literalLength - 15);
+  }
+
+  rBlock.insert(rBlock.end(), pLiterals, pLiterals + literalLength);
+
+  if (matchLength >= Lz4Block::MIN_MATCH)
+  {
+    rBlock.push_back(static_cast<uint8_t>(offset));
+    rBlock.push_back(static_cast<uint8_t>(offset >> 8));
+    if (matchCode >= 15)
+    {
+      writeLength(rBlock, matchCode - 15);
+    }
+  }
+}
+
+/* A greedy compressor that finds matches through a table of the last position of every 4 byte sequence, enough to 
+ * produce the long, overlapping and far back matches the server's encoder does
+ */
+static void compress(const std::vector<uint8_t>& rData, std::vector<uint8_t>& rBlock)
+{
+  static const uint32_t LAST_LITERALS = 5;
+
+  rBlock.clear();
+  std::vector<int32_t> lastPositions(1 << 16, -1);
+  uint32_t literalStart = 0;
+  uint32_t position = 0;
+  uint32_t size = static_cast<uint32_t>(rData.size());
+
+  while (size >= LAST_LITERALS && position + Lz4Block::MIN_MATCH <= size - LAST_LITERALS)
+  {
+    uint32_t sequence = 0;
+    memcpy(&sequence, &rData[position], 4);
+    uint32_t hash = (sequence * 2654435761U) >> 16;
+    int32_t candidate = lastPositions[hash];
+    lastPositions[hash] = static_cast<int32_t>(position);
+
+    if (candidate < 0 || position - candidate > 0xFFFF || memcmp(&rData[candidate], &rData[position], 4) != 0)
+    {
+      position++;
+      continue;
+    }
+
+    uint32_t matchLength = 4;
+    while (position + matchLength < size - LAST_LITERALS && rData[candidate + matchLength] == rData[position + matchLength])
+    {
+      matchLength++;
+    }
+
+    writeSequence(rBlock, &rData[literalStart], position - literalStart, position - candidate, matchLength);
+    position += matchLength;
+    literalStart = position;
+  }
+
+  writeSequence(rBlock, size > literalStart ? &rData[literalStart] : NULL, size - literalStart, 0, 0);
+}
+
+/* Decodes into a buffer with guard bytes after it, and fails if any of them were written */
+static bool decode(const std::vector<uint8_t>& rBlock, std::vector<uint8_t>& rOutput, uint32_t length, bool& rGuardIntact)
+{
+  rOutput.assign(length + GUARD_LENGTH, GUARD_BYTE);
+  bool decoded = Lz4Block::decompress(rBlock.empty() ? NULL : &rBlock[0], static_cast<uint32_t>(rBlock.size()), &rOutput[0], length);
+
+  rGuardIntact = true;
+  for (uint32_t i = length; i < rOutput.size(); i++)
+  {
+    rGuardIntact = rGuardIntact && rOutput[i] == GUARD_BYTE;
+  }
+
+  return decoded;
+}
+
+//decodes a hand built block that has to be refused without writing past the output
+static bool checkRefused(const char* pCase, const uint8_t* pBlock, uint32_t blockLength, uint32_t outputLength)
+{
+  std::vector<uint8_t> block(pBlock, pBlock + blockLength);
+  std::vector<uint8_t> output;
+  bool guardIntact = true;
+  if (decode(block, output, outputLength, guardIntact) || !guardIntact)
+  {
+    printf("  a block with %s was %s\n", pCase, guardIntact ? "decoded" : "decoded past the end of the output");
+    return false;
+  }
+
+  return true;
+}
+
+/* Decodes hand built blocks, literals only, an overlapping match and extended literal and match lengths, then blocks
+ * of batch-like data compressed by a reference encoder.  Damaged blocks have to be refused without writing out of
+ * bounds: literals cut short, a match offset that reaches back before the start of the output, output that would run
+ * past the destination or stop short of it, and random corruptions of valid blocks.
+ */
+bool testLz4Block()
+{
+  static const uint8_t LITERALS_ONLY[] = { 0x50, 'h', 'e', 'l', 'l', 'o' };
+  static const uint8_t OVERLAPPING_MATCH[] = { 0x23, 'a', 'b', 0x02, 0x00, 0x10, 'c' };
+  static const uint8_t OVERLAPPING_RESULT[] = { 'a', 'b', 'a', 'b', 'a', 'b', 'a', 'b', 'a', 'c' };
+
+  std::vector<uint8_t> output;
+  bool guardIntact = true;
+  if (!decode(std::vector<uint8_t>(LITERALS_ONLY, LITERALS_ONLY + sizeof(LITERALS_ONLY)), output, 5, guardIntact) || memcmp(&output[0], "hello", 5) != 0 ||
+    !decode(std::vector<uint8_t>(OVERLAPPING_MATCH, OVERLAPPING_MATCH + sizeof(OVERLAPPING_MATCH)), output, sizeof(OVERLAPPING_RESULT), guardIntact) ||
+    memcmp(&output[0], OVERLAPPING_RESULT, sizeof(OVERLAPPING_RESULT)) != 0)
+  {
+    printf("  a hand built block decoded wrong\n");
+    return false;
+  }
+
+  //15 + 255 + 30 literals, then a match of 4 + 15 + 255 + 255 + 1 bytes
+  std::vector<uint8_t> block;
+  std::vector<uint8_t> literals(300);
+  for (uint32_t i = 0; i < literals.size(); i++)
+  {
+    literals[i] = static_cast<uint8_t>(i);
+  }
+  writeSequence(block, &literals[0], 300, 300, 530);
+  writeSequence(block, NULL, 0, 0, 0);
+  if (block[0] != 0xFF || block[1] != 255 || block[2] != 30 || !decode(block, output, 830, guardIntact) ||
+    memcmp(&output[0], &literals[0], 300) != 0 || memcmp(&output[300], &literals[0], 300) != 0 || memcmp(&output[600], &literals[0], 230) != 0)
+  {
+    printf("  a block with extended lengths decoded wrong\n");
+    return false;
+  }
+
+  static const uint8_t TRUNCATED_LITERALS[] = { 0x50, 'h', 'e', 'l' };
+  static const uint8_t TRUNCATED_LENGTH[] = { 0xF0, 255 };
+  static const uint8_t TRUNCATED_OFFSET[] = { 0x14, 'a', 0x01 };
+  static const uint8_t OFFSET_BEFORE_START[] = { 0x20, 'a', 'b', 0x03, 0x00, 0x10, 'c' };
+  static const uint8_t ZERO_OFFSET[] = { 0x20, 'a', 'b', 0x00, 0x00, 0x10, 'c' };
+  static const uint8_t LITERAL_OVERRUN[] = { 0x60, 'a', 'b', 'c', 'd', 'e', 'f' };
+  static const uint8_t MATCH_OVERRUN[] = { 0x1F, 'a', 0x01, 0x00, 200, 0x10, 'c' };
+  if (!checkRefused("literals cut short", TRUNCATED_LITERALS, sizeof(TRUNCATED_LITERALS), 5) ||
+    !checkRefused("an extended length cut short", TRUNCATED_LENGTH, sizeof(TRUNCATED_LENGTH), 1024) ||
+    !checkRefused("an offset cut short", TRUNCATED_OFFSET, sizeof(TRUNCATED_OFFSET), 16) ||
+    !checkRefused("an offset before the start of the output", OFFSET_BEFORE_START, sizeof(OFFSET_BEFORE_START), 7) ||
+    !checkRefused("an offset of zero", ZERO_OFFSET, sizeof(ZERO_OFFSET), 7) ||
+    !checkRefused("literals past the end of the output", LITERAL_OVERRUN, sizeof(LITERAL_OVERRUN), 5) ||
+    !checkRefused("a match past the end of the output", MATCH_OVERRUN, sizeof(MATCH_OVERRUN), 32) ||
+    !checkRefused("output that stops short", LITERALS_ONLY, sizeof(LITERALS_ONLY), 6))
+  {
+    return false;
+  }
+
+  for (uint32_t iteration = 0; iteration < 200; iteration++)
+  {
+    //land and statics records repeat a lot, with runs of noise in between
+    std::vector<uint8_t> data(1 + getRandom(20000));
+    for (uint32_t i = 0; i < data.size(); i++)
+    {
+      uint32_t back = 1 + getRandom(i < 1000 ? i + 1 : 1000);
+      data[i] = (i > 0 && getRandom(4) != 0) ? data[i - (back <= i ? back : i)] : static_cast<uint8_t>(getRandom(256));
+    }
+
+    compress(data, block);
+    if (!decode(block, output, static_cast<uint32_t>(data.size()), guardIntact) || memcmp(&output[0], &data[0], data.size()) != 0)
+    {
+      printf("  a compressed block of %u bytes did not decode back to its data\n", static_cast<uint32_t>(data.size()));
+      return false;
+    }
+
+    //a damaged block may decode to garbage, but never past the output
+    for (uint32_t damage = 0; damage < 20; damage++)
+    {
+      std::vector<uint8_t> damaged(block);
+      if (damage % 2 == 0)
+      {
+        damaged[getRandom(static_cast<uint32_t>(damaged.size()))] = static_cast<uint8_t>(getRandom(256));
+      }
+      else
+      {
+        damaged.resize(getRandom(static_cast<uint32_t>(damaged.size())));
+      }
+
+      decode(damaged, output, static_cast<uint32_t>(data.size()), guardIntact);
+      if (!guardIntact)
+      {
+        printf("  a damaged block was decoded past the end of the output\n");
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,203 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include <cstdio>
+
+#ifdef _WIN32
+
+void benchmarkMapSwitch()
+{
+  printf("Map switch: skipped, the benchmark maps files with POSIX calls\n");
+}
+
+#else
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static const uint32_t MAP_FILE_SIZE = 7168 * 4096 / 64 * 196; //a 7168x4096 map#.mul
+static const uint32_t PAGE_SIZE = 0x1000;
+
+static double getMilliseconds(std::chrono::steady_clock::time_point startTime)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+//reads one byte of every page, the way the client walks a map it just switched to
+static void touchPages(const uint8_t* pView, uint32_t size)
+{
+  volatile uint8_t sum = 0;
+  for (uint32_t offset = 0; offset < size; offset += PAGE_SIZE)
+  {
+    sum += pView[offset];
+  }
+}
+
+static bool copyIntoPool(int file, uint8_t* pPool)
+{
+  uint32_t offset = 0;
+  while (offset < MAP_FILE_SIZE)
+  {
+    ssize_t length = pread(file, pPool + offset, MAP_FILE_SIZE - offset, offset);
+    if (length <= 0)
+    {
+      return false;
+    }
+
+    offset += static_cast<uint32_t>(length);
+  }
+
+  return true;
+}
+
+static uint8_t* mapWholeFile(int file)
+{
+  void* pView = mmap(NULL, MAP_FILE_SIZE, PROT_READ, MAP_SHARED, file, 0);
+  return pView != MAP_FAILED ? reinterpret_cast<uint8_t*>(pView) : NULL;
+}
+
+//drops the file from the page cache, so that the next read of it comes from disk
+static void evictFile(int file)
+{
+  fsync(file);
+  posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+/* Times what ResidentMapCache does for a map switch on a map file of the size of map0.mul, with mmap standing in for
+ * the Windows views.  Reading the map back is timed cold, with the file dropped from the page cache, and resident,
+ * with another view of it kept like a retained map.  Retaining the map the player leaves is timed the way the cache
+ * did it, touching every page before the switch goes on, against handing the touch to a background thread.  The
+ * switch itself is timed the way LoadMap did it before the files were mapped, copying the whole map into the pool,
+ * against only mapping it.  How cold the cold reads are depends on the file system the temporary file lands on.
+ */
+void benchmarkMapSwitch()
+{
+  char path[] = "/tmp/UltimaLiveMapSwitchXXXXXX";
+  int file = mkstemp(path);
+  if (file < 0)
+  {
+    printf("Map switch: unable to create a temporary file\n");
+    return;
+  }
+
+  unlink(path);
+
+  std::vector<uint8_t> block(1024 * 1024);
+  for (uint32_t i = 0; i < block.size(); i++)
+  {
+    block[i] = static_cast<uint8_t>(getRandom(256));
+  }
+
+  bool written = true;
+  for (uint32_t offset = 0; offset < MAP_FILE_SIZE && written; offset += static_cast<uint32_t>(block.size()))
+  {
+    size_t length = MAP_FILE_SIZE - offset < block.size() ? MAP_FILE_SIZE - offset : block.size();
+    written = write(file, &block[0], length) == static_cast<ssize_t>(length);
+  }
+
+  if (!written)
+  {
+    printf("Map switch: unable to write the temporary file\n");
+    close(file);
+    return;
+  }
+
+  //reading the map back with nothing resident
+  evictFile(file);
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  uint8_t* pView = mapWholeFile(file);
+  if (pView == NULL)
+  {
+    printf("Map switch: unable to map the temporary file\n");
+    close(file);
+    return;
+  }
+
+  touchPages(pView, MAP_FILE_SIZE);
+  double coldMs = getMilliseconds(startTime);
+  munmap(pView, MAP_FILE_SIZE);
+
+  //the way LoadMap read the map before it was mapped, the whole file copied into the pool before the switch goes on
+  std::vector<uint8_t> pool(MAP_FILE_SIZE);
+  evictFile(file);
+  startTime = std::chrono::steady_clock::now();
+  bool copied = copyIntoPool(file, &pool[0]);
+  double copyColdMs = getMilliseconds(startTime);
+  startTime = std::chrono::steady_clock::now();
+  copied = copyIntoPool(file, &pool[0]) && copied;
+  double copyResidentMs = getMilliseconds(startTime);
+
+  //mapping the map only waits for the view, its pages are read as the client touches them
+  evictFile(file);
+  startTime = std::chrono::steady_clock::now();
+  pView = mapWholeFile(file);
+  double mapColdMs = getMilliseconds(startTime);
+  if (pView != NULL)
+  {
+    munmap(pView, MAP_FILE_SIZE);
+  }
+
+  //reading the map back while a retained view keeps it in memory
+  uint8_t* pRetainedView = mapWholeFile(file);
+  touchPages(pRetainedView, MAP_FILE_SIZE);
+  startTime = std::chrono::steady_clock::now();
+  pView = mapWholeFile(file);
+  touchPages(pView, MAP_FILE_SIZE);
+  double residentMs = getMilliseconds(startTime);
+  munmap(pView, MAP_FILE_SIZE);
+  munmap(pRetainedView, MAP_FILE_SIZE);
+
+  //retaining the map the player leaves, with the touch on the switching thread
+  evictFile(file);
+  startTime = std::chrono::steady_clock::now();
+  pRetainedView = mapWholeFile(file);
+  touchPages(pRetainedView, MAP_FILE_SIZE);
+  double synchronousRetainMs = getMilliseconds(startTime);
+  munmap(pRetainedView, MAP_FILE_SIZE);
+
+  //and with the touch on a background thread, the switch only waits for the view
+  evictFile(file);
+  startTime = std::chrono::steady_clock::now();
+  pRetainedView = mapWholeFile(file);
+  std::thread prefetchThread(touchPages, pRetainedView, MAP_FILE_SIZE);
+  double backgroundRetainMs = getMilliseconds(startTime);
+  prefetchThread.join();
+  double backgroundPrefetchMs = getMilliseconds(startTime);
+  munmap(pRetainedView, MAP_FILE_SIZE);
+
+  close(file);
+
+  printf("Map switch: %u KB map read cold %.2f ms, resident %.2f ms\n", MAP_FILE_SIZE / 1024, coldMs, residentMs);
+  printf("Map switch: copying the map into the pool blocks the switch for %.2f ms cold, %.2f ms resident%s, mapping it for %.2f ms\n",
+    copyColdMs, copyResidentMs, copied ? "" : " (short read)", mapColdMs);
+  printf("Map switch: retaining the map blocks the switch for %.2f ms touching every page, %.2f ms with a background prefetch (done after %.2f ms)\n",
+    synchronousRetainMs, backgroundRetainMs, backgroundPrefetchMs);
+}
+
+#endif
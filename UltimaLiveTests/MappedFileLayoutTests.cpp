@@ -0,0 +1,99 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include "../UltimaLive/FileSystem/MappedFileLayout.h"
+#include <cstdio>
+
+static const uint32_t GRANULARITY = 0x10000;
+static const uint32_t MAP0_SIZE = 7168 * 4096 / 64 * 196;
+static const uint32_t STATICS_POOL_SIZE = 200000000;
+
+/* A file opened into a pool and the layout MappedFile should give it */
+struct LayoutCase
+{
+  const char* pName;
+  uint32_t fileSize;
+  uint32_t minimumSize;
+  bool copyOnWrite;
+  uint32_t poolSize;
+  uint32_t sizeToMap;
+  bool fitsPool;
+  bool growsFile;
+  uint32_t tailOffset;
+};
+
+static const LayoutCase LAYOUT_CASES[] =
+{
+  //map0.mul is a whole number of granules and fills a pool of its own size, a larger pool keeps the rest reserved
+  { "map file", MAP0_SIZE, 0, false, MAP0_SIZE, MAP0_SIZE, true, false, 0 },
+  { "map file in a larger pool", MAP0_SIZE, 0, false, MAP0_SIZE + 3 * GRANULARITY, MAP0_SIZE, true, false, MAP0_SIZE },
+  //a blank map is mapped copy-on-write and never grown
+  { "blank map", 4096 * 196, 8192 * 196, true, MAP0_SIZE, 4096 * 196, true, false, 0xD0000 },
+  //the statics grow into the room after their data, which the file is extended to cover
+  { "statics", 1234567, STATICS_POOL_SIZE, false, STATICS_POOL_SIZE, STATICS_POOL_SIZE, true, true, 0 },
+  { "statics past the room", STATICS_POOL_SIZE + 7, STATICS_POOL_SIZE, false, STATICS_POOL_SIZE, STATICS_POOL_SIZE + 7, false, false, 0 },
+  //a view that ends one byte into a granule still takes up the whole granule
+  { "one byte into a granule", GRANULARITY + 1, 0, false, 4 * GRANULARITY, GRANULARITY + 1, true, false, 2 * GRANULARITY },
+  { "a granule short of the pool", 3 * GRANULARITY, 0, false, 4 * GRANULARITY, 3 * GRANULARITY, true, false, 3 * GRANULARITY },
+  { "the last granule of the pool", 3 * GRANULARITY + 1, 0, false, 4 * GRANULARITY, 3 * GRANULARITY + 1, true, false, 0 },
+  { "larger than the pool", 4 * GRANULARITY + 1, 0, false, 4 * GRANULARITY, 4 * GRANULARITY + 1, false, false, 0 },
+  //an empty file is only mapped when there is room to write into
+  { "empty", 0, 0, false, 4 * GRANULARITY, 0, false, false, 0 },
+  { "empty with room", 0, GRANULARITY, false, 4 * GRANULARITY, GRANULARITY, true, true, GRANULARITY },
+  { "empty copy-on-write", 0, GRANULARITY, true, 4 * GRANULARITY, 0, false, false, 0 },
+  //without a pool Windows places the view and any size goes
+  { "no pool", 0xFFFFFF00, 0, false, MappedFileLayout::NO_POOL, 0xFFFFFF00, true, false, 0 },
+};
+
+/* Checks how much of a file MappedFile maps, whether the view fits its pool and grows the file, and where the 
+ * reservation after the view starts
+ */
+bool testMappedFileLayout()
+{
+  for (uint32_t i = 0; i < sizeof(LAYOUT_CASES) / sizeof(LAYOUT_CASES[0]); i++)
+  {
+    const LayoutCase& rCase = LAYOUT_CASES[i];
+    uint32_t sizeToMap = MappedFileLayout::getSizeToMap(rCase.fileSize, rCase.minimumSize, rCase.copyOnWrite);
+    bool fitsPool = MappedFileLayout::fitsPool(sizeToMap, rCase.poolSize);
+    bool growsFile = MappedFileLayout::growsFile(sizeToMap, rCase.fileSize);
+    uint32_t tailOffset = fitsPool && rCase.poolSize != MappedFileLayout::NO_POOL ? MappedFileLayout::getTailOffset(sizeToMap, rCase.poolSize, GRANULARITY) : 0;
+
+    if (sizeToMap != rCase.sizeToMap || fitsPool != rCase.fitsPool || growsFile != rCase.growsFile || tailOffset != rCase.tailOffset)
+    {
+      printf("  %s: maps %u bytes, %s the pool, %s the file, tail at 0x%x instead of %u bytes, %s, %s, 0x%x\n", rCase.pName, sizeToMap, 
+        fitsPool ? "fits" : "doesn't fit", growsFile ? "grows" : "keeps", tailOffset, rCase.sizeToMap, rCase.fitsPool ? "fits" : "doesn't fit", 
+        rCase.growsFile ? "grows" : "keeps", rCase.tailOffset);
+      return false;
+    }
+
+    if (tailOffset != 0 && (tailOffset < sizeToMap || tailOffset % GRANULARITY != 0 || tailOffset >= rCase.poolSize))
+    {
+      printf("  %s: the tail at 0x%x overlaps the view or isn't at a granule in the pool\n", rCase.pName, tailOffset);
+      return false;
+    }
+  }
+
+  return true;
+}
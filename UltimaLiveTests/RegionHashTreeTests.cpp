@@ -0,0 +1,112 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include "../UltimaLive/Maps/RegionHashTree.h"
+#include <cstdio>
+
+/* A map of 9x6 blocks, so that the regions on the right and bottom edges cover fewer blocks, with block crcs that 
+ * are easy to reproduce on the server.  RegionHashTree.cs checks itself against the same map and the same hashes, 
+ * so if these change they have to change there too.
+ */
+static const uint32_t MAP_WIDTH_IN_BLOCKS = 9;
+static const uint32_t MAP_HEIGHT_IN_BLOCKS = 6;
+static const uint32_t CHANGED_BLOCK = 22;
+static const uint16_t CHANGED_CRC = 0xBEEF;
+
+static const uint32_t LEVEL_1_HASHES[6] = { 0x67CF73DC, 0x8B281DA2, 0xE8DAE345, 0xCE2D5106, 0xCBEFE3CA, 0xC9E9C4B8 };
+static const uint32_t TOP_HASH = 0x8A7D78A1;
+static const uint32_t CHANGED_LEVEL_1_HASH = 0xA09FFB27;
+static const uint32_t CHANGED_TOP_HASH = 0xFDCF5BA4;
+
+static bool s_blockChanged = false;
+
+static uint16_t getSyntheticCrc(uint32_t blockNumber)
+{
+  if (s_blockChanged && blockNumber == CHANGED_BLOCK)
+  {
+    return CHANGED_CRC;
+  }
+
+  return static_cast<uint16_t>((blockNumber * 40503) + 4660);
+}
+
+static bool checkHash(RegionHashTree& rTree, uint32_t level, uint32_t node, uint32_t expected)
+{
+  uint32_t hash = rTree.getNodeHash(level, node);
+  if (hash != expected)
+  {
+    printf("  node %u of level %u hashed to 0x%08X instead of 0x%08X\n", node, level, hash, expected);
+    return false;
+  }
+
+  return true;
+}
+
+/* Checks the shape of the tree over the synthetic map and every node hash against the fixed values the server has to
+ * agree with, then that changing a block and invalidating it rehashes exactly the regions above it
+ */
+bool testRegionHashTree()
+{
+  s_blockChanged = false;
+
+  RegionHashTree tree;
+  tree.reset(MAP_WIDTH_IN_BLOCKS, MAP_HEIGHT_IN_BLOCKS, getSyntheticCrc);
+  if (tree.getNumberOfLevels() != 3 || tree.getNodeCount(0) != 54 || tree.getNodeCount(1) != 6 || tree.getNodeCount(2) != 1)
+  {
+    printf("  a 9x6 block map should have levels of 54, 6 and 1 nodes\n");
+    return false;
+  }
+
+  for (uint32_t node = 0; node < 6; node++)
+  {
+    if (!checkHash(tree, 1, node, LEVEL_1_HASHES[node]))
+    {
+      return false;
+    }
+  }
+
+  if (!checkHash(tree, 2, 0, TOP_HASH) || tree.getNodeHash(2, 1) != 0 || tree.getNodeHash(3, 0) != 0)
+  {
+    return false;
+  }
+
+  //the cached hashes stay until the block is invalidated
+  s_blockChanged = true;
+  if (!checkHash(tree, 2, 0, TOP_HASH))
+  {
+    return false;
+  }
+
+  tree.invalidateBlock(CHANGED_BLOCK);
+  for (uint32_t node = 0; node < 6; node++)
+  {
+    if (!checkHash(tree, 1, node, node == 1 ? CHANGED_LEVEL_1_HASH : LEVEL_1_HASHES[node]))
+    {
+      return false;
+    }
+  }
+
+  return checkHash(tree, 2, 0, CHANGED_TOP_HASH);
+}
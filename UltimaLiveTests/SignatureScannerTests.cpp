@@ -0,0 +1,236 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include "../UltimaLive/SignatureScanner.h"
+#include "../UltimaLive/ClientSignatures.h"
+#include "../SignatureAnalyzer/PeImage.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+//the bytes from the image base that the DLL scans inside the client
+static const uint32_t CLIENT_IMAGE_MAX_SIZE = 0x300000;
+
+/* Client builds to test the signatures against, from ULTIMALIVE_CLIENT_IMAGES as a ; separated list of client.exe 
+ * paths.  Each one is laid out at its RVAs the way the loader would, so the scan sees what the DLL sees.
+ */
+static bool loadClientImages(std::vector<std::string>& rPaths, std::vector<std::vector<uint8_t> >& rImages)
+{
+  const char* pList = getenv("ULTIMALIVE_CLIENT_IMAGES");
+  std::string list(pList != NULL ? pList : "");
+
+  size_t start = 0;
+  while (start < list.length())
+  {
+    size_t end = list.find(';', start);
+    if (end == std::string::npos)
+    {
+      end = list.length();
+    }
+
+    if (end > start)
+    {
+      PeImage image;
+      std::string path = list.substr(start, end - start);
+      if (!image.load(path))
+      {
+        printf("  unable to load %s: %s\n", path.c_str(), image.getError().c_str());
+        return false;
+      }
+
+      rPaths.push_back(path);
+      rImages.push_back(std::vector<uint8_t>());
+      image.mapImage(rImages.back(), CLIENT_IMAGE_MAX_SIZE);
+    }
+
+    start = end + 1;
+  }
+
+  return true;
+}
+
+//a random image weighted towards common x86 opcode bytes
+static void buildRandomImage(std::vector<uint8_t>& rImage, uint32_t size)
+{
+  static const uint8_t COMMON_BYTES[8] = { 0x00, 0x8B, 0xFF, 0x89, 0xE8, 0x55, 0x83, 0x04 };
+
+  rImage.resize(size);
+  for (uint32_t i = 0; i < rImage.size(); i++)
+  {
+    rImage[i] = getRandom(2) == 0 ? COMMON_BYTES[getRandom(8)] : static_cast<uint8_t>(getRandom(256));
+  }
+}
+
+/* Checks the scanner against the reference search on a random image, with signatures cut out of the image and partly
+ * wildcarded.  A few signatures get a byte changed so that some of them never match.  A small set is scanned to cover
+ * the SSE2 path and a large one to cover the scalar path, each at an unaligned start.
+ */
+bool testSignatureScanner()
+{
+  static const uint32_t IMAGE_SIZE = 0x100000;
+  static const uint32_t NUMBER_OF_SIGNATURES = 48;
+
+  std::vector<uint8_t> image;
+  buildRandomImage(image, IMAGE_SIZE);
+
+  std::vector<std::vector<uint8_t> > signatures(NUMBER_OF_SIGNATURES);
+  for (uint32_t id = 0; id < NUMBER_OF_SIGNATURES; id++)
+  {
+    uint32_t length = 3 + getRandom(22);
+    uint32_t start = getRandom(IMAGE_SIZE - length);
+    signatures[id].assign(image.begin() + start, image.begin() + start + length);
+
+    for (uint32_t offset = 0; offset < length; offset++)
+    {
+      if (getRandom(4) == 0)
+      {
+        signatures[id][offset] = SignatureScanner::WILDCARD;
+      }
+    }
+
+    if (id % 5 == 0)
+    {
+      uint32_t offset = getRandom(length);
+      signatures[id][offset] = static_cast<uint8_t>(signatures[id][offset] + 1);
+    }
+  }
+  signatures[NUMBER_OF_SIGNATURES - 1].assign(5, SignatureScanner::WILDCARD);
+
+  uint32_t setSizes[2] = { 6, NUMBER_OF_SIGNATURES };
+  for (uint32_t set = 0; set < 2; set++)
+  {
+    uint32_t firstSignature = NUMBER_OF_SIGNATURES - setSizes[set];
+
+    SignatureScanner scanner;
+    for (uint32_t id = 0; id < setSizes[set]; id++)
+    {
+      scanner.addSignature(&signatures[firstSignature + id][0], static_cast<uint32_t>(signatures[firstSignature + id].size()));
+    }
+
+    const uint8_t* pImage = &image[1];
+    uint32_t imageLength = IMAGE_SIZE - 1;
+    scanner.scan(pImage, imageLength);
+
+    for (uint32_t id = 0; id < setSizes[set]; id++)
+    {
+      const std::vector<uint8_t>& rSignature = signatures[firstSignature + id];
+      if (scanner.getMatch(id) != SignatureScanner::findReference(pImage, imageLength, &rSignature[0], static_cast<uint32_t>(rSignature.size())))
+      {
+        printf("  signature %u of a set of %u matches somewhere else than the reference search\n", id, setSizes[set]);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/* Checks that the client signature set resolves to the same addresses through the scanner as through the reference
+ * search in every client build named in ULTIMALIVE_CLIENT_IMAGES.  Passes without checking anything if none are.
+ */
+bool testClientSignatures()
+{
+  std::vector<std::string> paths;
+  std::vector<std::vector<uint8_t> > images;
+  if (!loadClientImages(paths, images))
+  {
+    return false;
+  }
+
+  if (images.empty())
+  {
+    printf("  no client images, set ULTIMALIVE_CLIENT_IMAGES to check the signatures against client builds\n");
+    return true;
+  }
+
+  for (uint32_t build = 0; build < images.size(); build++)
+  {
+    SignatureScanner scanner;
+    for (unsigned int i = 0; i < ClientSignatures::COUNT; i++)
+    {
+      scanner.addSignature(ClientSignatures::TABLE[i].pBytes, ClientSignatures::TABLE[i].length);
+    }
+    scanner.scan(&images[build][0], CLIENT_IMAGE_MAX_SIZE);
+
+    uint32_t resolved = 0;
+    for (unsigned int i = 0; i < ClientSignatures::COUNT; i++)
+    {
+      const uint8_t* pReference = SignatureScanner::findReference(&images[build][0], CLIENT_IMAGE_MAX_SIZE, ClientSignatures::TABLE[i].pBytes, ClientSignatures::TABLE[i].length);
+      if (scanner.getMatch(i) != pReference)
+      {
+        printf("  signature %u resolves somewhere else than the reference search in %s\n", i, paths[build].c_str());
+        return false;
+      }
+
+      resolved += pReference != NULL ? 1 : 0;
+    }
+
+    printf("  %s: %u of %u signatures resolved\n", paths[build].c_str(), resolved, ClientSignatures::COUNT);
+  }
+
+  return true;
+}
+
+/* Times the single pass against one reference search per signature for the client signature set, over the client 
+ * builds in ULTIMALIVE_CLIENT_IMAGES or over a random image the size of the client's if there are none.
+ */
+void benchmarkSignatureScan()
+{
+  std::vector<std::string> paths;
+  std::vector<std::vector<uint8_t> > images;
+  if (!loadClientImages(paths, images) || images.empty())
+  {
+    paths.assign(1, "random image");
+    images.assign(1, std::vector<uint8_t>());
+    buildRandomImage(images[0], CLIENT_IMAGE_MAX_SIZE);
+  }
+
+  for (uint32_t build = 0; build < images.size(); build++)
+  {
+    const uint8_t* pImage = &images[build][0];
+    volatile uintptr_t found = 0;
+
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    SignatureScanner scanner;
+    for (unsigned int i = 0; i < ClientSignatures::COUNT; i++)
+    {
+      scanner.addSignature(ClientSignatures::TABLE[i].pBytes, ClientSignatures::TABLE[i].length);
+    }
+    scanner.scan(pImage, CLIENT_IMAGE_MAX_SIZE);
+    std::chrono::steady_clock::time_point scanTime = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < ClientSignatures::COUNT; i++)
+    {
+      found += reinterpret_cast<uintptr_t>(SignatureScanner::findReference(pImage, CLIENT_IMAGE_MAX_SIZE, ClientSignatures::TABLE[i].pBytes, ClientSignatures::TABLE[i].length));
+    }
+    std::chrono::steady_clock::time_point referenceTime = std::chrono::steady_clock::now();
+
+    printf("Signature scan of %s: single pass %.2f ms, reference search %.2f ms for %u signatures\n", paths[build].c_str(),
+      std::chrono::duration<double, std::milli>(scanTime - startTime).count(), std::chrono::duration<double, std::milli>(referenceTime - scanTime).count(), 
+      ClientSignatures::COUNT);
+  }
+}
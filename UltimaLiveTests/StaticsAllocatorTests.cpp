@@ -0,0 +1,320 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include "../UltimaLive/FileSystem/StaticsAllocator.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const uint32_t NUMBER_OF_BLOCKS = 512;
+static const uint32_t NUMBER_OF_UPDATES = 4000;
+
+/* The statics index and statics of a small map, with the statics each block should read back kept on the side */
+struct StaticsPools
+{
+  std::vector<uint8_t> staidx;
+  std::vector<uint8_t> statics;
+  uint32_t staticsSize;
+  std::vector<std::vector<uint8_t> > expected;
+};
+
+static uint32_t getLookup(StaticsPools& rPools, uint32_t blockNum)
+{
+  return *reinterpret_cast<uint32_t*>(&rPools.staidx[blockNum * 12]);
+}
+
+static uint32_t getLength(StaticsPools& rPools, uint32_t blockNum)
+{
+  return *reinterpret_cast<uint32_t*>(&rPools.staidx[(blockNum * 12) + 4]);
+}
+
+static void setEntry(StaticsPools& rPools, uint32_t blockNum, uint32_t lookup, uint32_t length)
+{
+  *reinterpret_cast<uint32_t*>(&rPools.staidx[blockNum * 12]) = lookup;
+  *reinterpret_cast<uint32_t*>(&rPools.staidx[(blockNum * 12) + 4]) = length;
+}
+
+static void randomStatics(std::vector<uint8_t>& rData, uint32_t numberOfRecords)
+{
+  rData.resize(numberOfRecords * StaticsAllocator::RECORD_SIZE);
+  for (uint32_t i = 0; i < rData.size(); i++)
+  {
+    rData[i] = static_cast<uint8_t>(getRandom(256));
+  }
+}
+
+/* Lays the blocks out the way the stock files do, every fourth block pointing at the statics of the block before it
+ * and some blocks without statics
+ */
+static void buildPools(StaticsPools& rPools)
+{
+  rPools.staidx.assign(NUMBER_OF_BLOCKS * 12, 0);
+  rPools.statics.assign(0x100000, 0);
+  rPools.staticsSize = 0;
+  rPools.expected.assign(NUMBER_OF_BLOCKS, std::vector<uint8_t>());
+
+  for (uint32_t blockNum = 0; blockNum < NUMBER_OF_BLOCKS; blockNum++)
+  {
+    if (blockNum % 4 == 3 && getLength(rPools, blockNum - 1) > 0)
+    {
+      setEntry(rPools, blockNum, getLookup(rPools, blockNum - 1), getLength(rPools, blockNum - 1));
+      rPools.expected[blockNum] = rPools.expected[blockNum - 1];
+    }
+    else if (getRandom(5) == 0)
+    {
+      setEntry(rPools, blockNum, StaticsAllocator::INVALID_LOOKUP, 0);
+    }
+    else
+    {
+      randomStatics(rPools.expected[blockNum], 1 + getRandom(12));
+      setEntry(rPools, blockNum, rPools.staticsSize, static_cast<uint32_t>(rPools.expected[blockNum].size()));
+      memcpy(&rPools.statics[rPools.staticsSize], &rPools.expected[blockNum][0], rPools.expected[blockNum].size());
+      rPools.staticsSize += static_cast<uint32_t>(rPools.expected[blockNum].size());
+    }
+  }
+}
+
+//moves blocks the way BaseFileManager::compactStatics does
+static void compact(StaticsAllocator& rAllocator, StaticsPools& rPools, uint32_t maxMoves, bool force)
+{
+  if (!rAllocator.isCompacting())
+  {
+    if (!rAllocator.needsCompaction(rPools.staticsSize) && !(force && rAllocator.getFreeBytes() > 0))
+    {
+      return;
+    }
+
+    rAllocator.beginCompaction(&rPools.staidx[0], NUMBER_OF_BLOCKS, rPools.staticsSize);
+  }
+
+  uint32_t blockNum = 0;
+  uint32_t from = 0;
+  uint32_t to = 0;
+  uint32_t length = 0;
+  for (uint32_t moves = 0; moves < maxMoves; moves++)
+  {
+    if (!rAllocator.nextCompactionMove(&rPools.staidx[0], NUMBER_OF_BLOCKS, rPools.staticsSize, blockNum, from, to, length))
+    {
+      rAllocator.endCompaction(rPools.staticsSize);
+      break;
+    }
+
+    memmove(&rPools.statics[to], &rPools.statics[from], length);
+    *reinterpret_cast<uint32_t*>(&rPools.staidx[blockNum * 12]) = to;
+  }
+}
+
+//writes a block the way BaseFileManager::writeStaticsBlock does, minus the journal and the files
+static bool writeBlock(StaticsAllocator& rAllocator, StaticsPools& rPools, uint32_t blockNum, const std::vector<uint8_t>& rData)
+{
+  uint32_t existingLookup = getLookup(rPools, blockNum);
+  uint32_t existingLength = getLength(rPools, blockNum);
+  uint32_t length = static_cast<uint32_t>(rData.size());
+
+  if (length == 0)
+  {
+    setEntry(rPools, blockNum, StaticsAllocator::INVALID_LOOKUP, 0);
+    if (existingLength > 0)
+    {
+      rAllocator.release(existingLookup, existingLength);
+    }
+  }
+  else if (existingLength >= length && existingLookup != StaticsAllocator::INVALID_LOOKUP && !rAllocator.isShared(existingLookup))
+  {
+    memcpy(&rPools.statics[existingLookup], &rData[0], length);
+    setEntry(rPools, blockNum, existingLookup, length);
+    if (existingLength > length)
+    {
+      rAllocator.release(existingLookup + length, existingLength - length);
+    }
+  }
+  else
+  {
+    uint32_t lookup = rAllocator.allocate(length);
+    if (lookup == StaticsAllocator::INVALID_LOOKUP)
+    {
+      if (rPools.staticsSize + length > rPools.statics.size())
+      {
+        return false;
+      }
+
+      lookup = rPools.staticsSize;
+      rPools.staticsSize += length;
+    }
+
+    memcpy(&rPools.statics[lookup], &rData[0], length);
+    setEntry(rPools, blockNum, lookup, length);
+    if (existingLength > 0)
+    {
+      rAllocator.release(existingLookup, existingLength);
+    }
+  }
+
+  rPools.expected[blockNum] = rData;
+  compact(rAllocator, rPools, StaticsAllocator::COMPACTION_MOVES_PER_UPDATE, false);
+  return true;
+}
+
+static bool checkBlocks(StaticsPools& rPools, const char* pWhen)
+{
+  for (uint32_t blockNum = 0; blockNum < NUMBER_OF_BLOCKS; blockNum++)
+  {
+    uint32_t length = getLength(rPools, blockNum);
+    if (length != rPools.expected[blockNum].size() || (length > 0 && (getLookup(rPools, blockNum) + length > rPools.staticsSize || 
+      memcmp(&rPools.statics[getLookup(rPools, blockNum)], &rPools.expected[blockNum][0], length) != 0)))
+    {
+      printf("  block %u reads back the wrong statics %s\n", blockNum, pWhen);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* Rewrites random blocks of a map whose index shares statics between entries, with compactions running in between,
+ * and checks that every block still reads back what was last written to it.  Also checks that releasing a shared 
+ * lookup only drops a reference, that the references follow a shared block when it is compacted, and that free 
+ * extents loaded from a sidecar are dropped where the index points into them.
+ */
+bool testStaticsAllocator()
+{
+  StaticsPools pools;
+  buildPools(pools);
+
+  StaticsAllocator allocator;
+  allocator.countReferences(&pools.staidx[0], NUMBER_OF_BLOCKS, pools.staticsSize);
+
+  uint32_t sharedBlock = 3;
+  while (getLength(pools, sharedBlock) == 0)
+  {
+    sharedBlock += 4;
+  }
+
+  uint32_t sharedLookup = getLookup(pools, sharedBlock);
+  uint32_t ownBlock = 0;
+  while (getLength(pools, ownBlock) == 0)
+  {
+    ownBlock += 4;
+  }
+
+  if (!allocator.isShared(sharedLookup) || allocator.isShared(getLookup(pools, ownBlock)))
+  {
+    printf("  the shared lookups were not counted\n");
+    return false;
+  }
+
+  //the first of the two entries to let go of the statics leaves them in place
+  std::vector<uint8_t> data;
+  if (!writeBlock(allocator, pools, sharedBlock, data) || allocator.getFreeBytes() != 0 || allocator.isShared(sharedLookup))
+  {
+    printf("  releasing a shared lookup freed it\n");
+    return false;
+  }
+
+  uint32_t sharedLength = getLength(pools, sharedBlock - 1);
+  if (!writeBlock(allocator, pools, sharedBlock - 1, data) || allocator.getFreeBytes() != sharedLength)
+  {
+    printf("  releasing the last reference to a lookup did not free it\n");
+    return false;
+  }
+
+  for (uint32_t update = 0; update < NUMBER_OF_UPDATES; update++)
+  {
+    uint32_t blockNum = getRandom(NUMBER_OF_BLOCKS);
+    randomStatics(data, getRandom(4) == 0 ? 0 : 1 + getRandom(16));
+    if (!writeBlock(allocator, pools, blockNum, data))
+    {
+      printf("  the statics pool filled up after %u updates\n", update);
+      return false;
+    }
+
+    if (update % 500 == 0 && !checkBlocks(pools, "after an update"))
+    {
+      return false;
+    }
+  }
+
+  //a full compaction with the shared blocks from the original layout still in place
+  buildPools(pools);
+  allocator.countReferences(&pools.staidx[0], NUMBER_OF_BLOCKS, pools.staticsSize);
+  for (uint32_t blockNum = 0; blockNum < NUMBER_OF_BLOCKS; blockNum += 2)
+  {
+    if (getLength(pools, blockNum) > 0 && blockNum % 4 != 2)
+    {
+      data.clear();
+      writeBlock(allocator, pools, blockNum, data);
+    }
+  }
+
+  uint32_t sizeBefore = pools.staticsSize;
+  compact(allocator, pools, 0xFFFFFFFF, true);
+
+  if (!checkBlocks(pools, "after a compaction"))
+  {
+    return false;
+  }
+
+  if (pools.staticsSize >= sizeBefore || allocator.getFreeBytes() != 0)
+  {
+    printf("  the compaction did not reclaim the freed statics\n");
+    return false;
+  }
+
+  for (uint32_t blockNum = 3; blockNum < NUMBER_OF_BLOCKS; blockNum += 4)
+  {
+    if (getLength(pools, blockNum) > 0 && getLookup(pools, blockNum) == getLookup(pools, blockNum - 1) && !allocator.isShared(getLookup(pools, blockNum)))
+    {
+      printf("  the references to block %u's statics were lost when it was compacted\n", blockNum);
+      return false;
+    }
+  }
+
+  //free lists saved over statics that are in use again are not handed out
+  uint32_t usedBlock = 2;
+  while (getLength(pools, usedBlock) == 0)
+  {
+    usedBlock += 4;
+  }
+
+  char path[] = "UltimaLiveStaticsAllocatorTest.free";
+  StaticsAllocator sidecarAllocator;
+  sidecarAllocator.release(getLookup(pools, usedBlock), 14);
+  sidecarAllocator.save(path, pools.staticsSize);
+  sidecarAllocator.load(path, pools.staticsSize);
+  if (sidecarAllocator.getFreeBytes() != 14)
+  {
+    printf("  the free lists did not survive being saved\n");
+    return false;
+  }
+
+  sidecarAllocator.countReferences(&pools.staidx[0], NUMBER_OF_BLOCKS, pools.staticsSize);
+  if (sidecarAllocator.getFreeBytes() != 0)
+  {
+    printf("  a free extent that the index points into was kept\n");
+    return false;
+  }
+
+  return true;
+}
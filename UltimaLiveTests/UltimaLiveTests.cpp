@@ -0,0 +1,179 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+struct TestCase
+{
+  const char* pName;
+  bool (*pTest)();
+};
+
+struct BenchmarkCase
+{
+  const char* pName;
+  void (*pBenchmark)();
+};
+
+static const TestCase TESTS[] =
+{
+  { "Fletcher16", testFletcher16 },
+  { "LandDelta", testLandDelta },
+  { "Lz4Block", testLz4Block },
+  { "SignatureScanner", testSignatureScanner },
+  { "ClientSignatures", testClientSignatures },
+  { "UopEntryIndex", testUopEntryIndex },
+  { "UopBlockTable", testUopBlockTable },
+  { "UopReader", testUopReader },
+  { "Inflate", testInflate },
+  { "StaticsAllocator", testStaticsAllocator },
+  { "HashWindow", testHashWindow },
+  { "RegionHashTree", testRegionHashTree },
+  { "MappedFileLayout", testMappedFileLayout },
+};
+
+static const BenchmarkCase BENCHMARKS[] =
+{
+  { "Fletcher16", benchmarkFletcher16 },
+  { "Dispatch", benchmarkDispatch },
+  { "SignatureScan", benchmarkSignatureScan },
+  { "UopEntryIndex", benchmarkUopEntryIndex },
+  { "UopBlockLookup", benchmarkUopBlockLookup },
+  { "BlockQuery", benchmarkBlockQuery },
+  { "BlockCrcCache", benchmarkBlockCrcCache },
+  { "MapSwitch", benchmarkMapSwitch },
+};
+
+static const uint32_t NUMBER_OF_TESTS = sizeof(TESTS) / sizeof(TESTS[0]);
+static const uint32_t NUMBER_OF_BENCHMARKS = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+std::mt19937& getTestRandom()
+{
+  static std::mt19937 s_random(0x554C4956); //ULIV
+  return s_random;
+}
+
+//a random number below limit
+uint32_t getRandom(uint32_t limit)
+{
+  return static_cast<uint32_t>(getTestRandom()() % limit);
+}
+
+uint64_t readCycleCounter()
+{
+  return __rdtsc();
+}
+
+static bool runTest(const TestCase& rTest)
+{
+  bool passed = rTest.pTest();
+  printf("%s: %s\n", rTest.pName, passed ? "passed" : "FAILED");
+  return passed;
+}
+
+static void printUsage()
+{
+  printf("UltimaLiveTests [test ...]\nUltimaLiveTests benchmark [benchmark ...]\n\nTests:");
+  for (uint32_t i = 0; i < NUMBER_OF_TESTS; i++)
+  {
+    printf(" %s", TESTS[i].pName);
+  }
+
+  printf("\nBenchmarks:");
+  for (uint32_t i = 0; i < NUMBER_OF_BENCHMARKS; i++)
+  {
+    printf(" %s", BENCHMARKS[i].pName);
+  }
+  printf("\n");
+}
+
+/* With no arguments every test is run.  Otherwise the named tests are run, or the named benchmarks after 
+ * "benchmark", all of them if none are named.
+ */
+int main(int argc, char* argv[])
+{
+  bool benchmarks = argc > 1 && strcmp(argv[1], "benchmark") == 0;
+  int firstName = benchmarks ? 2 : 1;
+  bool runAll = argc <= firstName;
+  bool passed = true;
+
+  for (int arg = firstName; arg < argc; arg++)
+  {
+    bool found = false;
+    for (uint32_t i = 0; i < (benchmarks ? NUMBER_OF_BENCHMARKS : NUMBER_OF_TESTS); i++)
+    {
+      found = found || strcmp(argv[arg], benchmarks ? BENCHMARKS[i].pName : TESTS[i].pName) == 0;
+    }
+
+    if (!found)
+    {
+      printf("Unknown %s %s\n\n", benchmarks ? "benchmark" : "test", argv[arg]);
+      printUsage();
+      return 2;
+    }
+  }
+
+  if (benchmarks)
+  {
+    for (uint32_t i = 0; i < NUMBER_OF_BENCHMARKS; i++)
+    {
+      bool named = runAll;
+      for (int arg = firstName; arg < argc; arg++)
+      {
+        named = named || strcmp(argv[arg], BENCHMARKS[i].pName) == 0;
+      }
+
+      if (named)
+      {
+        BENCHMARKS[i].pBenchmark();
+      }
+    }
+
+    return 0;
+  }
+
+  for (uint32_t i = 0; i < NUMBER_OF_TESTS; i++)
+  {
+    bool named = runAll;
+    for (int arg = firstName; arg < argc; arg++)
+    {
+      named = named || strcmp(argv[arg], TESTS[i].pName) == 0;
+    }
+
+    if (named && !runTest(TESTS[i]))
+    {
+      passed = false;
+    }
+  }
+
+  return passed ? 0 : 1;
+}
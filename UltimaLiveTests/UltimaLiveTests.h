@@ -0,0 +1,73 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#ifndef _ULTIMALIVE_TESTS_H
+#define _ULTIMALIVE_TESTS_H
+
+#include <stdint.h>
+#include <random>
+
+/* Tests and benchmarks for the parts of UltimaLive that depend on neither the client nor Windows.  They used to run
+ * as self tests when a DEBUG build of the DLL started up, they now live in their own executable that CTest runs:
+ *
+ *   cmake -S UltimaLiveTests -B build && cmake --build build && ctest --test-dir build
+ *
+ * Every test is one function that returns whether it passed and prints what went wrong if it did not.  Benchmarks 
+ * are not part of the CTest run, they are started by name:
+ *
+ *   UltimaLiveTests benchmark Fletcher16
+ *
+ * The client signatures are checked against real client builds when ULTIMALIVE_CLIENT_IMAGES names some client.exe
+ * files, separated by ;.  They are read from disk, so this works on any platform.
+ */
+
+bool testFletcher16();
+void benchmarkFletcher16();
+bool testLandDelta();
+bool testLz4Block();
+void benchmarkDispatch();
+bool testSignatureScanner();
+bool testClientSignatures();
+void benchmarkSignatureScan();
+bool testUopEntryIndex();
+void benchmarkUopEntryIndex();
+bool testUopBlockTable();
+void benchmarkUopBlockLookup();
+bool testUopReader();
+bool testInflate();
+void benchmarkBlockQuery();
+void benchmarkBlockCrcCache();
+bool testStaticsAllocator();
+bool testHashWindow();
+bool testRegionHashTree();
+void benchmarkMapSwitch();
+bool testMappedFileLayout();
+
+//the same sequence on every run, so that a failure can be reproduced
+std::mt19937& getTestRandom();
+uint32_t getRandom(uint32_t limit);
+
+uint64_t readCycleCounter();
+
+#endif
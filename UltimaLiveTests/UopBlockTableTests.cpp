@@ -0,0 +1,249 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include "../UltimaLive/FileSystem/Uop/UopBlockTable.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+static const uint32_t BLOCK_LENGTH = 196;
+static const uint32_t NUMBER_OF_MAP_BLOCKS = 7168 * 4096 / 64; //map0LegacyMUL.uop
+static const uint32_t BLOCKS_PER_ENTRY = 4096;
+static const uint32_t HEADER_LENGTH = 0x200;
+
+//the original walk through the entries of the map, summing their sizes up to the block
+static bool findScanning(const std::vector<FileEntry>& rEntries, uint32_t blockNum, uint32_t& rPoolOffset)
+{
+  uint32_t blockSeekLocation = blockNum * BLOCK_LENGTH;
+  uint32_t fileSeekLocation = 0;
+
+  for (uint32_t i = 0; i < rEntries.size(); i++)
+  {
+    if (blockSeekLocation < fileSeekLocation + rEntries[i].UncompressedDataSize)
+    {
+      rPoolOffset = static_cast<uint32_t>(rEntries[i].UopFileOffset + rEntries[i].MetaDataSize) + (blockSeekLocation - fileSeekLocation);
+      return true;
+    }
+
+    fileSeekLocation += rEntries[i].UncompressedDataSize;
+  }
+
+  return false;
+}
+
+/* Lays the entries out one after the other behind the uop header, each behind its metadata */
+static void buildEntries(const std::vector<uint32_t>& rSizes, std::vector<FileEntry>& rEntries)
+{
+  rEntries.assign(rSizes.size(), FileEntry());
+
+  uint64_t fileOffset = HEADER_LENGTH;
+  for (uint32_t i = 0; i < rSizes.size(); i++)
+  {
+    rEntries[i].UopFileOffset = fileOffset;
+    rEntries[i].MetaDataSize = getRandom(3) * 12;
+    rEntries[i].CompressedDataSize = rSizes[i];
+    rEntries[i].UncompressedDataSize = rSizes[i];
+    fileOffset += rEntries[i].MetaDataSize + rSizes[i];
+  }
+}
+
+static void buildTable(const std::vector<FileEntry>& rEntries, UopBlockTable& rTable)
+{
+  rTable.clear();
+  for (uint32_t i = 0; i < rEntries.size(); i++)
+  {
+    rTable.addEntry(rEntries[i]);
+  }
+}
+
+//the entry sizes of the shipped map files, every entry but the last holds the same number of blocks
+static void getShippedSizes(uint32_t numberOfBlocks, std::vector<uint32_t>& rSizes)
+{
+  rSizes.clear();
+  for (uint32_t block = 0; block < numberOfBlocks; block += BLOCKS_PER_ENTRY)
+  {
+    uint32_t blocks = numberOfBlocks - block < BLOCKS_PER_ENTRY ? numberOfBlocks - block : BLOCKS_PER_ENTRY;
+    rSizes.push_back(blocks * BLOCK_LENGTH);
+  }
+}
+
+static bool checkLayout(const char* pName, const std::vector<uint32_t>& rSizes, bool uniform)
+{
+  std::vector<FileEntry> entries;
+  buildEntries(rSizes, entries);
+
+  UopBlockTable table;
+  buildTable(entries, table);
+
+  if (table.isUniform() != uniform)
+  {
+    printf("  the %s layout is%s taken to be uniform\n", pName, uniform ? " not" : "");
+    return false;
+  }
+
+  uint32_t numberOfBlocks = table.getTotalDataSize() / BLOCK_LENGTH;
+  for (uint32_t block = 0; block < numberOfBlocks + 8; block++)
+  {
+    uint32_t poolOffset = 0;
+    uint32_t referencePoolOffset = 0;
+    bool found = table.find(block, poolOffset);
+    bool referenceFound = block < numberOfBlocks && findScanning(entries, block, referencePoolOffset);
+
+    if (found != referenceFound || (found && poolOffset != referencePoolOffset))
+    {
+      printf("  the %s layout puts block %u at %s%u instead of %s%u\n", pName, block, found ? "" : "none ", poolOffset, 
+        referenceFound ? "" : "none ", referencePoolOffset);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* Checks the table against the walk through the entries it replaced, for the layout of the shipped map files and for 
+ * layouts that need the binary search: entries of any size, empty ones and a last entry that is longer than the rest
+ */
+bool testUopBlockTable()
+{
+  std::vector<uint32_t> sizes;
+
+  getShippedSizes(NUMBER_OF_MAP_BLOCKS, sizes);
+  if (!checkLayout("shipped", sizes, true))
+  {
+    return false;
+  }
+
+  getShippedSizes(NUMBER_OF_MAP_BLOCKS - 1000, sizes);
+  if (!checkLayout("short last entry", sizes, true))
+  {
+    return false;
+  }
+
+  getShippedSizes(BLOCKS_PER_ENTRY * 4, sizes);
+  sizes.back() += 100 * BLOCK_LENGTH;
+  if (!checkLayout("long last entry", sizes, true))
+  {
+    return false;
+  }
+
+  sizes.assign(1, 10 * BLOCK_LENGTH);
+  if (!checkLayout("single entry", sizes, true))
+  {
+    return false;
+  }
+
+  sizes.clear();
+  for (uint32_t i = 0; i < 300; i++)
+  {
+    sizes.push_back(getRandom(4) == 0 ? 0 : getRandom(BLOCKS_PER_ENTRY) * BLOCK_LENGTH);
+  }
+
+  if (!checkLayout("uneven", sizes, false))
+  {
+    return false;
+  }
+
+  //entries that don't end on a block boundary split blocks between them, which are read from the first one
+  sizes.clear();
+  for (uint32_t i = 0; i < 300; i++)
+  {
+    sizes.push_back(getRandom(BLOCKS_PER_ENTRY * BLOCK_LENGTH));
+  }
+
+  if (!checkLayout("unaligned", sizes, false))
+  {
+    return false;
+  }
+
+  sizes.clear();
+  if (!checkLayout("empty", sizes, false))
+  {
+    return false;
+  }
+
+  return true;
+}
+
+static double timeLookups(const std::vector<FileEntry>& rEntries, const std::vector<uint32_t>& rBlocks, const UopBlockTable* pTable)
+{
+  volatile uint32_t sum = 0;
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < rBlocks.size(); i++)
+  {
+    uint32_t poolOffset = 0;
+    if (pTable != NULL ? pTable->find(rBlocks[i], poolOffset) : findScanning(rEntries, rBlocks[i], poolOffset))
+    {
+      sum += poolOffset;
+    }
+  }
+
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+/* Times finding land blocks in map0LegacyMUL.uop in random order, the way the server's block queries and updates 
+ * arrive, through the table and through the walk over the entries it replaced, for the shipped layout and for one that
+ * needs the binary search
+ */
+void benchmarkUopBlockLookup()
+{
+  static const uint32_t NUMBER_OF_LOOKUPS = 1000000;
+
+  std::vector<uint32_t> blocks(NUMBER_OF_LOOKUPS);
+  for (uint32_t i = 0; i < NUMBER_OF_LOOKUPS; i++)
+  {
+    blocks[i] = getRandom(NUMBER_OF_MAP_BLOCKS);
+  }
+
+  std::vector<uint32_t> sizes;
+  getShippedSizes(NUMBER_OF_MAP_BLOCKS, sizes);
+
+  std::vector<FileEntry> entries;
+  buildEntries(sizes, entries);
+  UopBlockTable table;
+  buildTable(entries, table);
+
+  uint32_t numberOfEntries = table.getNumberOfEntries();
+  double scanMs = timeLookups(entries, blocks, NULL);
+  double uniformMs = timeLookups(entries, blocks, &table);
+
+  //the same blocks spread over entries of uneven size
+  uint32_t remainingBlocks = NUMBER_OF_MAP_BLOCKS;
+  sizes.clear();
+  while (remainingBlocks > 0)
+  {
+    uint32_t entryBlocks = BLOCKS_PER_ENTRY / 2 + getRandom(BLOCKS_PER_ENTRY);
+    entryBlocks = entryBlocks < remainingBlocks ? entryBlocks : remainingBlocks;
+    sizes.push_back(entryBlocks * BLOCK_LENGTH);
+    remainingBlocks -= entryBlocks;
+  }
+
+  buildEntries(sizes, entries);
+  buildTable(entries, table);
+  double unevenScanMs = timeLookups(entries, blocks, NULL);
+  double searchMs = timeLookups(entries, blocks, &table);
+
+  printf("Uop land block lookup of %u blocks: table %.2f ms (entry walk %.2f ms) over %u entries, binary search %.2f ms (entry walk %.2f ms) over %u uneven entries\n",
+    NUMBER_OF_LOOKUPS, uniformMs, scanMs, numberOfEntries, searchMs, unevenScanMs, table.getNumberOfEntries());
+}
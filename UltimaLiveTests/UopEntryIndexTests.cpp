@@ -0,0 +1,195 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include "../UltimaLive/FileSystem/Uop/UopEntryIndex.h"
+#include "../UltimaLive/FileSystem/Uop/UopPathHash.h"
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const uint32_t NUMBER_OF_MAP_ENTRIES = 20000;
+static const uint32_t NUMBER_OF_EXTRA_ENTRIES = 500;
+
+//the original way of hashing the entry names, one formatted name per entry
+static void getMapHashesReference(uint32_t count, std::string pattern, std::vector<uint64_t>& rHashes)
+{
+  rHashes.resize(count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    std::stringstream name;
+    name << "build/" << pattern << "/";
+    name.width(8);
+    name.fill('0');
+    name << i << ".dat";
+    rHashes[i] = UopPathHash::HashFileName(name.str());
+  }
+}
+
+//the original search through the file table, the first entry with the hash wins
+static int32_t findNested(const std::vector<FileEntry>& rEntries, uint64_t pathChecksum)
+{
+  for (uint32_t j = 0; j < rEntries.size(); j++)
+  {
+    if (rEntries[j].PathChecksum == pathChecksum)
+    {
+      return static_cast<int32_t>(j);
+    }
+  }
+
+  return UopEntryIndex::EMPTY_SLOT;
+}
+
+/* A synthetic file table for a map, stored in shuffled order with some duplicate and foreign entries mixed in, the 
+ * way a patched uop can look
+ */
+static void buildFileTable(const std::vector<uint64_t>& rHashes, std::vector<FileEntry>& rEntries)
+{
+  uint32_t numberOfEntries = NUMBER_OF_MAP_ENTRIES + NUMBER_OF_EXTRA_ENTRIES * 2;
+  rEntries.assign(numberOfEntries, FileEntry());
+
+  for (uint32_t i = 0; i < numberOfEntries; i++)
+  {
+    rEntries[i].UopFileOffset = i;
+    if (i < NUMBER_OF_MAP_ENTRIES)
+    {
+      rEntries[i].PathChecksum = rHashes[i];
+    }
+    else if (i < NUMBER_OF_MAP_ENTRIES + NUMBER_OF_EXTRA_ENTRIES)
+    {
+      rEntries[i].PathChecksum = rHashes[getRandom(NUMBER_OF_MAP_ENTRIES)];
+    }
+    else
+    {
+      rEntries[i].PathChecksum = (static_cast<uint64_t>(getTestRandom()()) << 32) | getTestRandom()();
+    }
+  }
+
+  for (uint32_t i = NUMBER_OF_MAP_ENTRIES - 1; i > 0; i--)
+  {
+    uint32_t j = getRandom(i + 1);
+    FileEntry swapped = rEntries[i];
+    rEntries[i] = rEntries[j];
+    rEntries[j] = swapped;
+  }
+}
+
+/* Checks the entry name hashes against the original formatted names, and the index against the nested search it 
+ * replaced on a synthetic file table, including tables small enough to stay at the minimum number of slots
+ */
+bool testUopEntryIndex()
+{
+  std::vector<uint64_t> hashes;
+  std::vector<uint64_t> referenceHashes;
+  UopPathHash::getMapHashes(NUMBER_OF_MAP_ENTRIES, "map0legacymul", hashes);
+  getMapHashesReference(NUMBER_OF_MAP_ENTRIES, "map0legacymul", referenceHashes);
+
+  for (uint32_t i = 0; i < NUMBER_OF_MAP_ENTRIES; i++)
+  {
+    if (hashes[i] != referenceHashes[i])
+    {
+      printf("  the name hash of entry %u differs from the formatted name's\n", i);
+      return false;
+    }
+  }
+
+  std::vector<FileEntry> entries;
+  buildFileTable(hashes, entries);
+
+  UopEntryIndex index;
+  index.build(&entries[0], static_cast<uint32_t>(entries.size()));
+  for (uint32_t i = 0; i < NUMBER_OF_MAP_ENTRIES; i++)
+  {
+    if (index.find(hashes[i]) != findNested(entries, hashes[i]))
+    {
+      printf("  the index finds a different entry for block %u than the nested search\n", i);
+      return false;
+    }
+  }
+
+  if (index.find(0) != UopEntryIndex::EMPTY_SLOT || index.getNumberOfEntries() != entries.size())
+  {
+    printf("  the index finds an entry that isn't there\n");
+    return false;
+  }
+
+  for (uint32_t numberOfEntries = 0; numberOfEntries < 12; numberOfEntries++)
+  {
+    std::vector<FileEntry> small(entries.begin(), entries.begin() + numberOfEntries);
+    UopEntryIndex smallIndex;
+    smallIndex.build(small.empty() ? NULL : &small[0], numberOfEntries);
+
+    for (uint32_t i = 0; i < NUMBER_OF_MAP_ENTRIES; i += 97)
+    {
+      if (smallIndex.find(hashes[i]) != findNested(small, hashes[i]))
+      {
+        printf("  an index of %u entries finds a different entry for block %u than the nested search\n", numberOfEntries, i);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/* Times matching every block of a map to its entry: the name hashes against the formatted names, and the index 
+ * against the nested search
+ */
+void benchmarkUopEntryIndex()
+{
+  std::vector<uint64_t> hashes;
+  std::vector<uint64_t> referenceHashes;
+
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  getMapHashesReference(NUMBER_OF_MAP_ENTRIES, "map0legacymul", referenceHashes);
+  std::chrono::steady_clock::time_point referenceHashTime = std::chrono::steady_clock::now();
+  UopPathHash::getMapHashes(NUMBER_OF_MAP_ENTRIES, "map0legacymul", hashes);
+  std::chrono::steady_clock::time_point hashTime = std::chrono::steady_clock::now();
+
+  std::vector<FileEntry> entries;
+  buildFileTable(hashes, entries);
+  volatile int32_t found = 0;
+
+  std::chrono::steady_clock::time_point nestedStartTime = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < NUMBER_OF_MAP_ENTRIES; i++)
+  {
+    found += findNested(entries, hashes[i]);
+  }
+  std::chrono::steady_clock::time_point nestedTime = std::chrono::steady_clock::now();
+
+  UopEntryIndex index;
+  index.build(&entries[0], static_cast<uint32_t>(entries.size()));
+  for (uint32_t i = 0; i < NUMBER_OF_MAP_ENTRIES; i++)
+  {
+    found += index.find(hashes[i]);
+  }
+  std::chrono::steady_clock::time_point indexTime = std::chrono::steady_clock::now();
+
+  printf("Uop entry matching of %u entries: name hashes %.2f ms (formatted names %.2f ms), index %.2f ms (nested search %.2f ms)\n", 
+    static_cast<uint32_t>(entries.size()), std::chrono::duration<double, std::milli>(hashTime - referenceHashTime).count(), 
+    std::chrono::duration<double, std::milli>(referenceHashTime - startTime).count(), std::chrono::duration<double, std::milli>(indexTime - nestedTime).count(), 
+    std::chrono::duration<double, std::milli>(nestedTime - nestedStartTime).count());
+}
@@ -0,0 +1,394 @@
+/* Copyright(c) 2016 UltimaLive
+*
+* Permission is hereby granted, free of charge, to any person obtaining
+* a copy of this software and associated documentation files (the
+* "Software"), to deal in the Software without restriction, including
+* without limitation the rights to use, copy, modify, merge, publish,
+* distribute, sublicense, and/or sell copies of the Software, and to
+* permit persons to whom the Software is furnished to do so, subject to
+* the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+
+#include "UltimaLiveTests.h"
+#include "../UltimaLive/FileSystem/Uop/UopReader.h"
+#include "../UltimaLive/FileSystem/Uop/Inflate.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/* Writes a uop file into a buffer: the header, file tables wherever they are put and entry data after them */
+class UopBuilder
+{
+  public:
+    UopBuilder()
+      : m_data(UopReader::HEADER_SIZE, 0)
+    {
+      write32(0, UopReader::UOP_IDENTIFIER);
+      write32(4, 5);
+    }
+
+    //a file table with capacity empty slots at the end of the file, returns its offset
+    uint32_t addFileTable(uint32_t capacity)
+    {
+      uint32_t offset = static_cast<uint32_t>(m_data.size());
+      m_data.resize(m_data.size() + UopReader::FILE_TABLE_HEADER_SIZE + capacity * UopReader::FILE_ENTRY_SIZE, 0);
+      write32(offset, capacity);
+      return offset;
+    }
+
+    void setFirstFileTable(uint64_t offset)
+    {
+      write64(12, offset);
+    }
+
+    void setNextFileTable(uint32_t fileTable, uint64_t nextOffset)
+    {
+      write64(fileTable + 4, nextOffset);
+    }
+
+    //adds data to the end of the file and points a slot at it, returns the entry the slot describes
+    FileEntry addEntry(uint32_t fileTable, uint32_t slot, uint64_t pathChecksum, const std::vector<uint8_t>& rStored, uint32_t uncompressedSize, uint16_t compressionMethod)
+    {
+      static const uint32_t META_DATA_SIZE = 8;
+
+      FileEntry entry;
+      entry.UopFileOffset = m_data.size();
+      entry.MetaDataSize = META_DATA_SIZE;
+      entry.CompressedDataSize = static_cast<uint32_t>(rStored.size());
+      entry.UncompressedDataSize = uncompressedSize;
+      entry.PathChecksum = pathChecksum;
+      entry.MetadataCrc = 0;
+      entry.CompressionMethod = compressionMethod;
+
+      m_data.resize(m_data.size() + META_DATA_SIZE, 0xEE);
+      m_data.insert(m_data.end(), rStored.begin(), rStored.end());
+      setSlot(fileTable, slot, entry);
+      return entry;
+    }
+
+    void setSlot(uint32_t fileTable, uint32_t slot, const FileEntry& rEntry)
+    {
+      uint32_t offset = fileTable + UopReader::FILE_TABLE_HEADER_SIZE + slot * UopReader::FILE_ENTRY_SIZE;
+      write64(offset, rEntry.UopFileOffset);
+      write32(offset + 8, rEntry.MetaDataSize);
+      write32(offset + 12, rEntry.CompressedDataSize);
+      write32(offset + 16, rEntry.UncompressedDataSize);
+      write64(offset + 20, rEntry.PathChecksum);
+      write32(offset + 28, rEntry.MetadataCrc);
+      memcpy(&m_data[offset + 32], &rEntry.CompressionMethod, sizeof(uint16_t));
+    }
+
+    void write32(uint32_t offset, uint32_t value)
+    {
+      memcpy(&m_data[offset], &value, sizeof(value));
+    }
+
+    void write64(uint32_t offset, uint64_t value)
+    {
+      memcpy(&m_data[offset], &value, sizeof(value));
+    }
+
+    std::vector<uint8_t>& getData()
+    {
+      return m_data;
+    }
+
+  private:
+    std::vector<uint8_t> m_data;
+};
+
+static std::vector<uint8_t> getTestData(uint32_t length)
+{
+  std::vector<uint8_t> data(length);
+  for (uint32_t i = 0; i < length; i++)
+  {
+    data[i] = static_cast<uint8_t>(getRandom(256));
+  }
+
+  return data;
+}
+
+//a zlib stream of one stored block
+static std::vector<uint8_t> getStoredStream(const std::vector<uint8_t>& rData)
+{
+  uint16_t length = static_cast<uint16_t>(rData.size());
+  uint32_t adler = Inflate::adler32(&rData[0], static_cast<uint32_t>(rData.size()));
+
+  std::vector<uint8_t> stream;
+  stream.push_back(0x78);
+  stream.push_back(0x01);
+  stream.push_back(0x01);
+  stream.push_back(static_cast<uint8_t>(length));
+  stream.push_back(static_cast<uint8_t>(length >> 8));
+  stream.push_back(static_cast<uint8_t>(~length));
+  stream.push_back(static_cast<uint8_t>(~length >> 8));
+  stream.insert(stream.end(), rData.begin(), rData.end());
+  stream.push_back(static_cast<uint8_t>(adler >> 24));
+  stream.push_back(static_cast<uint8_t>(adler >> 16));
+  stream.push_back(static_cast<uint8_t>(adler >> 8));
+  stream.push_back(static_cast<uint8_t>(adler));
+  return stream;
+}
+
+static bool attach(UopReader& rReader, std::vector<uint8_t>& rData)
+{
+  return rReader.attach(&rData[0], static_cast<uint32_t>(rData.size()));
+}
+
+/* Walks the entries with an iterator and as a copied out list, and checks both against the expected entries and 
+ * their data
+ */
+static bool checkEntries(const char* pName, UopReader& rReader, const std::vector<FileEntry>& rExpected, const std::vector<std::vector<uint8_t> >& rContents)
+{
+  uint32_t index = 0;
+  uint32_t totalSize = 0;
+  for (UopReader::EntryIterator itr = rReader.getEntries(); itr.isValid(); itr.next())
+  {
+    if (index >= rExpected.size() || itr.getPathChecksum() != rExpected[index].PathChecksum || 
+      itr.getUncompressedSize() != rExpected[index].UncompressedDataSize || itr.getCompressionMethod() != rExpected[index].CompressionMethod)
+    {
+      printf("  %s: entry %u of the iterator is not the expected one\n", pName, index);
+      return false;
+    }
+
+    totalSize += rExpected[index].UncompressedDataSize;
+    index++;
+  }
+
+  if (index != rExpected.size() || rReader.getUncompressedSize() != totalSize)
+  {
+    printf("  %s: the iterator found %u entries instead of %u\n", pName, index, static_cast<uint32_t>(rExpected.size()));
+    return false;
+  }
+
+  std::vector<FileEntry> entries;
+  rReader.getEntries(entries);
+  if (entries.size() != rExpected.size())
+  {
+    printf("  %s: %u entries copied out instead of %u\n", pName, static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(rExpected.size()));
+    return false;
+  }
+
+  for (uint32_t i = 0; i < entries.size(); i++)
+  {
+    std::vector<uint8_t> data(entries[i].UncompressedDataSize + 1, 0xCD);
+    if (entries[i].UopFileOffset != rExpected[i].UopFileOffset || entries[i].MetaDataSize != rExpected[i].MetaDataSize || 
+      entries[i].CompressedDataSize != rExpected[i].CompressedDataSize || !rReader.readData(entries[i], &data[0]) || 
+      memcmp(&data[0], &rContents[i][0], rContents[i].size()) != 0 || data.back() != 0xCD)
+    {
+      printf("  %s: entry %u doesn't read back\n", pName, i);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* A chain of three tables with empty slots at the end of the first, all of the second and the start of the third, 
+ * holding raw and zlib entries
+ */
+static bool testChainedTables()
+{
+  UopBuilder builder;
+  uint32_t tables[3];
+  for (uint32_t i = 0; i < 3; i++)
+  {
+    tables[i] = builder.addFileTable(5);
+  }
+
+  builder.setFirstFileTable(tables[0]);
+  builder.setNextFileTable(tables[0], tables[1]);
+  builder.setNextFileTable(tables[1], tables[2]);
+
+  static const uint32_t SLOTS[][2] = { { 0, 0 }, { 0, 1 }, { 0, 2 }, { 2, 3 }, { 2, 4 } };
+  std::vector<FileEntry> expected;
+  std::vector<std::vector<uint8_t> > contents;
+  for (uint32_t i = 0; i < sizeof(SLOTS) / sizeof(SLOTS[0]); i++)
+  {
+    contents.push_back(getTestData(100 + i * 37));
+    if (i % 2 == 0)
+    {
+      expected.push_back(builder.addEntry(tables[SLOTS[i][0]], SLOTS[i][1], 0x1000 + i, contents.back(), static_cast<uint32_t>(contents.back().size()), UopReader::COMPRESSION_NONE));
+    }
+    else
+    {
+      expected.push_back(builder.addEntry(tables[SLOTS[i][0]], SLOTS[i][1], 0x1000 + i, getStoredStream(contents.back()), static_cast<uint32_t>(contents.back().size()), UopReader::COMPRESSION_ZLIB));
+    }
+  }
+
+  UopReader reader;
+  if (!attach(reader, builder.getData()))
+  {
+    printf("  chained tables: the file was turned down\n");
+    return false;
+  }
+
+  if (!checkEntries("chained tables", reader, expected, contents))
+  {
+    return false;
+  }
+
+  //an entry whose data runs past the end of the file can't be read
+  FileEntry pastTheEnd = expected[0];
+  pastTheEnd.UncompressedDataSize = static_cast<uint32_t>(builder.getData().size());
+  std::vector<uint8_t> data(pastTheEnd.UncompressedDataSize);
+  if (reader.getData(pastTheEnd) != NULL || reader.readData(pastTheEnd, &data[0]))
+  {
+    printf("  chained tables: an entry past the end of the file was read\n");
+    return false;
+  }
+
+  return true;
+}
+
+/* Files with nothing in them: no file table at all, and a chain of tables whose slots are all empty */
+static bool testEmptyTables()
+{
+  std::vector<FileEntry> expected;
+  std::vector<std::vector<uint8_t> > contents;
+
+  UopBuilder noTables;
+  UopReader reader;
+  if (!attach(reader, noTables.getData()) || !checkEntries("no tables", reader, expected, contents))
+  {
+    printf("  a file without file tables is not read as empty\n");
+    return false;
+  }
+
+  UopBuilder emptyTables;
+  uint32_t first = emptyTables.addFileTable(3);
+  uint32_t second = emptyTables.addFileTable(0);
+  uint32_t third = emptyTables.addFileTable(4);
+  emptyTables.setFirstFileTable(first);
+  emptyTables.setNextFileTable(first, second);
+  emptyTables.setNextFileTable(second, third);
+  if (!attach(reader, emptyTables.getData()) || !checkEntries("empty tables", reader, expected, contents))
+  {
+    printf("  a chain of empty tables is not read as empty\n");
+    return false;
+  }
+
+  return true;
+}
+
+/* Chains that loop back into a table that was already read, and tables that lie partly or wholly outside of the file,
+ * are turned down
+ */
+static bool testDamagedChains()
+{
+  UopReader reader;
+
+  UopBuilder selfLoop;
+  uint32_t table = selfLoop.addFileTable(2);
+  selfLoop.setFirstFileTable(table);
+  selfLoop.setNextFileTable(table, table);
+  if (attach(reader, selfLoop.getData()))
+  {
+    printf("  a table that chains to itself is read\n");
+    return false;
+  }
+
+  UopBuilder loop;
+  uint32_t first = loop.addFileTable(2);
+  uint32_t second = loop.addFileTable(2);
+  loop.setFirstFileTable(first);
+  loop.setNextFileTable(first, second);
+  loop.setNextFileTable(second, first);
+  if (attach(reader, loop.getData()))
+  {
+    printf("  a chain that loops back to its first table is read\n");
+    return false;
+  }
+
+  //a table that starts inside the slots of a table before it
+  loop.setNextFileTable(second, first + UopReader::FILE_TABLE_HEADER_SIZE + UopReader::FILE_ENTRY_SIZE);
+  if (attach(reader, loop.getData()))
+  {
+    printf("  a chain into the slots of an earlier table is read\n");
+    return false;
+  }
+
+  //the chain ends cleanly again
+  loop.setNextFileTable(second, 0);
+  if (!attach(reader, loop.getData()))
+  {
+    printf("  a chain of two tables is turned down\n");
+    return false;
+  }
+
+  UopBuilder outOfRange;
+  first = outOfRange.addFileTable(2);
+  uint32_t size = static_cast<uint32_t>(outOfRange.getData().size());
+
+  //past the end of the file, past 4 GB, at the end of the file and with the table header running past it
+  uint64_t badOffsets[] = { 0xFFFFFFFFFFFFFFF0ULL, 0x100000000ULL, size, size - UopReader::FILE_TABLE_HEADER_SIZE + 1 };
+  for (uint32_t i = 0; i < sizeof(badOffsets) / sizeof(badOffsets[0]); i++)
+  {
+    outOfRange.setFirstFileTable(badOffsets[i]);
+    if (attach(reader, outOfRange.getData()))
+    {
+      printf("  a first file table at 0x%llx in a file of %u bytes is read\n", static_cast<unsigned long long>(badOffsets[i]), size);
+      return false;
+    }
+
+    outOfRange.setFirstFileTable(first);
+    outOfRange.setNextFileTable(first, badOffsets[i]);
+    if (attach(reader, outOfRange.getData()))
+    {
+      printf("  a next file table at 0x%llx in a file of %u bytes is read\n", static_cast<unsigned long long>(badOffsets[i]), size);
+      return false;
+    }
+
+    outOfRange.setNextFileTable(first, 0);
+  }
+
+  //a table whose slots run past the end of the file, with a capacity big enough to overflow 32 bits of slot bytes
+  static const uint32_t BAD_CAPACITIES[] = { 3, 0x7878788, 0xFFFFFFFF };
+  for (uint32_t i = 0; i < sizeof(BAD_CAPACITIES) / sizeof(BAD_CAPACITIES[0]); i++)
+  {
+    outOfRange.write32(first, BAD_CAPACITIES[i]);
+    if (attach(reader, outOfRange.getData()))
+    {
+      printf("  a table of %u slots in a file of %u bytes is read\n", BAD_CAPACITIES[i], size);
+      return false;
+    }
+  }
+
+  outOfRange.write32(first, 2);
+  if (!attach(reader, outOfRange.getData()))
+  {
+    printf("  a table that fills the file is turned down\n");
+    return false;
+  }
+
+  //something that isn't a uop file at all
+  outOfRange.write32(0, 0x12345678);
+  if (attach(reader, outOfRange.getData()) || reader.attach(&outOfRange.getData()[0], UopReader::HEADER_SIZE - 1))
+  {
+    printf("  a file that isn't a uop file is read\n");
+    return false;
+  }
+
+  return true;
+}
+
+/* Reads synthetic uop files through attach: chained file tables with empty slots on both sides of the table 
+ * boundaries, files without entries, and chains that loop or point outside of the file
+ */
+bool testUopReader()
+{
+  return testChainedTables() && testEmptyTables() && testDamagedChains();
+}